@@ -0,0 +1,549 @@
+// Headless microbenchmarks of the editor core: the gap buffer, buffer edits and line indexing, syntax lexing per
+// provider, line span layout, search, key mapping and fuzzy file matching.
+// Each benchmark is run for at least --time seconds a sample, and the median of the samples is reported in ns per
+// operation.  --json writes the results, and --baseline compares against results written before; a benchmark slower
+// than the baseline by more than --threshold percent fails the run:
+//   zep_bench [--filter <text>] [--time <seconds>] [--json <file>] [--baseline <file>] [--threshold <percent>]
+#include "config_app.h"
+
+#include "zep/buffer.h"
+#include "zep/display.h"
+#include "zep/editor.h"
+#include "zep/indexer.h"
+#include "zep/keymap.h"
+#include "zep/mode_search.h"
+#include "zep/mode_vim.h"
+#include "zep/syntax.h"
+#include "zep/tab_window.h"
+#include "zep/window.h"
+
+#include "zep/mcommon/animation/timer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <sstream>
+
+using namespace Zep;
+
+namespace
+{
+
+const int SampleCount = 5;
+
+struct BenchResult
+{
+    std::string name;
+    double nsPerOp = 0.0;
+    uint64_t iterations = 0;
+};
+
+struct BenchOptions
+{
+    std::string filter;
+    double seconds = 0.1;
+};
+
+// A fixed sequence, so that every run does the same work
+struct BenchRandom
+{
+    uint32_t state = 12345;
+    uint32_t Next(uint32_t range)
+    {
+        state = state * 1664525u + 1013904223u;
+        return (state >> 8) % range;
+    }
+};
+
+std::string ReadScaled(const std::string& path, size_t targetSize)
+{
+    std::ifstream in(path, std::ios::in | std::ios::binary);
+    std::ostringstream str;
+    str << in.rdbuf();
+    auto text = str.str();
+    if (text.empty())
+    {
+        return text;
+    }
+    if (text.back() != '\n')
+    {
+        text += '\n';
+    }
+
+    std::string scaled;
+    scaled.reserve(targetSize + text.size());
+    while (scaled.size() < targetSize)
+    {
+        scaled += text;
+    }
+    return scaled;
+}
+
+// Double the iterations until a run takes long enough to time, then take the median of a few runs of that many
+bool RunBench(const BenchOptions& options, const std::string& name, const std::function<void(uint64_t)>& fnRun, std::vector<BenchResult>& results)
+{
+    if (!options.filter.empty() && name.find(options.filter) == std::string::npos)
+    {
+        return false;
+    }
+
+    uint64_t iterations = 1;
+    for (;;)
+    {
+        auto start = profile_get_time_ns();
+        fnRun(iterations);
+        if (double(profile_get_time_ns() - start) >= options.seconds * 1e9 || iterations >= (1ull << 40))
+        {
+            break;
+        }
+        iterations *= 2;
+    }
+
+    std::vector<double> samples;
+    for (int sample = 0; sample < SampleCount; sample++)
+    {
+        auto start = profile_get_time_ns();
+        fnRun(iterations);
+        samples.push_back(double(profile_get_time_ns() - start) / iterations);
+    }
+    std::sort(samples.begin(), samples.end());
+
+    BenchResult result;
+    result.name = name;
+    result.nsPerOp = samples[SampleCount / 2];
+    result.iterations = iterations;
+    results.push_back(result);
+
+    printf("%-36s %14.1f %12llu\n", name.c_str(), result.nsPerOp, (unsigned long long)iterations);
+    fflush(stdout);
+    return true;
+}
+
+void WriteJson(const std::string& path, const std::vector<BenchResult>& results)
+{
+    std::ofstream out(path, std::ios::out | std::ios::binary);
+    out << "{\"benchmarks\":[\n";
+    for (size_t index = 0; index < results.size(); index++)
+    {
+        char line[64];
+        snprintf(line, sizeof(line), "%.1f", results[index].nsPerOp);
+        out << "{\"name\":\"" << results[index].name << "\",\"ns_per_op\":" << line << ",\"iterations\":" << results[index].iterations << "}";
+        out << (index + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "]}\n";
+}
+
+// Reads back what WriteJson wrote; one benchmark to a line
+std::map<std::string, double> ReadJson(const std::string& path)
+{
+    std::map<std::string, double> baseline;
+    std::ifstream in(path, std::ios::in | std::ios::binary);
+    std::string line;
+    while (std::getline(in, line))
+    {
+        auto namePos = line.find("\"name\":\"");
+        auto nsPos = line.find("\"ns_per_op\":");
+        if (namePos == std::string::npos || nsPos == std::string::npos)
+        {
+            continue;
+        }
+        namePos += 8;
+        auto nameEnd = line.find('"', namePos);
+        baseline[line.substr(namePos, nameEnd - namePos)] = strtod(line.c_str() + nsPos + 12, nullptr);
+    }
+    return baseline;
+}
+
+// The vim normal mode map, as the mode sets it up
+class BenchVimMode : public ZepMode_Vim
+{
+public:
+    BenchVimMode(ZepEditor& editor)
+        : ZepMode_Vim(editor)
+    {
+    }
+
+    const KeyMap& GetNormalMap() const
+    {
+        return m_normalMap;
+    }
+};
+
+void BenchGapBuffer(const BenchOptions& options, std::vector<BenchResult>& results)
+{
+    const char chars[] = "abcdefgh";
+
+    // Typing: each character after the last one
+    RunBench(options, "gap_buffer/insert_sequential_4k", [&](uint64_t count) {
+        for (uint64_t iteration = 0; iteration < count; iteration++)
+        {
+            GapBuffer<uint8_t> buffer;
+            for (int index = 0; index < 4096; index++)
+            {
+                buffer.insert(buffer.begin() + index, chars + (index & 7), chars + (index & 7) + 1);
+            }
+        }
+    },
+        results);
+
+    // Jumping about a 64k buffer, which moves the gap each time
+    GapBuffer<uint8_t> buffer;
+    buffer.assign(size_t(65536), uint8_t('x'));
+    RunBench(options, "gap_buffer/insert_erase_random_64k", [&](uint64_t count) {
+        BenchRandom random;
+        for (uint64_t iteration = 0; iteration < count; iteration++)
+        {
+            auto insertAt = random.Next(uint32_t(buffer.size()));
+            buffer.insert(buffer.begin() + insertAt, chars, chars + 8);
+            auto eraseAt = random.Next(uint32_t(buffer.size() - 8));
+            buffer.erase(buffer.begin() + eraseAt, buffer.begin() + eraseAt + 8);
+        }
+    },
+        results);
+}
+
+void BenchBuffer(const BenchOptions& options, ZepEditor& editor, const std::string& source, std::vector<BenchResult>& results)
+{
+    auto largeText = ReadScaled(source, 4 * 1024 * 1024);
+    auto pBuffer = editor.InitWithText("bench.txt", largeText.substr(0, 1024 * 1024));
+
+    // A line added and taken away in the middle, which shifts the line index after it
+    auto middle = ByteIndex(pBuffer->GetText().size() / 2);
+    RunBench(options, "buffer/insert_delete_line_1m", [&](uint64_t count) {
+        for (uint64_t iteration = 0; iteration < count; iteration++)
+        {
+            pBuffer->Insert(middle, "inserted line\n");
+            pBuffer->Delete(middle, middle + 14);
+        }
+    },
+        results);
+
+    RunBench(options, "buffer/insert_delete_char_1m", [&](uint64_t count) {
+        for (uint64_t iteration = 0; iteration < count; iteration++)
+        {
+            pBuffer->Insert(middle, "x");
+            pBuffer->Delete(middle, middle + 1);
+        }
+    },
+        results);
+
+    // Not found, so the whole buffer is searched
+    const std::string missing = "not in the buffer";
+    RunBench(options, "buffer/find_1m", [&](uint64_t count) {
+        for (uint64_t iteration = 0; iteration < count; iteration++)
+        {
+            pBuffer->Find(0, (const uint8_t*)missing.c_str(), (const uint8_t*)missing.c_str() + missing.size());
+        }
+    },
+        results);
+
+    RunBench(options, "buffer/set_text_4m", [&](uint64_t count) {
+        for (uint64_t iteration = 0; iteration < count; iteration++)
+        {
+            pBuffer->SetText(largeText);
+        }
+    },
+        results);
+}
+
+void BenchSyntax(const BenchOptions& options, ZepEditor& editor, const std::string& source, std::vector<BenchResult>& results)
+{
+    // One file for each provider; the text is the same, so the grammars are compared on equal work
+    const char* extensions[] = { ".vert", ".hlsl", ".cpp", ".lsp", ".cmake", ".toml", ".tree" };
+    auto text = ReadScaled(source, 256 * 1024);
+    for (auto& extension : extensions)
+    {
+        auto pBuffer = editor.InitWithText(std::string("bench") + extension, text);
+        auto pSyntax = pBuffer->GetSyntax();
+        if (pSyntax == nullptr)
+        {
+            continue;
+        }
+
+        RunBench(options, std::string("syntax/update_256k") + extension, [&](uint64_t count) {
+            for (uint64_t iteration = 0; iteration < count; iteration++)
+            {
+                SyntaxJob job;
+                job.text.assign(pBuffer->GetText().begin(), pBuffer->GetText().end());
+                job.targetChar = ByteIndex(job.text.size() - 1);
+                pSyntax->UpdateSyntax(job);
+            }
+        },
+            results);
+    }
+}
+
+void BenchLayout(const BenchOptions& options, ZepEditor& editor, const std::string& source, std::vector<BenchResult>& results)
+{
+    auto pBuffer = editor.InitWithText("bench.txt", ReadScaled(source, 1024 * 1024));
+    auto pWindow = editor.GetActiveTabWindow()->GetActiveWindow();
+    pWindow->GetNumDisplayedLines();
+
+    // A change of width wraps every line again; the width flips on every call, across runs, so none is the same as
+    // the last
+    bool wide = false;
+    RunBench(options, "layout/line_spans_full_1m", [&](uint64_t count) {
+        for (uint64_t iteration = 0; iteration < count; iteration++)
+        {
+            wide = !wide;
+            pWindow->SetDisplayRegion(NRectf(0.0f, 0.0f, wide ? 1024.0f : 1000.0f, 1024.0f));
+            pWindow->GetNumDisplayedLines();
+        }
+    },
+        results);
+
+    // A key typed on the screen
+    ByteIndex lineStart, lineEnd;
+    pBuffer->GetLineOffsets(pBuffer->GetLineCount() / 2, lineStart, lineEnd);
+    pWindow->SetBufferCursor(lineStart);
+    RunBench(options, "layout/line_spans_edit_1m", [&](uint64_t count) {
+        for (uint64_t iteration = 0; iteration < count; iteration++)
+        {
+            pBuffer->Insert(lineStart, "x");
+            pWindow->GetNumDisplayedLines();
+            pBuffer->Delete(lineStart, lineStart + 1);
+            pWindow->GetNumDisplayedLines();
+        }
+    },
+        results);
+
+    // Enter and backspace in the middle of a small file and a file of a million lines, which add and remove a line
+    // each time.  The layout of the two takes about as long; the rest of the gap is the buffer moving its line ends
+    for (auto lineCount : { 100, 1000000 })
+    {
+        std::string text;
+        text.reserve(size_t(lineCount) * 16);
+        for (int line = 0; line < lineCount; line++)
+        {
+            text += "a line of text\n";
+        }
+        auto pLinesBuffer = editor.InitWithText("lines.txt", text);
+        auto pLinesWindow = editor.GetActiveTabWindow()->GetActiveWindow();
+        pLinesWindow->GetNumDisplayedLines();
+
+        pLinesBuffer->GetLineOffsets(lineCount / 2, lineStart, lineEnd);
+        pLinesWindow->SetBufferCursor(lineStart);
+        RunBench(options, lineCount == 100 ? "layout/line_spans_newline_100" : "layout/line_spans_newline_1m_lines", [&](uint64_t count) {
+            for (uint64_t iteration = 0; iteration < count; iteration++)
+            {
+                pLinesBuffer->Insert(lineStart, "\n");
+                pLinesWindow->GetNumDisplayedLines();
+                pLinesBuffer->Delete(lineStart, lineStart + 1);
+                pLinesWindow->GetNumDisplayedLines();
+            }
+        },
+            results);
+    }
+}
+
+void BenchKeymap(const BenchOptions& options, ZepEditor& editor, const std::string& source, std::vector<BenchResult>& results)
+{
+    BenchVimMode mode(editor);
+    mode.Init();
+
+    // Complete commands, counts, registers, captured chars, partial commands and misses
+    const char* commands[] = { "j", "dd", "3dd", "dw", "ciw", "\"ayy", "gg", "10G", "fx", "dfx", "d", "\"", "2d3w", "q" };
+    RunBench(options, "keymap/find_vim_normal", [&](uint64_t count) {
+        for (uint64_t iteration = 0; iteration < count; iteration++)
+        {
+            KeyMapResult result;
+            keymap_find(mode.GetNormalMap(), commands[iteration % (sizeof(commands) / sizeof(commands[0]))], result);
+        }
+    },
+        results);
+
+    // Key events through the vim mode, a key per op: motions, with counts and captured chars, that leave the text alone
+    editor.SetGlobalMode(ZepMode_Vim::StaticName());
+    editor.InitWithText("bench.txt", ReadScaled(source, 64 * 1024));
+    auto pMode = editor.GetActiveTabWindow()->GetActiveWindow()->GetBuffer().GetMode();
+    const std::string keys = "jjjwwbe3jkk2wfefbFe0$ggG";
+    RunBench(options, "keymap/keys_vim_normal", [&](uint64_t count) {
+        for (uint64_t iteration = 0; iteration < count; iteration++)
+        {
+            pMode->AddKeyPress(keys[iteration % keys.size()]);
+        }
+    },
+        results);
+}
+
+// Text pasted through the key path into insert mode, a key at a time and coalesced for the frame
+void BenchInput(const BenchOptions& options, ZepEditor& editor, const std::string& source, std::vector<BenchResult>& results)
+{
+    editor.SetGlobalMode(ZepMode_Vim::StaticName());
+    auto pBuffer = editor.InitWithText("paste.txt", "");
+    auto pMode = editor.GetActiveTabWindow()->GetActiveWindow()->GetBuffer().GetMode();
+
+    // Without jk, which would leave insert mode
+    auto fnPaste = [&](const std::string& text) {
+        pBuffer->SetText("");
+        pMode->AddKeyPress('i');
+        for (auto& ch : text)
+        {
+            pMode->AddKeyPress(ch == '\n' ? uint32_t(ExtKeys::RETURN) : ch == '\t' ? uint32_t(ExtKeys::TAB) : uint32_t(uint8_t(ch)));
+        }
+        pMode->AddKeyPress(ExtKeys::ESCAPE);
+    };
+
+    auto text = ReadScaled(source, 256 * 1024);
+    text.erase(std::remove_if(text.begin(), text.end(), [](char ch) { return ch == 'j' || ch == '\r'; }), text.end());
+    auto shortText = text.substr(0, 4 * 1024);
+    RunBench(options, "input/paste_4k", [&](uint64_t count) {
+        for (uint64_t iteration = 0; iteration < count; iteration++)
+        {
+            fnPaste(shortText);
+        }
+    },
+        results);
+
+    auto flags = editor.GetFlags();
+    editor.SetFlags(flags | ZepEditorFlags::CoalesceInput);
+    RunBench(options, "input/paste_256k_coalesced", [&](uint64_t count) {
+        for (uint64_t iteration = 0; iteration < count; iteration++)
+        {
+            fnPaste(text);
+        }
+    },
+        results);
+    editor.SetFlags(flags);
+}
+
+void BenchFuzzy(const BenchOptions& options, std::vector<BenchResult>& results)
+{
+    // A source tree of paths, with a few sharing each directory
+    const char* parts[] = { "src", "include", "zep", "mcommon", "tests", "demos", "imgui", "qt", "syntax", "buffer", "window", "mode", "editor", "theme", "file" };
+    const uint32_t partCount = uint32_t(sizeof(parts) / sizeof(parts[0]));
+    FileIndexResult files;
+    BenchRandom random;
+    for (int index = 0; index < 20000; index++)
+    {
+        std::string path = "/root";
+        auto depth = 2 + random.Next(4);
+        for (uint32_t level = 0; level < depth; level++)
+        {
+            path += std::string("/") + parts[random.Next(partCount)];
+        }
+        path += "_" + std::to_string(index) + ".cpp";
+        files.paths.push_back(ZepPath(path));
+        files.lowerPaths.push_back(string_tolower(path));
+    }
+
+    ZepMode_Search::IndexSet startSet;
+    for (uint32_t index = 0; index < uint32_t(files.paths.size()); index++)
+    {
+        startSet.indices.insert(std::make_pair(0, ZepMode_Search::SearchResult{ index, 0 }));
+    }
+
+    // Typing a search a character at a time, each one narrowing the last
+    for (auto caseImportant : { false, true })
+    {
+        const std::string search = caseImportant ? "zEp" : "zepbuf";
+        RunBench(options, caseImportant ? "fuzzy/filter_20k_case" : "fuzzy/filter_20k", [&](uint64_t count) {
+            for (uint64_t iteration = 0; iteration < count; iteration++)
+            {
+                auto spSet = ZepMode_Search::FilterIndexSet(startSet, files, search[0], caseImportant);
+                for (size_t ch = 1; ch < search.size(); ch++)
+                {
+                    spSet = ZepMode_Search::FilterIndexSet(*spSet, files, search[ch], caseImportant);
+                }
+            }
+        },
+            results);
+    }
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    BenchOptions options;
+    std::string jsonPath;
+    std::string baselinePath;
+    double threshold = 10.0;
+    for (int arg = 1; arg < argc; arg++)
+    {
+        if (strcmp(argv[arg], "--filter") == 0 && arg + 1 < argc)
+        {
+            options.filter = argv[++arg];
+        }
+        else if (strcmp(argv[arg], "--time") == 0 && arg + 1 < argc)
+        {
+            options.seconds = atof(argv[++arg]);
+        }
+        else if (strcmp(argv[arg], "--json") == 0 && arg + 1 < argc)
+        {
+            jsonPath = argv[++arg];
+        }
+        else if (strcmp(argv[arg], "--baseline") == 0 && arg + 1 < argc)
+        {
+            baselinePath = argv[++arg];
+        }
+        else if (strcmp(argv[arg], "--threshold") == 0 && arg + 1 < argc)
+        {
+            threshold = atof(argv[++arg]);
+        }
+        else
+        {
+            printf("Usage: zep_bench [--filter <text>] [--time <seconds>] [--json <file>] [--baseline <file>] [--threshold <percent>]\n");
+            return 1;
+        }
+    }
+
+    auto source = std::string(ZEP_ROOT) + "/tests/main.cpp";
+    if (ReadScaled(source, 1).empty())
+    {
+        printf("Missing: %s\n", source.c_str());
+        return 1;
+    }
+
+    ZepEditor editor(new ZepDisplayNull(), ZEP_ROOT, ZepEditorFlags::DisableThreads);
+    editor.SetDisplayRegion(NVec2f(0.0f, 0.0f), NVec2f(1024.0f, 1024.0f));
+
+    printf("%-36s %14s %12s\n", "Benchmark", "ns/op", "Iterations");
+    std::vector<BenchResult> results;
+    BenchGapBuffer(options, results);
+    BenchBuffer(options, editor, source, results);
+    BenchSyntax(options, editor, source, results);
+    BenchLayout(options, editor, source, results);
+    BenchKeymap(options, editor, source, results);
+    BenchInput(options, editor, source, results);
+    BenchFuzzy(options, results);
+
+    if (!jsonPath.empty())
+    {
+        WriteJson(jsonPath, results);
+    }
+
+    if (baselinePath.empty())
+    {
+        return 0;
+    }
+
+    auto baseline = ReadJson(baselinePath);
+    if (baseline.empty())
+    {
+        printf("No results in baseline: %s\n", baselinePath.c_str());
+        return 1;
+    }
+
+    int regressions = 0;
+    printf("\n%-36s %14s %14s %9s\n", "Benchmark", "Baseline", "Now", "Change");
+    for (auto& result : results)
+    {
+        auto itrBaseline = baseline.find(result.name);
+        if (itrBaseline == baseline.end() || itrBaseline->second <= 0.0)
+        {
+            printf("%-36s %14s %14.1f\n", result.name.c_str(), "-", result.nsPerOp);
+            continue;
+        }
+
+        auto change = (result.nsPerOp - itrBaseline->second) * 100.0 / itrBaseline->second;
+        auto regressed = change > threshold;
+        printf("%-36s %14.1f %14.1f %+8.1f%%%s\n", result.name.c_str(), itrBaseline->second, result.nsPerOp, change, regressed ? " SLOWER" : "");
+        regressions += regressed ? 1 : 0;
+    }
+    return regressions == 0 ? 0 : 2;
+}
@@ -0,0 +1,153 @@
+// A headless benchmark of drawing the editor.
+// The files in tests/ are repeated until they are large, loaded into an editor which records its draw calls instead
+// of rendering them, and timed while drawing, scrolling a page at a time and typing.  No GPU or window is needed, so
+// this runs on a build machine.  With --retain the display keeps the last frame, so only the changes are drawn:
+//   zep_frame_bench [--size <kb>] [--frames <count>] [--retain]
+#include "config_app.h"
+
+#include "zep/buffer.h"
+#include "zep/display_recorder.h"
+#include "zep/editor.h"
+#include "zep/mode.h"
+#include "zep/tab_window.h"
+#include "zep/window.h"
+
+#include "zep/mcommon/animation/timer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <sstream>
+
+using namespace Zep;
+
+namespace
+{
+
+struct BenchFile
+{
+    const char* path;     // Relative to the root
+    const char* name;     // The buffer name, which picks the syntax
+};
+
+const BenchFile BenchFiles[] = {
+    { "tests/main.cpp", "bench.cpp" },
+    { "tests/test.lsp", "bench.lsp" },
+    { "tests/tabs.txt", "tabs.txt" },
+    { "tests/utf8.txt", "utf8.txt" },
+    { "tests/required.txt", "required.txt" }
+};
+
+std::string ReadScaled(const std::string& path, size_t targetSize)
+{
+    std::ifstream in(path, std::ios::in | std::ios::binary);
+    std::ostringstream str;
+    str << in.rdbuf();
+    auto text = str.str();
+    if (text.empty())
+    {
+        return text;
+    }
+    if (text.back() != '\n')
+    {
+        text += '\n';
+    }
+
+    std::string scaled;
+    scaled.reserve(targetSize + text.size());
+    while (scaled.size() < targetSize)
+    {
+        scaled += text;
+    }
+    return scaled;
+}
+
+// Time a number of frames, each one after a step, and report the draw calls in the last of them
+void RunScenario(ZepEditor& editor, ZepDisplayRecorder& display, const char* fileName, const char* scenario, int frames, const std::function<void(int)>& fnStep)
+{
+    timer frameTimer;
+    uint64_t total = 0;
+    for (int frame = 0; frame < frames; frame++)
+    {
+        fnStep(frame);
+
+        display.BeginFrame();
+        timer_restart(frameTimer);
+        editor.Display();
+        total += timer_get_elapsed(frameTimer);
+    }
+
+    auto& stats = display.GetFrame().stats;
+    printf("%-14s %-8s %10.3f %8u %8u %8u %8u\n", fileName, scenario, timer_to_ms(total) / frames, stats.drawCalls, stats.chars, stats.glyphs, stats.rects);
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    size_t sizeKb = 1024;
+    int frames = 50;
+    bool retain = false;
+    for (int arg = 1; arg < argc; arg++)
+    {
+        if (strcmp(argv[arg], "--size") == 0 && arg + 1 < argc)
+        {
+            sizeKb = size_t(atoi(argv[++arg]));
+        }
+        else if (strcmp(argv[arg], "--frames") == 0 && arg + 1 < argc)
+        {
+            frames = std::max(1, atoi(argv[++arg]));
+        }
+        else if (strcmp(argv[arg], "--retain") == 0)
+        {
+            retain = true;
+        }
+        else
+        {
+            printf("Usage: zep_frame_bench [--size <kb>] [--frames <count>] [--retain]\n");
+            return 1;
+        }
+    }
+
+    printf("%-14s %-8s %10s %8s %8s %8s %8s\n", "File", "Test", "ms/frame", "Draws", "Chars", "Glyphs", "Rects");
+    for (auto& benchFile : BenchFiles)
+    {
+        auto text = ReadScaled(std::string(ZEP_ROOT) + "/" + benchFile.path, sizeKb * 1024);
+        if (text.empty())
+        {
+            printf("Missing: %s\n", benchFile.path);
+            return 1;
+        }
+
+        auto pDisplay = new ZepDisplayRecorder(retain);
+        ZepEditor editor(pDisplay, ZEP_ROOT, ZepEditorFlags::DisableThreads);
+        editor.SetDisplayRegion(NVec2f(0.0f, 0.0f), NVec2f(1920.0f, 1080.0f));
+
+        auto pBuffer = editor.InitWithText(benchFile.name, text);
+        auto pWindow = editor.GetActiveTabWindow()->GetActiveWindow();
+
+        // The same frame, again
+        RunScenario(editor, *pDisplay, benchFile.name, "draw", frames, [](int) {});
+
+        // A page further down each frame
+        auto lineCount = pBuffer->GetLineCount();
+        RunScenario(editor, *pDisplay, benchFile.name, "scroll", frames, [&](int frame) {
+            ByteIndex lineStart, lineEnd;
+            pBuffer->GetLineOffsets(std::min(lineCount - 1, long(frame + 1) * pWindow->GetMaxDisplayLines()), lineStart, lineEnd);
+            pWindow->SetBufferCursor(lineStart);
+        });
+
+        // A key at a time, in the middle of the file
+        ByteIndex lineStart, lineEnd;
+        pBuffer->GetLineOffsets(lineCount / 2, lineStart, lineEnd);
+        pWindow->SetBufferCursor(lineStart);
+        pBuffer->GetMode()->AddKeyPress('i');
+        RunScenario(editor, *pDisplay, benchFile.name, "type", frames, [&](int frame) {
+            pBuffer->GetMode()->AddKeyPress('a' + (frame % 26));
+        });
+    }
+    return 0;
+}
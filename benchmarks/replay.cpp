@@ -0,0 +1,152 @@
+// Replays a recorded session into a headless editor, and reports the latency of each kind of event.
+// Traces are written by :ZRecord in the demos.  With --seed, a session of vim editing is made up instead, the same one
+// for the same seed, so that it can be compared from build to build.  By default the events are sent as fast as the
+// editor takes them; with --realtime they are sent at the times they were recorded:
+//   zep_replay <trace> [--realtime] [--save <trace>]
+//   zep_replay --seed <number> [--events <count>] [--save <trace>]
+#include "config_app.h"
+
+#include "zep/display.h"
+#include "zep/editor.h"
+#include "zep/mode.h"
+#include "zep/regress.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <sstream>
+
+using namespace Zep;
+
+namespace
+{
+
+// Moving about, typing, deleting and undoing, in the proportions someone editing code might
+WorkloadTrace MakeWorkload(uint32_t seed, uint32_t count)
+{
+    const char* actions[] = { "j", "j", "k", "w", "b", "e", "l", "h", "5j", "3k", "}", "{", "ione\x1b", "Aline end\x1b",
+        "oa new line\x1b", "x", "dw", "dd", "u", "cwword\x1b", "yyp", "G", "gg", "/main\n", "n" };
+    const size_t actionCount = sizeof(actions) / sizeof(actions[0]);
+
+    WorkloadTrace trace;
+    trace.bufferName = "workload.cpp";
+    std::ifstream in(std::string(ZEP_ROOT) + "/tests/main.cpp", std::ios::in | std::ios::binary);
+    std::ostringstream str;
+    str << in.rdbuf();
+    for (int copy = 0; copy < 20; copy++)
+    {
+        trace.text += str.str();
+    }
+
+    WorkloadEvent ev;
+    ev.type = WorkloadEventType::Resize;
+    ev.size = NVec2f(1920.0f, 1080.0f);
+    trace.events.push_back(ev);
+
+    // Keys about 100ms apart, for a real time replay
+    std::mt19937 random(seed);
+    std::uniform_int_distribution<size_t> pick(0, actionCount - 1);
+    uint64_t timeUs = 0;
+    while (trace.events.size() < count)
+    {
+        for (auto pCh = actions[pick(random)]; *pCh != 0; pCh++)
+        {
+            ev = WorkloadEvent();
+            ev.type = WorkloadEventType::Key;
+            ev.key = *pCh == '\n' ? uint32_t(ExtKeys::RETURN) : *pCh == 0x1b ? uint32_t(ExtKeys::ESCAPE) : uint32_t(*pCh);
+            ev.timeUs = timeUs += 100000;
+            trace.events.push_back(ev);
+        }
+    }
+    return trace;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    std::string tracePath;
+    std::string savePath;
+    bool seeded = false;
+    uint32_t seed = 0;
+    uint32_t events = 2000;
+    auto speed = WorkloadReplaySpeed::Fast;
+    for (int arg = 1; arg < argc; arg++)
+    {
+        if (strcmp(argv[arg], "--seed") == 0 && arg + 1 < argc)
+        {
+            seeded = true;
+            seed = uint32_t(strtoul(argv[++arg], nullptr, 10));
+        }
+        else if (strcmp(argv[arg], "--events") == 0 && arg + 1 < argc)
+        {
+            events = uint32_t(strtoul(argv[++arg], nullptr, 10));
+        }
+        else if (strcmp(argv[arg], "--save") == 0 && arg + 1 < argc)
+        {
+            savePath = argv[++arg];
+        }
+        else if (strcmp(argv[arg], "--realtime") == 0)
+        {
+            speed = WorkloadReplaySpeed::RealTime;
+        }
+        else if (argv[arg][0] != '-' && tracePath.empty())
+        {
+            tracePath = argv[arg];
+        }
+        else
+        {
+            tracePath.clear();
+            seeded = false;
+            break;
+        }
+    }
+
+    if (tracePath.empty() == !seeded)
+    {
+        printf("Usage: zep_replay <trace> [--realtime] [--save <trace>]\n");
+        printf("       zep_replay --seed <number> [--events <count>] [--save <trace>]\n");
+        return 1;
+    }
+
+    WorkloadTrace trace;
+    if (seeded)
+    {
+        trace = MakeWorkload(seed, events);
+    }
+    else
+    {
+        std::ifstream in(tracePath, std::ios::in | std::ios::binary);
+        if (!ReadWorkloadTrace(in, trace))
+        {
+            printf("Not a trace: %s\n", tracePath.c_str());
+            return 1;
+        }
+    }
+
+    if (!savePath.empty())
+    {
+        std::ofstream out(savePath, std::ios::out | std::ios::binary);
+        WriteWorkloadTrace(out, trace);
+    }
+
+    ZepEditor editor(new ZepDisplayNull(), ZEP_ROOT, ZepEditorFlags::DisableThreads);
+    WorkloadReplayResult result;
+    ReplayWorkload(editor, trace, speed, result);
+
+    printf("%-10s %8s %10s %10s %10s %10s %10s\n", "Event", "Count", "Avg us", "p50", "p95", "p99", "Max");
+    for (size_t type = 0; type < size_t(WorkloadEventType::Count); type++)
+    {
+        auto& latency = result.latency[type];
+        if (latency.count == 0)
+        {
+            continue;
+        }
+        printf("%-10s %8llu %10.1f %10llu %10llu %10llu %10llu\n", GetWorkloadEventName(WorkloadEventType(type)), (unsigned long long)latency.count, latency.Average(),
+            (unsigned long long)latency.Percentile(0.5), (unsigned long long)latency.Percentile(0.95), (unsigned long long)latency.Percentile(0.99), (unsigned long long)latency.maxUs);
+    }
+    printf("\n%zu events in %.3f s\n", result.eventLatencyUs.size(), result.totalUs / 1000000.0);
+    return 0;
+}
@@ -4,6 +4,11 @@ set(CMAKE_CXX_FLAGS "" )
 set(CMAKE_CXX_FLAGS_DEBUG "-D_DEBUG -ggdb -O0 -std=c++17")
 set(CMAKE_CXX_FLAGS_RELEASE "-DNDEBUG -O3 -std=c++17")
 
+if (ZEP_SANITIZE_THREAD)
+  set(CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} -fsanitize=thread -g")
+  set(CMAKE_EXE_LINKER_FLAGS "${CMAKE_EXE_LINKER_FLAGS} -fsanitize=thread")
+endif()
+
 if("${CMAKE_GENERATOR}" STREQUAL "Ninja")
   # Ninja redirects build output and prints it only on error
   # Redirection strips colorization, so let's force it here
@@ -8,6 +8,7 @@
 #include <SDL.h>
 #include <stdio.h>
 #include <thread>
+#include <fstream>
 
 #include <imgui/imgui.h>
 
@@ -155,7 +156,7 @@ bool ReadCommandLine(int argc, char** argv, int& exitCode)
 struct ZepContainer : public IZepComponent, public IZepReplProvider
 {
     ZepContainer(const std::string& startupFilePath)
-        : spEditor(std::make_unique<ZepEditor_ImGui>(ZEP_ROOT))
+        : spEditor(std::make_unique<ZepEditor_ImGui>(ZEP_ROOT, ZepEditorFlags::CoalesceInput))
     {
 
         // File watcher not used on apple yet ; needs investigating as to why it doesn't compile/run
@@ -172,12 +173,16 @@ struct ZepContainer : public IZepComponent, public IZepReplProvider
 
         chibi_init(scheme, SDL_GetBasePath());
 
-        spEditor->RegisterCallback(this);
+        for (auto messageId : { Msg::Tick, Msg::GetClipBoard, Msg::SetClipBoard, Msg::RequestQuit, Msg::ToolTip })
+        {
+            spEditor->Subscribe(this, messageId);
+        }
         spEditor->SetPixelScale(GetDisplayScale());
 
         ZepMode_Orca::Register(*spEditor);
 
         ZepRegressExCommand::Register(*spEditor);
+        ZepRecordExCommand::Register(*spEditor);
         ZepReplExCommand::Register(*spEditor, this);
 
         if (!startupFilePath.empty())
@@ -416,6 +421,13 @@ int main(int argc, char** argv)
 
     MUtils::TimeProvider::Instance().StartThread();
 
+    // Work finishing on another thread wakes the loop below
+    zep.spEditor->GetScheduler().SetWakeCallback([]() {
+        SDL_Event wakeEvent{};
+        wakeEvent.type = SDL_USEREVENT;
+        SDL_PushEvent(&wakeEvent);
+    });
+
     // Main loop
     bool done = false;
     while (!done && !zep.quit)
@@ -425,8 +437,13 @@ int main(int argc, char** argv)
         // - When io.WantCaptureMouse is true, do not dispatch mouse input data to your main application.
         // - When io.WantCaptureKeyboard is true, do not dispatch keyboard input data to your main application.
         // Generally you may always pass all inputs to dear imgui, and hide them from your application based on those two flags.
+        // Sleep until input or the editor's next deadline; the file watcher is polled at least every 100ms
+        auto now = timer_get_time_now();
+        auto wakeTime = std::min(zep.spEditor->GetNextWakeTime(), now + 100000);
+        int waitMs = int((std::max(wakeTime, now) - now + 999) / 1000);
+
         SDL_Event event;
-        if (SDL_WaitEventTimeout(&event, 10))
+        if (SDL_WaitEventTimeout(&event, waitMs))
         {
             ImGui_ImplSDL2_ProcessEvent(&event);
             if (event.type == SDL_QUIT)
@@ -538,12 +555,18 @@ int main(int argc, char** argv)
             // Currently on a typical file, editor display time is < 1ms, and editor editor time is < 2ms
             if (ImGui::BeginMenu("Timings"))
             {
-                for (auto& p : globalProfiler.timerData)
+                for (auto& zone : profile_get_zones())
                 {
                     std::ostringstream strval;
-                    strval << p.first << " : " << p.second.current / 1000.0 << "ms"; // << " Last: " << p.second.current / 1000.0 << "ms";
+                    strval << zone.name << " : " << zone.current / 1000.0 << "ms (p50 " << zone.p50 / 1000.0 << ", p95 " << zone.p95 / 1000.0 << ", p99 " << zone.p99 / 1000.0 << ")";
                     ImGui::MenuItem(strval.str().c_str());
                 }
+                ImGui::Separator();
+                if (ImGui::MenuItem("Save Trace"))
+                {
+                    std::ofstream trace("zep_trace.json");
+                    profile_write_chrome_trace(trace);
+                }
                 ImGui::EndMenu();
             }
 
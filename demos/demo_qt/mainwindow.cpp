@@ -76,6 +76,7 @@ MainWindow::MainWindow()
     // Register our extensions
     ZepMode_Orca::Register(pWidget->GetEditor());
     ZepRegressExCommand::Register(pWidget->GetEditor());
+    ZepRecordExCommand::Register(pWidget->GetEditor());
     ZepReplExCommand::Register(pWidget->GetEditor(), this);
 
     const QStringList args = parser.positionalArguments();
@@ -49,7 +49,7 @@ void ZepMode_Orca::Init()
 {
     ZepMode_Vim::Init();
 
-    GetEditor().RegisterCallback(this);
+    GetEditor().Subscribe(this, Msg::Buffer);
 }
 
 void ZepMode_Orca::SetupKeyMaps()
@@ -47,13 +47,20 @@ SyntaxResult ZepSyntax_Orca::GetSyntaxAt(long index) const
     return ret;
 }
 
-void ZepSyntax_Orca::UpdateSyntax()
+void ZepSyntax_Orca::GetSyntaxRange(ByteIndex start, ByteIndex end, std::vector<SyntaxResult>& results) const
 {
-    auto& buffer = m_buffer.GetText();
+    // Orca supplies its own colors per location
+    results.resize(std::max(0l, long(end - start)));
+    for (auto offset = start; offset < end; offset++)
+    {
+        results[offset - start] = GetSyntaxAt(offset);
+    }
+}
 
+void ZepSyntax_Orca::UpdateSyntax(SyntaxJob& job)
+{
     // We don't do anything in orca mode, we get dynamically because Orca tells us the colors
-    m_targetChar = long(0);
-    m_processedChar = long(buffer.size() - 1);
+    (void)job;
 }
 
 void ZepSyntax_Orca::UpdateSyntax(std::vector<SyntaxResult>& syntax)
@@ -14,8 +14,9 @@ public:
         const std::unordered_set<std::string>& identifiers = std::unordered_set<std::string>{},
         uint32_t flags = 0);
 
-    virtual void UpdateSyntax() override;
+    virtual void UpdateSyntax(SyntaxJob& job) override;
     virtual SyntaxResult GetSyntaxAt(long index) const override;
+    virtual void GetSyntaxRange(ByteIndex start, ByteIndex end, std::vector<SyntaxResult>& results) const override;
     
     virtual void UpdateSyntax(std::vector<SyntaxResult>& flags);
 private:
@@ -1,24 +1,31 @@
 #pragma once
 
 #ifdef ZEP_SINGLE_HEADER_BUILD
+#include "../src/bracket_tree.cpp"
 #include "../src/buffer.cpp"
 #include "../src/commands.cpp"
 #include "../src/editor.cpp"
 #include "../src/keymap.cpp"
+#include "../src/latency.cpp"
 #include "../src/mode.cpp"
 #include "../src/mode_standard.cpp"
 #include "../src/mode_vim.cpp"
 #include "../src/mode_tree.cpp"
 #include "../src/mode_search.cpp"
+#include "../src/regress.cpp"
+#include "../src/scheduler.cpp"
 #include "../src/scroller.cpp"
 #include "../src/splits.cpp"
 #include "../src/syntax.cpp"
+#include "../src/syntax_cache.cpp"
+#include "../src/syntax_grammar.cpp"
 #include "../src/syntax_providers.cpp"
 #include "../src/syntax_rainbow_brackets.cpp"
 #include "../src/syntax_tree.cpp"
 #include "../src/tab_window.cpp"
 #include "../src/theme.cpp"
 #include "../src/display.cpp"
+#include "../src/display_recorder.cpp"
 #include "../src/window.cpp"
 #include "../src/filesystem.cpp"
 #include "../src/indexer.cpp"
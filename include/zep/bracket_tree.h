@@ -0,0 +1,108 @@
+#pragma once
+
+#include <array>
+#include <functional>
+#include <vector>
+
+#include "buffer.h"
+
+namespace Zep
+{
+
+enum class BracketType
+{
+    Bracket = 0,
+    Brace = 1,
+    Group = 2,
+    Max = 3
+};
+
+struct BracketInfo
+{
+    ByteIndex location = 0;
+    BracketType type = BracketType::Bracket;
+    bool isOpen = false;
+    int32_t indent = 0;
+    bool valid = true;
+};
+
+// A balanced tree (treap) of the brackets in a buffer.
+// Each node stores its distance from the previous bracket rather than an absolute location, so inserting or
+// removing text only touches one path of the tree.  Each subtree also keeps a summary of the nesting walk for each
+// bracket type, so the indent of a bracket and its matching partner can be found without walking the whole file.
+// All operations are O(log n), other than visiting a range, which is O(log n + k)
+class BracketTree
+{
+public:
+    void Clear();
+
+    // Text edits; brackets after the edit move with the text.
+    // Erasing and rescanning return true if the nesting of the brackets after the range changed
+    void InsertText(ByteIndex start, ByteIndex length);
+    bool EraseText(ByteIndex start, ByteIndex end);
+
+    // Replace the brackets in [start, end) with the ones now in the text
+    bool Rescan(const GapBuffer<uint8_t>& text, ByteIndex start, ByteIndex end);
+
+    // True if any type of bracket is still open at the end of the text; its first bracket shows as an error
+    bool LeftOpen() const;
+
+    bool Find(ByteIndex location, BracketInfo& info) const;
+    void ForEach(ByteIndex start, ByteIndex end, const std::function<void(const BracketInfo&)>& fnVisit) const;
+    ByteIndex FindMatch(ByteIndex location) const;
+
+    size_t Size() const;
+
+private:
+    // The +1/-1 walk of open/close brackets of one type over a sequence of brackets
+    struct Summary
+    {
+        int32_t count = 0;
+        int32_t sum = 0;
+        int32_t minPrefix = 0;
+        int32_t maxSuffix = 0;
+    };
+    using Summaries = std::array<Summary, size_t(BracketType::Max)>;
+
+    struct Node
+    {
+        ByteIndex delta = 0;    // Distance from the previous bracket (or the start of the subtree)
+        ByteIndex span = 0;     // Sum of the deltas in this subtree; the location of the last bracket in it
+        uint32_t priority = 0;
+        int32_t left = -1;
+        int32_t right = -1;
+        BracketType type = BracketType::Bracket;
+        bool isOpen = false;
+        Summaries summary;
+    };
+
+    static Summary Combine(const Summary& a, const Summary& b);
+    static Summary SelfSummary(const Node& node, size_t type);
+    static bool SameWalk(const Summaries& a, const Summaries& b);
+
+    int32_t NewNode(ByteIndex delta, BracketType type, bool isOpen);
+    void FreeTree(int32_t t);
+    void Update(int32_t t);
+    ByteIndex Span(int32_t t) const;
+    void CombinePrefix(Summaries& prefix, int32_t t) const;
+    void CombinePrefix(Summaries& prefix, const Node& node) const;
+    void FillInfo(const Node& node, ByteIndex location, const Summaries& prefix, BracketInfo& info) const;
+
+    void Split(int32_t t, ByteIndex location, int32_t& left, int32_t& right);
+    int32_t Merge(int32_t left, int32_t right);
+    int32_t Join(int32_t left, int32_t right, ByteIndex rightBase);
+    void AddToFirst(int32_t t, ByteIndex amount);
+
+    void Visit(int32_t t, ByteIndex base, ByteIndex start, ByteIndex end, Summaries& prefix, const std::function<void(const BracketInfo&)>& fnVisit) const;
+    ByteIndex FindForward(int32_t t, ByteIndex base, ByteIndex after, size_t type, bool fullyAfter, int32_t& walk) const;
+    ByteIndex FindBackward(int32_t t, ByteIndex base, ByteIndex before, size_t type, bool fullyBefore, int32_t& walk) const;
+
+private:
+    std::vector<Node> m_nodes;
+    std::vector<int32_t> m_freeNodes;
+    int32_t m_root = -1;
+    size_t m_size = 0;
+    uint32_t m_seed = 0x9E3779B9;
+};
+
+} // namespace Zep
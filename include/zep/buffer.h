@@ -109,6 +109,16 @@ struct BufferByteRange
     {
         return loc >= first && loc < second;
     }
+
+    bool operator==(const BufferByteRange& rhs) const
+    {
+        return first == rhs.first && second == rhs.second;
+    }
+
+    bool operator!=(const BufferByteRange& rhs) const
+    {
+        return !(*this == rhs);
+    }
 };
 
 namespace RangeMarkerDisplayType
@@ -207,6 +217,7 @@ public:
 
     ByteIndex Find(ByteIndex start, const uint8_t* pBegin, const uint8_t* pEnd) const;
     ByteIndex FindOnLineMotion(ByteIndex start, const uint8_t* pCh, SearchDirection dir) const;
+    ByteIndex FindMatchingBracket(ByteIndex start) const;
     ByteIndex WordMotion(ByteIndex start, uint32_t searchType, SearchDirection dir) const;
     ByteIndex EndWordMotion(ByteIndex start, uint32_t searchType, SearchDirection dir) const;
     ByteIndex ChangeWordMotion(ByteIndex start, uint32_t searchType, SearchDirection dir) const;
@@ -357,7 +368,8 @@ enum class BufferMessageType
     TextDeleted,
     TextAdded,
     Loaded,
-    MarkersChanged
+    MarkersChanged,
+    SyntaxChanged       // The colors of a range changed, but not the text
 };
 
 struct BufferMessage : public ZepMessage
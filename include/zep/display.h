@@ -1,6 +1,7 @@
 #pragma once
 
 #include "buffer.h"
+#include "glyph_cache.h"
 
 namespace Zep
 {
@@ -17,6 +18,14 @@ struct SelectRegion
     bool vertical = false; // Not yet supported
 };
 
+// A line number as drawn, and its size
+struct NumberText
+{
+    long number = -1;
+    std::string text;
+    NVec2f size;
+};
+
 // Display interface
 class ZepDisplay
 {
@@ -37,21 +46,44 @@ public:
     virtual void DrawRectFilled(const NRectf& rc, const NVec4f& col = NVec4f(1.0f)) const = 0;
     virtual void SetClipRect(const NRectf& rc) = 0;
 
+    // Return true if the display keeps what was drawn in the last frame.  The editor then only draws the parts of
+    // a frame which changed, filling their background first; when nothing has changed it draws nothing
+    virtual bool RetainsFrame() const
+    {
+        return false;
+    }
+
     virtual uint32_t GetCodePointCount(const uint8_t* pCh, const uint8_t* pEnd) const;
     virtual NVec2f GetCharSize(const uint8_t* pChar);
     virtual const NVec2f& GetDefaultCharSize();
+
+    // The size of each code point in a run of text, appended to 'sizes'.  This measures through the character
+    // cache; a backend which can measure a run of glyphs directly can override it
+    virtual void GetCharSizes(const uint8_t* pBegin, const uint8_t* pEnd, std::vector<NVec2f>& sizes);
+
+    // Line numbers are drawn every frame, so the strings and their sizes are kept
+    const NumberText& GetNumberText(long number);
+
+    // True if every printable ASCII character is the default size, so that lines of them can be laid out and hit
+    // tested by counting instead of measuring each character
+    virtual bool HasFixedAdvance();
     virtual void InvalidateCharCache();
     virtual void DrawRect(const NRectf& rc, const NVec4f& col = NVec4f(1.0f)) const;
 
 protected:
     void BuildCharCache();
+    NVec2f MeasureChar(const uint8_t* pCh, uint32_t codePoint);
 
 protected:
     bool m_charCacheDirty = true;
-    std::unordered_map<uint32_t, NVec2f> m_charCache;
+    GlyphCache m_charCache;     // Shared by all the windows on this display
     NVec2f m_charCacheASCII[256];
 
+    static const long NumberCacheSize = 512;
+    NumberText m_numberCache[NumberCacheSize];
+
     NVec2f m_defaultCharSize;
+    bool m_fixedAdvance = false;
 };
 
 // A NULL renderer, used for testing
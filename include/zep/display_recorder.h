@@ -0,0 +1,108 @@
+#pragma once
+
+#include "display.h"
+
+#include <string>
+#include <vector>
+
+namespace Zep
+{
+
+enum class DisplayCommandType : uint8_t
+{
+    Line,
+    Chars,
+    RectFilled,
+    ClipRect
+};
+
+// One recorded draw call.  Text is kept in the frame's text store, so commands stay small
+struct DisplayCommand
+{
+    DisplayCommandType type;
+    uint32_t color;
+    float width;
+    NRectf rect;          // Line: start -> end.  Chars: position.  RectFilled, ClipRect: the rectangle
+    uint32_t textOffset;
+    uint32_t textLength;
+};
+
+struct DisplayFrameStats
+{
+    uint32_t drawCalls = 0; // Lines, characters and rectangles
+    uint32_t lines = 0;
+    uint32_t chars = 0;     // DrawChars calls
+    uint32_t glyphs = 0;    // Code points drawn
+    uint32_t rects = 0;
+    uint32_t clipRects = 0;
+};
+
+struct DisplayFrame
+{
+    std::vector<DisplayCommand> commands;
+    std::string text;
+    DisplayFrameStats stats;
+
+    void Clear();
+    std::string GetText(const DisplayCommand& command) const;
+};
+
+// The commands in one frame that are not in the other, ignoring their order
+struct DisplayFrameDiff
+{
+    uint32_t added = 0;
+    uint32_t removed = 0;
+    uint32_t unchanged = 0;
+
+    bool Empty() const
+    {
+        return added == 0 && removed == 0;
+    }
+};
+
+// A renderer which records the draw calls of each frame instead of drawing them, so the cost of a frame can be
+// measured and two frames compared without a GPU.  Text is measured the same way as ZepDisplayNull
+class ZepDisplayRecorder : public ZepDisplayNull
+{
+public:
+    // A retaining recorder stands in for a display that keeps the last frame, and records only what is drawn over it
+    ZepDisplayRecorder(bool retainFrame = false)
+        : m_retainFrame(retainFrame)
+    {
+    }
+
+    virtual bool RetainsFrame() const override
+    {
+        return m_retainFrame;
+    }
+
+    virtual void DrawLine(const NVec2f& start, const NVec2f& end, const NVec4f& color = NVec4f(1.0f), float width = 1.0f) const override;
+    virtual void DrawChars(const NVec2f& pos, const NVec4f& col, const uint8_t* text_begin, const uint8_t* text_end = nullptr) const override;
+    virtual void DrawRectFilled(const NRectf& rc, const NVec4f& col = NVec4f(1.0f)) const override;
+    virtual void SetClipRect(const NRectf& rc) override;
+
+    // Keep the last frame for comparison and start recording a new one
+    void BeginFrame();
+
+    const DisplayFrame& GetFrame() const
+    {
+        return m_frame;
+    }
+    const DisplayFrame& GetPreviousFrame() const
+    {
+        return m_previousFrame;
+    }
+
+    static DisplayFrameDiff Compare(const DisplayFrame& before, const DisplayFrame& after);
+
+private:
+    DisplayCommand& AddCommand(DisplayCommandType type, const NVec4f& color) const;
+
+private:
+    // Drawing is const in the display interface
+    mutable DisplayFrame m_frame;
+    DisplayFrame m_previousFrame;
+    bool m_retainFrame = false;
+};
+
+} // namespace Zep
@@ -6,6 +6,7 @@
 #include <set>
 #include <sstream>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include "zep_config.h"
 
@@ -18,6 +19,7 @@
 #endif
 
 #include "zep/keymap.h"
+#include "zep/scheduler.h"
 
 #include "splits.h"
 
@@ -54,6 +56,8 @@ class ZepTheme;
 class ZepDisplay;
 class IZepFileSystem;
 class Indexer;
+class ZepLatencyStats;
+class ZepWorkloadRecorder;
 
 struct Region;
 
@@ -70,7 +74,9 @@ enum
 {
     None = (0),
     DisableThreads = (1 << 0),
-    FastUpdate = (1 << 1)
+    FastUpdate = (1 << 1),
+    SharedThreadPool = (1 << 2), // One pool of workers for all the editors made with this flag, instead of one each
+    CoalesceInput = (1 << 3)     // Plain text typed in insert mode waits for the next frame, and goes in as one insert
 };
 };
 
@@ -129,6 +135,50 @@ public:
     IZepComponent* pComponent = nullptr;
 };
 
+// Messages are small and short lived, and there are many of them as the text changes; their memory comes from free
+// lists kept by each thread, so that sending one doesn't go to the heap
+void* AllocateMessage(size_t size);
+void FreeMessage(void* pMemory, size_t size);
+
+template <class T>
+struct MessageAllocator
+{
+    using value_type = T;
+
+    MessageAllocator() = default;
+    template <class U>
+    MessageAllocator(const MessageAllocator<U>&)
+    {
+    }
+
+    T* allocate(size_t count)
+    {
+        return static_cast<T*>(AllocateMessage(count * sizeof(T)));
+    }
+    void deallocate(T* pMemory, size_t count)
+    {
+        FreeMessage(pMemory, count * sizeof(T));
+    }
+
+    template <class U>
+    bool operator==(const MessageAllocator<U>&) const
+    {
+        return true;
+    }
+    template <class U>
+    bool operator!=(const MessageAllocator<U>&) const
+    {
+        return false;
+    }
+};
+
+// Make a message to broadcast, with its count in the same pooled block
+template <class T, class... Args>
+std::shared_ptr<T> MakeMessage(Args&&... args)
+{
+    return std::allocate_shared<T>(MessageAllocator<T>(), std::forward<Args>(args)...);
+}
+
 struct IZepComponent
 {
     virtual void Notify(std::shared_ptr<ZepMessage> message) { ZEP_UNUSED(message); };
@@ -222,6 +272,7 @@ struct EditorConfig
     bool autoHideCommandRegion = true;
     bool cursorLineSolid = false;
     bool showNormalModeKeyStrokes = false;
+    bool syntaxCache = false;
     float backgroundFadeTime = 60.0f;
     float backgroundFadeWait = 60.0f;
 };
@@ -279,16 +330,25 @@ public:
 
     void Display();
 
+    // Draw everything again on the next frame, for a display which keeps the last frame
+    void InvalidateDisplay();
+
     void RegisterSyntaxFactory(const std::vector<std::string>& mappings, SyntaxProvider factory);
+
+    // Send a message to the components which subscribed to it, in the order they subscribed, until one handles it.
+    // Buffer messages go to the subscribers for their buffer, then to those for all buffers
     bool Broadcast(std::shared_ptr<ZepMessage> payload);
-    void RegisterCallback(IZepComponent* pClient)
-    {
-        m_notifyClients.insert(pClient);
-    }
-    void UnRegisterCallback(IZepComponent* pClient)
-    {
-        m_notifyClients.erase(pClient);
-    }
+
+    // Hear one message; for Msg::Buffer, from one buffer, or from all of them if pBuffer is null.
+    // Safe to call from a Notify, while a message is being sent
+    void Subscribe(IZepComponent* pClient, Msg messageId, const ZepBuffer* pBuffer = nullptr);
+    void Unsubscribe(IZepComponent* pClient, Msg messageId, const ZepBuffer* pBuffer = nullptr);
+
+    // Hear every message, after the subscribers to it
+    void RegisterCallback(IZepComponent* pClient);
+
+    // Hear nothing more
+    void UnRegisterCallback(IZepComponent* pClient);
 
     const tBuffers& GetBuffers() const;
     ZepBuffer* GetMRUBuffer() const;
@@ -313,6 +373,11 @@ public:
     uint32_t GetFlags() const;
     void SetFlags(uint32_t flags);
 
+    // The mode holding typed text back, with ZepEditorFlags::CoalesceInput; flushing puts it in the buffer now
+    void FlushInput();
+    ZepMode* GetPendingInputMode() const;
+    void SetPendingInputMode(ZepMode* pMode);
+
     // Tab windows
     using tTabWindows = std::vector<ZepTabWindow*>;
     void NextTabWindow();
@@ -337,6 +402,11 @@ public:
     void RequestRefresh();
     bool RefreshRequired();
 
+    // When the editor next needs to be updated and displayed if no input arrives, on the clock of
+    // timer_get_time_now: the next deadline in the scheduler, or the next blink of the cursor.  A host can sleep until
+    // then, or until input arrives or the scheduler's wake callback is called
+    uint64_t GetNextWakeTime() const;
+
     void SetCommandText(const std::string& strCommand);
 
     std::string GetCommandText() const;
@@ -349,6 +419,7 @@ public:
 
     // Setup the display fixed_size for the editor
     void SetDisplayRegion(const NVec2f& topLeft, const NVec2f& bottomRight);
+    const NRectf& GetDisplayRegion() const;
     void UpdateSize();
 
     ZepDisplay& GetDisplay() const
@@ -383,6 +454,9 @@ public:
     ZepEditor& GetEditor() { return *this; }
 
     ThreadPool& GetThreadPool() const;
+    ZepScheduler& GetScheduler() const;
+    ZepLatencyStats& GetLatencyStats() const;
+    ZepWorkloadRecorder& GetWorkloadRecorder() const;
 
     // Used to inform when a file changes - called from outside zep by the platform specific code, if possible
     virtual void OnFileChanged(const ZepPath& path);
@@ -398,11 +472,25 @@ private:
     // Ensure there is a valid tab window and return it
     ZepTabWindow* EnsureTab();
 
+private:
+    void DisplayChrome();
+
 private:
     ZepDisplay* m_pDisplay;
     IZepFileSystem* m_pFileSystem;
 
-    std::set<IZepComponent*> m_notifyClients;
+    // Before everything that schedules work, so that it is destroyed after them
+    std::unique_ptr<ZepScheduler> m_spScheduler;
+    std::unique_ptr<ZepLatencyStats> m_spLatencyStats;
+    std::unique_ptr<ZepWorkloadRecorder> m_spWorkloadRecorder;
+
+    // Subscribers to each message id, by buffer for buffer messages, and those that hear everything.
+    // A client which leaves while a message is sent is set to null, and the lists are compacted after the send
+    std::vector<std::vector<IZepComponent*>> m_subscribers;
+    std::unordered_map<const ZepBuffer*, std::vector<IZepComponent*>> m_bufferSubscribers;
+    std::vector<IZepComponent*> m_allSubscribers;
+    int m_broadcastDepth = 0;
+    bool m_subscribersRemoved = false;
     mutable tRegisters m_registers;
 
     std::shared_ptr<ZepTheme> m_spTheme;
@@ -428,6 +516,7 @@ private:
     // May or may not be visible
     tBuffers m_buffers;
     uint32_t m_flags = 0;
+    ZepMode* m_pPendingInputMode = nullptr;
 
     mutable std::atomic_bool m_bPendingRefresh = true;
     mutable bool m_lastCursorBlink = false;
@@ -442,6 +531,10 @@ private:
 
     float m_tabOffsetX = 0.0f;
 
+    // The editor around the windows is only drawn when it changes, on a display which keeps the last frame
+    uint64_t m_lastChromeHash = 0;
+    bool m_redrawAll = true;
+
     NVec2f m_mousePos = NVec2f(0.0f);
     NVec2f m_pixelScale = NVec2f(1.0f);
     ZepPath m_rootPath;
@@ -449,7 +542,7 @@ private:
     // Config
     EditorConfig m_config;
 
-    std::unique_ptr<ThreadPool> m_threadPool;
+    std::shared_ptr<ThreadPool> m_threadPool;
 
     std::shared_ptr<Indexer> m_indexer;
 };
@@ -65,8 +65,16 @@ public:
     virtual bool Equivalent(const ZepPath& path1, const ZepPath& path2) const override;
     virtual ZepPath Canonical(const ZepPath& path) const override;
 
+    // Write through a temporary file renamed over the old one, instead of in place.  The file is never half written,
+    // but it gets a new inode, so hard links to it are broken and its owner is not kept
+    void SetAtomicWrite(bool atomic);
+
+private:
+    bool WriteAtomic(const ZepPath& filePath, const void* pData, size_t size);
+
 private:
     ZepPath m_workingDirectory;
+    bool m_atomicWrite = false;
 };
 #endif // CPP File system
 
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "zep/mcommon/math/math.h"
+
+namespace Zep
+{
+
+// The sizes of code points outside ASCII, in a flat open addressing table.
+// A lookup is a hash and a short linear probe through one array; the table doubles when it is half full, and
+// nothing is allocated otherwise
+class GlyphCache
+{
+public:
+    const NVec2f* Find(uint32_t codePoint) const
+    {
+        if (m_entries.empty())
+        {
+            return nullptr;
+        }
+
+        auto mask = m_entries.size() - 1;
+        for (auto index = Hash(codePoint);; index = (index + 1) & mask)
+        {
+            auto& entry = m_entries[index];
+            if (entry.codePoint == codePoint)
+            {
+                return &entry.size;
+            }
+            if (entry.codePoint == EmptyCodePoint)
+            {
+                return nullptr;
+            }
+        }
+    }
+
+    void Insert(uint32_t codePoint, const NVec2f& size)
+    {
+        if ((m_count + 1) * 2 > m_entries.size())
+        {
+            Grow();
+        }
+
+        auto mask = m_entries.size() - 1;
+        for (auto index = Hash(codePoint);; index = (index + 1) & mask)
+        {
+            auto& entry = m_entries[index];
+            if (entry.codePoint == codePoint)
+            {
+                entry.size = size;
+                return;
+            }
+            if (entry.codePoint == EmptyCodePoint)
+            {
+                entry.codePoint = codePoint;
+                entry.size = size;
+                m_count++;
+                return;
+            }
+        }
+    }
+
+    void Clear()
+    {
+        m_entries.clear();
+        m_count = 0;
+        m_bits = 0;
+    }
+
+    size_t Size() const
+    {
+        return m_count;
+    }
+
+private:
+    // Not a code point
+    static const uint32_t EmptyCodePoint = 0xFFFFFFFF;
+
+    struct Entry
+    {
+        uint32_t codePoint = EmptyCodePoint;
+        NVec2f size;
+    };
+
+    // Fibonacci hashing; the top bits of the product are well mixed even for runs of neighbouring code points
+    size_t Hash(uint32_t codePoint) const
+    {
+        return size_t((codePoint * 2654435769u) >> (32 - m_bits));
+    }
+
+    void Grow()
+    {
+        auto entries = std::move(m_entries);
+        m_bits = m_bits == 0 ? 8 : m_bits + 1;
+        m_entries.assign(size_t(1) << m_bits, Entry());
+        m_count = 0;
+        for (auto& entry : entries)
+        {
+            if (entry.codePoint != EmptyCodePoint)
+            {
+                Insert(entry.codePoint, entry.size);
+            }
+        }
+    }
+
+private:
+    std::vector<Entry> m_entries;
+    size_t m_count = 0;
+    uint32_t m_bits = 0;
+};
+
+} // namespace Zep
@@ -31,7 +31,7 @@ struct ZepConsole : Zep::IZepComponent
     ZepConsole(Zep::ZepPath& p)
         : zepEditor(p)
     {
-        zepEditor.RegisterCallback(this);
+        zepEditor.Subscribe(this, Zep::Msg::HandleCommand);
         auto pBuffer = zepEditor.GetEmptyBuffer("Log");
         pBuffer->SetFileFlags(Zep::FileFlags::ReadOnly);
     }
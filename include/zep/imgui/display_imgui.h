@@ -60,6 +60,36 @@ public:
         return toNVec2f(text_size);
     }
 
+    // Measures a run from the font's advances, as CalcTextSizeA would each character; ASCII comes from the cache,
+    // which has the sizes of control characters as GetTextSize gives them
+    virtual void GetCharSizes(const uint8_t* pBegin, const uint8_t* pEnd, std::vector<NVec2f>& sizes) override
+    {
+        auto defaultSize = GetDefaultCharSize();
+        ImFont* font = ImGui::GetFont();
+        const float font_size = ImGui::GetFontSize();
+        const float scale = font_size / font->FontSize;
+        for (auto pCh = pBegin; pCh < pEnd; pCh += utf8_codepoint_length(*pCh))
+        {
+            if (utf8_codepoint_length(*pCh) == 1 || pCh + utf8_codepoint_length(*pCh) > pEnd)
+            {
+                sizes.push_back(m_charCacheASCII[*pCh]);
+                continue;
+            }
+
+            // Outside the basic plane, ImWchar may be too small; let the font decide as it draws it
+            auto pNext = pCh;
+            auto codePoint = utf8::unchecked::next(pNext);
+            if (codePoint > 0xFFFF)
+            {
+                sizes.push_back(GetCharSize(pCh));
+                continue;
+            }
+
+            auto advance = font->GetCharAdvance(ImWchar(codePoint)) * scale;
+            sizes.push_back(advance == 0.0f ? defaultSize : NVec2f(advance, font_size));
+        }
+    }
+
     void DrawChars(const NVec2f& pos, const NVec4f& col, const uint8_t* text_begin, const uint8_t* text_end) const
     {
         ImDrawList* drawList = ImGui::GetWindowDrawList();
@@ -33,20 +33,28 @@ class Indexer : public ZepComponent
 {
 public:
     Indexer(ZepEditor& editor);
-    
-    virtual void Notify(std::shared_ptr<ZepMessage> message) override;
+    ~Indexer();
 
     bool StartIndexing();
     void StartSymbolSearch();
 
     static void GetSearchPaths(ZepEditor& editor, const ZepPath& path, std::vector<std::string>& ignore_patterns, std::vector<std::string>& include_patterns, std::string& errors);
-    static std::future<std::shared_ptr<FileIndexResult>> IndexPaths(ZepEditor& editor, const ZepPath& startPath);
+    // fnReady is posted to the editor's thread as the job finishes; the future may take a moment longer, so get() it.
+    // A cancelled job stops scanning, and returns the paths found so far
+    static std::future<std::shared_ptr<FileIndexResult>> IndexPaths(ZepEditor& editor, const ZepPath& startPath, const void* pOwner, std::function<void()> fnReady, const CancelToken& cancel = CancelToken());
+
+private:
+    void OnIndexReady();
 
 private:
     bool m_fileSearchActive = false;
     std::future<std::shared_ptr<FileIndexResult>> m_indexResult;
     std::shared_ptr<FileIndexResult> m_spFilePaths;
 
+    // Stops the background jobs as the indexer goes
+    CancelToken m_cancel;
+    std::future<bool> m_symbolResult;
+
     std::mutex m_queueMutex;
     std::deque<ZepPath> m_searchQueue;
 
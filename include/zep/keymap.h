@@ -127,6 +127,7 @@ DECLARE_COMMANDID(MotionEndWORD)
 DECLARE_COMMANDID(MotionBackEndWord)
 DECLARE_COMMANDID(MotionBackEndWORD)
 DECLARE_COMMANDID(MotionGotoBeginning)
+DECLARE_COMMANDID(MotionMatchingBracket)
 
 DECLARE_COMMANDID(MotionPageForward)
 DECLARE_COMMANDID(MotionPageBackward)
@@ -164,31 +165,102 @@ DECLARE_COMMANDID(InsertTab)
 
 // Insert Mode
 DECLARE_COMMANDID(Backspace)
+
+// A key in a map, as a number: the character or the ExtKeys value, with the modifiers above it.  The wildcards have
+// codes after all of the keys, so that they sort after them
+using KeyCode = uint32_t;
+struct KeyCodes
+{
+    enum : uint32_t
+    {
+        ExtKey = 0x100,
+        ModifierShift = 9,
+        Digits = 0x1000, // <D>
+        Register,        // <R>
+        AnyChar          // <.>
+    };
+};
+
+// The map as it is built
 struct CommandNode
 {
-    // <D> = digits
-    // <R> = register
-    // <.> = any char
-    std::string token;
+    KeyCode key = 0;
+    StringId commandId;
+    std::map<KeyCode, std::shared_ptr<CommandNode>> children;
+};
+
+// The map as it is searched; a node's children are together in the list, in key order
+struct KeyMapNode
+{
+    KeyCode key = 0;
     StringId commandId;
-    std::unordered_map<std::string, std::shared_ptr<CommandNode>> children;
+    uint32_t firstChild = 0;
+    uint32_t childCount = 0;
 };
 
 struct KeyMap
 {
     bool ignoreFinalDigit = false;
     std::shared_ptr<CommandNode> spRoot = std::make_shared<CommandNode>();
+
+    // Flattened from the tree when it is next searched after commands are added, so setting up a mode only does it
+    // once
+    mutable std::vector<KeyMapNode> nodes;
+    mutable bool nodesDirty = false;
+};
+
+// Captured values, kept without allocating; any beyond the first few are dropped
+template <typename T, uint32_t MaxCount = 4>
+struct KeyMapCaptures
+{
+    T values[MaxCount];
+    uint32_t count = 0;
+
+    void push_back(T value)
+    {
+        if (count < MaxCount)
+        {
+            values[count++] = value;
+        }
+    }
+    void clear()
+    {
+        count = 0;
+    }
+    bool empty() const
+    {
+        return count == 0;
+    }
+    size_t size() const
+    {
+        return count;
+    }
+    const T& operator[](size_t index) const
+    {
+        return values[index];
+    }
+    const T* begin() const
+    {
+        return values;
+    }
+    const T* end() const
+    {
+        return values + count;
+    }
 };
 
 struct KeyMapResult
 {
-    std::vector<int> captureNumbers;
-    std::vector<char> captureChars;
-    std::vector<char> captureRegisters;
+    KeyMapCaptures<int> captureNumbers;
+    KeyMapCaptures<char> captureChars;
+    KeyMapCaptures<char> captureRegisters;
     std::string commandWithoutGroups;
     bool needMoreChars = false;
 
     StringId foundMapping;
+
+    // The route through the map, for showing; only built when asked for
+    bool recordSearchPath = false;
     std::string searchPath;
 
     int TotalCount() const
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "zep/editor.h"
+
+namespace Zep
+{
+
+// Latencies in microseconds, in buckets a quarter of a power of two wide; a fixed size, and within a quarter at any
+// scale, which is close enough to see a regression
+struct LatencyHistogram
+{
+    static const uint32_t BucketCount = 128;
+
+    void Add(uint64_t us);
+
+    // The top of the bucket holding the given fraction of the samples, no more than the largest
+    uint64_t Percentile(double fraction) const;
+    double Average() const;
+
+    static uint32_t BucketIndex(uint64_t us);
+    static uint64_t BucketTop(uint32_t index);
+
+    uint64_t buckets[BucketCount] = {};
+    uint64_t count = 0;
+    uint64_t totalUs = 0;
+    uint64_t maxUs = 0;
+};
+
+// The keys pressed in one mode that ran one command
+struct LatencyStat
+{
+    std::string mode;         // The mode, and the vim state it was in: "Vim:Normal"
+    std::string command;      // The command id; (text) for typing, (pending) for part of a command, or (unmapped)
+    LatencyHistogram handled; // From the key to its command done, including the messages the command sent
+    LatencyHistogram frame;   // From the key to the end of the next frame, which shows what it did
+};
+
+// Keystroke to frame latency, by mode and command.  Modes report keys as they handle them, and the editor reports
+// the end of each frame; a host can read the stats from any thread
+class ZepLatencyStats
+{
+public:
+    void KeyHandled(const std::string& mode, const std::string& command, uint64_t pressedUs, uint64_t handledUs);
+    void FrameDisplayed(uint64_t nowUs);
+
+    // In mode, then command order
+    std::vector<LatencyStat> GetStats() const;
+    std::string ToString() const;
+    void Clear();
+
+private:
+    struct PendingKey
+    {
+        LatencyStat* pStat;
+        uint64_t pressedUs;
+    };
+
+    // Without a display no frame comes; past this many keys, the ones waiting are dropped, and have no frame time
+    static const size_t MaxPendingKeys = 1024;
+
+    mutable std::mutex m_mutex;
+    std::map<std::pair<std::string, std::string>, LatencyStat> m_stats;
+    std::vector<PendingKey> m_pending; // Keys waiting for the frame that shows them
+};
+
+// :ZStats shows the latency table in a window; :ZStats reset clears it
+class ZepStatsExCommand : public ZepExCommand
+{
+public:
+    ZepStatsExCommand(ZepEditor& editor);
+
+    static void Register(ZepEditor& editor);
+
+    virtual void Run(const std::vector<std::string>& tokens) override;
+    virtual const char* ExCommandName() const override;
+
+private:
+    ZepBuffer* m_pStatsBuffer = nullptr;
+};
+
+} // namespace Zep
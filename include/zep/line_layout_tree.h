@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace Zep
+{
+
+// The size of a buffer line in the window, kept for every line.
+// Lines are estimated from their length until they come into view and are measured
+struct LineLayout
+{
+    float heightPx = 0.0f;                         // All the spans of the line, with padding and widgets
+    float widthPx = 0.0f;                          // The widest span
+    long spanCount = 1;
+    bool measured = false;
+};
+
+// The layouts of the lines of a window, in a balanced tree (treap) ordered by line.
+// Each subtree keeps the number of lines in it, their total height and span count, and the widest of them, so the
+// position of a line, the line at a position, and the size of the text are O(log n).  Lines are inserted and erased
+// by splitting and joining the tree, which is O(log n) plus the lines added or removed
+class LineLayoutTree
+{
+public:
+    void Clear();
+
+    // Replace every line; O(n)
+    void Assign(const std::vector<LineLayout>& layouts);
+
+    // 'count' default layouts before line 'index', or erase the lines in [first, last)
+    void Insert(long index, long count);
+    void Erase(long first, long last);
+
+    const LineLayout& Get(long index) const;
+    void Set(long index, const LineLayout& layout);
+
+    long Size() const;
+    bool Empty() const;
+
+    // Sums of the first 'count' lines
+    double HeightPrefix(long count) const;
+    long SpanPrefix(long count) const;
+
+    double TotalHeight() const;
+    long TotalSpans() const;
+    float MaxWidth() const;
+
+    // The line containing a height or a span index; the first where the sum up to and including it is more than the
+    // value.  Returns Size() if the value is past the end
+    long FindHeight(double y) const;
+    long FindSpan(long spanIndex) const;
+
+private:
+    struct Node
+    {
+        LineLayout layout;
+        uint32_t priority = 0;
+        int32_t left = -1;
+        int32_t right = -1;
+        long count = 1;                            // Lines in this subtree
+        double heightPx = 0.0;
+        long spanCount = 0;
+        float maxWidthPx = 0.0f;
+    };
+
+    int32_t NewNode(const LineLayout& layout);
+    int32_t Build(const LineLayout* pLayouts, long count);
+    void FreeTree(int32_t t);
+    void Update(int32_t t);
+    long Count(int32_t t) const;
+
+    void Split(int32_t t, long count, int32_t& left, int32_t& right);
+    int32_t Merge(int32_t left, int32_t right);
+    void SetAt(int32_t t, long index, const LineLayout& layout);
+
+private:
+    std::vector<Node> m_nodes;
+    std::vector<int32_t> m_freeNodes;
+    std::vector<int32_t> m_buildStack;
+    int32_t m_root = -1;
+    uint32_t m_seed = 0x9E3779B9;
+};
+
+} // namespace Zep
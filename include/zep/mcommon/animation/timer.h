@@ -1,8 +1,9 @@
 #pragma once
 
 #include <cstdint>
+#include <ostream>
 #include <string>
-#include <unordered_map>
+#include <vector>
 
 namespace Zep
 {
@@ -27,30 +28,52 @@ double timer_get_elapsed_seconds(const timer& timer);
 double timer_to_seconds(uint64_t value);
 double timer_to_ms(uint64_t value);
 
-struct profile_value
+// Each thread times its zones into a ring buffer that only it writes, so TIME_SCOPE takes no lock and does no lookup.
+// A report or a trace reads the events still in the buffers, from any thread
+const uint64_t ProfileEventsPerThread = 8192;
+
+// The times of a zone's recent events, in microseconds
+struct profile_zone
 {
+    std::string name;
+    uint64_t count = 0;
     double average = 0;
     double current = 0;
-    uint64_t count = 0;
+    double p50 = 0;
+    double p95 = 0;
+    double p99 = 0;
 };
 
-struct profile_data
-{
-    std::unordered_map<const char*, profile_value> timerData;
-};
-extern profile_data globalProfiler;
+uint64_t profile_get_time_ns();
+void profile_add_event(const char* name, uint64_t beginNs, uint64_t endNs);
+
+// The name of this thread in a trace
+void profile_set_thread_name(const std::string& name);
+
+// Zones in name order
+std::vector<profile_zone> profile_get_zones();
+
+// Chrome trace JSON; open it in chrome://tracing or ui.perfetto.dev
+void profile_write_chrome_trace(std::ostream& stream);
 
-void profile_add_value(profile_value& val, double av);
+// Forget the events recorded so far
+void profile_clear();
 
 class ProfileBlock
 {
 public:
     const char* strTimer;
-    timer blockTimer;
-    uint64_t elapsed = 0;
+    uint64_t beginNs;
 
-    ProfileBlock(const char* timer);
-    ~ProfileBlock();
+    ProfileBlock(const char* timer)
+        : strTimer(timer)
+        , beginNs(profile_get_time_ns())
+    {
+    }
+    ~ProfileBlock()
+    {
+        profile_add_event(strTimer, beginNs, profile_get_time_ns());
+    }
 };
 
 #define TIME_SCOPE(name) ProfileBlock name##_timer_block(#name);
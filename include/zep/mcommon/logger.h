@@ -8,6 +8,7 @@
 
 #pragma once
 #include <iostream>
+#include <mutex>
 #include <sstream>
 
 #ifdef WIN32
@@ -38,8 +39,16 @@ struct structlog
     typelog level = WARN;
 };
 
+// Set up by the host before it makes its editors; every editor logs with it
 extern structlog LOGCFG;
 
+// Editors on different threads write their lines whole
+inline std::mutex& log_mutex()
+{
+    static std::mutex mutex;
+    return mutex;
+}
+
 class LOG
 {
 public:
@@ -59,6 +68,7 @@ public:
         if (opened)
         {
             out << std::endl;
+            std::lock_guard<std::mutex> lock(log_mutex());
 #ifdef WIN32
             OutputDebugStringA(out.str().c_str());
 #else
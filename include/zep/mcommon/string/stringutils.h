@@ -88,6 +88,9 @@ inline std::wstring makeWStr(const std::string& str)
 std::string string_from_wstring(const std::wstring& str);
 std::string string_tolower(const std::string& str);
 
+uint32_t murmur_hash(const void* key, int len, uint32_t seed);
+uint64_t murmur_hash_64(const void* key, uint32_t len, uint64_t seed);
+
 struct StringId
 {
     uint32_t id = 0;
@@ -116,17 +119,11 @@ struct StringId
     {
         return id;
     }
-    std::string ToString() const
-    {
-        auto itr = GetStringLookup().find(id);
-        if (itr == GetStringLookup().end())
-        {
-            return "murmur:" + std::to_string(id);
-        }
-        return itr->second;
-    }
+    std::string ToString() const;
 
-    static std::unordered_map<uint32_t, std::string>& GetStringLookup();
+private:
+    // The names are shared by every editor in the process, so they are looked up under a lock
+    static void Register(uint32_t id, const char* pszString, size_t length);
 };
 
 inline std::ostream& operator<<(std::ostream& str, StringId id)
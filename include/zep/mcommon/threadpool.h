@@ -25,6 +25,9 @@ freely, subject to the following restrictions:
 CM: Note: Modified from the original to support query of the threads available on the machine,
 and fallback to using single threaded if not possible.
 Original here: https://github.com/progschj/ThreadPool
+
+Each worker now has its own queues, one per priority, and takes work from the others when its own are empty;
+tasks can be named, and given a token to notice that they have been cancelled.  Each task is a profiler zone.
 */
 
 #ifndef THREAD_POOL_HPP
@@ -32,7 +35,7 @@ Original here: https://github.com/progschj/ThreadPool
 
 // containers
 #include <vector>
-#include <queue>
+#include <deque>
 // threading
 #include <thread>
 #include <mutex>
@@ -44,6 +47,27 @@ Original here: https://github.com/progschj/ThreadPool
 #include <functional>
 // exceptions
 #include <stdexcept>
+// task zones
+#include "zep/mcommon/animation/timer.h"
+
+// Work that the user is waiting for runs first; background work never has all of the workers
+enum class TaskPriority
+{
+    Interactive,
+    Normal,
+    Background,
+    Count
+};
+
+// Shared between the owner of a task and the task; cancelling is a request, which the task checks as it runs
+class CancelToken {
+public:
+    CancelToken() : cancelled(std::make_shared<std::atomic_bool>(false)) {}
+    void cancel() const { *cancelled = true; }
+    bool is_cancelled() const { return *cancelled; }
+private:
+    std::shared_ptr<std::atomic_bool> cancelled;
+};
 
 // std::thread pool for resources recycling
 class ThreadPool {
@@ -54,29 +78,16 @@ public:
         // If not enough threads, the pool will just execute all tasks immediately
         if (threads_n > 1)
         {
+            this->queues.reserve(threads_n);
+            for (size_t i = 0; i < threads_n; i++)
+                this->queues.emplace_back(new worker_queue());
+
+            // Leave a worker for the interactive and normal jobs
+            this->max_background = threads_n - 1;
+
             this->workers.reserve(threads_n);
-            for (; threads_n; --threads_n)
-                this->workers.emplace_back(
-                    [this]
-            {
-                while (true)
-                {
-                    std::function<void()> task;
-
-                    {
-                        std::unique_lock<std::mutex> lock(this->queue_mutex);
-                        this->condition.wait(lock,
-                            [this] { return this->stop || !this->tasks.empty(); });
-                        if (this->stop && this->tasks.empty())
-                            return;
-                        task = std::move(this->tasks.front());
-                        this->tasks.pop();
-                    }
-
-                    task();
-                }
-            }
-            );
+            for (size_t i = 0; i < threads_n; i++)
+                this->workers.emplace_back([this, i] { this->work(i); });
         }
     }
     // deleted copy&move ctors&assignments
@@ -88,43 +99,211 @@ public:
     template<class F, class... Args>
     std::future<typename std::result_of<F(Args...)>::type> enqueue(F&& f, Args&&... args)
     {
-        using packaged_task_t = std::packaged_task<typename std::result_of<F(Args...)>::type ()>;
+        return enqueue_task(TaskPriority::Normal, nullptr, std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+    }
+    // add a named work item at a priority
+    template<class F>
+    std::future<typename std::result_of<F()>::type> enqueue_task(TaskPriority priority, const char* name, F&& f)
+    {
+        using packaged_task_t = std::packaged_task<typename std::result_of<F()>::type ()>;
 
-        std::shared_ptr<packaged_task_t> task(new packaged_task_t(
-                std::bind(std::forward<F>(f), std::forward<Args>(args)...)
-            ));
+        std::shared_ptr<packaged_task_t> task(new packaged_task_t(std::forward<F>(f)));
+        auto res = task->get_future();
 
         // If there are no works, just run the task in the main thread and return
         if (workers.empty())
         {
-            (*task)();
-            return task->get_future();
+            auto last_name = current_name();
+            current_name() = name;
+            {
+                Zep::ProfileBlock block(name ? name : "Task");
+                (*task)();
+            }
+            current_name() = last_name;
+            return res;
         }
-        auto res = task->get_future();
+
+        // A task queued by a worker goes on its own queue; others are spread across the workers
+        auto index = current_pool() == this ? current_worker() : (next_queue++ % queues.size());
         {
-            std::unique_lock<std::mutex> lock(this->queue_mutex);
-            this->tasks.emplace([task](){ (*task)(); });
+            auto& queue = *this->queues[index];
+            std::unique_lock<std::mutex> lock(queue.mutex);
+            queue.tasks[size_t(priority)].push_back(pool_task{ [task]() { (*task)(); }, name });
+        }
+        {
+            std::unique_lock<std::mutex> lock(this->sleep_mutex);
+            this->pending++;
         }
         this->condition.notify_one();
         return res;
     }
-    // the destructor joins all threads
+    // a task, cancellable through the token it is given
+    template<class F>
+    std::future<typename std::result_of<F(const CancelToken&)>::type> enqueue_task(TaskPriority priority, const char* name, const CancelToken& token, F&& f)
+    {
+        return enqueue_task(priority, name, std::bind(std::forward<F>(f), token));
+    }
+    // the name of the task running on this thread, or null
+    static const char* current_task_name()
+    {
+        return current_name();
+    }
+    size_t worker_count() const
+    {
+        return workers.size();
+    }
+    // the destructor joins all threads, once they have finished the work queued
     virtual ~ThreadPool()
     {
-        this->stop = true;
+        {
+            std::unique_lock<std::mutex> lock(this->sleep_mutex);
+            this->stop = true;
+        }
         this->condition.notify_all();
         for(std::thread& worker : this->workers)
             worker.join();
     }
+private:
+    struct pool_task
+    {
+        std::function<void()> fn;
+        const char* name;
+    };
+    struct worker_queue
+    {
+        std::mutex mutex;
+        std::deque<pool_task> tasks[size_t(TaskPriority::Count)];
+    };
+
+    static const char*& current_name()
+    {
+        static thread_local const char* name = nullptr;
+        return name;
+    }
+    static ThreadPool*& current_pool()
+    {
+        static thread_local ThreadPool* pool = nullptr;
+        return pool;
+    }
+    static size_t& current_worker()
+    {
+        static thread_local size_t worker = 0;
+        return worker;
+    }
+
+    // Take the most urgent task; from the front of this worker's queue, or the back of another's.  A background slot
+    // is claimed before a background task is looked for, so workers taking at once can't go over the limit
+    bool take(size_t index, pool_task& task, TaskPriority& priority)
+    {
+        for (size_t p = 0; p < size_t(TaskPriority::Count); p++)
+        {
+            if (p == size_t(TaskPriority::Background))
+            {
+                auto running = this->background_running.load();
+                do
+                {
+                    if (running >= this->max_background)
+                        return false;
+                } while (!this->background_running.compare_exchange_weak(running, running + 1));
+            }
+
+            for (size_t offset = 0; offset < this->queues.size(); offset++)
+            {
+                auto& queue = *this->queues[(index + offset) % this->queues.size()];
+                std::unique_lock<std::mutex> lock(queue.mutex);
+                auto& tasks = queue.tasks[p];
+                if (tasks.empty())
+                    continue;
+
+                if (offset == 0)
+                {
+                    task = std::move(tasks.front());
+                    tasks.pop_front();
+                }
+                else
+                {
+                    task = std::move(tasks.back());
+                    tasks.pop_back();
+                }
+                priority = TaskPriority(p);
+                return true;
+            }
+
+            if (p == size_t(TaskPriority::Background))
+                this->background_running--;
+        }
+        return false;
+    }
+
+    void work(size_t index)
+    {
+        Zep::profile_set_thread_name("Worker " + std::to_string(index));
+        current_pool() = this;
+        current_worker() = index;
+        size_t seen = 0;
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(this->sleep_mutex);
+                this->condition.wait(lock,
+                    [this] { return (this->stop && this->pending == 0) || this->pending > this->waiting_background; });
+                if (this->stop && this->pending == 0)
+                    return;
+                seen = this->pending;
+            }
+
+            pool_task task;
+            auto priority = TaskPriority::Normal;
+            if (!take(index, task, priority))
+            {
+                // Only held back background work is queued, or another worker took the task; if nothing has been
+                // queued since, wait for more
+                std::unique_lock<std::mutex> lock(this->sleep_mutex);
+                if (this->pending == seen && this->background_running >= this->max_background)
+                    this->waiting_background = seen;
+                continue;
+            }
+
+            {
+                std::unique_lock<std::mutex> lock(this->sleep_mutex);
+                this->pending--;
+                this->waiting_background = 0;
+            }
+
+            current_name() = task.name;
+            {
+                Zep::ProfileBlock block(task.name ? task.name : "Task");
+                task.fn();
+            }
+            current_name() = nullptr;
+
+            if (priority == TaskPriority::Background)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(this->sleep_mutex);
+                    this->background_running--;
+                    this->waiting_background = 0;
+                }
+                this->condition.notify_all();
+            }
+        }
+    }
+
 private:
     // need to keep track of threads so we can join them
     std::vector< std::thread > workers;
-    // the task queue
-    std::queue< std::function<void()> > tasks;
+    // the task queues, one for each worker
+    std::vector< std::unique_ptr<worker_queue> > queues;
+    std::atomic<size_t> next_queue{ 0 };
 
-    // synchronization
-    std::mutex queue_mutex;
+    // synchronization; the counts are guarded by the sleep mutex, except the background slots, which are claimed with
+    // a compare-exchange as a task is taken
+    std::mutex sleep_mutex;
     std::condition_variable condition;
+    size_t pending = 0;
+    size_t waiting_background = 0;
+    std::atomic<size_t> background_running{ 0 };
+    size_t max_background = 0;
     // workers finalization flag
     std::atomic_bool stop;
 };
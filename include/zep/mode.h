@@ -72,6 +72,23 @@ enum class EditorMode
     Ex
 };
 
+inline const char* GetEditorModeName(EditorMode mode)
+{
+    switch (mode)
+    {
+    case EditorMode::Normal:
+        return "Normal";
+    case EditorMode::Insert:
+        return "Insert";
+    case EditorMode::Visual:
+        return "Visual";
+    case EditorMode::Ex:
+        return "Ex";
+    default:
+        return "None";
+    }
+}
+
 enum class CommandOperation
 {
     None,
@@ -155,6 +172,9 @@ public:
 
     virtual void Init() {};
     virtual void AddKeyPress(uint32_t key, uint32_t modifierKeys = ModifierKey::None);
+
+    // Puts the text held back by ZepEditorFlags::CoalesceInput into the buffer
+    virtual void FlushPendingInsert();
     virtual const char* Name() const = 0;
     virtual void Begin(ZepWindow* pWindow);
     virtual void Notify(std::shared_ptr<ZepMessage> message) override {}
@@ -210,6 +230,9 @@ protected:
 
     virtual bool HandleIgnoredInput(CommandContext&) { return false; };
 
+    // Holds back a key that only types its char, to go in with the others typed before the frame
+    virtual bool QueueInsert(uint32_t key, uint32_t modifierKeys);
+
 protected:
     std::stack<std::shared_ptr<ZepCommand>> m_undoStack;
     std::stack<std::shared_ptr<ZepCommand>> m_redoStack;
@@ -235,6 +258,8 @@ protected:
     CursorType m_visualCursorType = CursorType::Visual;
     uint32_t m_modeFlags = ModeFlags::None;
     uint32_t m_lastKey = 0;
+    std::string m_lastCommandName; // For the latency stats
+    std::string m_pendingInsert;
 
     ZepWindow* m_pCurrentWindow = nullptr;
 
@@ -19,8 +19,7 @@ public:
 
     virtual void AddKeyPress(uint32_t key, uint32_t modifiers = 0) override;
     virtual void Begin(ZepWindow* pWindow) override;
-    virtual void Notify(std::shared_ptr<ZepMessage> message) override;
-    
+
     static const char* StaticName()
     {
         return "Search";
@@ -32,11 +31,28 @@ public:
 
     virtual CursorType GetCursorType() const override;
 
+    // List of lines in the file result, with last found char
+    struct SearchResult
+    {
+        uint32_t index = 0;
+        uint32_t location = 0;
+    };
+
+    // A mapping from character distance to a list of lines
+    struct IndexSet
+    {
+        std::multimap<uint32_t, SearchResult> indices;
+    };
+
+    // The paths in the start set that have the next search character after the last one found
+    static std::shared_ptr<IndexSet> FilterIndexSet(const IndexSet& startSet, const FileIndexResult& files, char startChar, bool caseImportant);
+
 private:
     void GetSearchPaths(const ZepPath& path, std::vector<std::string>& ignore, std::vector<std::string>& include) const;
     void InitSearchTree();
     void ShowTreeResult();
     void UpdateTree();
+    void OnIndexReady();
 
     enum class OpenType
     {
@@ -48,25 +64,13 @@ private:
     void OpenSelection(OpenType type);
 
 private:
-
-    // List of lines in the file result, with last found char
-    struct SearchResult
-    {
-        uint32_t index = 0;
-        uint32_t location = 0;
-    };
-
-    // A mapping from character distance to a list of lines
-    struct IndexSet
-    {
-        std::multimap<uint32_t, SearchResult> indices;
-    };
-
     bool fileSearchActive = false;
     bool treeSearchActive = false;
+    uint32_t m_searchId = 0;
 
     // Results of the file search and the indexing threads
     std::future<std::shared_ptr<FileIndexResult>> m_indexResult;
+    CancelToken m_cancelIndex;
     std::future<std::shared_ptr<IndexSet>> m_searchResult;
 
     // All files that can potentially match
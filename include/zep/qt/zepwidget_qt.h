@@ -30,7 +30,9 @@ public:
         setFocusPolicy ( Qt::StrongFocus );
 
         m_spEditor = std::make_unique<ZepEditor>(new ZepDisplay_Qt(), root);
-        m_spEditor->RegisterCallback(this);
+        m_spEditor->Subscribe(this, Msg::RequestQuit);
+        m_spEditor->Subscribe(this, Msg::GetClipBoard);
+        m_spEditor->Subscribe(this, Msg::SetClipBoard);
 
         // On Apple/Qt, we scale 1.0 because the OS and Qt take care of the details
 #ifdef __APPLE__
@@ -44,15 +46,19 @@ public:
         setFocusPolicy(Qt::FocusPolicy::StrongFocus);
         setMouseTracking(true);
 
-        m_refreshTimer.setInterval(1);
-        m_refreshTimer.setSingleShot(false);
-        m_refreshTimer.start();
+        // Wake at the editor's next deadline, or sooner when work finishes on another thread
+        m_refreshTimer.setSingleShot(true);
+        m_refreshTimer.start(0);
         connect(&m_refreshTimer, &QTimer::timeout, this, &ZepWidget_Qt::OnTimer);
+        m_spEditor->GetScheduler().SetWakeCallback([this]() {
+            QMetaObject::invokeMethod(this, [this]() { m_refreshTimer.start(0); }, Qt::QueuedConnection);
+        });
 
     }
 
     ~ZepWidget_Qt()
     {
+        m_spEditor->GetScheduler().SetWakeCallback(nullptr);
         m_spEditor->UnRegisterCallback(this);
 
         m_spEditor.reset();
@@ -237,6 +243,7 @@ public:
         if (m_spEditor)
         {
             m_spEditor->OnMouseDown(toNVec2f(ev->localPos()), GetMouseButton(ev));
+            update();
         }
     }
     virtual void mouseReleaseEvent(QMouseEvent* ev) override
@@ -245,6 +252,7 @@ public:
         if (m_spEditor)
         {
             m_spEditor->OnMouseUp(toNVec2f(ev->localPos()), GetMouseButton(ev));
+            update();
         }
     }
 
@@ -258,6 +266,7 @@ public:
         if (m_spEditor)
         {
             m_spEditor->OnMouseMove(toNVec2f(ev->localPos()));
+            update();
         }
     }
 
@@ -274,6 +283,13 @@ private slots:
         {
             update();
         }
+
+        auto now = timer_get_time_now();
+        auto wakeTime = std::max(m_spEditor->GetNextWakeTime(), now);
+        if (wakeTime != NoDeadline)
+        {
+            m_refreshTimer.start(int(std::min(wakeTime - now, uint64_t(1000000)) / 1000));
+        }
     }
 
 private:
@@ -1,27 +1,131 @@
 #pragma once
 
+#include <iosfwd>
+#include <random>
+
+#include "zep/latency.h"
 #include "zep/mcommon/animation/timer.h"
 
 namespace Zep
 {
 
 class ZepEditor;
+
+// Splits and closes windows at random, from a seed so that a run can be repeated: ZRegress [seed]
 class ZepRegressExCommand : public ZepExCommand
 {
 public:
     ZepRegressExCommand(ZepEditor& editor);
-    
+
     static void Register(ZepEditor& editor);
-   
+
     virtual void Tick();
     virtual void Run(const std::vector<std::string>& tokens) override;
-    virtual void Notify(std::shared_ptr<ZepMessage> message) override;
     virtual const char* ExCommandName() const override;
 
 private:
-    timer m_timer;
+    ScheduleId m_tickSchedule = InvalidScheduleId;
     bool m_enable = false;
     uint32_t m_windowOperationCount = 0;
+    std::mt19937 m_random;
+};
+
+enum class WorkloadEventType : uint8_t
+{
+    Key,
+    MouseMove,
+    MouseDown,
+    MouseUp,
+    Resize,
+    Count
+};
+
+// Something the host did to the editor.  Positions are in pixels; a resize has the editor's corners in pos and size
+struct WorkloadEvent
+{
+    WorkloadEventType type = WorkloadEventType::Key;
+    uint64_t timeUs = 0; // Since the recording started
+    uint32_t key = 0;
+    uint32_t modifiers = 0;
+    ZepMouseButton button = ZepMouseButton::Unknown;
+    NVec2f pos;
+    NVec2f size;
+};
+
+// A recorded session: the buffer it started from, and the events in order
+struct WorkloadTrace
+{
+    std::string bufferName;
+    std::string text;
+    std::vector<WorkloadEvent> events;
+};
+
+// The binary form is a header, the buffer, then the events; each a type byte, then variable length integers for the
+// time since the last event and its fields.  Positions are stored in whole pixels
+void WriteWorkloadTrace(std::ostream& str, const WorkloadTrace& trace);
+bool ReadWorkloadTrace(std::istream& str, WorkloadTrace& trace);
+
+// Records the host's input into a trace.  The editor and the modes report their input here as they get it
+class ZepWorkloadRecorder
+{
+public:
+    // The trace starts from the buffer's text, and the editor's size
+    void Start(const ZepBuffer& buffer, const NRectf& editorRect);
+    WorkloadTrace Stop();
+
+    bool IsRecording() const
+    {
+        return m_recording;
+    }
+
+    void KeyPressed(uint32_t key, uint32_t modifiers, uint64_t pressedUs);
+    void MouseEvent(WorkloadEventType type, const NVec2f& pos, ZepMouseButton button = ZepMouseButton::Unknown);
+    void Resized(const NRectf& editorRect);
+
+    // The keys since the last ':', which typed the command that is stopping the recording
+    void DropExCommand();
+
+private:
+    void Add(WorkloadEvent& ev, uint64_t nowUs);
+
+private:
+    bool m_recording = false;
+    uint64_t m_startUs = 0;
+    WorkloadTrace m_trace;
+};
+
+enum class WorkloadReplaySpeed
+{
+    Fast,    // Each event as soon as the last one is drawn
+    RealTime // Each event at the time it was recorded
+};
+
+struct WorkloadReplayResult
+{
+    // For each event, from dispatching it to the end of the frame that shows it
+    std::vector<uint64_t> eventLatencyUs;
+    LatencyHistogram latency[size_t(WorkloadEventType::Count)];
+    uint64_t totalUs = 0;
+};
+
+// Loads the trace's buffer into the editor, and plays the events into it, drawing a frame after each one
+void ReplayWorkload(ZepEditor& editor, const WorkloadTrace& trace, WorkloadReplaySpeed speed, WorkloadReplayResult& result);
+
+const char* GetWorkloadEventName(WorkloadEventType type);
+
+// :ZRecord <file> starts recording the session; :ZRecord again stops, and writes the trace
+class ZepRecordExCommand : public ZepExCommand
+{
+public:
+    ZepRecordExCommand(ZepEditor& editor);
+
+    static void Register(ZepEditor& editor);
+
+    virtual void Run(const std::vector<std::string>& tokens) override;
+    virtual const char* ExCommandName() const override;
+
+private:
+    std::string m_path;
 };
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+namespace Zep
+{
+
+using ScheduleId = uint64_t;
+const ScheduleId InvalidScheduleId = 0;
+
+// A time that never comes; the next wake time when nothing is scheduled
+const uint64_t NoDeadline = std::numeric_limits<uint64_t>::max();
+
+// Work for the editor's thread at a given time, so that components don't poll on every tick.
+// Times are in microseconds, on the clock of timer_get_time_now.  Callbacks always run on the editor's thread, in
+// Update; Post may be called from any thread, and is how a worker reports that its job is done.
+// Every callback has an owner, and Cancel(pOwner) drops all of them; components do this as they are destroyed
+class ZepScheduler
+{
+public:
+    // Run at or after the time
+    ScheduleId AddDeadline(const void* pOwner, uint64_t time, std::function<void()> fnCallback);
+
+    // Run after a number of seconds, then every 'repeatSeconds' until cancelled, if it is more than 0
+    ScheduleId AddTimer(const void* pOwner, double seconds, std::function<void()> fnCallback, double repeatSeconds = 0.0);
+
+    // Run on the next update, from any thread
+    ScheduleId Post(const void* pOwner, std::function<void()> fnCallback);
+
+    void Cancel(ScheduleId id);
+    void Cancel(const void* pOwner);
+
+    // Call the host, from any thread, so that a host asleep until the next deadline wakes up early
+    void Wake();
+    void SetWakeCallback(std::function<void()> fnWake);
+
+    // Run the callbacks that are due.  Returns true if any ran
+    bool Update(uint64_t now);
+
+    // The time of the next deadline, 0 if work has been posted, or NoDeadline
+    uint64_t GetNextDeadline() const;
+
+private:
+    struct ScheduleEntry
+    {
+        ScheduleId id;
+        const void* pOwner;
+        uint64_t time;
+        uint64_t repeat;
+        std::function<void()> fnCallback;
+    };
+
+    ScheduleId Add(const void* pOwner, uint64_t time, uint64_t repeat, std::function<void()> fnCallback);
+
+private:
+    mutable std::mutex m_mutex;
+    std::vector<ScheduleEntry> m_entries;   // Ordered by time, then by the order they were added
+    std::function<void()> m_fnWake;
+    ScheduleId m_nextId = 1;
+};
+
+} // namespace Zep
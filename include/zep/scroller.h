@@ -25,6 +25,7 @@ public:
 
 private:
     void CheckState();
+    void StartRepeat();
     void ClickUp();
     void ClickDown();
     void PageUp();
@@ -42,6 +43,7 @@ private:
     std::shared_ptr<Region> m_mainRegion;
     timer m_start_delay_timer;
     timer m_reclick_timer;
+    ScheduleId m_repeatSchedule = InvalidScheduleId;
     enum class ScrollState
     {
         None,
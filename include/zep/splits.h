@@ -44,7 +44,7 @@ struct Region
 
 inline std::ostream& operator<<(std::ostream& str, const Region& region)
 {
-    static int indent = 0;
+    static thread_local int indent = 0;
     auto do_indent = [&str](int sz) { for (int i = 0; i < sz; i++) str << " "; };
 
     do_indent(indent);
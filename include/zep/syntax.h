@@ -10,6 +10,7 @@
 
 #include "zep/mcommon/animation/timer.h"
 #include "zep/mcommon/math/math.h"
+#include "zep/mcommon/threadutils.h"
 
 namespace Zep
 {
@@ -45,6 +46,53 @@ struct SyntaxResult : SyntaxData
     NVec4f customForegroundColor;
 };
 
+// A run of bytes sharing the same resolved colors; what the renderer consumes
+struct SyntaxSpan
+{
+    ByteIndex start = 0;
+    ByteIndex end = 0;
+    NVec4f foreground;
+    NVec4f background;
+    bool hasForeground = false;
+    bool hasBackground = false;
+    bool underline = false;
+};
+
+// The most text a syntax job copies; a job for more than this is done in windows of this size, one after the other
+const ByteIndex SyntaxWindowBytes = 256 * 1024;
+
+// A unit of background syntax work.
+// The job owns a snapshot of the buffer text from 'textOffset' to the end of the line holding 'targetChar', so the
+// worker never reads the live buffer.  If that is more than a window, the snapshot stops short ('truncated') and the
+// rest is queued when the result is applied.
+// Results are indexed from 'textOffset' and only applied if the buffer version still matches when the job completes
+struct SyntaxJob
+{
+    uint64_t version = 0;
+    ByteIndex textOffset = 0;
+    ByteIndex targetChar = 0;
+    bool truncated = false;
+    GapBuffer<uint8_t> text;
+    std::vector<SyntaxData> syntax;
+    std::atomic<bool> cancel = { false };
+
+    // Lexers that carry state across lines start on 'startLine' in 'startState', and record the state
+    // at the start of each following line they reach
+    long startLine = 0;
+    uint64_t startState = 0;
+    std::vector<uint64_t> lineStates;
+
+    // Mark a region of the snapshot, growing the results as required
+    void Mark(ByteIndex start, ByteIndex end, const SyntaxData& data)
+    {
+        if (end > ByteIndex(syntax.size()))
+        {
+            syntax.resize(end);
+        }
+        std::fill(syntax.begin() + start, syntax.begin() + end, data);
+    }
+};
+
 enum class SyntaxFlashType
 {
     Flash,
@@ -62,9 +110,11 @@ public:
     virtual ~ZepSyntax();
 
     virtual SyntaxResult GetSyntaxAt(long index) const;
-    virtual void UpdateSyntax();
+    virtual void GetSyntaxRange(ByteIndex start, ByteIndex end, std::vector<SyntaxResult>& results) const;
+    virtual void GetSyntaxSpans(ByteIndex start, ByteIndex end, std::vector<SyntaxSpan>& spans) const;
+    virtual void UpdateSyntax(SyntaxJob& job);
     virtual void Interrupt();
-    virtual void Wait() const;
+    virtual void Wait();
 
     virtual long GetProcessedChar() const
     {
@@ -72,6 +122,9 @@ public:
     }
     virtual void Notify(std::shared_ptr<ZepMessage> payload) override;
 
+    // The partner of a bracket from an adornment that tracks them; 'answered' is false if none does
+    virtual ByteIndex FindMatchingBracket(ByteIndex location, bool& answered) const;
+
     virtual void BeginFlash(float seconds, SyntaxFlashType type = SyntaxFlashType::Cylon, const NVec2i& range = NVec2i(0));
     virtual void EndFlash() const;
 
@@ -80,26 +133,41 @@ public:
 
     virtual void SetCurrentCursor(ByteIndex index) { m_currentCursor = index; };
 private:
+    virtual void ApplySyntaxResult();
+    void ApplyFlash(long offset, float time, SyntaxResult& result) const;
+
+protected:
     virtual void QueueUpdateSyntax(ByteIndex startLocation, ByteIndex endLocation);
 
+    // Called on the main thread before a job is queued, and after its result is applied.
+    // The default queues the rest of a truncated job
+    virtual void BeginSyntaxJob(SyntaxJob& job)
+    {
+        (void)job;
+    }
+    virtual void EndSyntaxJob(const SyntaxJob& job);
+
 protected:
     ZepBuffer& m_buffer;
     std::vector<CommentEntry> m_commentEntries;
     std::vector<SyntaxData> m_syntax;
-    std::future<void> m_syntaxResult;
+    std::shared_ptr<SyntaxJob> m_spSyntaxJob;
+    std::future<std::shared_ptr<SyntaxJob>> m_syntaxResult;
+    std::vector<std::future<std::shared_ptr<SyntaxJob>>> m_cancelledResults;
     std::atomic<long> m_processedChar = { 0 };
     std::atomic<long> m_targetChar = { 0 };
     std::vector<uint32_t> m_multiCommentStarts;
     std::vector<uint32_t> m_multiCommentEnds;
     std::unordered_set<std::string> m_keywords;
     std::unordered_set<std::string> m_identifiers;
-    std::atomic<bool> m_stop;
     std::vector<std::shared_ptr<ZepSyntaxAdorn>> m_adornments;
     uint32_t m_flags;
+    mutable std::vector<SyntaxResult> m_rangeResults;
 
     mutable NVec2<ByteIndex> m_flashRange;
     float m_flashDuration = 1.0f;
     timer m_flashTimer;
+    ScheduleId m_flashSchedule = InvalidScheduleId;
     SyntaxFlashType m_flashType = SyntaxFlashType::Cylon;
     ByteIndex m_currentCursor = 0;
 };
@@ -115,6 +183,30 @@ public:
     }
 
     virtual SyntaxResult GetSyntaxAt(long offset, bool& found) const = 0;
+
+    // Overwrite the results in [start, end) wherever this adornment has something to say
+    virtual void GetSyntaxRange(ByteIndex start, ByteIndex end, SyntaxResult* pResults) const
+    {
+        for (auto offset = start; offset < end; offset++)
+        {
+            bool found = false;
+            auto result = GetSyntaxAt(offset, found);
+            if (found)
+            {
+                pResults[offset - start] = result;
+            }
+        }
+    }
+
+    // Adornments that track nesting can find the partner of a bracket, and set 'answered' when they do, even if it
+    // has none
+    virtual ByteIndex FindMatchingBracket(ByteIndex location, bool& answered) const
+    {
+        (void)location;
+        answered = false;
+        return InvalidByteIndex;
+    }
+
     virtual void SetCurrentCursor(ByteIndex index) { m_currentCursor = index; };
 
 protected:
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "syntax.h"
+
+#include <string>
+#include <vector>
+
+namespace Zep
+{
+
+// Highlight results for one file, as stored under the project's .zep folder.
+// An entry is keyed by a hash of the content and by the grammar name and version; the per line hashes let a file
+// that has changed since reuse the results up to its first changed line
+struct SyntaxCacheEntry
+{
+    uint64_t contentHash = 0;
+    std::vector<uint32_t> lineHashes;
+    std::vector<uint64_t> lineStates;
+    std::vector<SyntaxData> syntax;
+};
+
+// Hash the text as a whole, and each line, given the offsets just past each line end
+void SyntaxCache_Hash(const std::string& text, const std::vector<long>& lineEnds, uint64_t& contentHash, std::vector<uint32_t>& lineHashes);
+
+// The syntax is stored as runs of identical colors, so reading expands straight into the result
+bool SyntaxCache_Read(ZepEditor& editor, const ZepPath& filePath, const std::string& grammarName, uint32_t grammarVersion, SyntaxCacheEntry& entry);
+bool SyntaxCache_Write(ZepEditor& editor, const ZepPath& filePath, const std::string& grammarName, uint32_t grammarVersion, const SyntaxCacheEntry& entry);
+
+} // namespace Zep
@@ -0,0 +1,153 @@
+#pragma once
+
+#include "syntax.h"
+#include "theme.h"
+
+#include <array>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace Zep
+{
+
+// A region of text between two literals, such as a string or a comment.
+// Regions can contain other regions; this is how nested comments and multi-line constructs are described
+struct ZepGrammarRegion
+{
+    ZepGrammarRegion(const std::string& regionName, const std::string& regionBegin, const std::string& regionEnd, ThemeColor regionColor = ThemeColor::Normal, uint8_t regionEscape = 0, bool regionSingleLine = false, bool regionLineStart = false)
+        : name(regionName)
+        , begin(regionBegin)
+        , end(regionEnd)
+        , color(regionColor)
+        , escape(regionEscape)
+        , singleLine(regionSingleLine)
+        , lineStart(regionLineStart)
+    {
+    }
+
+    std::string name;
+    std::string begin;
+    std::string end;                    // An empty end closes the region at the end of the line
+    ThemeColor color = ThemeColor::Normal;
+    uint8_t escape = 0;                 // Skips the next character, so "\"" doesn't close a string
+    bool singleLine = false;            // Also closes at the end of the line, if the end wasn't found
+    bool lineStart = false;             // Only opens in the first column
+    bool tokenize = false;              // Lex words inside the region, as at the top level
+    std::vector<std::string> contains;  // Regions that can open inside this one; name it to nest it in itself
+};
+
+struct ZepGrammarKeywords
+{
+    ThemeColor color = ThemeColor::Keyword;
+    std::unordered_set<std::string> words;
+};
+
+// A declarative description of a language
+struct ZepGrammar
+{
+    std::string name;
+    uint32_t version = 1;               // Bump when the grammar changes, so stored results are not reused
+    uint32_t flags = 0;                 // ZepSyntaxFlags
+    std::string wordChars = "_";        // Characters other than letters and digits that make up a word
+    std::string brackets = "(){}[]";
+    std::vector<std::string> contains;  // Regions that can open at the top level
+    std::vector<ZepGrammarRegion> regions;
+    std::vector<ZepGrammarKeywords> keywordClasses;
+};
+
+// The lexer state is the stack of open regions, packed into a word with the innermost in the low byte
+using GrammarState = uint64_t;
+
+// A grammar compiled to tables: one action per byte for each region, the literals that can open a region
+// indexed by their first byte, and a single keyword lookup.  Compiled once and shared by every buffer using it
+class ZepGrammarTable
+{
+public:
+    explicit ZepGrammarTable(const ZepGrammar& grammar);
+
+    // Lex the job's snapshot in its start state, up to the end of the line containing the target
+    void Lex(SyntaxJob& job) const;
+
+    const std::string& GetName() const
+    {
+        return m_name;
+    }
+    uint32_t GetVersion() const
+    {
+        return m_version;
+    }
+
+private:
+    enum CharAction : uint8_t
+    {
+        Word = (1 << 0),
+        Bracket = (1 << 1),
+        Space = (1 << 2),
+        Begin = (1 << 3),
+        End = (1 << 4),
+        Escape = (1 << 5)
+    };
+
+    struct Opener
+    {
+        std::string literal;
+        uint8_t context;
+        bool lineStart;
+    };
+
+    struct Context
+    {
+        ThemeColor color = ThemeColor::Normal;
+        std::string end;
+        bool endsAtLine = false;
+        bool tokenize = true;
+        std::array<uint8_t, 256> actions;
+        std::vector<Opener> openers; // Longest first, so """ wins over "
+    };
+
+    bool Matches(const GapBuffer<uint8_t>& text, ByteIndex offset, const std::string& literal) const;
+
+private:
+    std::string m_name;
+    uint32_t m_version;
+    uint32_t m_flags;
+    std::vector<Context> m_contexts; // [0] is the top level
+    std::array<bool, 256> m_wordChars;
+    std::unordered_map<std::string, ThemeColor> m_keywords;
+};
+
+// Syntax driven by a compiled grammar.  The lexer state at the start of each line is kept, so a job can start on
+// any line; when an edit changes the state flowing out of the lexed lines (an unclosed comment, say), the rest of
+// the buffer is queued again.
+// With the syntax cache enabled, the results for a clean file are stored in the background when lexing completes,
+// and loading the file again only lexes from the first line that differs from the stored copy
+class ZepSyntax_Grammar : public ZepSyntax
+{
+public:
+    ZepSyntax_Grammar(ZepBuffer& buffer, std::shared_ptr<const ZepGrammarTable> spGrammar);
+    virtual ~ZepSyntax_Grammar();
+
+    virtual void UpdateSyntax(SyntaxJob& job) override;
+    virtual void Notify(std::shared_ptr<ZepMessage> payload) override;
+
+protected:
+    virtual void BeginSyntaxJob(SyntaxJob& job) override;
+    virtual void EndSyntaxJob(const SyntaxJob& job) override;
+
+private:
+    bool ReadCache();
+    void WriteCache();
+
+private:
+    std::shared_ptr<const ZepGrammarTable> m_spGrammar;
+    std::vector<GrammarState> m_lineStates;
+    uint64_t m_cachedVersion = 0;
+    std::future<bool> m_cacheWrite;     // The last write of the cache, on a worker
+    ZepPath m_cacheWritePath;           // The file it is for
+    uint64_t m_cacheWriteId = 0;
+    bool m_cacheWritePending = false;   // Another write was asked for while it was going
+};
+
+} // namespace Zep
@@ -1,8 +1,7 @@
 #pragma once
+#include "bracket_tree.h"
 #include "syntax.h"
-#include <list>
 #include <string>
-#include <unordered_map>
 
 namespace Zep
 {
@@ -16,29 +15,19 @@ public:
 
     void Notify(std::shared_ptr<ZepMessage> payload) override;
     virtual SyntaxResult GetSyntaxAt(long offset, bool& found) const override;
+    virtual void GetSyntaxRange(ByteIndex start, ByteIndex end, SyntaxResult* pResults) const override;
 
-    virtual void Clear(long start, long end);
+    // Clear and Update return true if the nesting of the brackets after the range changed
+    virtual bool Clear(long start, long end);
     virtual void Insert(long start, long end);
-    virtual void Update(long start, long end);
+    virtual bool Update(long start, long end);
+
+    virtual ByteIndex FindMatchingBracket(ByteIndex location, bool& answered) const override;
 
 private:
-    void RefreshBrackets();
-    enum class BracketType
-    {
-        Bracket = 0,
-        Brace = 1,
-        Group = 2,
-        Max = 3
-    };
-
-    struct Bracket
-    {
-        int32_t indent;
-        BracketType type;
-        bool is_open;
-        bool valid = true;
-    };
-    std::map<ByteIndex, Bracket> m_brackets;
+    static SyntaxResult ToSyntax(const BracketInfo& bracket);
+
+    BracketTree m_brackets;
 };
 
 } // namespace Zep
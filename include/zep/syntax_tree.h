@@ -13,7 +13,7 @@ public:
         const std::unordered_set<std::string>& identifiers = std::unordered_set<std::string>{},
         uint32_t flags = 0);
 
-    virtual void UpdateSyntax() override;
+    virtual void UpdateSyntax(SyntaxJob& job) override;
 };
 
 } // namespace Zep
@@ -88,10 +88,12 @@ public:
 private:
     void SetDarkTheme();
     void SetLightTheme();
+    void BuildPalette();
 
 private:
     std::vector<NVec4f> m_uniqueColors;
     std::map<ThemeColor, NVec4f> m_colors;
+    std::vector<NVec4f> m_palette;              // Flat lookup of m_colors + m_uniqueColors, indexed by ThemeColor
     ThemeType m_currentTheme = ThemeType::Dark;
 };
 
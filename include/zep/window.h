@@ -1,10 +1,14 @@
 #pragma once
 
+#include <algorithm>
+#include <list>
 #include <vector>
 #include <string>
 #include <unordered_map>
 
 #include "buffer.h"
+#include "line_layout_tree.h"
+#include "syntax.h"
 #include "zep/mcommon/utf8/unchecked.h"
 
 namespace Zep
@@ -19,20 +23,39 @@ struct Region;
 struct LineCharInfo
 {
     NVec2f size;
-    ByteIndex byteIndex = 0;
+    ByteIndex byteOffset = 0;                      // From the start of the span, so spans can move without touching their characters
 };
+
+// Lines longer than this are laid out without keeping every span and code point; only the parts near the view
+const long LongLineBytes = 16384;
+
+// A wrapped long line keeps where every block of this many spans starts, and builds a block again from there
+const long LongLineSpanStep = 64;
+
+// A long line which isn't wrapped keeps the byte offset of every this many code points past the edge of the view
+const long LongLineCodePointStep = 256;
+
 // Line information, calculated during display update.
 // A collection of spans that show split lines on the display
 struct SpanInfo
 {
     BufferByteRange lineByteRange;                 // Begin/end range of the text buffer for this line, as always end is one beyond the end.
-    std::vector<LineCharInfo> lineCodePoints;      // Codepoints
+    std::vector<LineCharInfo> lineCodePoints;      // Codepoints, unless they are all the same size
     long bufferLineNumber = 0;                     // Line in the original buffer, not the screen line
     float yOffsetPx = 0.0f;                        // Position in the buffer in pixels, if the screen was as big as the buffer.
     NVec2f textSizePx = NVec2f(0.0f);              // Pixel size of the text 
     int spanLineIndex = 0;                         // The index of this line in spans; might be more than buffer index
     NVec2f padding = NVec2f(1.0f, 1.0f);           // Padding above and below the line
     bool isSplitContinuation = false;
+    bool fixedAdvance = false;                     // Every code point is a single byte of the same size, other than the last
+    NVec2f fixedCharSize;
+    NVec2f fixedLastCharSize;
+
+    // A long line which isn't wrapped is only measured as far as the view could show it.  The code points past that
+    // are found in the text, from the nearest checkpoint, and are given the default size
+    const GapBuffer<uint8_t>* pTailText = nullptr;
+    size_t tailCodePointCount = 0;
+    std::vector<ByteIndex> tailCheckpoints;        // From the start of the span, every LongLineCodePointStep code points
 
     float FullLineHeightPx() const
     {
@@ -50,6 +73,173 @@ struct SpanInfo
     {
         return offset >= lineByteRange.first && offset < lineByteRange.second;
     }
+
+    size_t CodePointCount() const
+    {
+        return fixedAdvance ? size_t(ByteLength()) : lineCodePoints.size() + tailCodePointCount;
+    }
+
+    LineCharInfo CodePoint(size_t index) const
+    {
+        if (!fixedAdvance && index < lineCodePoints.size())
+        {
+            return lineCodePoints[index];
+        }
+
+        LineCharInfo info;
+        if (fixedAdvance)
+        {
+            info.byteOffset = ByteIndex(index);
+            info.size = (index + 1 == CodePointCount()) ? fixedLastCharSize : fixedCharSize;
+        }
+        else
+        {
+            info.byteOffset = TailByteOffset(index);
+            info.size = fixedCharSize;
+        }
+        return info;
+    }
+
+    ByteIndex CodePointByteIndex(size_t index) const
+    {
+        return lineByteRange.first + (fixedAdvance ? ByteIndex(index) : index < lineCodePoints.size() ? lineCodePoints[index].byteOffset : TailByteOffset(index));
+    }
+
+    // The distance of a code point from the start of the span, when each is followed by the padding
+    float CodePointX(size_t index, float xPad) const
+    {
+        if (fixedAdvance)
+        {
+            return index * (fixedCharSize.x + xPad);
+        }
+
+        float x = 0.0f;
+        for (size_t cp = 0; cp < index && cp < lineCodePoints.size(); cp++)
+        {
+            x += lineCodePoints[cp].size.x + xPad;
+        }
+        if (index > lineCodePoints.size())
+        {
+            x += (std::min(index, CodePointCount()) - lineCodePoints.size()) * (fixedCharSize.x + xPad);
+        }
+        return x;
+    }
+
+    // The code point at a distance from the start of the span, or -1 if there isn't one or the distance falls
+    // in the padding
+    long CodePointAtX(float x, float xPad) const
+    {
+        if (x < 0.0f)
+        {
+            return -1;
+        }
+
+        if (fixedAdvance)
+        {
+            auto index = size_t(x / (fixedCharSize.x + xPad));
+            if (index >= CodePointCount() || x - CodePointX(index, xPad) >= CodePoint(index).size.x)
+            {
+                return -1;
+            }
+            return long(index);
+        }
+
+        for (size_t index = 0; index < lineCodePoints.size(); index++)
+        {
+            if (x < lineCodePoints[index].size.x)
+            {
+                return long(index);
+            }
+            x -= lineCodePoints[index].size.x + xPad;
+            if (x < 0.0f)
+            {
+                break;
+            }
+        }
+        return -1;
+    }
+
+    // The index of the code point starting at the offset, or -1
+    long CodePointIndex(ByteIndex offset) const
+    {
+        if (!BufferCursorInside(offset))
+        {
+            return -1;
+        }
+
+        // When every code point is a single byte, the index is the offset
+        auto byteOffset = offset - lineByteRange.first;
+        if (fixedAdvance || long(CodePointCount()) == ByteLength())
+        {
+            return long(byteOffset);
+        }
+
+        if (!tailCheckpoints.empty() && byteOffset >= tailCheckpoints[0])
+        {
+            // Step from the checkpoint before it
+            auto itrCheckpoint = std::upper_bound(tailCheckpoints.begin(), tailCheckpoints.end(), byteOffset) - 1;
+            auto index = lineCodePoints.size() + size_t(itrCheckpoint - tailCheckpoints.begin()) * LongLineCodePointStep;
+            for (auto tail = *itrCheckpoint; tail <= byteOffset; tail += utf8_codepoint_length((*pTailText)[lineByteRange.first + tail]), index++)
+            {
+                if (tail == byteOffset)
+                {
+                    return long(index);
+                }
+            }
+            return -1;
+        }
+
+        auto itr = std::lower_bound(lineCodePoints.begin(), lineCodePoints.end(), byteOffset, [](const LineCharInfo& info, ByteIndex value) {
+            return info.byteOffset < value;
+        });
+        if (itr == lineCodePoints.end() || itr->byteOffset != byteOffset)
+        {
+            return -1;
+        }
+        return long(itr - lineCodePoints.begin());
+    }
+
+private:
+    // The offset of a code point past the measured ones, from the checkpoint before it
+    ByteIndex TailByteOffset(size_t index) const
+    {
+        auto tailIndex = index - lineCodePoints.size();
+        auto byteOffset = tailCheckpoints[tailIndex / LongLineCodePointStep];
+        for (auto count = tailIndex % LongLineCodePointStep; count > 0; count--)
+        {
+            byteOffset += utf8_codepoint_length((*pTailText)[lineByteRange.first + byteOffset]);
+        }
+        return byteOffset;
+    }
+};
+
+// Some of the spans of a buffer line, from the 'first' one
+struct SpanBlock
+{
+    long first = 0;
+    std::vector<SpanInfo> spans;
+};
+
+// The spans of a buffer line near the view, with the detail of each code point.
+// A short line keeps all of its spans in one block.  A long wrapped line only keeps the blocks of LongLineSpanStep
+// spans which were used lately, and builds one again from where it starts when it is needed.  It is only walked as
+// far as the blocks asked for; until the walk reaches its end, its span count is estimated
+struct LineSpans
+{
+    long bufferLine = -1;                          // -1 if the entry is free
+    long spanCount = 0;
+    std::list<SpanBlock> blocks;                   // Most recently used first
+    std::vector<ByteIndex> blockStarts;            // For a long wrapped line, where each block found so far starts
+    bool complete = true;                          // False until a long wrapped line is walked to its end
+    float widthPx = 0.0f;                          // The widest span walked
+    bool fixedAdvance = false;
+    float firstHeightPx = 0.0f;                    // The height of the first span, with the widgets above it
+    float splitHeightPx = 0.0f;                    // The height of each span after it
+
+    // Where the spans are
+    ByteIndex lineStart = 0;
+    float yOffsetPx = 0.0f;
+    long spanLineIndex = 0;
 };
 
 inline bool operator < (const SpanInfo& lhs, const SpanInfo& rhs)
@@ -76,6 +266,35 @@ enum class DisplayMode
     Vim
 };
 
+// What a window showed in the last frame.  On a display which keeps its last frame, the window is only drawn again
+// in full when the layout part of this changes; otherwise just the lines that changed are drawn
+struct WindowFrameState
+{
+    NRectf textRect;
+    NRectf numberRect;
+    NRectf indicatorRect;
+    float textOffsetPx = 0.0f;
+    NVec2f textSizePx;
+    uint32_t windowFlags = 0;
+    CursorType cursorType = CursorType::None;
+    bool active = false;
+    bool fastUpdate = false;
+    bool toolTips = false;
+    bool mouseOverScroller = false;
+
+    // Only the lines these were on are drawn again when they change
+    ByteIndex cursor = -1;
+    bool cursorBlink = false;
+    ByteIndex mouseLocation = -1; // Markers under the mouse are highlighted
+    BufferByteRange selection = BufferByteRange(0, 0);
+    uint64_t airlineHash = 0;
+
+    bool SameLayout(const WindowFrameState& rhs) const
+    {
+        return textRect == rhs.textRect && numberRect == rhs.numberRect && indicatorRect == rhs.indicatorRect && textOffsetPx == rhs.textOffsetPx && textSizePx == rhs.textSizePx && windowFlags == rhs.windowFlags && cursorType == rhs.cursorType && active == rhs.active && fastUpdate == rhs.fastUpdate && toolTips == rhs.toolTips && mouseOverScroller == rhs.mouseOverScroller;
+    }
+};
+
 namespace WindowFlags
 {
 enum
@@ -137,11 +356,15 @@ public:
     virtual void SetDisplayRegion(const NRectf& region);
     virtual void Display();
 
+    // Draw everything in the next frame, even on a display which keeps the last one
+    virtual void InvalidateDisplay();
+
     // Cursor
     virtual ByteIndex GetBufferCursor();
     virtual void SetBufferCursor(ByteIndex location);
     virtual void MoveCursorY(int yDistance, LineLocation clampLocation = LineLocation::LineLastNonCR);
     virtual NVec2i BufferToDisplay();
+    virtual ByteIndex DisplayToBuffer(const NVec2i& display);
 
     // Flags
     virtual void SetWindowFlags(uint32_t windowFlags);
@@ -162,11 +385,23 @@ private:
     void UpdateLayout(bool force = false);
     void UpdateAirline();
     void UpdateScrollers();
-    void UpdateLineSpans();
+    void UpdateLineSpans(bool fullLayout);
+    void EstimateLineLayout(long bufferLine, LineLayout& layout);
+    void SetLineLayout(long bufferLine, const LineLayout& layout);
+    bool IsFixedAdvanceText(ByteIndex start, ByteIndex end) const;
+    void LayoutBufferLine(LineSpans& lineSpans, SpanBlock& block, LineLayout* pLayout);
+    LineSpans& GetLineSpans(long bufferLine);
+    void ExtendLineSpans(LineSpans& lineSpans, long spanInLine, ByteIndex location);
+    SpanInfo& GetLineSpan(LineSpans& lineSpans, long spanInLine);
+    long FindLineSpan(LineSpans& lineSpans, ByteIndex location);
+    long FindLineSpanAtY(const LineSpans& lineSpans, float y) const;
+    SpanInfo& GetSpan(long index);
+    long GetSpanCount() const;
     void EnsureCursorVisible();
     void UpdateVisibleLineRange();
 
     NVec2i BufferToDisplay(const ByteIndex& location);
+    ByteIndex ScreenToBuffer(const NVec2f& pos);
 
     void ScrollToCursor();
     bool IsInsideTextRegion(NVec2i pos) const;
@@ -198,6 +433,10 @@ private:
     void PlaceToolTip(const NVec2f& pos, ToolTipPos location, uint32_t lineGap, const std::shared_ptr<RangeMarker> spMarker);
 
     void DrawLineWidgets(SpanInfo& lineInfo);
+    void DisplayBackgrounds(float top, float bottom);
+    void DisplayAirline();
+    void InvalidateLines(long firstLine, long lastLine);
+    bool IsLineInvalid(long bufferLine) const;
 
     float GetLineTopPadding(long line);
     
@@ -243,8 +482,21 @@ private:
     DisplayMode m_displayMode = DisplayMode::Vim;
     std::vector<std::string> m_statusLines; // Status information, shown under the buffer
 
-    // Setup of displayed lines
-    std::vector<SpanInfo*> m_windowLines;   // Information about the currently displayed lines
+    // Setup of displayed lines.
+    // Every buffer line has a layout, and the sums of their heights and span counts give the position of any line.
+    // Spans are only built for the lines near the view, and kept for the most recently used lines
+    LineLayoutTree m_lineLayouts;
+    std::list<LineSpans> m_spanCache;       // Most recently used first; free entries at the end
+    std::unordered_map<long, std::list<LineSpans>::iterator> m_spanCacheLines;
+    long m_dirtyFirstLine = -1;             // The first buffer line edited since the last layout, or -1
+    long m_dirtyTailLines = 0;              // The unchanged lines at the end of the buffer
+    float m_layoutWidthPx = 0.0f;           // The width the lines were wrapped to
+    uint64_t m_layoutVersion = 0;           // Changes when any span might have moved
+
+    // The last location mapped to the display, which is nearly always the cursor
+    ByteIndex m_displayCacheLocation = -1;
+    uint64_t m_displayCacheVersion = 0;
+    NVec2i m_displayCachePos;
     float m_textOffsetPx = 0.0f;         // The Scroll position within the text
     NVec2f m_textSizePx;                    // The calculated size of the buffer text, containing just the text
     NVec2i m_visibleLineIndices = {0, 0};   // Index of the line spans that are visible 
@@ -259,6 +511,17 @@ private:
     NVec2f m_lastTipQueryPos;            // last query location for the tip
     bool m_tipDisabledTillMove = false;  // Certain operations will stop the tip until the mouse is moved
     std::map<NVec2f, std::shared_ptr<RangeMarker>> m_toolTips;  // All tooltips for a given position, currently only 1 at a time
+    std::vector<SyntaxSpan> m_syntaxSpans;                       // Resolved syntax colors for the line being drawn
+    std::vector<float> m_codePointX;                             // Screen position of each code point on the line being drawn
+    std::string m_layoutText;                                    // The line being laid out
+    std::vector<NVec2f> m_layoutCharSizes;                       // The size of each code point in it
+    SpanBlock m_walkBlock;                                       // The blocks a long line is walked through
+    std::string m_drawRun;                                       // Characters of one color waiting to be drawn
+
+    // Partial redraw, on displays which keep the last frame
+    WindowFrameState m_lastFrameState;
+    bool m_redrawAll = true;
+    std::vector<NVec2<long>> m_redrawLines;                      // Buffer lines to draw again, first to last
 };
 
 } // namespace Zep
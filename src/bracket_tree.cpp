@@ -0,0 +1,502 @@
+#include "zep/bracket_tree.h"
+
+#include <algorithm>
+
+namespace Zep
+{
+
+namespace
+{
+bool GetBracketType(uint8_t ch, BracketType& type, bool& isOpen)
+{
+    switch (ch)
+    {
+    case '(':
+    case ')':
+        type = BracketType::Bracket;
+        break;
+    case '[':
+    case ']':
+        type = BracketType::Group;
+        break;
+    case '{':
+    case '}':
+        type = BracketType::Brace;
+        break;
+    default:
+        return false;
+    }
+    isOpen = (ch == '(' || ch == '[' || ch == '{');
+    return true;
+}
+} // namespace
+
+BracketTree::Summary BracketTree::Combine(const Summary& a, const Summary& b)
+{
+    Summary ret;
+    ret.count = a.count + b.count;
+    ret.sum = a.sum + b.sum;
+    ret.minPrefix = std::min(a.minPrefix, a.sum + b.minPrefix);
+    ret.maxSuffix = std::max(b.maxSuffix, b.sum + a.maxSuffix);
+    return ret;
+}
+
+BracketTree::Summary BracketTree::SelfSummary(const Node& node, size_t type)
+{
+    Summary ret;
+    if (size_t(node.type) == type)
+    {
+        ret.count = 1;
+        ret.sum = node.isOpen ? 1 : -1;
+        ret.minPrefix = std::min(0, ret.sum);
+        ret.maxSuffix = std::max(0, ret.sum);
+    }
+    return ret;
+}
+
+// Two sections with the same sum and lowest point leave the depth of every bracket after them the same
+bool BracketTree::SameWalk(const Summaries& a, const Summaries& b)
+{
+    for (size_t type = 0; type < a.size(); type++)
+    {
+        if (a[type].sum != b[type].sum || a[type].minPrefix != b[type].minPrefix)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void BracketTree::Clear()
+{
+    m_nodes.clear();
+    m_freeNodes.clear();
+    m_root = -1;
+    m_size = 0;
+}
+
+size_t BracketTree::Size() const
+{
+    return m_size;
+}
+
+int32_t BracketTree::NewNode(ByteIndex delta, BracketType type, bool isOpen)
+{
+    int32_t index;
+    if (!m_freeNodes.empty())
+    {
+        index = m_freeNodes.back();
+        m_freeNodes.pop_back();
+    }
+    else
+    {
+        index = int32_t(m_nodes.size());
+        m_nodes.emplace_back();
+    }
+
+    // xorshift; the priorities just need to be well spread to keep the tree balanced
+    m_seed ^= m_seed << 13;
+    m_seed ^= m_seed >> 17;
+    m_seed ^= m_seed << 5;
+
+    auto& node = m_nodes[index];
+    node = Node{};
+    node.delta = delta;
+    node.priority = m_seed;
+    node.type = type;
+    node.isOpen = isOpen;
+    Update(index);
+
+    m_size++;
+    return index;
+}
+
+void BracketTree::FreeTree(int32_t t)
+{
+    if (t == -1)
+    {
+        return;
+    }
+    FreeTree(m_nodes[t].left);
+    FreeTree(m_nodes[t].right);
+    m_freeNodes.push_back(t);
+    m_size--;
+}
+
+ByteIndex BracketTree::Span(int32_t t) const
+{
+    return t == -1 ? 0 : m_nodes[t].span;
+}
+
+void BracketTree::Update(int32_t t)
+{
+    auto& node = m_nodes[t];
+    node.span = Span(node.left) + node.delta + Span(node.right);
+    for (size_t type = 0; type < node.summary.size(); type++)
+    {
+        auto summary = SelfSummary(node, type);
+        if (node.left != -1)
+        {
+            summary = Combine(m_nodes[node.left].summary[type], summary);
+        }
+        if (node.right != -1)
+        {
+            summary = Combine(summary, m_nodes[node.right].summary[type]);
+        }
+        node.summary[type] = summary;
+    }
+}
+
+void BracketTree::CombinePrefix(Summaries& prefix, int32_t t) const
+{
+    if (t == -1)
+    {
+        return;
+    }
+    for (size_t type = 0; type < prefix.size(); type++)
+    {
+        prefix[type] = Combine(prefix[type], m_nodes[t].summary[type]);
+    }
+}
+
+void BracketTree::CombinePrefix(Summaries& prefix, const Node& node) const
+{
+    auto type = size_t(node.type);
+    prefix[type] = Combine(prefix[type], SelfSummary(node, type));
+}
+
+// Split into brackets before 'location' and the rest.  The right tree comes back relative to 'location'
+void BracketTree::Split(int32_t t, ByteIndex location, int32_t& left, int32_t& right)
+{
+    if (t == -1)
+    {
+        left = right = -1;
+        return;
+    }
+
+    auto& node = m_nodes[t];
+    auto nodeLocation = Span(node.left) + node.delta;
+    if (nodeLocation < location)
+    {
+        int32_t splitRight;
+        Split(node.right, location - nodeLocation, m_nodes[t].right, splitRight);
+        left = t;
+        right = splitRight;
+    }
+    else
+    {
+        int32_t splitLeft, splitRight;
+        Split(node.left, location, splitLeft, splitRight);
+
+        // This node now follows the brackets in splitRight, in a tree that starts at 'location'
+        m_nodes[t].left = splitRight;
+        m_nodes[t].delta = nodeLocation - location - Span(splitRight);
+        left = splitLeft;
+        right = t;
+    }
+    Update(t);
+}
+
+// Concatenate two trees; the first bracket in the right tree must already be relative to the last one in the left
+int32_t BracketTree::Merge(int32_t left, int32_t right)
+{
+    if (left == -1)
+    {
+        return right;
+    }
+    if (right == -1)
+    {
+        return left;
+    }
+
+    if (m_nodes[left].priority > m_nodes[right].priority)
+    {
+        auto merged = Merge(m_nodes[left].right, right);
+        m_nodes[left].right = merged;
+        Update(left);
+        return left;
+    }
+
+    auto merged = Merge(left, m_nodes[right].left);
+    m_nodes[right].left = merged;
+    Update(right);
+    return right;
+}
+
+// Concatenate, where the right tree is relative to 'rightBase' in the left tree
+int32_t BracketTree::Join(int32_t left, int32_t right, ByteIndex rightBase)
+{
+    AddToFirst(right, rightBase - Span(left));
+    return Merge(left, right);
+}
+
+void BracketTree::AddToFirst(int32_t t, ByteIndex amount)
+{
+    if (t == -1)
+    {
+        return;
+    }
+
+    if (m_nodes[t].left != -1)
+    {
+        AddToFirst(m_nodes[t].left, amount);
+    }
+    else
+    {
+        m_nodes[t].delta += amount;
+    }
+    m_nodes[t].span += amount;
+}
+
+void BracketTree::InsertText(ByteIndex start, ByteIndex length)
+{
+    int32_t left, right;
+    Split(m_root, start, left, right);
+    m_root = Join(left, right, start + length);
+}
+
+bool BracketTree::EraseText(ByteIndex start, ByteIndex end)
+{
+    int32_t left, right, erased, remain;
+    Split(m_root, start, left, right);
+    Split(right, end - start, erased, remain);
+
+    Summaries erasedWalk;
+    CombinePrefix(erasedWalk, erased);
+    FreeTree(erased);
+    m_root = Join(left, remain, start);
+    return !SameWalk(erasedWalk, Summaries());
+}
+
+bool BracketTree::Rescan(const GapBuffer<uint8_t>& text, ByteIndex start, ByteIndex end)
+{
+    end = std::min(end, ByteIndex(text.size()));
+    if (end <= start)
+    {
+        return false;
+    }
+
+    int32_t left, right, erased, remain;
+    Split(m_root, start, left, right);
+    Split(right, end - start, erased, remain);
+
+    Summaries erasedWalk;
+    CombinePrefix(erasedWalk, erased);
+    FreeTree(erased);
+
+    // Build the new section relative to 'start'
+    int32_t section = -1;
+    auto itrEnd = text.begin() + end;
+    for (auto itr = text.begin() + start; itr != itrEnd; itr++)
+    {
+        BracketType type;
+        bool isOpen;
+        if (GetBracketType(*itr, type, isOpen))
+        {
+            auto location = ByteIndex(itr - text.begin()) - start;
+            section = Merge(section, NewNode(location - Span(section), type, isOpen));
+        }
+    }
+
+    Summaries sectionWalk;
+    CombinePrefix(sectionWalk, section);
+
+    section = Join(section, remain, end - start);
+    m_root = Join(left, section, start);
+    return !SameWalk(erasedWalk, sectionWalk);
+}
+
+bool BracketTree::LeftOpen() const
+{
+    if (m_root == -1)
+    {
+        return false;
+    }
+    for (auto& total : m_nodes[m_root].summary)
+    {
+        if (total.sum - total.minPrefix > 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void BracketTree::FillInfo(const Node& node, ByteIndex location, const Summaries& prefix, BracketInfo& info) const
+{
+    auto type = size_t(node.type);
+
+    // The depth is the walk over everything before us, where an unmatched close resets to 0
+    auto depth = prefix[type].sum - prefix[type].minPrefix;
+
+    info.location = location;
+    info.type = node.type;
+    info.isOpen = node.isOpen;
+    info.indent = node.isOpen ? depth : depth - 1;
+    info.valid = info.indent >= 0;
+
+    // If this type is left open at the end of the file, mark the first one
+    if (prefix[type].count == 0 && m_root != -1)
+    {
+        auto& total = m_nodes[m_root].summary[type];
+        if (total.sum - total.minPrefix > 0)
+        {
+            info.valid = false;
+        }
+    }
+}
+
+bool BracketTree::Find(ByteIndex location, BracketInfo& info) const
+{
+    // Walk down to the bracket, collecting the summaries of everything before it
+    Summaries prefix;
+    ByteIndex base = 0;
+    auto t = m_root;
+    while (t != -1)
+    {
+        auto& node = m_nodes[t];
+        auto nodeLocation = base + Span(node.left) + node.delta;
+        if (location < nodeLocation)
+        {
+            t = node.left;
+            continue;
+        }
+
+        CombinePrefix(prefix, node.left);
+        if (location == nodeLocation)
+        {
+            FillInfo(node, nodeLocation, prefix, info);
+            return true;
+        }
+
+        CombinePrefix(prefix, node);
+        base = nodeLocation;
+        t = node.right;
+    }
+    return false;
+}
+
+void BracketTree::Visit(int32_t t, ByteIndex base, ByteIndex start, ByteIndex end, Summaries& prefix, const std::function<void(const BracketInfo&)>& fnVisit) const
+{
+    if (t == -1)
+    {
+        return;
+    }
+
+    auto& node = m_nodes[t];
+    auto nodeLocation = base + Span(node.left) + node.delta;
+    if (nodeLocation >= start)
+    {
+        Visit(node.left, base, start, end, prefix, fnVisit);
+    }
+    else
+    {
+        CombinePrefix(prefix, node.left);
+    }
+
+    if (nodeLocation >= end)
+    {
+        return;
+    }
+
+    if (nodeLocation >= start)
+    {
+        BracketInfo info;
+        FillInfo(node, nodeLocation, prefix, info);
+        fnVisit(info);
+    }
+
+    CombinePrefix(prefix, node);
+    Visit(node.right, nodeLocation, start, end, prefix, fnVisit);
+}
+
+void BracketTree::ForEach(ByteIndex start, ByteIndex end, const std::function<void(const BracketInfo&)>& fnVisit) const
+{
+    Summaries prefix;
+    Visit(m_root, 0, start, end, prefix, fnVisit);
+}
+
+// Find the first bracket after 'after' where the walk of this type drops to -1
+ByteIndex BracketTree::FindForward(int32_t t, ByteIndex base, ByteIndex after, size_t type, bool fullyAfter, int32_t& walk) const
+{
+    if (t == -1)
+    {
+        return InvalidByteIndex;
+    }
+
+    auto& node = m_nodes[t];
+    if (fullyAfter && walk + node.summary[type].minPrefix > -1)
+    {
+        walk += node.summary[type].sum;
+        return InvalidByteIndex;
+    }
+
+    auto nodeLocation = base + Span(node.left) + node.delta;
+    if (nodeLocation > after)
+    {
+        auto found = FindForward(node.left, base, after, type, fullyAfter, walk);
+        if (found != InvalidByteIndex)
+        {
+            return found;
+        }
+
+        walk += SelfSummary(node, type).sum;
+        if (walk == -1)
+        {
+            return nodeLocation;
+        }
+    }
+    return FindForward(node.right, nodeLocation, after, type, fullyAfter || nodeLocation >= after, walk);
+}
+
+// Find the last bracket before 'before' where the walk of this type back from it reaches +1
+ByteIndex BracketTree::FindBackward(int32_t t, ByteIndex base, ByteIndex before, size_t type, bool fullyBefore, int32_t& walk) const
+{
+    if (t == -1)
+    {
+        return InvalidByteIndex;
+    }
+
+    auto& node = m_nodes[t];
+    if (fullyBefore && walk + node.summary[type].maxSuffix < 1)
+    {
+        walk += node.summary[type].sum;
+        return InvalidByteIndex;
+    }
+
+    auto nodeLocation = base + Span(node.left) + node.delta;
+    if (nodeLocation < before)
+    {
+        auto found = FindBackward(node.right, nodeLocation, before, type, fullyBefore, walk);
+        if (found != InvalidByteIndex)
+        {
+            return found;
+        }
+
+        walk += SelfSummary(node, type).sum;
+        if (walk == 1)
+        {
+            return nodeLocation;
+        }
+        return FindBackward(node.left, base, before, type, true, walk);
+    }
+    return FindBackward(node.left, base, before, type, fullyBefore, walk);
+}
+
+ByteIndex BracketTree::FindMatch(ByteIndex location) const
+{
+    BracketInfo info;
+    if (!Find(location, info))
+    {
+        return InvalidByteIndex;
+    }
+
+    int32_t walk = 0;
+    if (info.isOpen)
+    {
+        return FindForward(m_root, 0, location, size_t(info.type), false, walk);
+    }
+    return FindBackward(m_root, 0, location, size_t(info.type), false, walk);
+}
+
+} // namespace Zep
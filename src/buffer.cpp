@@ -7,6 +7,7 @@
 #include "zep/buffer.h"
 #include "zep/editor.h"
 #include "zep/filesystem.h"
+#include "zep/syntax.h"
 
 #include "zep/mcommon/file/path.h"
 #include "zep/mcommon/string/stringutils.h"
@@ -374,6 +375,59 @@ ByteIndex ZepBuffer::FindOnLineMotion(ByteIndex start, const uint8_t* pCh, Searc
     return entry;
 }
 
+// Find the partner of the bracket under the cursor, or of the next bracket on the line (vim's %)
+ByteIndex ZepBuffer::FindMatchingBracket(ByteIndex start) const
+{
+    static const std::string brackets = "()[]{}";
+
+    auto location = start;
+    while (Valid(location) && m_gapBuffer[location] != '\n' && brackets.find(char(m_gapBuffer[location])) == std::string::npos)
+    {
+        location++;
+    }
+
+    if (!Valid(location) || m_gapBuffer[location] == '\n')
+    {
+        return InvalidByteIndex;
+    }
+
+    // The syntax keeps a bracket tree, which can answer without walking the text.  It holds every bracket the walk
+    // would find, so its answer stands, even when there is no partner
+    if (m_spSyntax)
+    {
+        bool answered = false;
+        auto match = m_spSyntax->FindMatchingBracket(location, answered);
+        if (answered)
+        {
+            return match;
+        }
+    }
+
+    auto index = brackets.find(char(m_gapBuffer[location]));
+    auto open = uint8_t(brackets[index & ~size_t(1)]);
+    auto close = uint8_t(brackets[index | 1]);
+    auto dir = (index & 1) ? -1 : 1;
+
+    long depth = 0;
+    for (auto current = location; Valid(current); current += dir)
+    {
+        if (m_gapBuffer[current] == open)
+        {
+            depth += dir;
+        }
+        else if (m_gapBuffer[current] == close)
+        {
+            depth -= dir;
+        }
+
+        if (depth == 0)
+        {
+            return current;
+        }
+    }
+    return InvalidByteIndex;
+}
+
 ByteIndex ZepBuffer::WordMotion(ByteIndex start, uint32_t searchType, SearchDirection dir) const
 {
     auto IsWord = searchType == SearchType::Word ? IsWordChar : IsWORDChar;
@@ -675,7 +729,7 @@ void ZepBuffer::Clear()
     if (m_gapBuffer.size() > 1)
     {
         // Inform clients we are about to change the buffer
-        GetEditor().Broadcast(std::make_shared<BufferMessage>(this, BufferMessageType::PreBufferChange, 0, ByteIndex(m_gapBuffer.size() - 1)));
+        GetEditor().Broadcast(MakeMessage<BufferMessage>(this, BufferMessageType::PreBufferChange, 0, ByteIndex(m_gapBuffer.size() - 1)));
         changed = true;
     }
 
@@ -689,7 +743,7 @@ void ZepBuffer::Clear()
     if (changed)
     {
         MarkUpdate();
-        GetEditor().Broadcast(std::make_shared<BufferMessage>(this, BufferMessageType::TextDeleted, 0, ByteIndex(m_gapBuffer.size() - 1)));
+        GetEditor().Broadcast(MakeMessage<BufferMessage>(this, BufferMessageType::TextDeleted, 0, ByteIndex(m_gapBuffer.size() - 1)));
     }
 }
 
@@ -766,14 +820,14 @@ void ZepBuffer::SetText(const std::string& text, bool initFromFile)
     // When loading a file, send the Loaded message to distinguish it from adding to a buffer, and remember that the buffer is not dirty in this case
     if (initFromFile)
     {
-        GetEditor().Broadcast(std::make_shared<BufferMessage>(this, BufferMessageType::Loaded, ByteIndex{ 0 }, ByteIndex{ long(m_gapBuffer.size()) }));
-
-        // Doc is not dirty
+        // Doc is not dirty; clear it first, so listeners see a clean buffer
         m_fileFlags = ZClearFlags(m_fileFlags, FileFlags::Dirty);
+
+        GetEditor().Broadcast(MakeMessage<BufferMessage>(this, BufferMessageType::Loaded, ByteIndex{ 0 }, ByteIndex{ long(m_gapBuffer.size()) }));
     }
     else
     {
-        GetEditor().Broadcast(std::make_shared<BufferMessage>(this, BufferMessageType::TextAdded, ByteIndex{ 0 }, ByteIndex{ long(m_gapBuffer.size()) }));
+        GetEditor().Broadcast(MakeMessage<BufferMessage>(this, BufferMessageType::TextAdded, ByteIndex{ 0 }, ByteIndex{ long(m_gapBuffer.size()) }));
     }
 }
 
@@ -1034,7 +1088,7 @@ bool ZepBuffer::Insert(const ByteIndex& startIndex, const std::string& str)
     ByteIndex changeRange{ long(str.length()) };
 
     // We are about to modify this range
-    GetEditor().Broadcast(std::make_shared<BufferMessage>(this, BufferMessageType::PreBufferChange, startIndex, startIndex + changeRange));
+    GetEditor().Broadcast(MakeMessage<BufferMessage>(this, BufferMessageType::PreBufferChange, startIndex, startIndex + changeRange));
 
     UpdateForInsert(startIndex, startIndex + changeRange);
 
@@ -1088,7 +1142,7 @@ bool ZepBuffer::Insert(const ByteIndex& startIndex, const std::string& str)
     MarkUpdate();
 
     // This is the range we added (not valid any more in the buffer)
-    GetEditor().Broadcast(std::make_shared<BufferMessage>(this, BufferMessageType::TextAdded, startIndex, startIndex + changeRange));
+    GetEditor().Broadcast(MakeMessage<BufferMessage>(this, BufferMessageType::TextAdded, startIndex, startIndex + changeRange));
 
     return true;
 }
@@ -1101,7 +1155,7 @@ bool ZepBuffer::Replace(const ByteIndex& startIndex, const ByteIndex& endIndex,
     }
 
     // We are about to modify this range
-    GetEditor().Broadcast(std::make_shared<BufferMessage>(this, BufferMessageType::PreBufferChange, startIndex, endIndex));
+    GetEditor().Broadcast(MakeMessage<BufferMessage>(this, BufferMessageType::PreBufferChange, startIndex, endIndex));
 
     // Perform a straight replace
     for (auto loc = startIndex; loc < endIndex; loc++)
@@ -1113,7 +1167,7 @@ bool ZepBuffer::Replace(const ByteIndex& startIndex, const ByteIndex& endIndex,
     MarkUpdate();
 
     // This is the range we added (not valid any more in the buffer)
-    GetEditor().Broadcast(std::make_shared<BufferMessage>(this, BufferMessageType::TextChanged, startIndex, endIndex));
+    GetEditor().Broadcast(MakeMessage<BufferMessage>(this, BufferMessageType::TextChanged, startIndex, endIndex));
 
     return true;
 }
@@ -1131,7 +1185,7 @@ bool ZepBuffer::Delete(const ByteIndex& startIndex, const ByteIndex& endIndex)
     assert(startIndex >= 0 && endIndex <= (ByteIndex)(m_gapBuffer.size() - 1));
 
     // We are about to modify this range
-    GetEditor().Broadcast(std::make_shared<BufferMessage>(this, BufferMessageType::PreBufferChange, startIndex, endIndex));
+    GetEditor().Broadcast(MakeMessage<BufferMessage>(this, BufferMessageType::PreBufferChange, startIndex, endIndex));
 
     UpdateForDelete(startIndex, endIndex);
 
@@ -1166,7 +1220,7 @@ bool ZepBuffer::Delete(const ByteIndex& startIndex, const ByteIndex& endIndex)
     MarkUpdate();
 
     // This is the range we deleted (not valid any more in the buffer)
-    GetEditor().Broadcast(std::make_shared<BufferMessage>(this, BufferMessageType::TextDeleted, startIndex, endIndex));
+    GetEditor().Broadcast(MakeMessage<BufferMessage>(this, BufferMessageType::TextDeleted, startIndex, endIndex));
 
     return true;
 }
@@ -1220,7 +1274,7 @@ void ZepBuffer::SetSelection(const BufferByteRange& selection)
 void ZepBuffer::AddRangeMarker(std::shared_ptr<RangeMarker> spMarker)
 {
     m_rangeMarkers[spMarker->range.first].insert(spMarker);
-    GetEditor().Broadcast(std::make_shared<BufferMessage>(this, BufferMessageType::MarkersChanged, 0, ByteIndex(m_gapBuffer.size() - 1)));
+    GetEditor().Broadcast(MakeMessage<BufferMessage>(this, BufferMessageType::MarkersChanged, 0, ByteIndex(m_gapBuffer.size() - 1)));
 }
 
 void ZepBuffer::ClearRangeMarker(std::shared_ptr<RangeMarker> spMarker)
@@ -1247,7 +1301,7 @@ void ZepBuffer::ClearRangeMarkers(const std::set<std::shared_ptr<RangeMarker>>&
     {
         ClearRangeMarker(marker);
     }
-    GetEditor().Broadcast(std::make_shared<BufferMessage>(this, BufferMessageType::MarkersChanged, 0, ByteIndex(m_gapBuffer.size() - 1)));
+    GetEditor().Broadcast(MakeMessage<BufferMessage>(this, BufferMessageType::MarkersChanged, 0, ByteIndex(m_gapBuffer.size() - 1)));
 }
 
 void ZepBuffer::ClearRangeMarkers(uint32_t markerType)
@@ -1263,7 +1317,7 @@ void ZepBuffer::ClearRangeMarkers(uint32_t markerType)
         ClearRangeMarker(victim);
     }
 
-    GetEditor().Broadcast(std::make_shared<BufferMessage>(this, BufferMessageType::MarkersChanged, 0, ByteIndex(m_gapBuffer.size() - 1)));
+    GetEditor().Broadcast(MakeMessage<BufferMessage>(this, BufferMessageType::MarkersChanged, 0, ByteIndex(m_gapBuffer.size() - 1)));
 }
 
 void ZepBuffer::ForEachMarker(uint32_t markerType, SearchDirection dir, ByteIndex begin, ByteIndex end, std::function<bool(const std::shared_ptr<RangeMarker>&)> fnCB) const
@@ -1427,7 +1481,7 @@ void ZepBuffer::AddLineWidget(long line, std::shared_ptr<ILineWidget> spWidget)
     GetLineOffsets(line, start, end);
 
     m_lineWidgets[start].push_back(spWidget);
-    GetEditor().Broadcast(std::make_shared<BufferMessage>(this, BufferMessageType::TextChanged, 0, 0));
+    GetEditor().Broadcast(MakeMessage<BufferMessage>(this, BufferMessageType::TextChanged, 0, 0));
 }
 
 void ZepBuffer::ClearLineWidgets(long line)
@@ -1442,7 +1496,7 @@ void ZepBuffer::ClearLineWidgets(long line)
     {
         m_lineWidgets.clear();
     }
-    GetEditor().Broadcast(std::make_shared<BufferMessage>(this, BufferMessageType::TextChanged, 0, 0));
+    GetEditor().Broadcast(MakeMessage<BufferMessage>(this, BufferMessageType::TextChanged, 0, 0));
 }
 
 const ZepBuffer::tLineWidgets* ZepBuffer::GetLineWidgets(long line) const
@@ -15,15 +15,51 @@ void ZepDisplay::InvalidateCharCache()
     m_charCacheDirty = true;
 }
 
+namespace
+{
+// Blocks common in code and prose, measured with the rest of the cache so that the first frame showing them doesn't
+// measure them one at a time
+const uint32_t PrewarmRanges[][2] = {
+    { 0x00A0, 0x017F }, // Latin-1 Supplement, Latin Extended-A
+    { 0x0370, 0x03FF }, // Greek
+    { 0x0400, 0x04FF }, // Cyrillic
+    { 0x2000, 0x206F }, // General Punctuation
+    { 0x2190, 0x22FF }, // Arrows, Mathematical Operators
+    { 0x2500, 0x259F }  // Box Drawing, Block Elements
+};
+} // namespace
+
 void ZepDisplay::BuildCharCache()
 {
     const char chA = 'A';
     m_defaultCharSize = GetTextSize((const uint8_t*)&chA, (const uint8_t*)&chA + 1);
-    for (int i = 0; i < 127; i++)
+    for (int i = 0; i < 128; i++)
     {
         uint8_t ch = (uint8_t)i;
         m_charCacheASCII[i] = GetTextSize(&ch, &ch + 1);
     }
+
+    m_fixedAdvance = true;
+    for (int i = ' '; i < 127; i++)
+    {
+        m_fixedAdvance &= (m_charCacheASCII[i] == m_defaultCharSize);
+    }
+
+    m_charCache.Clear();
+    for (auto& range : PrewarmRanges)
+    {
+        for (auto codePoint = range[0]; codePoint <= range[1]; codePoint++)
+        {
+            uint8_t utf8[4];
+            auto pEnd = utf8::unchecked::append(codePoint, utf8);
+            m_charCache.Insert(codePoint, GetTextSize(utf8, pEnd));
+        }
+    }
+
+    for (auto& numberText : m_numberCache)
+    {
+        numberText.number = -1;
+    }
     m_charCacheDirty = false;
 }
 
@@ -36,6 +72,15 @@ const NVec2f& ZepDisplay::GetDefaultCharSize()
     return m_defaultCharSize;
 }
 
+bool ZepDisplay::HasFixedAdvance()
+{
+    if (m_charCacheDirty)
+    {
+        BuildCharCache();
+    }
+    return m_fixedAdvance;
+}
+
 uint32_t ZepDisplay::GetCodePointCount(const uint8_t* pCh, const uint8_t* pEnd) const
 {
     uint32_t count = 0;
@@ -58,21 +103,64 @@ NVec2f ZepDisplay::GetCharSize(const uint8_t* pCh)
     {
         return m_charCacheASCII[*pCh];
     }
- 
-    auto ch32 = utf8::unchecked::next(pCh);
 
-    auto itr = m_charCache.find((uint32_t)ch32);
-    if (itr != m_charCache.end())
+    auto pNext = pCh;
+    auto ch32 = (uint32_t)utf8::unchecked::next(pNext);
+    if (auto pSize = m_charCache.Find(ch32))
     {
-        return itr->second;
+        return *pSize;
     }
-     
-    auto sz = GetTextSize(pCh, pCh + utf8_codepoint_length(*pCh));
-    m_charCache[(uint32_t)ch32] = sz;
+    return MeasureChar(pCh, ch32);
+}
 
+NVec2f ZepDisplay::MeasureChar(const uint8_t* pCh, uint32_t codePoint)
+{
+    auto sz = GetTextSize(pCh, pCh + utf8_codepoint_length(*pCh));
+    m_charCache.Insert(codePoint, sz);
     return sz;
 }
-    
+
+void ZepDisplay::GetCharSizes(const uint8_t* pBegin, const uint8_t* pEnd, std::vector<NVec2f>& sizes)
+{
+    if (m_charCacheDirty)
+    {
+        BuildCharCache();
+    }
+
+    // Steps the same way as the layout, one code point at a time; a sequence cut off by the end is measured as a byte
+    for (auto pCh = pBegin; pCh < pEnd; pCh += utf8_codepoint_length(*pCh))
+    {
+        auto length = utf8_codepoint_length(*pCh);
+        if (length == 1 || pCh + length > pEnd)
+        {
+            sizes.push_back(m_charCacheASCII[*pCh]);
+            continue;
+        }
+
+        auto pNext = pCh;
+        auto ch32 = (uint32_t)utf8::unchecked::next(pNext);
+        auto pSize = m_charCache.Find(ch32);
+        sizes.push_back(pSize ? *pSize : MeasureChar(pCh, ch32));
+    }
+}
+
+const NumberText& ZepDisplay::GetNumberText(long number)
+{
+    if (m_charCacheDirty)
+    {
+        BuildCharCache();
+    }
+
+    auto& numberText = m_numberCache[std::abs(number) % NumberCacheSize];
+    if (numberText.number != number)
+    {
+        numberText.number = number;
+        numberText.text = std::to_string(number);
+        numberText.size = GetTextSize((const uint8_t*)numberText.text.c_str(), (const uint8_t*)(numberText.text.c_str() + numberText.text.size()));
+    }
+    return numberText;
+}
+
 void ZepDisplay::DrawRect(const NRectf& rc, const NVec4f& col) const
 {
     DrawLine(rc.topLeftPx, rc.BottomLeft(), col);
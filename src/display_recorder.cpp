@@ -0,0 +1,158 @@
+#include "zep/display_recorder.h"
+
+#include "zep/mcommon/string/stringutils.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace Zep
+{
+
+namespace
+{
+// A command and its text, as one value
+uint64_t HashCommand(const DisplayFrame& frame, const DisplayCommand& command)
+{
+    uint8_t data[sizeof(uint8_t) + sizeof(uint32_t) + sizeof(float) * 5];
+    auto pData = data;
+    memcpy(pData, &command.type, sizeof(uint8_t));
+    pData += sizeof(uint8_t);
+    memcpy(pData, &command.color, sizeof(uint32_t));
+    pData += sizeof(uint32_t);
+    memcpy(pData, &command.width, sizeof(float));
+    pData += sizeof(float);
+    memcpy(pData, &command.rect.topLeftPx.x, sizeof(float));
+    pData += sizeof(float);
+    memcpy(pData, &command.rect.topLeftPx.y, sizeof(float));
+    pData += sizeof(float);
+    memcpy(pData, &command.rect.bottomRightPx.x, sizeof(float));
+    pData += sizeof(float);
+    memcpy(pData, &command.rect.bottomRightPx.y, sizeof(float));
+
+    auto hash = murmur_hash_64(data, uint32_t(sizeof(data)), 0);
+    return murmur_hash_64(frame.text.c_str() + command.textOffset, command.textLength, hash);
+}
+} // namespace
+
+void DisplayFrame::Clear()
+{
+    commands.clear();
+    text.clear();
+    stats = DisplayFrameStats();
+}
+
+std::string DisplayFrame::GetText(const DisplayCommand& command) const
+{
+    return text.substr(command.textOffset, command.textLength);
+}
+
+DisplayCommand& ZepDisplayRecorder::AddCommand(DisplayCommandType type, const NVec4f& color) const
+{
+    m_frame.commands.emplace_back();
+    auto& command = m_frame.commands.back();
+    command.type = type;
+    command.color = ToPacked(color);
+    command.width = 0.0f;
+    command.textOffset = 0;
+    command.textLength = 0;
+    return command;
+}
+
+void ZepDisplayRecorder::DrawLine(const NVec2f& start, const NVec2f& end, const NVec4f& color, float width) const
+{
+    auto& command = AddCommand(DisplayCommandType::Line, color);
+    command.rect = NRectf(start, end);
+    command.width = width;
+
+    m_frame.stats.drawCalls++;
+    m_frame.stats.lines++;
+}
+
+void ZepDisplayRecorder::DrawChars(const NVec2f& pos, const NVec4f& col, const uint8_t* text_begin, const uint8_t* text_end) const
+{
+    if (text_end == nullptr)
+    {
+        text_end = text_begin + strlen((const char*)text_begin);
+    }
+
+    auto& command = AddCommand(DisplayCommandType::Chars, col);
+    command.rect = NRectf(pos, pos);
+    command.textOffset = uint32_t(m_frame.text.size());
+    command.textLength = uint32_t(text_end - text_begin);
+    m_frame.text.append((const char*)text_begin, (const char*)text_end);
+
+    m_frame.stats.drawCalls++;
+    m_frame.stats.chars++;
+    m_frame.stats.glyphs += GetCodePointCount(text_begin, text_end);
+}
+
+void ZepDisplayRecorder::DrawRectFilled(const NRectf& rc, const NVec4f& col) const
+{
+    auto& command = AddCommand(DisplayCommandType::RectFilled, col);
+    command.rect = rc;
+
+    m_frame.stats.drawCalls++;
+    m_frame.stats.rects++;
+}
+
+void ZepDisplayRecorder::SetClipRect(const NRectf& rc)
+{
+    auto& command = AddCommand(DisplayCommandType::ClipRect, NVec4f(0.0f));
+    command.rect = rc;
+
+    m_frame.stats.clipRects++;
+}
+
+void ZepDisplayRecorder::BeginFrame()
+{
+    std::swap(m_frame, m_previousFrame);
+    m_frame.Clear();
+}
+
+DisplayFrameDiff ZepDisplayRecorder::Compare(const DisplayFrame& before, const DisplayFrame& after)
+{
+    auto hashFrame = [](const DisplayFrame& frame) {
+        std::vector<uint64_t> hashes;
+        hashes.reserve(frame.commands.size());
+        for (auto& command : frame.commands)
+        {
+            if (command.type != DisplayCommandType::ClipRect)
+            {
+                hashes.push_back(HashCommand(frame, command));
+            }
+        }
+        std::sort(hashes.begin(), hashes.end());
+        return hashes;
+    };
+
+    auto beforeHashes = hashFrame(before);
+    auto afterHashes = hashFrame(after);
+
+    DisplayFrameDiff diff;
+    auto itrBefore = beforeHashes.begin();
+    auto itrAfter = afterHashes.begin();
+    while (itrBefore != beforeHashes.end() && itrAfter != afterHashes.end())
+    {
+        if (*itrBefore == *itrAfter)
+        {
+            diff.unchanged++;
+            itrBefore++;
+            itrAfter++;
+        }
+        else if (*itrBefore < *itrAfter)
+        {
+            diff.removed++;
+            itrBefore++;
+        }
+        else
+        {
+            diff.added++;
+            itrAfter++;
+        }
+    }
+    diff.removed += uint32_t(beforeHashes.end() - itrBefore);
+    diff.added += uint32_t(afterHashes.end() - itrAfter);
+    return diff;
+}
+
+} // namespace Zep
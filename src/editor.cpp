@@ -7,6 +7,7 @@
 #include "zep/syntax_providers.h"
 #include "zep/tab_window.h"
 #include "zep/indexer.h"
+#include "zep/latency.h"
 
 #ifndef ZEP_SINGLE_HEADER_BUILD
 #include "config_app.h"
@@ -23,17 +24,39 @@ namespace Zep
 ZepComponent::ZepComponent(ZepEditor& editor)
     : m_editor(editor)
 {
-    m_editor.RegisterCallback(this);
 }
 
 ZepComponent::~ZepComponent()
 {
     m_editor.UnRegisterCallback(this);
+    m_editor.GetScheduler().Cancel(this);
 }
 
+namespace
+{
+// Made for the first editor that asks, and gone with the last one using it
+std::shared_ptr<ThreadPool> GetSharedThreadPool()
+{
+    static std::mutex poolMutex;
+    static std::weak_ptr<ThreadPool> sharedPool;
+
+    std::lock_guard<std::mutex> lock(poolMutex);
+    auto spPool = sharedPool.lock();
+    if (!spPool)
+    {
+        spPool = std::make_shared<ThreadPool>();
+        sharedPool = spPool;
+    }
+    return spPool;
+}
+} // namespace
+
 ZepEditor::ZepEditor(ZepDisplay* pDisplay, const ZepPath& root, uint32_t flags, IZepFileSystem* pFileSystem)
     : m_pDisplay(pDisplay)
     , m_pFileSystem(pFileSystem)
+    , m_spScheduler(std::make_unique<ZepScheduler>())
+    , m_spLatencyStats(std::make_unique<ZepLatencyStats>())
+    , m_spWorkloadRecorder(std::make_unique<ZepWorkloadRecorder>())
     , m_flags(flags)
     , m_rootPath(root)
 {
@@ -53,11 +76,15 @@ ZepEditor::ZepEditor(ZepDisplay* pDisplay, const ZepPath& root, uint32_t flags,
 
     if (m_flags & ZepEditorFlags::DisableThreads)
     {
-        m_threadPool = std::make_unique<ThreadPool>(1);
+        m_threadPool = std::make_shared<ThreadPool>(1);
+    }
+    else if (m_flags & ZepEditorFlags::SharedThreadPool)
+    {
+        m_threadPool = GetSharedThreadPool();
     }
     else
     {
-        m_threadPool = std::make_unique<ThreadPool>();
+        m_threadPool = std::make_shared<ThreadPool>();
     }
 
 #ifdef ZEP_FEATURE_TOML_CONFIG
@@ -71,6 +98,8 @@ ZepEditor::ZepEditor(ZepDisplay* pDisplay, const ZepPath& root, uint32_t flags,
     RegisterGlobalMode(std::make_shared<ZepMode_Standard>(*this));
     SetGlobalMode(ZepMode_Vim::StaticName());
 
+    ZepStatsExCommand::Register(*this);
+
     timer_restart(m_cursorTimer);
     timer_restart(m_lastEditTimer);
     m_commandLines.push_back("");
@@ -112,6 +141,21 @@ ThreadPool& ZepEditor::GetThreadPool() const
     return *m_threadPool;
 }
 
+ZepScheduler& ZepEditor::GetScheduler() const
+{
+    return *m_spScheduler;
+}
+
+ZepLatencyStats& ZepEditor::GetLatencyStats() const
+{
+    return *m_spLatencyStats;
+}
+
+ZepWorkloadRecorder& ZepEditor::GetWorkloadRecorder() const
+{
+    return *m_spWorkloadRecorder;
+}
+
 void ZepEditor::OnFileChanged(const ZepPath& path)
 {
 #ifdef ZEP_FEATURE_TOML_CONFIG
@@ -119,7 +163,7 @@ void ZepEditor::OnFileChanged(const ZepPath& path)
     {
         LOG(INFO) << "Reloading config";
         LoadConfig(path);
-        Broadcast(std::make_shared<ZepMessage>(Msg::ConfigChanged));
+        Broadcast(MakeMessage<ZepMessage>(Msg::ConfigChanged));
     }
 #endif
 }
@@ -174,6 +218,7 @@ void ZepEditor::LoadConfig(std::shared_ptr<cpptoml::table> spConfig)
         m_config.widgetMargins.x = (float)spConfig->get_qualified_as<double>("editor.widget_margin_top").value_or(1);
         m_config.widgetMargins.y = (float)spConfig->get_qualified_as<double>("editor.widget_margin_bottom").value_or(1);
         m_config.shortTabNames = spConfig->get_qualified_as<bool>("editor.short_tab_names").value_or(false);
+        m_config.syntaxCache = spConfig->get_qualified_as<bool>("editor.syntax_cache").value_or(false);
         auto styleStr = string_tolower(spConfig->get_qualified_as<std::string>("editor.style").value_or("normal"));
         if (styleStr == "normal")
         {
@@ -204,6 +249,7 @@ void ZepEditor::SaveConfig(std::shared_ptr<cpptoml::table> spConfig)
     table->insert("autohide_command_region", m_config.autoHideCommandRegion);
     table->insert("cursor_line_solid", m_config.cursorLineSolid);
     table->insert("short_tab_names", m_config.shortTabNames);
+    table->insert("syntax_cache", m_config.syntaxCache);
     table->insert("background_fade_time", (double)m_config.backgroundFadeTime);
     table->insert("background_fade_wait", (double)m_config.backgroundFadeWait);
     table->insert("show_scrollbar", m_config.showScrollBar);
@@ -276,6 +322,8 @@ std::vector<ZepWindow*> ZepEditor::FindBufferWindows(const ZepBuffer* pBuffer) c
 
 void ZepEditor::RemoveBuffer(ZepBuffer* pBuffer)
 {
+    FlushInput();
+
     auto bufferWindows = FindBufferWindows(pBuffer);
     for (auto& window : bufferWindows)
     {
@@ -612,7 +660,7 @@ ZepTabWindow* ZepEditor::AddTabWindow()
 
 void ZepEditor::RequestQuit()
 {
-    Broadcast(std::make_shared<ZepMessage>(Msg::RequestQuit, "RequestQuit"));
+    Broadcast(MakeMessage<ZepMessage>(Msg::RequestQuit, "RequestQuit"));
 }
 
 void ZepEditor::RemoveTabWindow(ZepTabWindow* pTabWindow)
@@ -702,6 +750,8 @@ void ZepEditor::RegisterBufferMode(const std::string& extension, std::shared_ptr
 
 void ZepEditor::SetGlobalMode(const std::string& currentMode)
 {
+    FlushInput();
+
     auto itrMode = m_mapGlobalModes.find(currentMode);
     if (itrMode != m_mapGlobalModes.end())
     {
@@ -817,6 +867,77 @@ void ZepEditor::RegisterSyntaxFactory(const std::vector<std::string>& mappings,
     }
 }
 
+namespace
+{
+// Free message blocks of each size class, for the thread that freed them
+struct MessageFreeLists
+{
+    static const size_t Granularity = 16;
+    static const size_t MaxSize = 256;
+    static const size_t MaxFree = 64;
+
+    ~MessageFreeLists();
+    std::vector<void*> lists[MaxSize / Granularity];
+};
+
+// Messages can outlive the lists, in objects destroyed after the thread's own
+thread_local bool messageFreeListsGone = false;
+thread_local MessageFreeLists messageFreeLists;
+
+MessageFreeLists::~MessageFreeLists()
+{
+    messageFreeListsGone = true;
+    for (auto& list : lists)
+    {
+        for (auto pMemory : list)
+        {
+            ::operator delete(pMemory);
+        }
+    }
+}
+
+std::vector<void*>* GetMessageFreeList(size_t size)
+{
+    if (size == 0 || size > MessageFreeLists::MaxSize || messageFreeListsGone)
+    {
+        return nullptr;
+    }
+    return &messageFreeLists.lists[(size - 1) / MessageFreeLists::Granularity];
+}
+} // namespace
+
+void* AllocateMessage(size_t size)
+{
+    // Round up, so that any message of the class can reuse the block; also when this thread's lists are gone, since
+    // another thread may free it into its own
+    if (size > MessageFreeLists::MaxSize)
+    {
+        return ::operator new(size);
+    }
+    auto classSize = (size + MessageFreeLists::Granularity - 1) / MessageFreeLists::Granularity * MessageFreeLists::Granularity;
+
+    auto pList = GetMessageFreeList(size);
+    if (pList == nullptr || pList->empty())
+    {
+        return ::operator new(classSize);
+    }
+
+    auto pMemory = pList->back();
+    pList->pop_back();
+    return pMemory;
+}
+
+void FreeMessage(void* pMemory, size_t size)
+{
+    auto pList = GetMessageFreeList(size);
+    if (pList == nullptr || pList->size() >= MessageFreeLists::MaxFree)
+    {
+        ::operator delete(pMemory);
+        return;
+    }
+    pList->push_back(pMemory);
+}
+
 // Inform clients of an event in the buffer
 bool ZepEditor::Broadcast(std::shared_ptr<ZepMessage> message)
 {
@@ -824,15 +945,150 @@ bool ZepEditor::Broadcast(std::shared_ptr<ZepMessage> message)
     if (message->handled)
         return true;
 
-    for (auto& client : m_notifyClients)
+    // Indexed, since the lists can grow while a client is notified; clients which leave are null until the end
+    m_broadcastDepth++;
+    auto notifyAll = [&](std::vector<IZepComponent*>& clients) {
+        for (size_t index = 0; index < clients.size() && !message->handled; index++)
+        {
+            if (clients[index])
+            {
+                clients[index]->Notify(message);
+            }
+        }
+    };
+
+    if (message->messageId == Msg::Buffer)
     {
-        client->Notify(message);
-        if (message->handled)
-            break;
+        auto itrBuffer = m_bufferSubscribers.find(static_cast<BufferMessage&>(*message).pBuffer);
+        if (itrBuffer != m_bufferSubscribers.end())
+        {
+            notifyAll(itrBuffer->second);
+        }
+    }
+
+    // Not a reference to the list; a new message id can move the lists
+    auto id = size_t(message->messageId);
+    for (size_t index = 0; id < m_subscribers.size() && index < m_subscribers[id].size() && !message->handled; index++)
+    {
+        if (auto pClient = m_subscribers[id][index])
+        {
+            pClient->Notify(message);
+        }
+    }
+
+    notifyAll(m_allSubscribers);
+
+    if (--m_broadcastDepth == 0 && m_subscribersRemoved)
+    {
+        m_subscribersRemoved = false;
+        auto compact = [](std::vector<IZepComponent*>& clients) {
+            clients.erase(std::remove(clients.begin(), clients.end(), nullptr), clients.end());
+        };
+        for (auto& clients : m_subscribers)
+        {
+            compact(clients);
+        }
+        for (auto itr = m_bufferSubscribers.begin(); itr != m_bufferSubscribers.end();)
+        {
+            compact(itr->second);
+            itr = itr->second.empty() ? m_bufferSubscribers.erase(itr) : std::next(itr);
+        }
+        compact(m_allSubscribers);
     }
     return message->handled;
 }
 
+void ZepEditor::Subscribe(IZepComponent* pClient, Msg messageId, const ZepBuffer* pBuffer)
+{
+    std::vector<IZepComponent*>* pClients;
+    if (messageId == Msg::Buffer && pBuffer)
+    {
+        pClients = &m_bufferSubscribers[pBuffer];
+    }
+    else
+    {
+        auto id = size_t(messageId);
+        if (id >= m_subscribers.size())
+        {
+            m_subscribers.resize(id + 1);
+        }
+        pClients = &m_subscribers[id];
+    }
+
+    if (std::find(pClients->begin(), pClients->end(), pClient) == pClients->end())
+    {
+        pClients->push_back(pClient);
+    }
+}
+
+namespace
+{
+// Remove a client from a list; only mark it while the list may be walked
+bool RemoveSubscriber(std::vector<IZepComponent*>& clients, IZepComponent* pClient, bool broadcasting)
+{
+    auto itr = std::find(clients.begin(), clients.end(), pClient);
+    if (itr == clients.end())
+    {
+        return false;
+    }
+
+    if (broadcasting)
+    {
+        *itr = nullptr;
+    }
+    else
+    {
+        clients.erase(itr);
+    }
+    return true;
+}
+} // namespace
+
+void ZepEditor::Unsubscribe(IZepComponent* pClient, Msg messageId, const ZepBuffer* pBuffer)
+{
+    bool broadcasting = m_broadcastDepth != 0;
+    if (messageId == Msg::Buffer && pBuffer)
+    {
+        auto itr = m_bufferSubscribers.find(pBuffer);
+        if (itr != m_bufferSubscribers.end() && RemoveSubscriber(itr->second, pClient, broadcasting))
+        {
+            m_subscribersRemoved |= broadcasting;
+            if (itr->second.empty())
+            {
+                m_bufferSubscribers.erase(itr);
+            }
+        }
+    }
+    else if (size_t(messageId) < m_subscribers.size())
+    {
+        m_subscribersRemoved |= RemoveSubscriber(m_subscribers[size_t(messageId)], pClient, broadcasting) && broadcasting;
+    }
+}
+
+void ZepEditor::RegisterCallback(IZepComponent* pClient)
+{
+    if (std::find(m_allSubscribers.begin(), m_allSubscribers.end(), pClient) == m_allSubscribers.end())
+    {
+        m_allSubscribers.push_back(pClient);
+    }
+}
+
+void ZepEditor::UnRegisterCallback(IZepComponent* pClient)
+{
+    bool broadcasting = m_broadcastDepth != 0;
+    bool removed = RemoveSubscriber(m_allSubscribers, pClient, broadcasting);
+    for (auto& clients : m_subscribers)
+    {
+        removed |= RemoveSubscriber(clients, pClient, broadcasting);
+    }
+    for (auto itr = m_bufferSubscribers.begin(); itr != m_bufferSubscribers.end();)
+    {
+        removed |= RemoveSubscriber(itr->second, pClient, broadcasting);
+        itr = (!broadcasting && itr->second.empty()) ? m_bufferSubscribers.erase(itr) : std::next(itr);
+    }
+    m_subscribersRemoved |= removed && broadcasting;
+}
+
 const std::deque<std::shared_ptr<ZepBuffer>>& ZepEditor::GetBuffers() const
 {
     return m_buffers;
@@ -889,7 +1145,7 @@ ZepBuffer* ZepEditor::GetMRUBuffer() const
 
 void ZepEditor::ReadClipboard()
 {
-    auto pMsg = std::make_shared<ZepMessage>(Msg::GetClipBoard);
+    auto pMsg = MakeMessage<ZepMessage>(Msg::GetClipBoard);
     Broadcast(pMsg);
     if (pMsg->handled)
     {
@@ -900,7 +1156,7 @@ void ZepEditor::ReadClipboard()
 
 void ZepEditor::WriteClipboard()
 {
-    auto pMsg = std::make_shared<ZepMessage>(Msg::SetClipBoard);
+    auto pMsg = MakeMessage<ZepMessage>(Msg::SetClipBoard);
     pMsg->str = m_registers["+"].text;
     Broadcast(pMsg);
 }
@@ -1009,12 +1265,18 @@ void ZepEditor::SetCommandText(const std::string& strCommand)
 void ZepEditor::RequestRefresh()
 {
     m_bPendingRefresh = true;
+
+    // This may come from a worker thread, while the host sleeps
+    m_spScheduler->Wake();
 }
 
 bool ZepEditor::RefreshRequired()
 {
-    // Allow any components to update themselves
-    Broadcast(std::make_shared<ZepMessage>(Msg::Tick));
+    // Run the timers and completions that are due; components schedule their work instead of waiting for a tick
+    m_spScheduler->Update(timer_get_time_now());
+
+    // Still sent for the host's own components
+    Broadcast(MakeMessage<ZepMessage>(Msg::Tick));
 
     auto lastBlink = m_lastCursorBlink;
     if (m_bPendingRefresh || lastBlink != GetCursorBlinkState())
@@ -1029,6 +1291,22 @@ bool ZepEditor::RefreshRequired()
     return false;
 }
 
+uint64_t ZepEditor::GetNextWakeTime() const
+{
+    auto now = timer_get_time_now();
+    if (m_bPendingRefresh || ZTestFlags(m_flags, ZepEditorFlags::FastUpdate))
+    {
+        return now;
+    }
+
+    // The cursor blinks 1.75 times a second
+    const uint64_t blinkPeriod = uint64_t(1000000.0 / 1.75);
+    auto elapsed = timer_get_elapsed(m_cursorTimer);
+    auto nextBlink = now + (blinkPeriod - (elapsed % blinkPeriod));
+
+    return std::min(nextBlink, m_spScheduler->GetNextDeadline());
+}
+
 bool ZepEditor::GetCursorBlinkState() const
 {
     m_lastCursorBlink = (int(timer_get_elapsed_seconds(m_cursorTimer) * 1.75f) & 1) ? true : false;
@@ -1039,9 +1317,15 @@ void ZepEditor::SetDisplayRegion(const NVec2f& topLeft, const NVec2f& bottomRigh
 {
     m_editorRegion->rect.topLeftPx = topLeft;
     m_editorRegion->rect.bottomRightPx = bottomRight;
+    m_spWorkloadRecorder->Resized(m_editorRegion->rect);
     UpdateSize();
 }
 
+const NRectf& ZepEditor::GetDisplayRegion() const
+{
+    return m_editorRegion->rect;
+}
+
 void ZepEditor::UpdateSize()
 {
     auto commandCount = GetCommandLines().size();
@@ -1076,6 +1360,9 @@ void ZepEditor::UpdateSize()
 
 void ZepEditor::Display()
 {
+    // The text typed since the last frame
+    FlushInput();
+
     UpdateWindowState();
 
     if (m_bRegionsChanged)
@@ -1084,6 +1371,93 @@ void ZepEditor::Display()
         UpdateSize();
     }
 
+    // Figure out the active region
+    auto pActiveTabWindow = GetActiveTabWindow();
+    NRectf tabRect;
+    for (auto& tab : m_tabRegion->children)
+    {
+        if (std::static_pointer_cast<TabRegionTab>(tab)->pTabWindow == pActiveTabWindow)
+        {
+            tabRect = tab->rect;
+            break;
+        }
+    }
+
+    // Figure out the virtual vs real page size of the tabs
+    float virtualSize = 0.0f;
+    float tabRegionSize = m_tabRegion->rect.Width();
+    if (!m_tabRegion->children.empty())
+    {
+        virtualSize = m_tabRegion->children.back()->rect.Right();
+    }
+
+    // Move the tab bar origin if approriate
+    if (tabRect.Width() != 0.0f)
+    {
+        if ((tabRect.Left() - tabRect.Width() + m_tabOffsetX) < m_tabRegion->rect.Left())
+        {
+            m_tabOffsetX += m_tabRegion->rect.Left() - (tabRect.Left() + m_tabOffsetX - tabRect.Width());
+        }
+        else if ((tabRect.Right() + m_tabOffsetX + tabRect.Width()) > m_tabRegion->rect.Right())
+        {
+            m_tabOffsetX -= (tabRect.Right() + m_tabOffsetX - m_tabRegion->rect.Right() + tabRect.Width());
+        }
+    }
+
+    // Clamp it
+    m_tabOffsetX = std::min(m_tabOffsetX, 0.0f);
+    m_tabOffsetX = std::max(std::min(tabRegionSize - virtualSize, 0.0f), m_tabOffsetX);
+
+    // A display which keeps the last frame only needs the editor around the windows when it changes
+    auto& commandLines = GetCommandLines();
+    std::ostringstream chrome;
+    chrome << m_editorRegion->rect << m_commandRegion->rect << m_tabRegion->rect << m_tabOffsetX << int(GetConfig().style) << int(GetTheme().GetThemeType()) << pActiveTabWindow << GetCommandText().empty();
+    for (auto& line : commandLines)
+    {
+        chrome << line << '\n';
+    }
+    for (auto& tab : m_tabRegion->children)
+    {
+        auto spTabRegionTab = std::static_pointer_cast<TabRegionTab>(tab);
+        chrome << spTabRegionTab->rect << spTabRegionTab->color << spTabRegionTab->name << '\n';
+    }
+    auto strChrome = chrome.str();
+    auto chromeHash = murmur_hash_64(strChrome.c_str(), uint32_t(strChrome.size()), 0);
+
+    if (m_redrawAll || !m_pDisplay->RetainsFrame() || chromeHash != m_lastChromeHash)
+    {
+        m_redrawAll = false;
+        m_lastChromeHash = chromeHash;
+        DisplayChrome();
+
+        // The editor background has been drawn over the windows
+        if (pActiveTabWindow)
+        {
+            for (auto& pWindow : pActiveTabWindow->GetWindows())
+            {
+                pWindow->InvalidateDisplay();
+            }
+        }
+    }
+
+    // Display the tab
+    if (pActiveTabWindow)
+    {
+        pActiveTabWindow->Display();
+    }
+
+    // The keys since the last frame are on the screen now
+    m_spLatencyStats->FrameDisplayed(timer_get_time_now());
+}
+
+void ZepEditor::InvalidateDisplay()
+{
+    m_redrawAll = true;
+}
+
+// The background, the command region and the tabs
+void ZepEditor::DisplayChrome()
+{
     // Command plus output
     auto& commandLines = GetCommandLines();
 
@@ -1128,43 +1502,6 @@ void ZepEditor::Display()
             NRectf(NVec2f(m_tabRegion->rect.Left(), m_tabRegion->rect.Bottom() - DPI_Y(1)), NVec2f(m_tabRegion->rect.Right(), m_tabRegion->rect.Bottom())), GetTheme().GetColor(ThemeColor::TabInactive));
     }
 
-    // Figure out the active region
-    auto pActiveTabWindow = GetActiveTabWindow();
-    NRectf tabRect;
-    for (auto& tab : m_tabRegion->children)
-    {
-        if (std::static_pointer_cast<TabRegionTab>(tab)->pTabWindow == pActiveTabWindow)
-        {
-            tabRect = tab->rect;
-            break;
-        }
-    }
-
-    // Figure out the virtual vs real page size of the tabs
-    float virtualSize = 0.0f;
-    float tabRegionSize = m_tabRegion->rect.Width();
-    if (!m_tabRegion->children.empty())
-    {
-        virtualSize = m_tabRegion->children.back()->rect.Right();
-    }
-
-    // Move the tab bar origin if approriate
-    if (tabRect.Width() != 0.0f)
-    {
-        if ((tabRect.Left() - tabRect.Width() + m_tabOffsetX) < m_tabRegion->rect.Left())
-        {
-            m_tabOffsetX += m_tabRegion->rect.Left() - (tabRect.Left() + m_tabOffsetX - tabRect.Width());
-        }
-        else if ((tabRect.Right() + m_tabOffsetX + tabRect.Width()) > m_tabRegion->rect.Right())
-        {
-            m_tabOffsetX -= (tabRect.Right() + m_tabOffsetX - m_tabRegion->rect.Right() + tabRect.Width());
-        }
-    }
-
-    // Clamp it
-    m_tabOffsetX = std::min(m_tabOffsetX, 0.0f);
-    m_tabOffsetX = std::max(std::min(tabRegionSize - virtualSize, 0.0f), m_tabOffsetX);
-
     // Now display the tabs
     for (auto& tab : m_tabRegion->children)
     {
@@ -1188,12 +1525,6 @@ void ZepEditor::Display()
         // Tab text
         m_pDisplay->DrawChars(rc.topLeftPx + DPI_VEC2(NVec2f(textBorder, 0.0f)), textCol, (const uint8_t*)spTabRegionTab->name.c_str());
     }
-
-    // Display the tab
-    if (GetActiveTabWindow())
-    {
-        GetActiveTabWindow()->Display();
-    }
 } // namespace Zep
 
 ZepTheme& ZepEditor::GetTheme() const
@@ -1204,24 +1535,28 @@ ZepTheme& ZepEditor::GetTheme() const
 bool ZepEditor::OnMouseMove(const NVec2f& mousePos)
 {
     m_mousePos = mousePos;
-    bool handled = Broadcast(std::make_shared<ZepMessage>(Msg::MouseMove, mousePos));
-    m_bPendingRefresh = true;
+    m_spWorkloadRecorder->MouseEvent(WorkloadEventType::MouseMove, mousePos);
+    bool handled = Broadcast(MakeMessage<ZepMessage>(Msg::MouseMove, mousePos));
+    RequestRefresh();
     return handled;
 }
 
 bool ZepEditor::OnMouseDown(const NVec2f& mousePos, ZepMouseButton button)
 {
     m_mousePos = mousePos;
-    bool handled = Broadcast(std::make_shared<ZepMessage>(Msg::MouseDown, mousePos, button));
-    m_bPendingRefresh = true;
+    m_spWorkloadRecorder->MouseEvent(WorkloadEventType::MouseDown, mousePos, button);
+    FlushInput();
+    bool handled = Broadcast(MakeMessage<ZepMessage>(Msg::MouseDown, mousePos, button));
+    RequestRefresh();
     return handled;
 }
 
 bool ZepEditor::OnMouseUp(const NVec2f& mousePos, ZepMouseButton button)
 {
     m_mousePos = mousePos;
-    bool handled = Broadcast(std::make_shared<ZepMessage>(Msg::MouseUp, mousePos, button));
-    m_bPendingRefresh = true;
+    m_spWorkloadRecorder->MouseEvent(WorkloadEventType::MouseUp, mousePos, button);
+    bool handled = Broadcast(MakeMessage<ZepMessage>(Msg::MouseUp, mousePos, button));
+    RequestRefresh();
     return handled;
 }
 
@@ -1253,6 +1588,26 @@ void ZepEditor::SetFlags(uint32_t flags)
         RequestRefresh();
     }
 }
+
+void ZepEditor::FlushInput()
+{
+    if (m_pPendingInputMode)
+    {
+        auto pMode = m_pPendingInputMode;
+        m_pPendingInputMode = nullptr;
+        pMode->FlushPendingInsert();
+    }
+}
+
+ZepMode* ZepEditor::GetPendingInputMode() const
+{
+    return m_pPendingInputMode;
+}
+
+void ZepEditor::SetPendingInputMode(ZepMode* pMode)
+{
+    m_pPendingInputMode = pMode;
+}
     
 std::vector<const KeyMap*> ZepEditor::GetGlobalKeyMaps(ZepMode& mode)
 {
@@ -1,6 +1,8 @@
 #include "zep/filesystem.h"
 
+#include <atomic>
 #include <fstream>
+#include <thread>
 
 #include "zep/mcommon/logger.h"
 #include "zep/mcommon/string/stringutils.h"
@@ -79,17 +81,60 @@ std::string ZepFileSystemCPP::Read(const ZepPath& fileName)
     return std::string();
 }
 
+void ZepFileSystemCPP::SetAtomicWrite(bool atomic)
+{
+    m_atomicWrite = atomic;
+}
+
 bool ZepFileSystemCPP::Write(const ZepPath& fileName, const void* pData, size_t size)
 {
+    if (m_atomicWrite)
+    {
+        return WriteAtomic(fileName, pData, size);
+    }
+
     FILE* pFile;
     pFile = fopen(fileName.string().c_str(), "wb");
     if (!pFile)
     {
         return false;
     }
-    fwrite(pData, sizeof(uint8_t), size, pFile);
-    fclose(pFile);
-    return true;
+    bool written = fwrite(pData, sizeof(uint8_t), size, pFile) == size;
+    return (fclose(pFile) == 0) && written;
+}
+
+// Written to a file beside the real one (through any links to it), then renamed over it, so the file is never seen
+// half written, and a failed write leaves the old one as it was
+bool ZepFileSystemCPP::WriteAtomic(const ZepPath& fileName, const void* pData, size_t size)
+{
+    static std::atomic<uint32_t> tempCount(0);
+    auto target = Exists(fileName) ? Canonical(fileName).string() : fileName.string();
+    auto tempName = target + ".zep" + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()) % 100000) + "-" + std::to_string(tempCount++);
+
+    FILE* pFile;
+    pFile = fopen(tempName.c_str(), "wb");
+    if (!pFile)
+    {
+        return false;
+    }
+    bool written = fwrite(pData, sizeof(uint8_t), size, pFile) == size;
+    written = (fclose(pFile) == 0) && written;
+
+    std::error_code ec;
+    if (written && cpp_fs::exists(target, ec))
+    {
+        cpp_fs::permissions(tempName, cpp_fs::status(target, ec).permissions(), ec);
+    }
+    if (written)
+    {
+        cpp_fs::rename(tempName, target, ec);
+        written = !ec;
+    }
+    if (!written)
+    {
+        cpp_fs::remove(tempName, ec);
+    }
+    return written;
 }
 
 void ZepFileSystemCPP::ScanDirectory(const ZepPath& path, std::function<bool(const ZepPath& path, bool& dont_recurse)> fnScan) const
@@ -49,6 +49,19 @@ Indexer::Indexer(ZepEditor& editor)
 {
 }
 
+Indexer::~Indexer()
+{
+    m_cancel.cancel();
+    if (m_indexResult.valid())
+    {
+        m_indexResult.wait();
+    }
+    if (m_symbolResult.valid())
+    {
+        m_symbolResult.wait();
+    }
+}
+
 void Indexer::GetSearchPaths(ZepEditor& editor, const ZepPath& path, std::vector<std::string>& ignore_patterns, std::vector<std::string>& include_patterns, std::string& errors)
 {
     ZepPath config = path / ".zep" / "project.cfg";
@@ -104,7 +117,7 @@ void Indexer::GetSearchPaths(ZepEditor& editor, const ZepPath& path, std::vector
     }
 } // namespace Zep
 
-std::future<std::shared_ptr<FileIndexResult>> Indexer::IndexPaths(ZepEditor& editor, const ZepPath& startPath)
+std::future<std::shared_ptr<FileIndexResult>> Indexer::IndexPaths(ZepEditor& editor, const ZepPath& startPath, const void* pOwner, std::function<void()> fnReady, const CancelToken& cancel)
 {
     std::vector<std::string> ignorePaths;
     std::vector<std::string> includePaths;
@@ -115,17 +128,24 @@ std::future<std::shared_ptr<FileIndexResult>> Indexer::IndexPaths(ZepEditor& edi
     if (!errors.empty())
     {
         spResult->errors = errors;
+        editor.GetScheduler().Post(pOwner, fnReady);
         return make_ready_future(spResult);
     }
 
     auto pFileSystem = &editor.GetFileSystem();
-    return editor.GetThreadPool().enqueue([=](ZepPath root) {
+    auto pEditor = &editor;
+    return editor.GetThreadPool().enqueue_task(TaskPriority::Background, "IndexPaths", cancel, [=](const CancelToken& cancel) {
+        auto root = startPath;
         spResult->root = root;
 
         try
         {
             // Index the whole subtree, ignoring any patterns supplied to us
             pFileSystem->ScanDirectory(root, [&](const ZepPath& p, bool& recurse) -> bool {
+                if (cancel.is_cancelled())
+                {
+                    return false;
+                }
                 recurse = true;
 
                 auto bDir = pFileSystem->IsDirectory(p);
@@ -185,50 +205,43 @@ std::future<std::shared_ptr<FileIndexResult>> Indexer::IndexPaths(ZepEditor& edi
         catch (std::exception&)
         {
         }
+        pEditor->GetScheduler().Post(pOwner, fnReady);
         return spResult;
-    },
-        startPath);
+    });
 }
 
-void Indexer::Notify(std::shared_ptr<ZepMessage> message)
+void Indexer::OnIndexReady()
 {
-    if (message->messageId == Msg::Tick)
+    if (!m_fileSearchActive)
     {
-        if (m_fileSearchActive)
-        {
-            if (!is_future_ready(m_indexResult))
-            {
-                return;
-            }
-
-            m_fileSearchActive = false;
-
-            m_spFilePaths = m_indexResult.get();
-            if (!m_spFilePaths->errors.empty())
-            {
-                GetEditor().SetCommandText(m_spFilePaths->errors);
-                return;
-            }
+        return;
+    }
+    m_fileSearchActive = false;
 
-            // Queue the files to be searched
-            {
-                std::lock_guard<std::mutex> guard(m_queueMutex);
-                for (auto& p : m_spFilePaths->paths)
-                {
-                    m_searchQueue.push_back(p);
-                }
-            }
+    m_spFilePaths = m_indexResult.get();
+    if (!m_spFilePaths->errors.empty())
+    {
+        GetEditor().SetCommandText(m_spFilePaths->errors);
+        return;
+    }
 
-            // Kick off the thread
-            StartSymbolSearch();
+    // Queue the files to be searched
+    {
+        std::lock_guard<std::mutex> guard(m_queueMutex);
+        for (auto& p : m_spFilePaths->paths)
+        {
+            m_searchQueue.push_back(p);
         }
     }
+
+    // Kick off the thread
+    StartSymbolSearch();
 }
 
 void Indexer::StartSymbolSearch()
 {
-    GetEditor().GetThreadPool().enqueue([=]() {
-        for (;;)
+    m_symbolResult = GetEditor().GetThreadPool().enqueue_task(TaskPriority::Background, "SymbolSearch", m_cancel, [=](const CancelToken& cancel) {
+        while (!cancel.is_cancelled())
         {
             ZepPath path;
             {
@@ -256,6 +269,7 @@ void Indexer::StartSymbolSearch()
                 string_split(strFile, ";()[] \t\n\r&!\"\'*:,<>", tokens);
             }
         }
+        return false;
     });
 }
 
@@ -285,7 +299,10 @@ bool Indexer::StartIndexing()
     fs.Write(indexDBRoot / "indexdb", &v, 1);
 
     m_fileSearchActive = true;
-    m_indexResult = Indexer::IndexPaths(GetEditor(), m_searchRoot);
+    m_indexResult = Indexer::IndexPaths(GetEditor(), m_searchRoot, this, [this]() {
+        OnIndexReady();
+    },
+        m_cancel);
 
     return true;
 }
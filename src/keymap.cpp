@@ -1,5 +1,7 @@
+#include <algorithm>
 #include <cassert>
-#include <regex>
+#include <cstring>
+#include <limits>
 
 #include "zep/keymap.h"
 #include "zep/mode.h"
@@ -9,86 +11,403 @@
 namespace Zep
 {
 
-// Keyboard mapping strings such as <PageDown> get converted here
-ExtKeys::Key MapStringToExKey(const std::string& str)
+namespace
 {
-#define COMPARE(a, b)              \
-    if (string_tolower(str) == #a) \
-        return b;
-
-    COMPARE(return, ExtKeys::RETURN)
-    COMPARE(escape, ExtKeys::ESCAPE)
-    COMPARE(backspace, ExtKeys::BACKSPACE)
-    COMPARE(left, ExtKeys::LEFT)
-    COMPARE(right, ExtKeys::RIGHT)
-    COMPARE(up, ExtKeys::UP)
-    COMPARE(down, ExtKeys::DOWN)
-    COMPARE(tab, ExtKeys::TAB)
-    COMPARE(del, ExtKeys::DEL)
-    COMPARE(home, ExtKeys::HOME)
-    COMPARE(end, ExtKeys::END)
-    COMPARE(pagedown, ExtKeys::PAGEDOWN)
-    COMPARE(pageup, ExtKeys::PAGEUP)
-    COMPARE(f1, ExtKeys::F1)
-    COMPARE(f2, ExtKeys::F2)
-    COMPARE(f3, ExtKeys::F3)
-    COMPARE(f4, ExtKeys::F4)
-    COMPARE(f5, ExtKeys::F5)
-    COMPARE(f6, ExtKeys::F6)
-    COMPARE(f7, ExtKeys::F7)
-    COMPARE(f8, ExtKeys::F8)
-    COMPARE(f9, ExtKeys::F9)
-    COMPARE(f10, ExtKeys::F10)
-    COMPARE(f11, ExtKeys::F11)
-    COMPARE(f12, ExtKeys::F12)
-
-    return ExtKeys::NONE;
+
+const struct
+{
+    const char* name;
+    ExtKeys::Key key;
+} ExtKeyNames[] = {
+    { "Return", ExtKeys::RETURN }, { "Escape", ExtKeys::ESCAPE }, { "Backspace", ExtKeys::BACKSPACE }, { "Left", ExtKeys::LEFT },
+    { "Right", ExtKeys::RIGHT }, { "Up", ExtKeys::UP }, { "Down", ExtKeys::DOWN }, { "Tab", ExtKeys::TAB }, { "Del", ExtKeys::DEL },
+    { "Home", ExtKeys::HOME }, { "End", ExtKeys::END }, { "PageDown", ExtKeys::PAGEDOWN }, { "PageUp", ExtKeys::PAGEUP },
+    { "F1", ExtKeys::F1 }, { "F2", ExtKeys::F2 }, { "F3", ExtKeys::F3 }, { "F4", ExtKeys::F4 }, { "F5", ExtKeys::F5 },
+    { "F6", ExtKeys::F6 }, { "F7", ExtKeys::F7 }, { "F8", ExtKeys::F8 }, { "F9", ExtKeys::F9 }, { "F10", ExtKeys::F10 },
+    { "F11", ExtKeys::F11 }, { "F12", ExtKeys::F12 }
+};
+
+// Deepest path through a map that a search follows
+const uint32_t MaxKeyMapDepth = 32;
+
+bool IsPlainChar(KeyCode key)
+{
+    return key < KeyCodes::ExtKey;
 }
 
-// Keyboard mapping strings such as <PageDown> get converted here
-std::string keymap_string(const std::string& str)
+// Names in groups such as <PageDown> get converted here
+bool MapNameToKey(const char* pName, size_t length, KeyCode& key)
 {
-    return str;
+    for (auto& extKey : ExtKeyNames)
+    {
+        if (strlen(extKey.name) != length)
+        {
+            continue;
+        }
+
+        size_t index = 0;
+        while (index < length && std::tolower(uint8_t(pName[index])) == std::tolower(uint8_t(extKey.name[index])))
+        {
+            index++;
+        }
+        if (index == length)
+        {
+            key = KeyCodes::ExtKey + extKey.key;
+            return true;
+        }
+    }
+    return false;
 }
 
-// Splitting the input into groups of <> or ch
-std::string NextToken(std::string::const_iterator& itrChar, std::string::const_iterator itrEnd)
+// Reads the next key, a char or a group such as <C-S-Left>, and moves past it.  A '<' that doesn't start a known
+// group is just a '<'.  Maps use the wildcards; typed keys can't make them
+KeyCode NextKey(const std::string& str, size_t& pos, bool allowWildcards)
 {
-    std::ostringstream str;
+    auto ch = KeyCode(uint8_t(str[pos++]));
+    if (ch != '<')
+    {
+        return ch;
+    }
 
-    // Find a group
-    if (*itrChar == '<')
+    auto close = str.find('>', pos + 1);
+    if (close == std::string::npos)
     {
-        itrChar++;
-        auto itrStart = itrChar;
+        return ch;
+    }
 
-        // Walk the group, ensuring we consistently output (C-)(S-)foo
-        while (itrChar != itrEnd && *itrChar != '>')
+    // Modifiers first; (C-)(S-)foo, or the other way round
+    auto pName = str.c_str() + pos;
+    auto length = close - pos;
+    KeyCode modifiers = 0;
+    while (length > 2 && pName[1] == '-')
+    {
+        auto modifier = std::toupper(uint8_t(pName[0]));
+        if (modifier == 'C')
+        {
+            modifiers |= ModifierKey::Ctrl;
+        }
+        else if (modifier == 'S')
+        {
+            modifiers |= ModifierKey::Shift;
+        }
+        else if (modifier == 'A' || modifier == 'M')
+        {
+            modifiers |= ModifierKey::Alt;
+        }
+        else
         {
-            itrChar++;
+            break;
         }
+        pName += 2;
+        length -= 2;
+    }
+
+    KeyCode key;
+    if (length == 1)
+    {
+        key = KeyCode(uint8_t(pName[0]));
+        if (allowWildcards && modifiers == 0)
+        {
+            key = key == 'D' ? KeyCodes::Digits : key == 'R' ? KeyCodes::Register : key == '.' ? KeyCodes::AnyChar : key;
+        }
+    }
+    else if (!MapNameToKey(pName, length, key))
+    {
+        return ch;
+    }
 
-        // Ensure <C-S- or variants, ie. capitalize for consistency if the mapping
-        // was badly supplied
-        auto strGroup = std::string(itrStart, itrChar);
-        string_replace_in_place(strGroup, "c-", "C-");
-        string_replace_in_place(strGroup, "s-", "S-");
+    pos = close + 1;
+    return key | (modifiers << KeyCodes::ModifierShift);
+}
 
-        // Skip to the next
-        if (itrChar != itrEnd)
-            itrChar++;
+// The key as it would be written in a map
+void AppendKeyName(std::string& str, KeyCode key)
+{
+    switch (key)
+    {
+    case KeyCodes::Digits:
+        str += "<D>";
+        return;
+    case KeyCodes::Register:
+        str += "<R>";
+        return;
+    case KeyCodes::AnyChar:
+        str += "<.>";
+        return;
+    default:
+        break;
+    }
 
-        str << "<" << strGroup << ">";
+    auto modifiers = key >> KeyCodes::ModifierShift;
+    key &= (1 << KeyCodes::ModifierShift) - 1;
+    if (modifiers == 0 && IsPlainChar(key))
+    {
+        str += char(key);
+        return;
+    }
+
+    str += "<";
+    if (modifiers & ModifierKey::Ctrl)
+    {
+        str += "C-";
+    }
+    if (modifiers & ModifierKey::Shift)
+    {
+        str += "S-";
+    }
+    if (modifiers & ModifierKey::Alt)
+    {
+        str += "A-";
+    }
+    if (IsPlainChar(key))
+    {
+        str += char(key);
     }
     else
     {
-        str << *itrChar++;
+        for (auto& extKey : ExtKeyNames)
+        {
+            if (KeyCodes::ExtKey + extKey.key == key)
+            {
+                str += extKey.name;
+            }
+        }
     }
+    str += ">";
+}
+
+// Lays the tree out breadth first, so that each node's children are next to each other
+void CompileKeyMap(const KeyMap& map)
+{
+    map.nodesDirty = false;
+    std::vector<const CommandNode*> order;
+    order.push_back(map.spRoot.get());
 
-    // Return the converted string
-    return str.str();
+    map.nodes.clear();
+    map.nodes.push_back(KeyMapNode{ 0, map.spRoot->commandId, 0, 0 });
+    for (size_t index = 0; index < order.size(); index++)
+    {
+        auto& children = order[index]->children;
+        map.nodes[index].firstChild = uint32_t(map.nodes.size());
+        map.nodes[index].childCount = uint32_t(children.size());
+        for (auto& child : children)
+        {
+            map.nodes.push_back(KeyMapNode{ child.first, child.second->commandId, 0, 0 });
+            order.push_back(child.second.get());
+        }
+    }
 }
 
+// Captures on the way down, one per level at most; the search backs out of them when a branch doesn't match
+struct KeyMapCapture
+{
+    KeyCode type = 0;
+    int value = 0;
+};
+
+class KeyMapSearch
+{
+public:
+    KeyMapSearch(const KeyMap& map, const std::string& command, KeyMapResult& result)
+        : m_map(map)
+        , m_command(command)
+        , m_result(result)
+    {
+    }
+
+    bool Search(uint32_t nodeIndex, size_t pos, uint32_t depth)
+    {
+        auto& node = m_map.nodes[nodeIndex];
+        auto itrChildren = m_map.nodes.begin() + node.firstChild;
+        auto itrChildrenEnd = itrChildren + node.childCount;
+        if (pos == m_command.size())
+        {
+            // Out of keys, but a command could start here
+            for (auto itrChild = itrChildren; itrChild != itrChildrenEnd; itrChild++)
+            {
+                if (itrChild->commandId == StringId() && itrChild->childCount != 0)
+                {
+                    AppendSearchPath("(...)");
+                    m_result.needMoreChars = true;
+                }
+            }
+            return false;
+        }
+
+        if (depth == MaxKeyMapDepth)
+        {
+            return false;
+        }
+
+        // The key itself; the wildcards sort after all the keys
+        auto keyPos = pos;
+        auto key = NextKey(m_command, keyPos, false);
+        auto itrWildcards = std::lower_bound(itrChildren, itrChildrenEnd, KeyCode(KeyCodes::Digits), [](const KeyMapNode& node, KeyCode key) { return node.key < key; });
+        auto itrFound = std::lower_bound(itrChildren, itrWildcards, key, [](const KeyMapNode& node, KeyCode key) { return node.key < key; });
+        if (itrFound != itrWildcards && itrFound->key == key && Visit(*itrFound, keyPos, depth))
+        {
+            return true;
+        }
+
+        for (auto itrChild = itrWildcards; itrChild != itrChildrenEnd; itrChild++)
+        {
+            auto wildcardPos = pos;
+            KeyMapCapture capture;
+            capture.type = itrChild->key;
+            if (itrChild->key == KeyCodes::Digits)
+            {
+                // Walk along grabbing digits
+                while (wildcardPos < m_command.size() && std::isdigit(uint8_t(m_command[wildcardPos])))
+                {
+                    if (capture.value < std::numeric_limits<int>::max() / 10)
+                    {
+                        capture.value = capture.value * 10 + (m_command[wildcardPos] - '0');
+                    }
+                    wildcardPos++;
+                }
+                if (wildcardPos == pos)
+                {
+                    continue;
+                }
+            }
+            else if (itrChild->key == KeyCodes::Register)
+            {
+                // A register is a quote, then its name; just the quote waits for the name
+                if (key != '"')
+                {
+                    continue;
+                }
+                wildcardPos = keyPos;
+                if (wildcardPos < m_command.size())
+                {
+                    auto reg = NextKey(m_command, wildcardPos, false);
+                    if (!IsPlainChar(reg))
+                    {
+                        continue;
+                    }
+                    capture.value = int(reg);
+                }
+                else
+                {
+                    capture.type = 0;
+                }
+            }
+            else if (itrChild->key == KeyCodes::AnyChar)
+            {
+                if (!IsPlainChar(key))
+                {
+                    continue;
+                }
+                wildcardPos = keyPos;
+                capture.value = int(key);
+            }
+
+            m_captures[depth] = capture;
+            if (Visit(*itrChild, wildcardPos, depth))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    bool Visit(const KeyMapNode& child, size_t pos, uint32_t depth)
+    {
+        if (m_result.recordSearchPath)
+        {
+            RecordStep(child, depth);
+        }
+
+        // Remember if this is a valid match for something
+        m_result.foundMapping = child.commandId;
+        if (child.commandId == StringId())
+        {
+            // There are more children, and we haven't got any more characters, keep asking for more
+            if (child.childCount != 0 && pos == m_command.size())
+            {
+                m_result.needMoreChars = true;
+                m_captures[depth].type = 0;
+                return false;
+            }
+
+            // Walk down to the next level
+            auto found = Search(uint32_t(&child - m_map.nodes.data()), pos, depth + 1);
+            m_captures[depth].type = 0;
+            return found;
+        }
+
+        // This is the find result, record the capture groups for it, the deepest first
+        if (m_result.recordSearchPath)
+        {
+            m_result.searchPath += " : ";
+            m_result.searchPath += child.commandId.ToString();
+        }
+        m_result.captureNumbers.clear();
+        m_result.captureChars.clear();
+        m_result.captureRegisters.clear();
+        for (auto level = depth + 1; level > 0; level--)
+        {
+            auto& capture = m_captures[level - 1];
+            switch (capture.type)
+            {
+            case KeyCodes::Digits:
+                m_result.captureNumbers.push_back(capture.value);
+                break;
+            case KeyCodes::Register:
+                m_result.captureRegisters.push_back(char(capture.value));
+                break;
+            case KeyCodes::AnyChar:
+                m_result.captureChars.push_back(char(capture.value));
+                break;
+            default:
+                break;
+            }
+        }
+        m_captures[depth].type = 0;
+        m_result.needMoreChars = false;
+        return true;
+    }
+
+    void RecordStep(const KeyMapNode& child, uint32_t depth)
+    {
+        auto& capture = m_captures[depth];
+        switch (capture.type)
+        {
+        case KeyCodes::Digits:
+            m_result.searchPath += "(D:" + std::to_string(capture.value) + ")";
+            break;
+        case KeyCodes::Register:
+            m_result.searchPath += std::string("(\"") + char(capture.value) + ")";
+            break;
+        case KeyCodes::AnyChar:
+            m_result.searchPath += std::string("(.") + char(capture.value) + ")";
+            break;
+        default:
+            break;
+        }
+        m_result.searchPath += "(";
+        AppendKeyName(m_result.searchPath, child.key);
+        m_result.searchPath += ")";
+    }
+
+    void AppendSearchPath(const char* pText)
+    {
+        if (m_result.recordSearchPath)
+        {
+            m_result.searchPath += pText;
+        }
+    }
+
+private:
+    const KeyMap& m_map;
+    const std::string& m_command;
+    KeyMapResult& m_result;
+    KeyMapCapture m_captures[MaxKeyMapDepth];
+};
+
+} // namespace
+
 /*
 static bool ends_with(const std::string& str, const std::string& suffix)
 {
@@ -120,18 +439,17 @@ bool keymap_add(KeyMap& map, const std::string& strCommand, const StringId& comm
 {
     auto spCurrent = map.spRoot;
 
-    std::ostringstream str;
-    auto itrChar = strCommand.begin();
-    while (itrChar != strCommand.end())
+    size_t pos = 0;
+    while (pos < strCommand.size())
     {
-        auto search = NextToken(itrChar, strCommand.end());
+        auto key = NextKey(strCommand, pos, true);
 
-        auto itrRoot = spCurrent->children.find(search);
+        auto itrRoot = spCurrent->children.find(key);
         if (itrRoot == spCurrent->children.end())
         {
             auto spNode = std::make_shared<CommandNode>();
-            spNode->token = search;
-            spCurrent->children[search] = spNode;
+            spNode->key = key;
+            spCurrent->children[key] = spNode;
             spCurrent = spNode;
         }
         else
@@ -147,206 +465,68 @@ bool keymap_add(KeyMap& map, const std::string& strCommand, const StringId& comm
     }
 
     spCurrent->commandId = commandId;
+    map.nodesDirty = true;
     return true;
 }
 
 void keymap_dump(const KeyMap& map, std::ostringstream& str)
 {
-    std::function<void(std::shared_ptr<CommandNode>, int)> fnDump;
-    fnDump = [&](std::shared_ptr<CommandNode> node, int depth) {
-        for (int i = 0; i < depth; i++)
+    std::function<void(uint32_t, int)> fnDump;
+    fnDump = [&](uint32_t nodeIndex, int depth) {
+        auto& node = map.nodes[nodeIndex];
+        std::string name;
+        if (nodeIndex != 0)
         {
-            str << " ";
+            AppendKeyName(name, node.key);
         }
-        str << node->token;
-        if (node->commandId != 0)
-            str << " : " << node->commandId.ToString();
+        str << std::string(depth, ' ') << name;
+        if (node.commandId != 0)
+            str << " : " << node.commandId.ToString();
         str << std::endl;
 
-        for (auto& child : node->children)
+        for (uint32_t child = 0; child < node.childCount; child++)
         {
-            fnDump(child.second, depth + 2);
+            fnDump(node.firstChild + child, depth + 2);
         }
     };
-    fnDump(map.spRoot, 0);
+
+    if (map.nodesDirty)
+    {
+        CompileKeyMap(map);
+    }
+    if (!map.nodes.empty())
+    {
+        fnDump(0, 0);
+    }
 }
 
-// Walk the tree of tokens, figuring out which command this is
-// Input to this function:
+// Walk the map, figuring out which command this is.  Input to this function:
 // <C-x>fgh
-// i.e. Keyboard mappings are fed in as <> strings.
+// i.e. Keyboard mappings are fed in as <> strings, and read a key at a time as the search goes.  Nothing is
+// allocated unless the search path is asked for
 void keymap_find(const KeyMap& map, const std::string& strCommand, KeyMapResult& findResult)
 {
-    auto consumeDigits = [](std::shared_ptr<CommandNode>& spNode, std::string::const_iterator& itrChar, std::string::const_iterator itrEnd, std::vector<int>& result, std::ostringstream& str) {
-        if (spNode->token == "<D>")
-        {
-            // Walk along grabbing digits
-            auto itrStart = itrChar;
-            while (itrChar != itrEnd && std::isdigit(*itrChar))
-            {
-                itrChar++;
-            }
-
-            if (itrStart != itrChar)
-            {
-                auto token = std::string(itrStart, itrChar);
-                try
-                {
-                    // Grab the data, but continue to search for the next token
-                    result.push_back(std::stoi(token));
-                    str << "(D:" << token << ")";
-                }
-                catch (std::exception& ex)
-                {
-                    LOG(DEBUG) << ex.what();
-                }
-                return true;
-            }
-        }
-        return false;
-    };
-
-    auto consumeChar = [](std::shared_ptr<CommandNode>& spNode, std::string::const_iterator& itrChar, std::string::const_iterator itrEnd, std::vector<char>& chars, std::ostringstream& str) {
-        if (spNode->token == "<.>")
-        {
-            // Special match groups
-            if (itrChar != itrEnd)
-            {
-                chars.push_back(*itrChar);
-                str << "(." << *itrChar << ")";
-                itrChar++;
-                return true;
-            }
-        }
-        return false;
-    };
-
-    auto consumeRegister = [](std::shared_ptr<CommandNode>& spNode, std::string::const_iterator& itrChar, std::string::const_iterator itrEnd, std::vector<char>& registers, std::ostringstream& str) {
-        if (spNode->token == "<R>")
-        {
-            // Grab register
-            if (itrChar != itrEnd && *itrChar == '"')
-            {
-                itrChar++;
-                if (itrChar != itrEnd)
-                {
-                    registers.push_back(*itrChar);
-                    str << "(\"" << *itrChar << ")";
-                    itrChar++;
-                }
-                return true;
-            }
-        }
-        return false;
-    };
-
-    struct Captures
+    findResult.needMoreChars = false;
+    if (map.nodesDirty)
     {
-        std::vector<int> captureNumbers;
-        std::vector<char> captureChars;
-        std::vector<char> captureRegisters;
-    };
-
-    std::function<bool(std::shared_ptr<CommandNode>, std::string::const_iterator, std::string::const_iterator, const Captures& captures, KeyMapResult&)> fnSearch;
-    fnSearch = [&](std::shared_ptr<CommandNode> spNode, std::string::const_iterator itrChar, std::string::const_iterator itrEnd, const Captures& captures, KeyMapResult& result) {
-        for (auto& child : spNode->children)
-        {
-            auto spChildNode = child.second;
-            std::string::const_iterator itr = itrChar;
-
-            Captures nodeCaptures;
-            std::ostringstream strCaptures;
-
-            std::string token;
-
-            // Consume wildcards
-            if (consumeDigits(spChildNode, itr, itrEnd, nodeCaptures.captureNumbers, strCaptures))
-            {
-                token = spChildNode->token;
-            }
-            else if (consumeRegister(spChildNode, itr, itrEnd, nodeCaptures.captureRegisters, strCaptures))
-            {
-                token = spChildNode->token;
-            }
-            else if (consumeChar(spChildNode, itr, itrEnd, nodeCaptures.captureChars, strCaptures))
-            {
-                token = spChildNode->token;
-            }
-            else
-            {
-                // Grab full <C-> tokens
-                token = string_slurp_if(itr, itrEnd, '<', '>');
-                if (token.empty() && itr != itrEnd)
-                {
-                    // ... or next char
-                    token = std::string(itr, itr + 1);
-                    string_eat_char(itr, itrEnd);
-                }
-            }
-
-            if (token.empty() && child.second->commandId == StringId() && !spChildNode->children.empty())
-            {
-                result.searchPath += "(...)";
-                result.needMoreChars = true;
-                continue;
-            }
-
-            // We found a matching token or wildcard token at this level
-            if (child.first == token)
-            {
-                // Remember what we found
-                result.searchPath += strCaptures.str() + "(" + token + ")";
-
-                // Remember if this is a valid match for something
-                result.foundMapping = spChildNode->commandId;
-
-                // Append our capture groups to the current hierarchy level
-                nodeCaptures.captureChars.insert(nodeCaptures.captureChars.end(), captures.captureChars.begin(), captures.captureChars.end());
-                nodeCaptures.captureNumbers.insert(nodeCaptures.captureNumbers.end(), captures.captureNumbers.begin(), captures.captureNumbers.end());
-                nodeCaptures.captureRegisters.insert(nodeCaptures.captureRegisters.end(), captures.captureRegisters.begin(), captures.captureRegisters.end());
-
-                // This node doesn't have a mapping, so look harder
-                if (result.foundMapping == StringId())
-                {
-                    // There are more children, and we haven't got any more characters, keep asking for more
-                    if (!spChildNode->children.empty() && itr == itrEnd)
-                    {
-                        result.needMoreChars = true;
-                    }
-                    else
-                    {
-                        // Walk down to the next level
-                        if (fnSearch(spChildNode, itr, itrEnd, nodeCaptures, result))
-                            return true;
-                    }
-                }
-                else
-                {
-                    // This is the find result, note it and record the capture groups for the find
-                    result.searchPath += " : " + spChildNode->commandId.ToString();
-                    result.captureChars = nodeCaptures.captureChars;
-                    result.captureNumbers = nodeCaptures.captureNumbers;
-                    result.captureRegisters = nodeCaptures.captureRegisters;
-                    result.needMoreChars = false;
-                    return true;
-                }
-            }
-        };
-
-        // Searched and found nothing in this level
-        return false;
-
-    }; // fnSearch
+        CompileKeyMap(map);
+    }
 
-    findResult.needMoreChars = false;
+    bool found = false;
+    if (!map.nodes.empty())
+    {
+        KeyMapSearch search(map, strCommand, findResult);
+        found = search.Search(0, 0, 0);
+    }
 
-    Captures captures;
-    bool found = fnSearch(map.spRoot, strCommand.begin(), strCommand.end(), captures, findResult);
     if (!found)
     {
         if (findResult.needMoreChars)
         {
-            findResult.searchPath += "(...)";
+            if (findResult.recordSearchPath)
+            {
+                findResult.searchPath += "(...)";
+            }
         }
         else
         {
@@ -357,25 +537,32 @@ void keymap_find(const KeyMap& map, const std::string& strCommand, KeyMapResult&
             {
                 findResult.needMoreChars = false;
                 findResult.commandWithoutGroups = strCommand;
-                findResult.searchPath += "(j.)";
+                if (findResult.recordSearchPath)
+                {
+                    findResult.searchPath += "(j.)";
+                }
             }
             else
             {
-                findResult.searchPath += "(Unknown)";
+                if (findResult.recordSearchPath)
+                {
+                    findResult.searchPath += "(Unknown)";
+                }
 
                 // Didn't find anything, return sanitized text for possible input
                 auto itr = strCommand.begin();
                 auto token = string_slurp_if(itr, strCommand.end(), '<', '>');
                 if (token.empty())
                 {
-                    token = strCommand;
+                    findResult.commandWithoutGroups = strCommand;
+                }
+                else
+                {
+                    findResult.commandWithoutGroups = token;
                 }
-                findResult.commandWithoutGroups = token;
             }
         }
     }
-
-    //LOG(DEBUG) << strCommand << " - " << findResult.searchPath;
 }
 
 } // namespace Zep
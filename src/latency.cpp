@@ -0,0 +1,189 @@
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+#include "zep/buffer.h"
+#include "zep/latency.h"
+#include "zep/tab_window.h"
+#include "zep/window.h"
+
+namespace Zep
+{
+
+uint32_t LatencyHistogram::BucketIndex(uint64_t us)
+{
+    if (us < 4)
+    {
+        return uint32_t(us);
+    }
+
+    uint32_t power = 2;
+    while ((us >> (power + 1)) != 0)
+    {
+        power++;
+    }
+    auto index = 4 + (power - 2) * 4 + uint32_t((us >> (power - 2)) & 3);
+    return std::min(index, BucketCount - 1);
+}
+
+uint64_t LatencyHistogram::BucketTop(uint32_t index)
+{
+    if (index < 4)
+    {
+        return index;
+    }
+
+    auto power = (index - 4) / 4 + 2;
+    auto quarter = (index - 4) % 4;
+    return ((uint64_t(5 + quarter)) << (power - 2)) - 1;
+}
+
+void LatencyHistogram::Add(uint64_t us)
+{
+    buckets[BucketIndex(us)]++;
+    count++;
+    totalUs += us;
+    maxUs = std::max(maxUs, us);
+}
+
+uint64_t LatencyHistogram::Percentile(double fraction) const
+{
+    if (count == 0)
+    {
+        return 0;
+    }
+
+    auto rank = std::max(uint64_t(1), uint64_t(std::ceil(fraction * count)));
+    uint64_t seen = 0;
+    for (uint32_t index = 0; index < BucketCount; index++)
+    {
+        seen += buckets[index];
+        if (seen >= rank)
+        {
+            return std::min(BucketTop(index), maxUs);
+        }
+    }
+    return maxUs;
+}
+
+double LatencyHistogram::Average() const
+{
+    return count == 0 ? 0.0 : double(totalUs) / count;
+}
+
+void ZepLatencyStats::KeyHandled(const std::string& mode, const std::string& command, uint64_t pressedUs, uint64_t handledUs)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto& stat = m_stats[std::make_pair(mode, command)];
+    if (stat.mode.empty())
+    {
+        stat.mode = mode;
+        stat.command = command;
+    }
+    stat.handled.Add(handledUs > pressedUs ? handledUs - pressedUs : 0);
+    if (m_pending.size() >= MaxPendingKeys)
+    {
+        m_pending.clear();
+    }
+    m_pending.push_back(PendingKey{ &stat, pressedUs });
+}
+
+void ZepLatencyStats::FrameDisplayed(uint64_t nowUs)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto& key : m_pending)
+    {
+        key.pStat->frame.Add(nowUs > key.pressedUs ? nowUs - key.pressedUs : 0);
+    }
+    m_pending.clear();
+}
+
+std::vector<LatencyStat> ZepLatencyStats::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<LatencyStat> stats;
+    for (auto& stat : m_stats)
+    {
+        stats.push_back(stat.second);
+    }
+    return stats;
+}
+
+std::string ZepLatencyStats::ToString() const
+{
+    auto stats = GetStats();
+
+    std::ostringstream str;
+    str << "Keystroke latency in microseconds; handled is until the command is done, frame until it is displayed\n\n";
+    str << std::left << std::setw(16) << "Mode" << std::setw(28) << "Command" << std::right << std::setw(8) << "Count"
+        << std::setw(26) << "Handled p50/p95/p99" << std::setw(26) << "Frame p50/p95/p99" << std::setw(10) << "Max"
+        << '\n';
+
+    auto percentiles = [](const LatencyHistogram& histogram) {
+        return std::to_string(histogram.Percentile(0.5)) + "/" + std::to_string(histogram.Percentile(0.95)) + "/" + std::to_string(histogram.Percentile(0.99));
+    };
+    for (auto& stat : stats)
+    {
+        str << std::left << std::setw(16) << stat.mode << std::setw(28) << stat.command << std::right << std::setw(8) << stat.handled.count
+            << std::setw(26) << percentiles(stat.handled) << std::setw(26) << percentiles(stat.frame) << std::setw(10) << stat.frame.maxUs
+            << '\n';
+    }
+    return str.str();
+}
+
+void ZepLatencyStats::Clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.clear();
+    m_pending.clear();
+}
+
+ZepStatsExCommand::ZepStatsExCommand(ZepEditor& editor)
+    : ZepExCommand(editor)
+{
+}
+
+void ZepStatsExCommand::Register(ZepEditor& editor)
+{
+    editor.RegisterExCommand(std::make_shared<ZepStatsExCommand>(editor));
+}
+
+const char* ZepStatsExCommand::ExCommandName() const
+{
+    return "ZStats";
+}
+
+void ZepStatsExCommand::Run(const std::vector<std::string>& tokens)
+{
+    auto& stats = GetEditor().GetLatencyStats();
+    if (tokens.size() > 1 && tokens[1] == "reset")
+    {
+        stats.Clear();
+        GetEditor().SetCommandText("Latency stats cleared");
+        return;
+    }
+
+    // The buffer is kept for the next time, unless it has been closed
+    auto& buffers = GetEditor().GetBuffers();
+    if (std::none_of(buffers.begin(), buffers.end(), [&](const std::shared_ptr<ZepBuffer>& spBuffer) { return spBuffer.get() == m_pStatsBuffer; }))
+    {
+        m_pStatsBuffer = GetEditor().GetEmptyBuffer("[Stats]", FileFlags::ReadOnly);
+    }
+    m_pStatsBuffer->SetText(stats.ToString());
+
+    auto pTabWindow = GetEditor().GetActiveTabWindow();
+    if (pTabWindow == nullptr)
+    {
+        return;
+    }
+
+    auto& windows = pTabWindow->GetWindows();
+    auto itrWindow = std::find_if(windows.begin(), windows.end(), [&](ZepWindow* pWindow) { return &pWindow->GetBuffer() == m_pStatsBuffer; });
+    if (itrWindow == windows.end())
+    {
+        pTabWindow->AddWindow(m_pStatsBuffer, nullptr, RegionLayoutType::VBox);
+    }
+}
+
+} // namespace Zep
@@ -0,0 +1,356 @@
+#include "zep/line_layout_tree.h"
+
+#include <algorithm>
+
+namespace Zep
+{
+
+void LineLayoutTree::Clear()
+{
+    m_nodes.clear();
+    m_freeNodes.clear();
+    m_root = -1;
+}
+
+long LineLayoutTree::Size() const
+{
+    return Count(m_root);
+}
+
+bool LineLayoutTree::Empty() const
+{
+    return m_root == -1;
+}
+
+long LineLayoutTree::Count(int32_t t) const
+{
+    return t == -1 ? 0 : m_nodes[t].count;
+}
+
+int32_t LineLayoutTree::NewNode(const LineLayout& layout)
+{
+    int32_t index;
+    if (!m_freeNodes.empty())
+    {
+        index = m_freeNodes.back();
+        m_freeNodes.pop_back();
+    }
+    else
+    {
+        index = int32_t(m_nodes.size());
+        m_nodes.emplace_back();
+    }
+
+    // xorshift; the priorities just need to be well spread to keep the tree balanced
+    m_seed ^= m_seed << 13;
+    m_seed ^= m_seed >> 17;
+    m_seed ^= m_seed << 5;
+
+    auto& node = m_nodes[index];
+    node = Node{};
+    node.layout = layout;
+    node.priority = m_seed;
+    Update(index);
+    return index;
+}
+
+void LineLayoutTree::FreeTree(int32_t t)
+{
+    if (t == -1)
+    {
+        return;
+    }
+    FreeTree(m_nodes[t].left);
+    FreeTree(m_nodes[t].right);
+    m_freeNodes.push_back(t);
+}
+
+void LineLayoutTree::Update(int32_t t)
+{
+    auto& node = m_nodes[t];
+    node.count = 1;
+    node.heightPx = node.layout.heightPx;
+    node.spanCount = node.layout.spanCount;
+    node.maxWidthPx = node.layout.widthPx;
+    for (auto child : { node.left, node.right })
+    {
+        if (child != -1)
+        {
+            auto& childNode = m_nodes[child];
+            node.count += childNode.count;
+            node.heightPx += childNode.heightPx;
+            node.spanCount += childNode.spanCount;
+            node.maxWidthPx = std::max(node.maxWidthPx, childNode.maxWidthPx);
+        }
+    }
+}
+
+// Build a tree of lines in order, in one pass: the right edge of the tree so far is kept on a stack, and each new
+// line goes under the last node on it with a higher priority.  Nodes are finished as they come off the stack
+int32_t LineLayoutTree::Build(const LineLayout* pLayouts, long count)
+{
+    m_buildStack.clear();
+    for (long index = 0; index < count; index++)
+    {
+        auto node = NewNode(pLayouts ? pLayouts[index] : LineLayout());
+        int32_t last = -1;
+        while (!m_buildStack.empty() && m_nodes[m_buildStack.back()].priority < m_nodes[node].priority)
+        {
+            last = m_buildStack.back();
+            m_buildStack.pop_back();
+            Update(last);
+        }
+        m_nodes[node].left = last;
+        if (!m_buildStack.empty())
+        {
+            m_nodes[m_buildStack.back()].right = node;
+        }
+        m_buildStack.push_back(node);
+    }
+
+    int32_t root = -1;
+    while (!m_buildStack.empty())
+    {
+        root = m_buildStack.back();
+        m_buildStack.pop_back();
+        Update(root);
+    }
+    return root;
+}
+
+// Split into the first 'count' lines and the rest
+void LineLayoutTree::Split(int32_t t, long count, int32_t& left, int32_t& right)
+{
+    if (t == -1)
+    {
+        left = right = -1;
+        return;
+    }
+
+    auto leftCount = Count(m_nodes[t].left);
+    if (leftCount < count)
+    {
+        int32_t splitRight;
+        Split(m_nodes[t].right, count - leftCount - 1, m_nodes[t].right, splitRight);
+        left = t;
+        right = splitRight;
+    }
+    else
+    {
+        int32_t splitLeft;
+        Split(m_nodes[t].left, count, splitLeft, m_nodes[t].left);
+        left = splitLeft;
+        right = t;
+    }
+    Update(t);
+}
+
+int32_t LineLayoutTree::Merge(int32_t left, int32_t right)
+{
+    if (left == -1)
+    {
+        return right;
+    }
+    if (right == -1)
+    {
+        return left;
+    }
+
+    if (m_nodes[left].priority > m_nodes[right].priority)
+    {
+        auto merged = Merge(m_nodes[left].right, right);
+        m_nodes[left].right = merged;
+        Update(left);
+        return left;
+    }
+
+    auto merged = Merge(left, m_nodes[right].left);
+    m_nodes[right].left = merged;
+    Update(right);
+    return right;
+}
+
+void LineLayoutTree::Assign(const std::vector<LineLayout>& layouts)
+{
+    Clear();
+    m_nodes.reserve(layouts.size());
+    m_root = Build(layouts.data(), long(layouts.size()));
+}
+
+void LineLayoutTree::Insert(long index, long count)
+{
+    if (count <= 0)
+    {
+        return;
+    }
+
+    int32_t left, right;
+    Split(m_root, index, left, right);
+    m_root = Merge(Merge(left, Build(nullptr, count)), right);
+}
+
+void LineLayoutTree::Erase(long first, long last)
+{
+    if (last <= first)
+    {
+        return;
+    }
+
+    int32_t left, right, erased, remain;
+    Split(m_root, first, left, right);
+    Split(right, last - first, erased, remain);
+    FreeTree(erased);
+    m_root = Merge(left, remain);
+}
+
+const LineLayout& LineLayoutTree::Get(long index) const
+{
+    auto t = m_root;
+    for (;;)
+    {
+        auto& node = m_nodes[t];
+        auto leftCount = Count(node.left);
+        if (index < leftCount)
+        {
+            t = node.left;
+        }
+        else if (index == leftCount)
+        {
+            return node.layout;
+        }
+        else
+        {
+            index -= leftCount + 1;
+            t = node.right;
+        }
+    }
+}
+
+void LineLayoutTree::SetAt(int32_t t, long index, const LineLayout& layout)
+{
+    auto& node = m_nodes[t];
+    auto leftCount = Count(node.left);
+    if (index < leftCount)
+    {
+        SetAt(node.left, index, layout);
+    }
+    else if (index == leftCount)
+    {
+        node.layout = layout;
+    }
+    else
+    {
+        SetAt(node.right, index - leftCount - 1, layout);
+    }
+    Update(t);
+}
+
+void LineLayoutTree::Set(long index, const LineLayout& layout)
+{
+    SetAt(m_root, index, layout);
+}
+
+double LineLayoutTree::HeightPrefix(long count) const
+{
+    double sum = 0.0;
+    for (auto t = m_root; t != -1 && count > 0;)
+    {
+        auto& node = m_nodes[t];
+        auto leftCount = Count(node.left);
+        if (count <= leftCount)
+        {
+            t = node.left;
+            continue;
+        }
+        sum += (node.left == -1 ? 0.0 : m_nodes[node.left].heightPx) + node.layout.heightPx;
+        count -= leftCount + 1;
+        t = node.right;
+    }
+    return sum;
+}
+
+long LineLayoutTree::SpanPrefix(long count) const
+{
+    long sum = 0;
+    for (auto t = m_root; t != -1 && count > 0;)
+    {
+        auto& node = m_nodes[t];
+        auto leftCount = Count(node.left);
+        if (count <= leftCount)
+        {
+            t = node.left;
+            continue;
+        }
+        sum += (node.left == -1 ? 0 : m_nodes[node.left].spanCount) + node.layout.spanCount;
+        count -= leftCount + 1;
+        t = node.right;
+    }
+    return sum;
+}
+
+double LineLayoutTree::TotalHeight() const
+{
+    return m_root == -1 ? 0.0 : m_nodes[m_root].heightPx;
+}
+
+long LineLayoutTree::TotalSpans() const
+{
+    return m_root == -1 ? 0 : m_nodes[m_root].spanCount;
+}
+
+float LineLayoutTree::MaxWidth() const
+{
+    return m_root == -1 ? 0.0f : m_nodes[m_root].maxWidthPx;
+}
+
+long LineLayoutTree::FindHeight(double y) const
+{
+    long index = 0;
+    for (auto t = m_root; t != -1;)
+    {
+        auto& node = m_nodes[t];
+        auto leftHeight = node.left == -1 ? 0.0 : m_nodes[node.left].heightPx;
+        if (y < leftHeight)
+        {
+            t = node.left;
+            continue;
+        }
+        y -= leftHeight;
+        index += Count(node.left);
+        if (y < node.layout.heightPx)
+        {
+            return index;
+        }
+        y -= node.layout.heightPx;
+        index++;
+        t = node.right;
+    }
+    return index;
+}
+
+long LineLayoutTree::FindSpan(long spanIndex) const
+{
+    long index = 0;
+    for (auto t = m_root; t != -1;)
+    {
+        auto& node = m_nodes[t];
+        auto leftSpans = node.left == -1 ? 0 : m_nodes[node.left].spanCount;
+        if (spanIndex < leftSpans)
+        {
+            t = node.left;
+            continue;
+        }
+        spanIndex -= leftSpans;
+        index += Count(node.left);
+        if (spanIndex < node.layout.spanCount)
+        {
+            return index;
+        }
+        spanIndex -= node.layout.spanCount;
+        index++;
+        t = node.right;
+    }
+    return index;
+}
+
+} // namespace Zep
@@ -1,5 +1,12 @@
+#include <algorithm>
+#include <atomic>
 #include <chrono> // Timing
+#include <cmath>
 #include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <numeric>
 #include "zep/mcommon/logger.h"
 
 #include "zep/mcommon/animation/timer.h"
@@ -14,7 +21,6 @@ struct TimedSection
 };
 
 timer globalTimer;
-profile_data globalProfiler;
 
 uint64_t timer_get_time_now()
 {
@@ -52,28 +58,250 @@ double timer_to_ms(uint64_t value)
     return double(value / 1000.0);
 }
 
-ProfileBlock::ProfileBlock(const char* timer)
-    : strTimer(timer)
+namespace
 {
-    timer_start(blockTimer);
-    if (globalProfiler.timerData.find(timer) == globalProfiler.timerData.end())
+// Written by one thread, and read by others while it writes; a reader drops the events that may have been overwritten
+// as it read them
+struct ProfileEvent
+{
+    std::atomic<const char*> name{ nullptr };
+    std::atomic<uint64_t> beginNs{ 0 };
+    std::atomic<uint64_t> endNs{ 0 };
+};
+
+struct ProfileThread
+{
+    uint32_t id = 0;
+    std::string name;                   // Guarded by the registry's mutex
+    std::atomic<bool> inUse{ true };    // A thread that has finished leaves its buffer to the next one
+    std::atomic<uint64_t> written{ 0 }; // Events written, ever
+    std::atomic<uint64_t> cleared{ 0 }; // Events before this were cleared
+    ProfileEvent events[ProfileEventsPerThread];
+};
+
+struct ProfileRegistry
+{
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ProfileThread>> threads;
+};
+
+// Never destroyed, since threads may time zones as the process exits
+ProfileRegistry& GetProfileRegistry()
+{
+    static auto pRegistry = new ProfileRegistry();
+    return *pRegistry;
+}
+
+struct ProfileThreadHolder
+{
+    ProfileThread* pThread = nullptr;
+    ~ProfileThreadHolder()
+    {
+        if (pThread)
+        {
+            pThread->inUse = false;
+        }
+    }
+};
+
+ProfileThread& GetProfileThread()
+{
+    thread_local ProfileThreadHolder holder;
+    if (holder.pThread == nullptr)
+    {
+        auto& registry = GetProfileRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        for (auto& spThread : registry.threads)
+        {
+            bool inUse = false;
+            if (spThread->inUse.compare_exchange_strong(inUse, true))
+            {
+                spThread->name.clear();
+                holder.pThread = spThread.get();
+                break;
+            }
+        }
+
+        if (holder.pThread == nullptr)
+        {
+            registry.threads.push_back(std::make_unique<ProfileThread>());
+            holder.pThread = registry.threads.back().get();
+            holder.pThread->id = uint32_t(registry.threads.size());
+        }
+    }
+    return *holder.pThread;
+}
+
+struct ProfileRecord
+{
+    const char* name;
+    uint64_t beginNs;
+    uint64_t endNs;
+};
+
+// Copy out the events of each thread; call with the registry locked
+template <class F>
+void ForEachProfileThread(ProfileRegistry& registry, F fn)
+{
+    std::vector<ProfileRecord> records;
+    for (auto& spThread : registry.threads)
+    {
+        auto& thread = *spThread;
+        auto written = thread.written.load(std::memory_order_acquire);
+        auto first = std::max(thread.cleared.load(), written > ProfileEventsPerThread ? written - ProfileEventsPerThread : 0);
+
+        records.clear();
+        for (auto index = first; index < written; index++)
+        {
+            auto& event = thread.events[index % ProfileEventsPerThread];
+            records.push_back(ProfileRecord{ event.name.load(std::memory_order_relaxed), event.beginNs.load(std::memory_order_relaxed), event.endNs.load(std::memory_order_relaxed) });
+        }
+
+        // The writer may have gone round the ring while these were copied; it could be writing the slot after its last
+        std::atomic_thread_fence(std::memory_order_acquire);
+        auto writtenAfter = thread.written.load(std::memory_order_relaxed);
+        auto valid = writtenAfter + 1 > ProfileEventsPerThread ? writtenAfter + 1 - ProfileEventsPerThread : 0;
+        if (valid > first)
+        {
+            records.erase(records.begin(), records.begin() + std::min(size_t(valid - first), records.size()));
+        }
+        fn(thread, records);
+    }
+}
+
+void WriteJsonString(std::ostream& stream, const std::string& str)
+{
+    stream << '"';
+    for (auto ch : str)
     {
-        globalProfiler.timerData[timer] = profile_value{};
+        if (ch == '"' || ch == '\\')
+        {
+            stream << '\\' << ch;
+        }
+        else if (uint8_t(ch) < 0x20)
+        {
+            stream << ' ';
+        }
+        else
+        {
+            stream << ch;
+        }
     }
+    stream << '"';
+}
+} // namespace
+
+uint64_t profile_get_time_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
 }
 
-ProfileBlock::~ProfileBlock()
+void profile_add_event(const char* name, uint64_t beginNs, uint64_t endNs)
 {
-    elapsed = timer_get_elapsed(blockTimer);
-    profile_add_value(globalProfiler.timerData.find(strTimer)->second, double(elapsed));
+    auto& thread = GetProfileThread();
+    auto index = thread.written.load(std::memory_order_relaxed);
+    auto& event = thread.events[index % ProfileEventsPerThread];
+    event.name.store(name, std::memory_order_relaxed);
+    event.beginNs.store(beginNs, std::memory_order_relaxed);
+    event.endNs.store(endNs, std::memory_order_relaxed);
+    thread.written.store(index + 1, std::memory_order_release);
 }
 
-void profile_add_value(profile_value& val, double av)
+void profile_set_thread_name(const std::string& name)
 {
-    val.count++;
-    val.average = val.average * (val.count - 1) / val.count + av / val.count;
-    val.current = av;
+    auto& thread = GetProfileThread();
+    std::lock_guard<std::mutex> lock(GetProfileRegistry().mutex);
+    thread.name = name;
 }
 
+std::vector<profile_zone> profile_get_zones()
+{
+    // Zones are grouped by name; the same name can be a different string in each module
+    std::map<std::string, std::vector<uint64_t>> durations;
+    std::map<std::string, std::pair<uint64_t, uint64_t>> latest;
+    {
+        auto& registry = GetProfileRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        ForEachProfileThread(registry, [&](ProfileThread&, const std::vector<ProfileRecord>& records) {
+            for (auto& record : records)
+            {
+                auto& zoneDurations = durations[record.name];
+                zoneDurations.push_back(record.endNs - record.beginNs);
+
+                auto& zoneLatest = latest[record.name];
+                if (record.endNs >= zoneLatest.first)
+                {
+                    zoneLatest = std::make_pair(record.endNs, record.endNs - record.beginNs);
+                }
+            }
+        });
+    }
+
+    std::vector<profile_zone> zones;
+    for (auto& zoneDurations : durations)
+    {
+        auto& values = zoneDurations.second;
+        std::sort(values.begin(), values.end());
+
+        // Nearest rank
+        auto percentile = [&](double p) {
+            auto rank = size_t(std::ceil(p * values.size()));
+            return values[std::min(values.size(), std::max(rank, size_t(1))) - 1] / 1000.0;
+        };
+
+        profile_zone zone;
+        zone.name = zoneDurations.first;
+        zone.count = values.size();
+        zone.average = std::accumulate(values.begin(), values.end(), 0.0) / values.size() / 1000.0;
+        zone.current = latest[zone.name].second / 1000.0;
+        zone.p50 = percentile(0.50);
+        zone.p95 = percentile(0.95);
+        zone.p99 = percentile(0.99);
+        zones.push_back(zone);
+    }
+    return zones;
+}
+
+void profile_write_chrome_trace(std::ostream& stream)
+{
+    auto& registry = GetProfileRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    auto flags = stream.flags();
+    stream << std::fixed << std::setprecision(3);
+    stream << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+
+    bool first = true;
+    auto separate = [&]() {
+        stream << (first ? "\n" : ",\n");
+        first = false;
+    };
+    ForEachProfileThread(registry, [&](ProfileThread& thread, const std::vector<ProfileRecord>& records) {
+        separate();
+        stream << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << thread.id << ",\"args\":{\"name\":";
+        WriteJsonString(stream, thread.name.empty() ? "Thread " + std::to_string(thread.id) : thread.name);
+        stream << "}}";
+
+        for (auto& record : records)
+        {
+            separate();
+            stream << "{\"ph\":\"X\",\"name\":";
+            WriteJsonString(stream, record.name);
+            stream << ",\"pid\":1,\"tid\":" << thread.id << ",\"ts\":" << record.beginNs / 1000.0 << ",\"dur\":" << (record.endNs - record.beginNs) / 1000.0 << "}";
+        }
+    });
+    stream << "\n]}\n";
+    stream.flags(flags);
+}
+
+void profile_clear()
+{
+    auto& registry = GetProfileRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (auto& spThread : registry.threads)
+    {
+        spThread->cleared = spThread->written.load();
+    }
+}
 
 } // namespace Zep
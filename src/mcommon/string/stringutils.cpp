@@ -2,6 +2,8 @@
 #include <cassert>
 #include <cstring>
 #include <locale>
+#include <mutex>
+#include <shared_mutex>
 #include <string>
 
 #include <codecvt>
@@ -11,10 +13,46 @@
 namespace Zep
 {
 
-std::unordered_map<uint32_t, std::string>& StringId::GetStringLookup()
+namespace
 {
-    static std::unordered_map<uint32_t, std::string> stringLookup;
-    return stringLookup;
+struct StringIdLookup
+{
+    std::shared_mutex mutex;
+    std::unordered_map<uint32_t, std::string> strings;
+};
+
+StringIdLookup& GetStringIdLookup()
+{
+    static StringIdLookup lookup;
+    return lookup;
+}
+} // namespace
+
+void StringId::Register(uint32_t id, const char* pszString, size_t length)
+{
+    auto& lookup = GetStringIdLookup();
+    {
+        // Almost always there already; ids are made from the same few names over and over
+        std::shared_lock<std::shared_mutex> lock(lookup.mutex);
+        if (lookup.strings.find(id) != lookup.strings.end())
+        {
+            return;
+        }
+    }
+    std::unique_lock<std::shared_mutex> lock(lookup.mutex);
+    lookup.strings.emplace(id, std::string(pszString, length));
+}
+
+std::string StringId::ToString() const
+{
+    auto& lookup = GetStringIdLookup();
+    std::shared_lock<std::shared_mutex> lock(lookup.mutex);
+    auto itr = lookup.strings.find(id);
+    if (itr == lookup.strings.end())
+    {
+        return "murmur:" + std::to_string(id);
+    }
+    return itr->second;
 }
 
 std::string string_tolower(const std::string& str)
@@ -379,27 +417,29 @@ std::string string_slurp_if(std::string::const_iterator& itr, std::string::const
 
 StringId::StringId(const char* pszString)
 {
-    id = murmur_hash(pszString, (int)strlen(pszString), 0);
-    StringId::GetStringLookup()[id] = pszString;
+    auto length = strlen(pszString);
+    id = murmur_hash(pszString, (int)length, 0);
+    Register(id, pszString, length);
 }
 
 StringId::StringId(const std::string& str)
 {
     id = murmur_hash(str.c_str(), (int)str.length(), 0);
-    StringId::GetStringLookup()[id] = str;
+    Register(id, str.c_str(), str.length());
 }
 
 const StringId& StringId::operator=(const char* pszString)
 {
-    id = murmur_hash(pszString, (int)strlen(pszString), 0);
-    StringId::GetStringLookup()[id] = pszString;
+    auto length = strlen(pszString);
+    id = murmur_hash(pszString, (int)length, 0);
+    Register(id, pszString, length);
     return *this;
 }
 
 const StringId& StringId::operator=(const std::string& str)
 {
     id = murmur_hash(str.c_str(), (int)str.length(), 0);
-    StringId::GetStringLookup()[id] = str;
+    Register(id, str.c_str(), str.length());
     return *this;
 }
 
@@ -2,6 +2,7 @@
 #include "zep/buffer.h"
 #include "zep/editor.h"
 #include "zep/filesystem.h"
+#include "zep/latency.h"
 #include "zep/mcommon/logger.h"
 #include "zep/mode_search.h"
 #include "zep/regress.h"
@@ -22,6 +23,7 @@ CommandContext::CommandContext(const std::string& commandIn, ZepMode& md, Editor
     pRegister = &tempReg;
 
     bool needMore = false;
+    keymap.recordSearchPath = md.GetEditor().GetConfig().showNormalModeKeyStrokes;
     auto extraMaps = md.GetEditor().GetGlobalKeyMaps(md);
     for (auto& extra : extraMaps)
     {
@@ -154,6 +156,10 @@ ZepMode::ZepMode(ZepEditor& editor)
 
 ZepMode::~ZepMode()
 {
+    if (GetEditor().GetPendingInputMode() == this)
+    {
+        GetEditor().SetPendingInputMode(nullptr);
+    }
 }
 
 ZepWindow* ZepMode::GetCurrentWindow() const
@@ -211,6 +217,8 @@ void ZepMode::SwitchMode(EditorMode currentMode)
     if (currentMode == m_currentMode)
         return;
 
+    GetEditor().FlushInput();
+
     auto pWindow = GetCurrentWindow();
     auto& buffer = pWindow->GetBuffer();
     auto cursor = pWindow->GetBufferCursor();
@@ -277,11 +285,12 @@ void ZepMode::SwitchMode(EditorMode currentMode)
 
 std::string ZepMode::ConvertInputToMapString(uint32_t key, uint32_t modifierKeys)
 {
-    std::ostringstream str;
+    // Short enough to stay in the string, without allocating
+    std::string str;
     bool closeBracket = false;
     if (modifierKeys & ModifierKey::Ctrl)
     {
-        str << "<C-";
+        str += "<C-";
         if (modifierKeys & ModifierKey::Shift)
         {
             // Add the S- modifier for shift enabled special keys
@@ -289,7 +298,7 @@ std::string ZepMode::ConvertInputToMapString(uint32_t key, uint32_t modifierKeys
             // keys
             if (key < ' ')
             {
-                str << "S-";
+                str += "S-";
             }
         }
         closeBracket = true;
@@ -298,12 +307,12 @@ std::string ZepMode::ConvertInputToMapString(uint32_t key, uint32_t modifierKeys
     {
         if (key < ' ')
         {
-            str << "<S-";
+            str += "<S-";
             closeBracket = true;
         }
     }
 
-    std::string mapped;
+    const char* mapped = nullptr;
 
 #define COMPARE_STR(a, b) \
     if (key == b)         \
@@ -335,29 +344,26 @@ std::string ZepMode::ConvertInputToMapString(uint32_t key, uint32_t modifierKeys
     COMPARE_STR(F11, ExtKeys::F11)
     COMPARE_STR(F12, ExtKeys::F12)
 
-    if (!mapped.empty())
+    if (mapped)
     {
         if (!closeBracket)
         {
-            str << "<" << mapped;
+            str += "<";
             closeBracket = true;
         }
-        else
-        {
-            str << mapped;
-        }
+        str += mapped;
     }
-    else
+    else if (key != 0)
     {
-        str << std::string((const char*)&key);
+        str += char(key);
     }
 
     if (closeBracket)
     {
-        str << ">";
+        str += ">";
     }
 
-    return str.str();
+    return str;
 }
 
 // Handle a key press, convert it to an input command and context, and return it.
@@ -368,18 +374,112 @@ void ZepMode::AddKeyPress(uint32_t key, uint32_t modifierKeys)
         return;
     }
 
+    auto pressedTime = timer_get_time_now();
+    GetEditor().GetWorkloadRecorder().KeyPressed(key, modifierKeys, pressedTime);
+
     // For now, slice off the UTF8 ;)
     key = key & 0xFF;
 
     m_lastKey = key;
 
+    // The mode the key was pressed in; the command may switch it
+    auto modeName = std::string(Name()) + ":" + GetEditorModeName(m_currentMode);
+
+    // Plain text waits for the frame, or for a key that isn't plain text
+    if (QueueInsert(key, modifierKeys))
+    {
+        GetEditor().GetLatencyStats().KeyHandled(modeName, m_lastCommandName, pressedTime, timer_get_time_now());
+        timer_restart(m_lastKeyPressTimer);
+        return;
+    }
+    GetEditor().FlushInput();
+
     // Get the new command by parsing out the keys
     // We convert CTRL + f to a string: "<C-f>"
     HandleMappedInput(ConvertInputToMapString(key, modifierKeys));
 
+    GetEditor().GetLatencyStats().KeyHandled(modeName, m_lastCommandName, pressedTime, timer_get_time_now());
+
     timer_restart(m_lastKeyPressTimer);
 }
 
+bool ZepMode::QueueInsert(uint32_t key, uint32_t modifierKeys)
+{
+    if (!ZTestFlags(GetEditor().GetFlags(), ZepEditorFlags::CoalesceInput) || m_currentMode != EditorMode::Insert || !m_currentCommand.empty())
+    {
+        return false;
+    }
+
+    // Modes that group inserts start a group at a space or a new line, so those go the long way
+    bool groupInserts = ZTestFlags(m_modeFlags, ModeFlags::InsertModeGroupUndo);
+    if ((modifierKeys & ModifierKey::Ctrl) || (key == ' ' && groupInserts))
+    {
+        return false;
+    }
+
+    // As do keys that are mapped, or start a mapping, such as the j of jk; apart from the ones that just type
+    auto input = ConvertInputToMapString(key, modifierKeys);
+    KeyMapResult keymap;
+    for (auto& extra : GetEditor().GetGlobalKeyMaps(*this))
+    {
+        keymap_find(*extra, input, keymap);
+        if (keymap.foundMapping.id != 0 || keymap.needMoreChars)
+        {
+            return false;
+        }
+    }
+    keymap_find(GetKeyMappings(m_currentMode), input, keymap);
+    if (keymap.needMoreChars)
+    {
+        return false;
+    }
+
+    const char* pText = input.c_str();
+    if (keymap.foundMapping == id_InsertCarriageReturn && !groupInserts)
+    {
+        pText = "\n";
+    }
+    else if (keymap.foundMapping == id_InsertTab && !groupInserts)
+    {
+        pText = GetCurrentWindow()->GetBuffer().HasFileFlags(FileFlags::InsertTabs) ? "\t" : "    ";
+    }
+    else if (keymap.foundMapping.id != 0 || input.size() != 1)
+    {
+        return false;
+    }
+
+    if (GetEditor().GetPendingInputMode() != this)
+    {
+        GetEditor().FlushInput();
+        GetEditor().SetPendingInputMode(this);
+    }
+    m_pendingInsert += pText;
+    m_dotCommand += input;
+    m_lastCommandName = "(text)";
+    return true;
+}
+
+// As the keys would have done one at a time: one insert at the cursor, in the current undo group
+void ZepMode::FlushPendingInsert()
+{
+    if (m_pendingInsert.empty() || m_pCurrentWindow == nullptr)
+    {
+        m_pendingInsert.clear();
+        return;
+    }
+
+    std::string text;
+    text.swap(m_pendingInsert);
+
+    GetEditor().ResetLastEditTimer();
+    GetEditor().ResetCursorTimer();
+    GetEditor().SetCommandText("");
+
+    auto cursor = GetCurrentWindow()->GetBufferCursor();
+    AddCommand(std::make_shared<ZepCommand_Insert>(GetCurrentWindow()->GetBuffer(), cursor, text, cursor));
+    ClampCursorForMode();
+}
+
 void ZepMode::HandleMappedInput(const std::string& input)
 {
     if (input.empty())
@@ -429,6 +529,14 @@ void ZepMode::HandleMappedInput(const std::string& input)
     }
 
     spContext->foundCommand = GetCommand(*spContext);
+    if (spContext->foundCommand && spContext->keymap.foundMapping.id != 0)
+    {
+        m_lastCommandName = spContext->keymap.foundMapping.ToString();
+    }
+    else
+    {
+        m_lastCommandName = spContext->foundCommand ? "(text)" : spContext->keymap.needMoreChars ? "(pending)" : "(unmapped)";
+    }
 
     // A lambda to check for a pending mode switch after the command
     auto enteringMode = [=](auto mode) {
@@ -1128,6 +1236,15 @@ bool ZepMode::GetCommand(CommandContext& context)
         GetCurrentWindow()->SetBufferCursor(ByteIndex{ 0 });
         return true;
     }
+    else if (mappedCommand == id_MotionMatchingBracket)
+    {
+        auto target = context.buffer.FindMatchingBracket(bufferCursor);
+        if (target != InvalidByteIndex)
+        {
+            GetCurrentWindow()->SetBufferCursor(target);
+        }
+        return true;
+    }
     else if (mappedCommand == id_JoinLines)
     {
         // Delete the CR (and thus join lines)
@@ -1885,15 +2002,16 @@ bool ZepMode::HandleExCommand(std::string strCommand)
             return false;
         }
 
-        if (GetEditor().Broadcast(std::make_shared<ZepMessage>(Msg::HandleCommand, strCommand)))
+        if (GetEditor().Broadcast(MakeMessage<ZepMessage>(Msg::HandleCommand, strCommand)))
         {
             return true;
         }
 
-        auto pCommand = GetEditor().FindExCommand(strCommand.substr(1));
+        // Found by name, so that it can be given arguments
+        auto strTok = string_split(strCommand, " ");
+        auto pCommand = strTok.empty() ? nullptr : GetEditor().FindExCommand(strTok[0].substr(1));
         if (pCommand)
         {
-            auto strTok = string_split(strCommand, " ");
             pCommand->Run(strTok);
         }
         else if (strCommand == ":reg")
@@ -2373,6 +2491,7 @@ void ZepMode::AddNavigationKeyMaps(bool allowInVisualMode)
     AddKeyMapWithCountRegisters(navigationMaps, { "ge" }, id_MotionBackEndWord);
     AddKeyMapWithCountRegisters(navigationMaps, { "gE" }, id_MotionBackEndWORD);
     AddKeyMapWithCountRegisters(navigationMaps, { "gg" }, id_MotionGotoBeginning);
+    keymap_add(navigationMaps, { "%" }, id_MotionMatchingBracket);
 
     // Navigate between splits
     keymap_add(navigationMaps, { "<C-j>" }, id_MotionDownSplit);
@@ -2430,6 +2549,8 @@ CursorType ZepMode::GetCursorType() const
 
 void ZepMode::Begin(ZepWindow* pWindow)
 {
+    GetEditor().FlushInput();
+
     timer_restart(m_lastKeyPressTimer);
 
     m_pCurrentWindow = pWindow;
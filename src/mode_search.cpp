@@ -1,5 +1,6 @@
 #include "zep/mode_search.h"
 #include "zep/filesystem.h"
+#include "zep/regress.h"
 #include "zep/tab_window.h"
 #include "zep/window.h"
 
@@ -22,6 +23,7 @@ ZepMode_Search::ZepMode_Search(ZepEditor& editor, ZepWindow& launchWindow, ZepWi
 ZepMode_Search::~ZepMode_Search()
 {
     // Ensure threads have finished
+    m_cancelIndex.cancel();
     if (m_indexResult.valid())
     {
         m_indexResult.wait();
@@ -35,7 +37,7 @@ ZepMode_Search::~ZepMode_Search()
 
 void ZepMode_Search::AddKeyPress(uint32_t key, uint32_t modifiers)
 {
-    (void)modifiers;
+    GetEditor().GetWorkloadRecorder().KeyPressed(key, modifiers, timer_get_time_now());
     if (key == ExtKeys::ESCAPE)
     {
         // CM TODO:
@@ -128,45 +130,36 @@ void ZepMode_Search::Begin(ZepWindow* pWindow)
     m_searchTerm = "";
     GetEditor().SetCommandText(">>> ");
 
-    m_indexResult = Indexer::IndexPaths(GetEditor(), m_startPath);
+    m_indexResult = Indexer::IndexPaths(GetEditor(), m_startPath, this, [this]() {
+        OnIndexReady();
+    },
+        m_cancelIndex);
     m_window.GetBuffer().SetText(std::string("Indexing: ") + m_startPath.string());
 
     fileSearchActive = true;
 }
 
-void ZepMode_Search::Notify(std::shared_ptr<ZepMessage> message)
+void ZepMode_Search::OnIndexReady()
 {
-    ZepMode::Notify(message);
-    if (message->messageId == Msg::Tick)
+    if (!fileSearchActive)
     {
-        if (fileSearchActive)
-        {
-            if (!is_future_ready(m_indexResult))
-            {
-                return;
-            }
-    
-            fileSearchActive = false;
+        return;
+    }
 
-            m_spFilePaths = m_indexResult.get();
-            if (!m_spFilePaths->errors.empty())
-            {
-                GetEditor().SetCommandText(m_spFilePaths->errors);
-                return;
-            }
+    fileSearchActive = false;
 
-            InitSearchTree();
-            ShowTreeResult();
-            UpdateTree();
+    m_spFilePaths = m_indexResult.get();
+    if (!m_spFilePaths->errors.empty())
+    {
+        GetEditor().SetCommandText(m_spFilePaths->errors);
+        return;
+    }
 
-            GetEditor().RequestRefresh();
-        }
+    InitSearchTree();
+    ShowTreeResult();
+    UpdateTree();
 
-        if (treeSearchActive)
-        {
-            UpdateTree();
-        }
-    }
+    GetEditor().RequestRefresh();
 }
 
 void ZepMode_Search::InitSearchTree()
@@ -180,6 +173,51 @@ void ZepMode_Search::InitSearchTree()
     m_indexTree.push_back(pInitSet);
 }
 
+std::shared_ptr<ZepMode_Search::IndexSet> ZepMode_Search::FilterIndexSet(const IndexSet& startSet, const FileIndexResult& files, char startChar, bool caseImportant)
+{
+    auto spResult = std::make_shared<IndexSet>();
+    for (auto& searchPair : startSet.indices)
+    {
+        auto index = searchPair.second.index;
+        auto loc = searchPair.second.location;
+        auto dist = searchPair.first;
+
+        size_t pos = 0;
+        if (caseImportant)
+        {
+            auto str = files.paths[index].string();
+            pos = str.find_first_of(startChar, loc);
+        }
+        else
+        {
+            auto& str = files.lowerPaths[index];
+            pos = str.find_first_of(startChar, loc);
+        }
+
+        if (pos != std::string::npos)
+        {
+            // this approach 'clumps things together'
+            // It rewards more for strings of subsequent characters
+            uint32_t newDist = ((uint32_t)pos - loc);
+            if (dist == 0)
+            {
+                newDist = 1;
+            }
+            else if (newDist == 1)
+            {
+                newDist = dist;
+            }
+            else
+            {
+                newDist = dist + 1;
+            }
+
+            spResult->indices.insert(std::make_pair(newDist, SearchResult{ index, (uint32_t)pos }));
+        }
+    }
+    return spResult;
+}
+
 void ZepMode_Search::ShowTreeResult()
 {
     std::ostringstream str;
@@ -283,50 +321,20 @@ void ZepMode_Search::UpdateTree()
         char startChar = m_searchTerm[m_indexTree.size() - 1];
 
         // Search for a match at the next level of the search tree
-        m_searchResult = GetEditor().GetThreadPool().enqueue([&](std::shared_ptr<IndexSet> spStartSet, const char startChar) {
-            auto spResult = std::make_shared<IndexSet>();
-            for (auto& searchPair : spStartSet->indices)
-            {
-                auto index = searchPair.second.index;
-                auto loc = searchPair.second.location;
-                auto dist = searchPair.first;
+        // Typing may collect this result before the worker's message arrives, and start the next search
+        auto searchId = ++m_searchId;
+        m_searchResult = GetEditor().GetThreadPool().enqueue_task(TaskPriority::Interactive, "SearchFiles", [this, spStartSet, startChar, searchId]() {
+            auto spResult = FilterIndexSet(*spStartSet, *m_spFilePaths, startChar, m_caseImportant);
 
-                size_t pos = 0;
-                if (m_caseImportant)
+            GetEditor().GetScheduler().Post(this, [this, searchId]() {
+                if (treeSearchActive && searchId == m_searchId)
                 {
-                    auto str = m_spFilePaths->paths[index].string();
-                    pos = str.find_first_of(startChar, loc);
+                    m_searchResult.wait();
+                    UpdateTree();
                 }
-                else
-                {
-                    auto str = m_spFilePaths->lowerPaths[index];
-                    pos = str.find_first_of(startChar, loc);
-                }
-
-                if (pos != std::string::npos)
-                {
-                    // this approach 'clumps things together'
-                    // It rewards more for strings of subsequent characters
-                    uint32_t newDist = ((uint32_t)pos - loc);
-                    if (dist == 0)
-                    {
-                        newDist = 1;
-                    }
-                    else if (newDist == 1)
-                    {
-                        newDist = dist;
-                    }
-                    else
-                    {
-                        newDist = dist + 1;
-                    }
-
-                    spResult->indices.insert(std::make_pair(newDist, SearchResult{ index, (uint32_t)pos }));
-                }
-            }
+            });
             return spResult;
-        },
-            spStartSet, startChar);
+        });
 
         treeSearchActive = true;
     }
@@ -1,8 +1,16 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
 #include <iterator>
 #include <random>
+#include <thread>
 
+#include "zep/buffer.h"
 #include "zep/editor.h"
 #include "zep/mcommon/animation/timer.h"
+#include "zep/mode.h"
 #include "zep/regress.h"
 #include "zep/tab_window.h"
 #include "zep/window.h"
@@ -18,18 +26,9 @@ Iter select_randomly(Iter start, Iter end, RandomGenerator& g)
     return start;
 }
 
-template <typename Iter>
-Iter select_randomly(Iter start, Iter end)
-{
-    static std::random_device rd;
-    static std::mt19937 gen(rd());
-    return select_randomly(start, end, gen);
-}
-
 ZepRegressExCommand::ZepRegressExCommand(ZepEditor& editor)
     : ZepExCommand(editor)
 {
-    timer_start(m_timer);
 }
 
 void ZepRegressExCommand::Register(ZepEditor& editor)
@@ -44,24 +43,20 @@ const char* ZepRegressExCommand::ExCommandName() const
 
 void ZepRegressExCommand::Run(const std::vector<std::string>& tokens)
 {
-    ZEP_UNUSED(tokens);
     m_enable = !m_enable;
     if (m_enable)
     {
-        GetEditor().RegisterCallback(this);
+        // The same seed does the same things, given the same starting layout
+        m_random.seed(tokens.size() > 1 ? uint32_t(strtoul(tokens[1].c_str(), nullptr, 10)) : std::mt19937::default_seed);
         m_windowOperationCount = 150;
+        m_tickSchedule = GetEditor().GetScheduler().AddTimer(this, 0.05, [this]() {
+            Tick();
+        },
+            0.05);
     }
     else
     {
-        GetEditor().UnRegisterCallback(this);
-    }
-}
-
-void ZepRegressExCommand::Notify(std::shared_ptr<ZepMessage> message)
-{
-    if (message->messageId == Msg::Tick)
-    {
-        Tick();
+        GetEditor().GetScheduler().Cancel(m_tickSchedule);
     }
 }
 
@@ -73,23 +68,17 @@ void ZepRegressExCommand::Tick()
         return;
     }
 
-    auto seconds = timer_get_elapsed_seconds(m_timer);
-    if (seconds < .05f)
-    {
-        return;
-    }
-    
     m_windowOperationCount--;
     if (m_windowOperationCount == 0)
     {
         m_enable = false;
+        GetEditor().GetScheduler().Cancel(m_tickSchedule);
     }
 
-    timer_restart(m_timer);
-
-    float fRand1 = rand() / (float)RAND_MAX;
-    float fRand2 = rand() / (float)RAND_MAX;
-    float fRand3 = rand() / (float)RAND_MAX;
+    std::uniform_real_distribution<float> dis(0.0f, 1.0f);
+    float fRand1 = dis(m_random);
+    float fRand2 = dis(m_random);
+    float fRand3 = dis(m_random);
 
     auto& tabWindows = GetEditor().GetTabWindows();
     auto& buffer = GetEditor().GetActiveTabWindow()->GetActiveWindow()->GetBuffer();
@@ -104,7 +93,7 @@ void ZepRegressExCommand::Tick()
     {
         if (tabWindows.size() > 1)
         {
-            GetEditor().RemoveTabWindow(*select_randomly(tabWindows.begin(), tabWindows.end()));
+            GetEditor().RemoveTabWindow(*select_randomly(tabWindows.begin(), tabWindows.end(), m_random));
         }
     }
 
@@ -114,13 +103,421 @@ void ZepRegressExCommand::Tick()
 
     if (fRand1 > .5f && windows.size() > 1)
     {
-        pTab->RemoveWindow(*select_randomly(windows.begin(), windows.end()));
+        pTab->RemoveWindow(*select_randomly(windows.begin(), windows.end(), m_random));
     }
     else if (windows.size() < 10)
     {
-        pTab->AddWindow(&pActiveWindow->GetBuffer(), *select_randomly(windows.begin(), windows.end()), fRand2 > .5f ? RegionLayoutType::HBox : RegionLayoutType::VBox);
+        pTab->AddWindow(&pActiveWindow->GetBuffer(), *select_randomly(windows.begin(), windows.end(), m_random), fRand2 > .5f ? RegionLayoutType::HBox : RegionLayoutType::VBox);
     }
     GetEditor().RequestRefresh();
 }
 
+namespace
+{
+
+const char TraceMagic[4] = { 'Z', 'E', 'P', 'W' };
+const uint8_t TraceVersion = 1;
+
+void WriteTraceNumber(std::ostream& str, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        str.put(char(uint8_t(value) | 0x80));
+        value >>= 7;
+    }
+    str.put(char(value));
+}
+
+bool ReadTraceNumber(std::istream& str, uint64_t& value)
+{
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        auto c = str.get();
+        if (c == std::char_traits<char>::eof())
+        {
+            return false;
+        }
+        value |= uint64_t(c & 0x7F) << shift;
+        if ((c & 0x80) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Pixels may be off the window, so they are signed; small either way
+void WriteTracePixel(std::ostream& str, float value)
+{
+    auto pixel = int64_t(std::lround(value));
+    WriteTraceNumber(str, (uint64_t(pixel) << 1) ^ uint64_t(pixel >> 63));
+}
+
+bool ReadTracePixel(std::istream& str, float& value)
+{
+    uint64_t number;
+    if (!ReadTraceNumber(str, number))
+    {
+        return false;
+    }
+    value = float(int64_t(number >> 1) ^ -int64_t(number & 1));
+    return true;
+}
+
+void WriteTraceString(std::ostream& str, const std::string& value)
+{
+    WriteTraceNumber(str, value.size());
+    str.write(value.data(), value.size());
+}
+
+// The bytes left in the stream, or -1 if it can't seek
+int64_t RemainingTraceBytes(std::istream& str)
+{
+    auto pos = str.tellg();
+    if (pos == std::streampos(-1) || !str.seekg(0, std::ios::end))
+    {
+        str.clear();
+        return -1;
+    }
+    auto end = str.tellg();
+    str.seekg(pos);
+    return int64_t(end - pos);
+}
+
+// The size comes from the file, so it is checked against what is left before anything is allocated for it; a
+// stream that can't say is read a block at a time
+bool ReadTraceString(std::istream& str, std::string& value)
+{
+    uint64_t size;
+    if (!ReadTraceNumber(str, size))
+    {
+        return false;
+    }
+
+    auto remaining = RemainingTraceBytes(str);
+    if (remaining >= 0 && size > uint64_t(remaining))
+    {
+        return false;
+    }
+
+    const uint64_t BlockSize = 64 * 1024;
+    value.clear();
+    while (value.size() < size)
+    {
+        auto offset = value.size();
+        auto count = remaining >= 0 ? size : std::min(size - offset, BlockSize);
+        value.resize(offset + size_t(count));
+        if (!str.read(&value[offset], std::streamsize(count)))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+void WriteWorkloadTrace(std::ostream& str, const WorkloadTrace& trace)
+{
+    str.write(TraceMagic, sizeof(TraceMagic));
+    str.put(char(TraceVersion));
+    WriteTraceString(str, trace.bufferName);
+    WriteTraceString(str, trace.text);
+    WriteTraceNumber(str, trace.events.size());
+
+    uint64_t lastUs = 0;
+    for (auto& ev : trace.events)
+    {
+        str.put(char(ev.type));
+        WriteTraceNumber(str, ev.timeUs - lastUs);
+        lastUs = ev.timeUs;
+
+        switch (ev.type)
+        {
+        case WorkloadEventType::Key:
+            WriteTraceNumber(str, ev.key);
+            WriteTraceNumber(str, ev.modifiers);
+            break;
+        case WorkloadEventType::MouseDown:
+        case WorkloadEventType::MouseUp:
+            str.put(char(ev.button));
+            // Fall through
+        case WorkloadEventType::MouseMove:
+            WriteTracePixel(str, ev.pos.x);
+            WriteTracePixel(str, ev.pos.y);
+            break;
+        case WorkloadEventType::Resize:
+            WriteTracePixel(str, ev.pos.x);
+            WriteTracePixel(str, ev.pos.y);
+            WriteTracePixel(str, ev.size.x);
+            WriteTracePixel(str, ev.size.y);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+bool ReadWorkloadTrace(std::istream& str, WorkloadTrace& trace)
+{
+    char magic[sizeof(TraceMagic)];
+    if (!str.read(magic, sizeof(magic)) || !std::equal(magic, magic + sizeof(magic), TraceMagic) || str.get() != TraceVersion)
+    {
+        return false;
+    }
+
+    uint64_t count;
+    if (!ReadTraceString(str, trace.bufferName) || !ReadTraceString(str, trace.text) || !ReadTraceNumber(str, count))
+    {
+        return false;
+    }
+
+    trace.events.clear();
+    uint64_t lastUs = 0;
+    for (uint64_t index = 0; index < count; index++)
+    {
+        WorkloadEvent ev;
+        auto type = str.get();
+        uint64_t deltaUs;
+        if (type < 0 || type >= int(WorkloadEventType::Count) || !ReadTraceNumber(str, deltaUs))
+        {
+            return false;
+        }
+        ev.type = WorkloadEventType(type);
+        ev.timeUs = lastUs + deltaUs;
+        lastUs = ev.timeUs;
+
+        bool ok = true;
+        uint64_t key, modifiers;
+        switch (ev.type)
+        {
+        case WorkloadEventType::Key:
+            ok = ReadTraceNumber(str, key) && ReadTraceNumber(str, modifiers);
+            ev.key = uint32_t(key);
+            ev.modifiers = uint32_t(modifiers);
+            break;
+        case WorkloadEventType::MouseDown:
+        case WorkloadEventType::MouseUp:
+            ev.button = ZepMouseButton(str.get());
+            // Fall through
+        case WorkloadEventType::MouseMove:
+            ok = ReadTracePixel(str, ev.pos.x) && ReadTracePixel(str, ev.pos.y);
+            break;
+        case WorkloadEventType::Resize:
+            ok = ReadTracePixel(str, ev.pos.x) && ReadTracePixel(str, ev.pos.y) && ReadTracePixel(str, ev.size.x) && ReadTracePixel(str, ev.size.y);
+            break;
+        default:
+            break;
+        }
+        if (!ok)
+        {
+            return false;
+        }
+        trace.events.push_back(ev);
+    }
+    return true;
+}
+
+void ZepWorkloadRecorder::Start(const ZepBuffer& buffer, const NRectf& editorRect)
+{
+    m_trace = WorkloadTrace();
+    m_trace.bufferName = buffer.GetName();
+    m_trace.text = buffer.GetText().string();
+
+    // Without the terminator the buffer adds
+    if (!m_trace.text.empty() && m_trace.text.back() == 0)
+    {
+        m_trace.text.pop_back();
+    }
+    m_startUs = timer_get_time_now();
+    m_recording = true;
+
+    // Replays lay out at the recorded size
+    Resized(editorRect);
+}
+
+WorkloadTrace ZepWorkloadRecorder::Stop()
+{
+    m_recording = false;
+    return std::move(m_trace);
+}
+
+void ZepWorkloadRecorder::Add(WorkloadEvent& ev, uint64_t nowUs)
+{
+    ev.timeUs = nowUs > m_startUs ? nowUs - m_startUs : 0;
+    if (!m_trace.events.empty())
+    {
+        ev.timeUs = std::max(ev.timeUs, m_trace.events.back().timeUs);
+    }
+    m_trace.events.push_back(ev);
+}
+
+void ZepWorkloadRecorder::KeyPressed(uint32_t key, uint32_t modifiers, uint64_t pressedUs)
+{
+    if (!m_recording)
+    {
+        return;
+    }
+    WorkloadEvent ev;
+    ev.type = WorkloadEventType::Key;
+    ev.key = key;
+    ev.modifiers = modifiers;
+    Add(ev, pressedUs);
+}
+
+void ZepWorkloadRecorder::MouseEvent(WorkloadEventType type, const NVec2f& pos, ZepMouseButton button)
+{
+    if (!m_recording)
+    {
+        return;
+    }
+    WorkloadEvent ev;
+    ev.type = type;
+    ev.pos = pos;
+    ev.button = button;
+    Add(ev, timer_get_time_now());
+}
+
+void ZepWorkloadRecorder::Resized(const NRectf& editorRect)
+{
+    if (!m_recording)
+    {
+        return;
+    }
+    WorkloadEvent ev;
+    ev.type = WorkloadEventType::Resize;
+    ev.pos = editorRect.topLeftPx;
+    ev.size = editorRect.bottomRightPx;
+    Add(ev, timer_get_time_now());
+}
+
+void ZepWorkloadRecorder::DropExCommand()
+{
+    auto& events = m_trace.events;
+    auto itr = std::find_if(events.rbegin(), events.rend(), [](const WorkloadEvent& ev) {
+        return ev.type == WorkloadEventType::Key && ev.key == ':';
+    });
+    if (itr != events.rend())
+    {
+        events.erase(std::next(itr).base(), events.end());
+    }
+}
+
+const char* GetWorkloadEventName(WorkloadEventType type)
+{
+    switch (type)
+    {
+    case WorkloadEventType::Key:
+        return "Key";
+    case WorkloadEventType::MouseMove:
+        return "MouseMove";
+    case WorkloadEventType::MouseDown:
+        return "MouseDown";
+    case WorkloadEventType::MouseUp:
+        return "MouseUp";
+    case WorkloadEventType::Resize:
+        return "Resize";
+    default:
+        return "Unknown";
+    }
+}
+
+void ReplayWorkload(ZepEditor& editor, const WorkloadTrace& trace, WorkloadReplaySpeed speed, WorkloadReplayResult& result)
+{
+    editor.InitWithText(trace.bufferName, trace.text);
+
+    result = WorkloadReplayResult();
+    result.eventLatencyUs.reserve(trace.events.size());
+
+    auto replayStart = timer_get_time_now();
+    for (auto& ev : trace.events)
+    {
+        if (speed == WorkloadReplaySpeed::RealTime)
+        {
+            auto now = timer_get_time_now();
+            if (replayStart + ev.timeUs > now)
+            {
+                std::this_thread::sleep_for(std::chrono::microseconds(replayStart + ev.timeUs - now));
+            }
+        }
+
+        // Sent the way a host sends them
+        auto eventStart = timer_get_time_now();
+        switch (ev.type)
+        {
+        case WorkloadEventType::Key:
+            if (editor.GetActiveTabWindow() && editor.GetActiveTabWindow()->GetActiveWindow())
+            {
+                editor.GetActiveTabWindow()->GetActiveWindow()->GetBuffer().GetMode()->AddKeyPress(ev.key, ev.modifiers);
+            }
+            break;
+        case WorkloadEventType::MouseMove:
+            editor.OnMouseMove(ev.pos);
+            break;
+        case WorkloadEventType::MouseDown:
+            editor.OnMouseDown(ev.pos, ev.button);
+            break;
+        case WorkloadEventType::MouseUp:
+            editor.OnMouseUp(ev.pos, ev.button);
+            break;
+        case WorkloadEventType::Resize:
+            editor.SetDisplayRegion(ev.pos, ev.size);
+            break;
+        default:
+            break;
+        }
+
+        editor.RefreshRequired();
+        editor.Display();
+
+        auto latency = timer_get_time_now() - eventStart;
+        result.eventLatencyUs.push_back(latency);
+        result.latency[size_t(ev.type)].Add(latency);
+    }
+    result.totalUs = timer_get_time_now() - replayStart;
+}
+
+ZepRecordExCommand::ZepRecordExCommand(ZepEditor& editor)
+    : ZepExCommand(editor)
+{
+}
+
+void ZepRecordExCommand::Register(ZepEditor& editor)
+{
+    editor.RegisterExCommand(std::make_shared<ZepRecordExCommand>(editor));
+}
+
+const char* ZepRecordExCommand::ExCommandName() const
+{
+    return "ZRecord";
+}
+
+void ZepRecordExCommand::Run(const std::vector<std::string>& tokens)
+{
+    auto& recorder = GetEditor().GetWorkloadRecorder();
+    if (recorder.IsRecording())
+    {
+        // Typing this command isn't part of the session
+        recorder.DropExCommand();
+        auto trace = recorder.Stop();
+
+        std::ofstream out(m_path, std::ios::out | std::ios::binary);
+        WriteWorkloadTrace(out, trace);
+        GetEditor().SetCommandText(out ? "Recorded " + std::to_string(trace.events.size()) + " events to " + m_path : "Failed to write " + m_path);
+        return;
+    }
+
+    auto pTabWindow = GetEditor().GetActiveTabWindow();
+    if (tokens.size() < 2 || pTabWindow == nullptr || pTabWindow->GetActiveWindow() == nullptr)
+    {
+        GetEditor().SetCommandText("Usage: ZRecord <file>");
+        return;
+    }
+
+    m_path = tokens[1];
+    recorder.Start(pTabWindow->GetActiveWindow()->GetBuffer(), GetEditor().GetDisplayRegion());
+    GetEditor().SetCommandText("Recording to " + m_path + "; ZRecord again to stop");
+}
+
 } // namespace Zep
@@ -0,0 +1,133 @@
+#include "zep/scheduler.h"
+
+#include "zep/mcommon/animation/timer.h"
+
+#include <algorithm>
+
+namespace Zep
+{
+
+ScheduleId ZepScheduler::Add(const void* pOwner, uint64_t time, uint64_t repeat, std::function<void()> fnCallback)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto itr = std::upper_bound(m_entries.begin(), m_entries.end(), time, [](uint64_t value, const ScheduleEntry& entry) {
+        return value < entry.time;
+    });
+
+    auto id = m_nextId++;
+    m_entries.insert(itr, ScheduleEntry{ id, pOwner, time, repeat, std::move(fnCallback) });
+    return id;
+}
+
+ScheduleId ZepScheduler::AddDeadline(const void* pOwner, uint64_t time, std::function<void()> fnCallback)
+{
+    return Add(pOwner, time, 0, std::move(fnCallback));
+}
+
+ScheduleId ZepScheduler::AddTimer(const void* pOwner, double seconds, std::function<void()> fnCallback, double repeatSeconds)
+{
+    auto repeat = repeatSeconds > 0.0 ? std::max(uint64_t(1), uint64_t(repeatSeconds * 1000000.0)) : 0;
+    return Add(pOwner, timer_get_time_now() + uint64_t(std::max(0.0, seconds) * 1000000.0), repeat, std::move(fnCallback));
+}
+
+ScheduleId ZepScheduler::Post(const void* pOwner, std::function<void()> fnCallback)
+{
+    auto id = Add(pOwner, 0, 0, std::move(fnCallback));
+    Wake();
+    return id;
+}
+
+void ZepScheduler::Cancel(ScheduleId id)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_entries.erase(std::remove_if(m_entries.begin(), m_entries.end(), [id](const ScheduleEntry& entry) {
+        return entry.id == id;
+    }),
+        m_entries.end());
+}
+
+void ZepScheduler::Cancel(const void* pOwner)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_entries.erase(std::remove_if(m_entries.begin(), m_entries.end(), [pOwner](const ScheduleEntry& entry) {
+        return entry.pOwner == pOwner;
+    }),
+        m_entries.end());
+}
+
+void ZepScheduler::Wake()
+{
+    std::function<void()> fnWake;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        fnWake = m_fnWake;
+    }
+
+    if (fnWake)
+    {
+        fnWake();
+    }
+}
+
+void ZepScheduler::SetWakeCallback(std::function<void()> fnWake)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_fnWake = std::move(fnWake);
+}
+
+bool ZepScheduler::Update(uint64_t now)
+{
+    // Work added by the callbacks waits for the next update, so a callback which posts itself can't spin here
+    ScheduleId lastId;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        lastId = m_nextId;
+    }
+
+    bool ran = false;
+    for (;;)
+    {
+        std::function<void()> fnCallback;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto itr = std::find_if(m_entries.begin(), m_entries.end(), [&](const ScheduleEntry& entry) {
+                return entry.time > now || entry.id < lastId;
+            });
+            if (itr == m_entries.end() || itr->time > now)
+            {
+                break;
+            }
+
+            auto entry = std::move(*itr);
+            m_entries.erase(itr);
+
+            // A repeating entry goes back in before it runs, so that it can cancel itself
+            if (entry.repeat != 0)
+            {
+                fnCallback = entry.fnCallback;
+                auto time = now + entry.repeat;
+                auto itrInsert = std::upper_bound(m_entries.begin(), m_entries.end(), time, [](uint64_t value, const ScheduleEntry& rhs) {
+                    return value < rhs.time;
+                });
+                entry.time = time;
+                m_entries.insert(itrInsert, std::move(entry));
+            }
+            else
+            {
+                fnCallback = std::move(entry.fnCallback);
+            }
+        }
+
+        fnCallback();
+        ran = true;
+    }
+    return ran;
+}
+
+uint64_t ZepScheduler::GetNextDeadline() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_entries.empty() ? NoDeadline : m_entries.front().time;
+}
+
+} // namespace Zep
@@ -38,6 +38,10 @@ Scroller::Scroller(ZepEditor& editor, Region& parent)
     m_region->children.push_back(m_mainRegion);
     m_region->children.push_back(m_bottomButtonRegion);
 
+    editor.Subscribe(this, Msg::MouseDown);
+    editor.Subscribe(this, Msg::MouseUp);
+    editor.Subscribe(this, Msg::MouseMove);
+
     parent.children.push_back(m_region);
 }
 
@@ -45,6 +49,7 @@ void Scroller::CheckState()
 {
     if (m_scrollState == ScrollState::None)
     {
+        GetEditor().GetScheduler().Cancel(m_repeatSchedule);
         return;
     }
 
@@ -75,11 +80,24 @@ void Scroller::CheckState()
     GetEditor().RequestRefresh();
 }
 
+// Holding the mouse on a button or the page area scrolls again after a delay, and then at the frame rate
+void Scroller::StartRepeat()
+{
+    timer_start(m_start_delay_timer);
+
+    auto& scheduler = GetEditor().GetScheduler();
+    scheduler.Cancel(m_repeatSchedule);
+    m_repeatSchedule = scheduler.AddTimer(this, 0.5, [this]() {
+        CheckState();
+    },
+        1.0 / 60.0);
+}
+
 void Scroller::ClickUp()
 {
     vScrollPosition -= vScrollLinePercent;
     vScrollPosition = std::max(0.0f, vScrollPosition);
-    GetEditor().Broadcast(std::make_shared<ZepMessage>(Msg::ComponentChanged, this));
+    GetEditor().Broadcast(MakeMessage<ZepMessage>(Msg::ComponentChanged, this));
     m_scrollState = ScrollState::ScrollUp;
 }
 
@@ -87,7 +105,7 @@ void Scroller::ClickDown()
 {
     vScrollPosition += vScrollLinePercent;
     vScrollPosition = std::min(1.0f - vScrollVisiblePercent, vScrollPosition);
-    GetEditor().Broadcast(std::make_shared<ZepMessage>(Msg::ComponentChanged, this));
+    GetEditor().Broadcast(MakeMessage<ZepMessage>(Msg::ComponentChanged, this));
     m_scrollState = ScrollState::ScrollDown;
 }
 
@@ -95,7 +113,7 @@ void Scroller::PageUp()
 {
     vScrollPosition -= vScrollPagePercent;
     vScrollPosition = std::max(0.0f, vScrollPosition);
-    GetEditor().Broadcast(std::make_shared<ZepMessage>(Msg::ComponentChanged, this));
+    GetEditor().Broadcast(MakeMessage<ZepMessage>(Msg::ComponentChanged, this));
     m_scrollState = ScrollState::PageUp;
 }
 
@@ -103,7 +121,7 @@ void Scroller::PageDown()
 {
     vScrollPosition += vScrollPagePercent;
     vScrollPosition = std::min(1.0f - vScrollVisiblePercent, vScrollPosition);
-    GetEditor().Broadcast(std::make_shared<ZepMessage>(Msg::ComponentChanged, this));
+    GetEditor().Broadcast(MakeMessage<ZepMessage>(Msg::ComponentChanged, this));
     m_scrollState = ScrollState::PageDown;
 }
 
@@ -118,7 +136,7 @@ void Scroller::DoMove(NVec2f pos)
         vScrollPosition = m_mouseDownPercent + (percentPerPixel * dist);
         vScrollPosition = std::min(1.0f - vScrollVisiblePercent, vScrollPosition);
         vScrollPosition = std::max(0.0f, vScrollPosition);
-        GetEditor().Broadcast(std::make_shared<ZepMessage>(Msg::ComponentChanged, this));
+        GetEditor().Broadcast(MakeMessage<ZepMessage>(Msg::ComponentChanged, this));
     }
 }
 
@@ -142,25 +160,19 @@ void Scroller::Notify(std::shared_ptr<ZepMessage> message)
 {
     switch (message->messageId)
     {
-        case Msg::Tick:
-        {
-            CheckState();
-        }
-        break;
-
         case Msg::MouseDown:
             if (message->button == ZepMouseButton::Left)
             {
                 if (m_bottomButtonRegion->rect.Contains(message->pos))
                 {
                     ClickDown();
-                    timer_start(m_start_delay_timer);
+                    StartRepeat();
                     message->handled = true;
                 }
                 else if (m_topButtonRegion->rect.Contains(message->pos))
                 {
                     ClickUp();
-                    timer_start(m_start_delay_timer);
+                    StartRepeat();
                     message->handled = true;
                 }
                 else if (m_mainRegion->rect.Contains(message->pos))
@@ -176,13 +188,13 @@ void Scroller::Notify(std::shared_ptr<ZepMessage> message)
                     else if (message->pos.y > thumbRect.BottomLeft().y)
                     {
                         PageDown();
-                        timer_start(m_start_delay_timer);
+                        StartRepeat();
                         message->handled = true;
                     }
                     else if (message->pos.y < thumbRect.TopRight().y)
                     {
                         PageUp();
-                        timer_start(m_start_delay_timer);
+                        StartRepeat();
                         message->handled = true;
                     }
                 }
@@ -191,6 +203,7 @@ void Scroller::Notify(std::shared_ptr<ZepMessage> message)
         case Msg::MouseUp:
         {
             m_scrollState = ScrollState::None;
+            GetEditor().GetScheduler().Cancel(m_repeatSchedule);
         }
         break;
         case Msg::MouseMove:
@@ -21,25 +21,31 @@ ZepSyntax::ZepSyntax(
     , m_buffer(buffer)
     , m_keywords(keywords)
     , m_identifiers(identifiers)
-    , m_stop(false)
     , m_flags(flags)
 {
+    GetEditor().Subscribe(this, Msg::Buffer, &m_buffer);
+
     m_syntax.resize(m_buffer.GetText().size());
     m_adornments.push_back(std::make_shared<ZepSyntaxAdorn_RainbowBrackets>(*this, m_buffer));
 }
 
 ZepSyntax::~ZepSyntax()
 {
+    // Jobs reference this object, so the only place we wait for them is on the way out
     Interrupt();
+    for (auto& result : m_cancelledResults)
+    {
+        result.wait();
+    }
 }
 
 SyntaxResult ZepSyntax::GetSyntaxAt(long offset) const
 {
     Zep::SyntaxResult result;
 
-    Wait();
-
-    if (m_processedChar < offset || (long)m_syntax.size() <= offset)
+    // Never wait for the worker here; until its result arrives we show the existing syntax, which
+    // has already been shifted to match the edit
+    if ((long)m_syntax.size() <= offset)
     {
         return result;
     }
@@ -64,53 +70,101 @@ SyntaxResult ZepSyntax::GetSyntaxAt(long offset) const
         auto elapsed = timer_get_elapsed_seconds(m_flashTimer);
         if (elapsed < m_flashDuration)
         {
-            // first get the preferred back color
-            NVec4f backColor;
-            if (result.background != ThemeColor::None)
-            {
-                backColor = GetEditor().GetTheme().GetColor(result.background);
-            }
-            else
-            {
-                backColor = GetEditor().GetTheme().GetColor(ThemeColor::Background);
-            }
+            ApplyFlash(offset, float(elapsed) / m_flashDuration, result);
+        }
+        else
+        {
+            EndFlash();
+        }
+    }
+    return result;
+}
+
+void ZepSyntax::ApplyFlash(long offset, float time, SyntaxResult& result) const
+{
+    // first get the preferred back color
+    NVec4f backColor;
+    if (result.background != ThemeColor::None)
+    {
+        backColor = GetEditor().GetTheme().GetColor(result.background);
+    }
+    else
+    {
+        backColor = GetEditor().GetTheme().GetColor(ThemeColor::Background);
+    }
 
-            // Swap it out for our custom flash color
-            float time = float(elapsed) / m_flashDuration;
+    // Swap it out for our custom flash color
+    result.background = ThemeColor::Custom;
+    result.customBackgroundColor = NVec4f(GetEditor().GetTheme().GetColor(ThemeColor::FlashColor));
 
-            result.background = ThemeColor::Custom;
-            result.customBackgroundColor = NVec4f(GetEditor().GetTheme().GetColor(ThemeColor::FlashColor));
+    if (m_flashType == SyntaxFlashType::Flash)
+    {
+        result.customBackgroundColor = Mix(backColor, result.customBackgroundColor, sin(time * ZPI));
+    }
+    else
+    {
+        float t = std::abs(sin(time * ZPI * .5f)) * 2.0f + .5f;
+        if (t > 1.0f)
+        {
+            t = 1.0f - (t - 1.0f);
+        }
 
-            if (m_flashType == SyntaxFlashType::Flash)
-            {
-                result.customBackgroundColor = Mix(backColor, result.customBackgroundColor, sin(time * ZPI));
-            }
-            else
-            {
-                float t = std::abs(sin(time * ZPI * .5f)) * 2.0f + .5f;
-                if (t > 1.0f)
-                {
-                    t = 1.0f - (t - 1.0f);
-                }
+        // https://codegolf.stackexchange.com/a/22629
+        // Light up the characters with a bright spot in the center, and a
+        // ten character fall off; walk through the text and return
+        auto bellCurve = [](float x) {
+            float b = 0.0f;
+            float c = 6.0f;
+            return std::exp((-((x - b) * (x - b)) / 2) * (c * c));
+        };
 
-                // https://codegolf.stackexchange.com/a/22629
-                // Light up the characters with a bright spot in the center, and a
-                // ten character fall off; walk through the text and return
-                auto bellCurve = [](float x) {
-                    float b = 0.0f;
-                    float c = 6.0f;
-                    return std::exp((-((x - b) * (x - b)) / 2) * (c * c));
-                };
+        auto range = m_flashRange.y - m_flashRange.x;
+        auto center = range * t;
 
-                auto range = m_flashRange.y - m_flashRange.x;
-                auto center = range * t;
+        // Sample a bell curve about the current point, but don't draw the head
+        auto distance = bellCurve(((offset - center) / range));
 
-                // Sample a bell curve about the current point, but don't draw the head
-                auto distance = bellCurve(((offset - center) / range));
+        distance = std::min(1.0f, distance);
+        distance = std::max(0.0f, distance);
+        result.customBackgroundColor = Mix(backColor, result.customBackgroundColor, float(distance));
+    }
+}
 
-                distance = std::min(1.0f, distance);
-                distance = std::max(0.0f, distance);
-                result.customBackgroundColor = Mix(backColor, result.customBackgroundColor, float(distance));
+// Fill in the syntax for a range in one go; adornments and the flash are applied to the whole range at once
+void ZepSyntax::GetSyntaxRange(ByteIndex start, ByteIndex end, std::vector<SyntaxResult>& results) const
+{
+    end = std::min(end, ByteIndex(m_syntax.size()));
+    results.resize(std::max(0l, long(end - start)));
+    if (results.empty())
+    {
+        return;
+    }
+
+    for (auto offset = start; offset < end; offset++)
+    {
+        auto& result = results[offset - start];
+        result = SyntaxResult{};
+        result.background = m_syntax[offset].background;
+        result.foreground = m_syntax[offset].foreground;
+        result.underline = m_syntax[offset].underline;
+    }
+
+    // Walk the adornments backwards, so that the first one to claim a location wins, as in GetSyntaxAt
+    for (auto itr = m_adornments.rbegin(); itr != m_adornments.rend(); itr++)
+    {
+        (*itr)->GetSyntaxRange(start, end, &results[0]);
+    }
+
+    if (m_flashRange.x != m_flashRange.y && m_flashRange.x < end && m_flashRange.y >= start)
+    {
+        auto elapsed = timer_get_elapsed_seconds(m_flashTimer);
+        if (elapsed < m_flashDuration)
+        {
+            auto time = float(elapsed) / m_flashDuration;
+            auto flashEnd = std::min(end, ByteIndex(m_flashRange.y + 1));
+            for (auto offset = std::max(start, ByteIndex(m_flashRange.x)); offset < flashEnd; offset++)
+            {
+                ApplyFlash(offset, time, results[offset - start]);
             }
         }
         else
@@ -118,32 +172,83 @@ SyntaxResult ZepSyntax::GetSyntaxAt(long offset) const
             EndFlash();
         }
     }
-    return result;
 }
 
-void ZepSyntax::Wait() const
+// Return runs of resolved colors for the range, for drawing
+void ZepSyntax::GetSyntaxSpans(ByteIndex start, ByteIndex end, std::vector<SyntaxSpan>& spans) const
 {
-    if (m_syntaxResult.valid())
+    spans.clear();
+
+    GetSyntaxRange(start, end, m_rangeResults);
+
+    const SyntaxResult* pLast = nullptr;
+    for (long index = 0; index < long(m_rangeResults.size()); index++)
+    {
+        auto& result = m_rangeResults[index];
+
+        // Extend the current run if nothing visible changed
+        if (pLast && pLast->foreground == result.foreground && pLast->background == result.background && pLast->underline == result.underline && result.foreground != ThemeColor::Custom && result.background != ThemeColor::Custom)
+        {
+            spans.back().end++;
+            continue;
+        }
+
+        SyntaxSpan span;
+        span.start = start + index;
+        span.end = span.start + 1;
+        span.hasForeground = result.foreground != ThemeColor::None;
+        span.hasBackground = result.background != ThemeColor::None;
+        span.underline = result.underline;
+        if (span.hasForeground)
+        {
+            span.foreground = ToForegroundColor(result);
+        }
+        if (span.hasBackground)
+        {
+            span.background = ToBackgroundColor(result);
+        }
+        spans.push_back(span);
+        pLast = &result;
+    }
+}
+
+// Applying a result may queue the next window, so wait until there are none left
+void ZepSyntax::Wait()
+{
+    while (m_syntaxResult.valid())
     {
         m_syntaxResult.wait();
+        ApplySyntaxResult();
     }
 }
 
 void ZepSyntax::Interrupt()
 {
-    // Stop the thread, wait for it
-    m_stop = true;
+    // Ask the worker to stop, but don't wait for it; whatever it produces is dropped when it arrives
+    if (m_spSyntaxJob)
+    {
+        m_spSyntaxJob->cancel = true;
+        m_spSyntaxJob.reset();
+    }
+
     if (m_syntaxResult.valid())
     {
-        m_syntaxResult.get();
+        m_cancelledResults.push_back(std::move(m_syntaxResult));
     }
-    m_stop = false;
+
+    m_cancelledResults.erase(std::remove_if(m_cancelledResults.begin(), m_cancelledResults.end(), [](auto& result) {
+        return is_future_ready(result);
+    }),
+        m_cancelledResults.end());
 }
 
 void ZepSyntax::QueueUpdateSyntax(ByteIndex startLocation, ByteIndex endLocation)
 {
     assert(startLocation >= 0);
     assert(endLocation >= startLocation);
+
+    Interrupt();
+
     // Record the max location the syntax is valid up to.  This will
     // ensure that multiple calls to restart the thread keep track of where to start
     // This means a small edit at the end of a big file, followed by a small edit at the top
@@ -153,16 +258,124 @@ void ZepSyntax::QueueUpdateSyntax(ByteIndex startLocation, ByteIndex endLocation
 
     // Make sure the syntax buffer is big enough - adding normal syntax to the end
     // This may also 'chop'
-    m_syntax.resize(m_buffer.GetText().size(), SyntaxData{});
+    auto& text = m_buffer.GetText();
+    m_syntax.resize(text.size(), SyntaxData{});
+
+    m_processedChar = std::max(0l, std::min(long(m_processedChar), long(text.size() - 1)));
+    m_targetChar = std::max(0l, std::min(long(m_targetChar), long(text.size() - 1)));
 
-    m_processedChar = std::min(long(m_processedChar), long(m_buffer.GetText().size() - 1));
-    m_targetChar = std::min(long(m_targetChar), long(m_buffer.GetText().size() - 1));
+    // Snapshot the text from the start of the first dirty line to the end of the target line, a window at most;
+    // the worker only sees the copy
+    auto itrStart = text.begin() + m_processedChar;
+    while (itrStart > text.begin() && *(itrStart - 1) != '\n')
+    {
+        itrStart--;
+    }
+
+    std::string lineEnd("\n");
+    auto itrWindowEnd = text.begin() + std::min(long(text.size()), long(itrStart - text.begin()) + SyntaxWindowBytes);
+    auto itrTarget = std::min(itrWindowEnd, std::max(text.begin() + m_targetChar, itrStart));
+    auto itrEnd = text.find_first_of(itrTarget, itrWindowEnd, lineEnd.begin(), lineEnd.end());
+    bool truncated = false;
+    if (itrEnd != text.end())
+    {
+        itrEnd++;
+    }
+    else if (itrWindowEnd != text.end())
+    {
+        // Stop after the last whole line in the window, so the next one starts where this one ends; a line longer
+        // than the window is taken whole
+        truncated = true;
+        itrEnd = itrWindowEnd;
+        while (itrEnd > itrStart && *(itrEnd - 1) != '\n')
+        {
+            itrEnd--;
+        }
+        if (itrEnd == itrStart)
+        {
+            itrEnd = text.find_first_of(itrWindowEnd, text.end(), lineEnd.begin(), lineEnd.end());
+            itrEnd = itrEnd == text.end() ? itrEnd : itrEnd + 1;
+        }
+    }
+
+    auto spJob = std::make_shared<SyntaxJob>();
+    spJob->version = m_buffer.GetUpdateCount();
+    spJob->textOffset = ByteIndex(itrStart - text.begin());
+    spJob->targetChar = m_targetChar;
+    spJob->truncated = truncated && itrEnd != text.end();
+    spJob->text.assign(itrStart, itrEnd);
+    BeginSyntaxJob(*spJob);
+    m_spSyntaxJob = spJob;
 
     // Have the thread update the syntax in the new region
-    // If the pool has no threads, this will end up serial
-    m_syntaxResult = GetEditor().GetThreadPool().enqueue([=]() {
-        UpdateSyntax();
+    // If the pool has no threads, this will end up serial and we can apply the result immediately
+    m_syntaxResult = GetEditor().GetThreadPool().enqueue_task(TaskPriority::Normal, "UpdateSyntax", [=]() {
+        UpdateSyntax(*spJob);
+
+        // Apply the result on the editor's thread, unless another job has replaced this one by then.  The result is
+        // set as this returns, so waiting for it there is brief
+        GetEditor().GetScheduler().Post(this, [this, spJob]() {
+            if (m_spSyntaxJob == spJob && m_syntaxResult.valid())
+            {
+                ApplySyntaxResult();
+            }
+        });
+        return spJob;
     });
+
+    if (is_future_ready(m_syntaxResult))
+    {
+        ApplySyntaxResult();
+    }
+}
+
+void ZepSyntax::ApplySyntaxResult()
+{
+    auto spJob = m_syntaxResult.get();
+    m_spSyntaxJob.reset();
+
+    // Stale; the buffer has changed since this job was queued
+    if (spJob->cancel || spJob->version != m_buffer.GetUpdateCount())
+    {
+        return;
+    }
+
+    auto count = std::min(long(spJob->syntax.size()), long(m_syntax.size()) - spJob->textOffset);
+    if (count > 0)
+    {
+        // Tell the windows which lines changed color, so they can draw just those again
+        auto itrResult = spJob->syntax.begin();
+        auto itrSyntax = m_syntax.begin() + spJob->textOffset;
+        auto same = [](const SyntaxData& lhs, const SyntaxData& rhs) {
+            return lhs.foreground == rhs.foreground && lhs.background == rhs.background && lhs.underline == rhs.underline;
+        };
+        auto first = std::mismatch(itrResult, itrResult + count, itrSyntax, same).first - itrResult;
+        if (first < count)
+        {
+            auto last = count;
+            while (last > first && same(itrResult[last - 1], itrSyntax[last - 1]))
+            {
+                last--;
+            }
+            std::copy(itrResult + first, itrResult + last, itrSyntax + first);
+            GetEditor().Broadcast(MakeMessage<BufferMessage>(&m_buffer, BufferMessageType::SyntaxChanged, spJob->textOffset + first, spJob->textOffset + last - 1));
+        }
+    }
+
+    // Reset the target to the beginning
+    m_targetChar = long(0);
+    m_processedChar = long(m_syntax.size() - 1);
+
+    EndSyntaxJob(*spJob);
+}
+
+void ZepSyntax::EndSyntaxJob(const SyntaxJob& job)
+{
+    // Lex the next window; it starts again at the beginning of the line the last one stopped in
+    if (job.truncated)
+    {
+        QueueUpdateSyntax(job.textOffset + ByteIndex(job.text.size()), job.targetChar);
+    }
 }
 
 void ZepSyntax::Notify(std::shared_ptr<ZepMessage> spMsg)
@@ -175,82 +388,63 @@ void ZepSyntax::Notify(std::shared_ptr<ZepMessage> spMsg)
         {
             return;
         }
+
+        // Edits are applied to the syntax store straight away, so existing colors follow the text
+        // while the worker catches up
+        auto changeSize = spBufferMsg->endLocation - spBufferMsg->startLocation;
         if (spBufferMsg->type == BufferMessageType::PreBufferChange)
         {
             Interrupt();
         }
         else if (spBufferMsg->type == BufferMessageType::TextDeleted)
         {
-            Interrupt();
             m_syntax.erase(m_syntax.begin() + spBufferMsg->startLocation, m_syntax.begin() + spBufferMsg->endLocation);
+            if (m_targetChar > spBufferMsg->startLocation)
+            {
+                m_targetChar = std::max(long(spBufferMsg->startLocation), long(m_targetChar) - changeSize);
+            }
             QueueUpdateSyntax(spBufferMsg->startLocation, spBufferMsg->endLocation);
         }
         else if (spBufferMsg->type == BufferMessageType::TextAdded || spBufferMsg->type == BufferMessageType::Loaded)
         {
-            Interrupt();
-            m_syntax.insert(m_syntax.begin() + spBufferMsg->startLocation, spBufferMsg->endLocation - spBufferMsg->startLocation, SyntaxData{});
+            m_syntax.insert(m_syntax.begin() + spBufferMsg->startLocation, changeSize, SyntaxData{});
+            if (m_targetChar >= spBufferMsg->startLocation)
+            {
+                m_targetChar = long(m_targetChar) + changeSize;
+            }
             QueueUpdateSyntax(spBufferMsg->startLocation, spBufferMsg->endLocation);
         }
         else if (spBufferMsg->type == BufferMessageType::TextChanged)
         {
-            Interrupt();
             QueueUpdateSyntax(spBufferMsg->startLocation, spBufferMsg->endLocation);
         }
     }
 }
 
 // TODO: Multiline comments
-void ZepSyntax::UpdateSyntax()
+void ZepSyntax::UpdateSyntax(SyntaxJob& job)
 {
-    auto& buffer = m_buffer.GetText();
-    auto itrCurrent = buffer.begin() + m_processedChar;
-    auto itrEnd = buffer.begin() + m_targetChar;
-
-    assert(std::distance(itrCurrent, itrEnd) < int(m_syntax.size()));
-    assert(m_syntax.size() == buffer.size());
+    // The snapshot starts on a line boundary, so we can lex from the beginning of it
+    auto& buffer = job.text;
+    auto itrCurrent = buffer.begin();
+    auto itrEnd = buffer.begin() + std::min(long(job.targetChar - job.textOffset), long(buffer.size()));
 
     std::string delim(" \t.\n;(){}=:");
     std::string lineEnd("\n");
 
-    // Walk backwards to previous delimiter
-    while (itrCurrent > buffer.begin())
-    {
-        if (std::find(delim.begin(), delim.end(), *itrCurrent) == delim.end())
-        {
-            itrCurrent--;
-        }
-        else
-        {
-            break;
-        }
-    }
-
-    // Back to the previous line
-    while (itrCurrent > buffer.begin() && *itrCurrent != '\n')
-    {
-        itrCurrent--;
-    }
     itrEnd = buffer.find_first_of(itrEnd, buffer.end(), lineEnd.begin(), lineEnd.end());
 
     // Mark a region of the syntax buffer with the correct marker
     auto mark = [&](GapBuffer<uint8_t>::const_iterator itrA, GapBuffer<uint8_t>::const_iterator itrB, ThemeColor type, ThemeColor background) {
-        std::fill(m_syntax.begin() + (itrA - buffer.begin()), m_syntax.begin() + (itrB - buffer.begin()), SyntaxData{ type, background });
+        job.Mark(ByteIndex(itrA - buffer.begin()), ByteIndex(itrB - buffer.begin()), SyntaxData{ type, background });
     };
 
-    auto markSingle = [&](GapBuffer<uint8_t>::const_iterator itrA, ThemeColor type, ThemeColor background) {
-        (m_syntax.begin() + (itrA - buffer.begin()))->foreground = type;
-        (m_syntax.begin() + (itrA - buffer.begin()))->background = background;
-    };
-
-    // Update start location
-    m_processedChar = long(itrCurrent - buffer.begin());
-
-    //LOG(DEBUG) << "Updating Syntax: Start=" << m_processedChar << ", End=" << std::distance(buffer.begin(), itrEnd);
+    //LOG(DEBUG) << "Updating Syntax: Start=" << job.textOffset << ", End=" << job.textOffset + std::distance(buffer.begin(), itrEnd);
 
     // Walk the buffer updating information about syntax coloring
     while (itrCurrent != itrEnd)
     {
-        if (m_stop == true)
+        if (job.cancel)
         {
             return;
         }
@@ -359,17 +553,31 @@ void ZepSyntax::UpdateSyntax()
         itrCurrent = itrLast;
     }
 
-    // If we got here, we sucessfully completed
-    // Reset the target to the beginning
-    m_targetChar = long(0);
-    m_processedChar = long(buffer.size() - 1);
+    // Anything we walked over without marking is plain text
+    auto walked = std::min(long(itrCurrent - buffer.begin()), long(buffer.size()));
+    if (walked > long(job.syntax.size()))
+    {
+        job.syntax.resize(walked);
+    }
+}
+
+ByteIndex ZepSyntax::FindMatchingBracket(ByteIndex location, bool& answered) const
+{
+    for (auto& adorn : m_adornments)
+    {
+        auto match = adorn->FindMatchingBracket(location, answered);
+        if (answered)
+        {
+            return match;
+        }
+    }
+    answered = false;
+    return InvalidByteIndex;
 }
 
 void ZepSyntax::EndFlash() const
 {
     m_flashRange = NVec2<ByteIndex>(0, 0);
-
-    GetEditor().SetFlags(ZClearFlags(GetEditor().GetFlags(), ZepEditorFlags::FastUpdate));
 }
 
 void ZepSyntax::BeginFlash(float seconds, SyntaxFlashType flashType, const NVec2i& range)
@@ -383,7 +591,21 @@ void ZepSyntax::BeginFlash(float seconds, SyntaxFlashType flashType, const NVec2
     {
         m_flashRange = NVec2i(long(0), long(m_syntax.size() - 1));
     }
-    GetEditor().SetFlags(ZSetFlags(GetEditor().GetFlags(), ZepEditorFlags::FastUpdate));
+
+    // Each frame of the flash changes the colors of its lines; one more after it ends puts them back
+    auto flashRange = m_flashRange;
+    auto& scheduler = GetEditor().GetScheduler();
+    scheduler.Cancel(m_flashSchedule);
+    m_flashSchedule = scheduler.AddTimer(this, 0.0, [this, flashRange]() {
+        if (timer_get_elapsed_seconds(m_flashTimer) >= m_flashDuration)
+        {
+            GetEditor().GetScheduler().Cancel(m_flashSchedule);
+            m_flashSchedule = InvalidScheduleId;
+        }
+        GetEditor().Broadcast(MakeMessage<BufferMessage>(&m_buffer, BufferMessageType::SyntaxChanged, flashRange.x, flashRange.y));
+        GetEditor().RequestRefresh();
+    },
+        1.0 / 60.0);
 }
 
 const NVec4f& ZepSyntax::ToBackgroundColor(const SyntaxResult& res) const
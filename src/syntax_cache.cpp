@@ -0,0 +1,181 @@
+#include "zep/syntax_cache.h"
+#include "zep/editor.h"
+#include "zep/filesystem.h"
+#include "zep/theme.h"
+
+#include "zep/mcommon/logger.h"
+#include "zep/mcommon/string/stringutils.h"
+
+#include <cstring>
+#include <sstream>
+
+namespace Zep
+{
+
+namespace
+{
+// Bump the last byte when the layout changes
+const uint32_t SyntaxCacheMagic = 0x3159535A; // ZSY1
+
+struct SyntaxCacheHeader
+{
+    uint32_t magic = SyntaxCacheMagic;
+    uint32_t grammarHash = 0;
+    uint32_t grammarVersion = 0;
+    uint32_t lineCount = 0;
+    uint64_t contentHash = 0;
+    uint64_t textSize = 0;
+    uint64_t runCount = 0;
+};
+
+struct SyntaxCacheRun
+{
+    uint32_t length;
+    uint8_t foreground;
+    uint8_t background;
+    uint8_t underline;
+    uint8_t padding;
+};
+
+bool GetSyntaxCachePath(ZepEditor& editor, const ZepPath& filePath, ZepPath& cachePath)
+{
+    // Only files in a project have somewhere to keep the cache
+    bool foundGit = false;
+    auto root = editor.GetFileSystem().GetSearchRoot(filePath, foundGit);
+    if (!foundGit)
+    {
+        return false;
+    }
+
+    auto name = filePath.string();
+    std::ostringstream str;
+    str << std::hex << murmur_hash_64(name.c_str(), uint32_t(name.size()), 0) << ".syn";
+    cachePath = root / ".zep" / "syntax" / str.str();
+    return true;
+}
+
+uint32_t HashGrammarName(const std::string& grammarName)
+{
+    return murmur_hash(grammarName.c_str(), int(grammarName.size()), 0);
+}
+} // namespace
+
+void SyntaxCache_Hash(const std::string& text, const std::vector<long>& lineEnds, uint64_t& contentHash, std::vector<uint32_t>& lineHashes)
+{
+    contentHash = murmur_hash_64(text.c_str(), uint32_t(text.size()), 0);
+
+    lineHashes.resize(lineEnds.size());
+    long lineStart = 0;
+    for (size_t line = 0; line < lineEnds.size(); line++)
+    {
+        auto lineEnd = std::min(lineEnds[line], long(text.size()));
+        lineHashes[line] = murmur_hash(text.c_str() + lineStart, int(lineEnd - lineStart), 0);
+        lineStart = lineEnd;
+    }
+}
+
+bool SyntaxCache_Read(ZepEditor& editor, const ZepPath& filePath, const std::string& grammarName, uint32_t grammarVersion, SyntaxCacheEntry& entry)
+{
+    ZepPath cachePath;
+    if (!GetSyntaxCachePath(editor, filePath, cachePath) || !editor.GetFileSystem().Exists(cachePath))
+    {
+        return false;
+    }
+
+    auto data = editor.GetFileSystem().Read(cachePath);
+    if (data.size() < sizeof(SyntaxCacheHeader))
+    {
+        return false;
+    }
+
+    SyntaxCacheHeader header;
+    memcpy(&header, data.c_str(), sizeof(header));
+    if (header.magic != SyntaxCacheMagic || header.grammarHash != HashGrammarName(grammarName) || header.grammarVersion != grammarVersion)
+    {
+        return false;
+    }
+
+    auto expectedSize = sizeof(SyntaxCacheHeader) + header.lineCount * (sizeof(uint32_t) + sizeof(uint64_t)) + header.runCount * sizeof(SyntaxCacheRun);
+    if (data.size() != expectedSize)
+    {
+        LOG(DEBUG) << "Ignoring damaged syntax cache: " << cachePath.string();
+        return false;
+    }
+
+    auto pData = data.c_str() + sizeof(SyntaxCacheHeader);
+    entry.contentHash = header.contentHash;
+    entry.lineHashes.resize(header.lineCount);
+    entry.lineStates.resize(header.lineCount);
+    if (header.lineCount > 0)
+    {
+        memcpy(&entry.lineHashes[0], pData, header.lineCount * sizeof(uint32_t));
+        pData += header.lineCount * sizeof(uint32_t);
+        memcpy(&entry.lineStates[0], pData, header.lineCount * sizeof(uint64_t));
+        pData += header.lineCount * sizeof(uint64_t);
+    }
+
+    // Expand the runs
+    entry.syntax.clear();
+    entry.syntax.reserve(header.textSize);
+    for (uint64_t index = 0; index < header.runCount; index++)
+    {
+        SyntaxCacheRun run;
+        memcpy(&run, pData, sizeof(run));
+        pData += sizeof(run);
+
+        if (entry.syntax.size() + run.length > header.textSize)
+        {
+            return false;
+        }
+        entry.syntax.insert(entry.syntax.end(), run.length, SyntaxData{ ThemeColor(run.foreground), ThemeColor(run.background), run.underline != 0 });
+    }
+    return entry.syntax.size() == header.textSize;
+}
+
+bool SyntaxCache_Write(ZepEditor& editor, const ZepPath& filePath, const std::string& grammarName, uint32_t grammarVersion, const SyntaxCacheEntry& entry)
+{
+    ZepPath cachePath;
+    if (!GetSyntaxCachePath(editor, filePath, cachePath) || entry.lineHashes.size() != entry.lineStates.size())
+    {
+        return false;
+    }
+
+    auto& fs = editor.GetFileSystem();
+    if (!fs.IsDirectory(cachePath.parent_path()) && !fs.MakeDirectories(cachePath.parent_path()))
+    {
+        return false;
+    }
+
+    std::vector<SyntaxCacheRun> runs;
+    for (auto& data : entry.syntax)
+    {
+        auto foreground = uint8_t(data.foreground);
+        auto background = uint8_t(data.background);
+        auto underline = uint8_t(data.underline ? 1 : 0);
+        if (!runs.empty() && runs.back().foreground == foreground && runs.back().background == background && runs.back().underline == underline)
+        {
+            runs.back().length++;
+            continue;
+        }
+        runs.push_back(SyntaxCacheRun{ 1, foreground, background, underline, 0 });
+    }
+
+    SyntaxCacheHeader header;
+    header.grammarHash = HashGrammarName(grammarName);
+    header.grammarVersion = grammarVersion;
+    header.lineCount = uint32_t(entry.lineHashes.size());
+    header.contentHash = entry.contentHash;
+    header.textSize = entry.syntax.size();
+    header.runCount = runs.size();
+
+    std::string data;
+    data.reserve(sizeof(header) + header.lineCount * (sizeof(uint32_t) + sizeof(uint64_t)) + runs.size() * sizeof(SyntaxCacheRun));
+    data.append((const char*)&header, sizeof(header));
+    data.append((const char*)entry.lineHashes.data(), entry.lineHashes.size() * sizeof(uint32_t));
+    data.append((const char*)entry.lineStates.data(), entry.lineStates.size() * sizeof(uint64_t));
+    data.append((const char*)runs.data(), runs.size() * sizeof(SyntaxCacheRun));
+
+    return fs.Write(cachePath, data.c_str(), data.size());
+}
+
+} // namespace Zep
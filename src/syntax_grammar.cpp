@@ -0,0 +1,474 @@
+#include "zep/syntax_grammar.h"
+#include "zep/editor.h"
+#include "zep/syntax_cache.h"
+
+#include <algorithm>
+#include <cctype>
+
+namespace Zep
+{
+
+ZepGrammarTable::ZepGrammarTable(const ZepGrammar& grammar)
+    : m_name(grammar.name)
+    , m_version(grammar.version)
+    , m_flags(grammar.flags)
+{
+    // Bytes above 127 are UTF8 sequences; keep them inside words
+    for (int ch = 0; ch < 256; ch++)
+    {
+        m_wordChars[ch] = ch >= 128 || std::isalnum(ch);
+    }
+    for (auto ch : grammar.wordChars)
+    {
+        m_wordChars[uint8_t(ch)] = true;
+    }
+
+    // Region contexts are numbered from 1, since 0 is the top level and marks the bottom of the state stack
+    auto regionCount = std::min(grammar.regions.size(), size_t(255));
+    std::unordered_map<std::string, uint8_t> regionIds;
+    for (size_t index = 0; index < regionCount; index++)
+    {
+        regionIds[grammar.regions[index].name] = uint8_t(index + 1);
+    }
+
+    auto addOpeners = [&](Context& context, const std::vector<std::string>& contains) {
+        for (auto& name : contains)
+        {
+            auto itrId = regionIds.find(name);
+            if (itrId == regionIds.end())
+            {
+                assert(!"Unknown grammar region");
+                continue;
+            }
+
+            auto& region = grammar.regions[itrId->second - 1];
+            if (region.begin.empty())
+            {
+                continue;
+            }
+            context.openers.push_back(Opener{ region.begin, itrId->second, region.lineStart });
+            context.actions[uint8_t(region.begin[0])] |= CharAction::Begin;
+        }
+
+        std::stable_sort(context.openers.begin(), context.openers.end(), [](const Opener& a, const Opener& b) {
+            return a.literal.size() > b.literal.size();
+        });
+    };
+
+    auto addTokens = [&](Context& context) {
+        for (int ch = 0; ch < 256; ch++)
+        {
+            if (m_wordChars[ch])
+            {
+                context.actions[ch] |= CharAction::Word;
+            }
+        }
+        for (auto ch : grammar.brackets)
+        {
+            context.actions[uint8_t(ch)] |= CharAction::Bracket;
+        }
+        context.actions[' '] |= CharAction::Space;
+        context.actions['\t'] |= CharAction::Space;
+    };
+
+    m_contexts.resize(regionCount + 1);
+    for (auto& context : m_contexts)
+    {
+        context.actions.fill(0);
+    }
+
+    auto& topLevel = m_contexts[0];
+    addTokens(topLevel);
+    addOpeners(topLevel, grammar.contains);
+
+    for (size_t index = 0; index < regionCount; index++)
+    {
+        auto& region = grammar.regions[index];
+        auto& context = m_contexts[index + 1];
+        context.color = region.color;
+        context.end = region.end;
+        context.endsAtLine = region.end.empty() || region.singleLine;
+        context.tokenize = region.tokenize;
+        if (context.tokenize)
+        {
+            addTokens(context);
+        }
+        if (!region.end.empty())
+        {
+            context.actions[uint8_t(region.end[0])] |= CharAction::End;
+        }
+        if (region.escape != 0)
+        {
+            context.actions[region.escape] |= CharAction::Escape;
+        }
+        addOpeners(context, region.contains);
+    }
+
+    // All classes share one lookup; the first class to claim a word keeps it
+    for (auto& keywordClass : grammar.keywordClasses)
+    {
+        for (auto word : keywordClass.words)
+        {
+            if (m_flags & ZepSyntaxFlags::CaseInsensitive)
+            {
+                std::transform(word.begin(), word.end(), word.begin(), ::tolower);
+            }
+            m_keywords.emplace(word, keywordClass.color);
+        }
+    }
+}
+
+bool ZepGrammarTable::Matches(const GapBuffer<uint8_t>& text, ByteIndex offset, const std::string& literal) const
+{
+    if (offset + ByteIndex(literal.size()) > ByteIndex(text.size()))
+    {
+        return false;
+    }
+
+    for (size_t index = 0; index < literal.size(); index++)
+    {
+        if (text[offset + index] != uint8_t(literal[index]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void ZepGrammarTable::Lex(SyntaxJob& job) const
+{
+    auto& text = job.text;
+    auto size = ByteIndex(text.size());
+    auto target = std::max(0l, long(job.targetChar - job.textOffset));
+
+    auto mark = [&](ByteIndex start, ByteIndex end, ThemeColor color) {
+        job.Mark(start, end, SyntaxData{ color, ThemeColor::None });
+    };
+
+    GrammarState state = job.startState;
+    std::string token;
+    ByteIndex index = 0;
+    while (index < size)
+    {
+        auto& context = m_contexts[state & 0xFF];
+        auto ch = text[index];
+
+        if (ch == '\n')
+        {
+            // Line comments and single line strings close here
+            while ((state & 0xFF) != 0 && m_contexts[state & 0xFF].endsAtLine)
+            {
+                state >>= 8;
+            }
+
+            mark(index, index + 1, ThemeColor::Normal);
+            index++;
+            job.lineStates.push_back(state);
+
+            if (job.cancel)
+            {
+                return;
+            }
+
+            // Stop at the end of the target line; if the state leaving it has changed, the owner queues the rest
+            if (index > target)
+            {
+                break;
+            }
+            continue;
+        }
+
+        auto action = context.actions[ch];
+        if ((action & CharAction::Escape) && index + 1 < size && text[index + 1] != '\n')
+        {
+            mark(index, index + 2, context.color);
+            index += 2;
+            continue;
+        }
+
+        if ((action & CharAction::End) && Matches(text, index, context.end))
+        {
+            auto length = ByteIndex(context.end.size());
+            mark(index, index + length, context.color);
+            index += length;
+            state >>= 8;
+            continue;
+        }
+
+        // Open a region, if there is room on the stack
+        if ((action & CharAction::Begin) && (state >> 56) == 0)
+        {
+            auto itrOpener = std::find_if(context.openers.begin(), context.openers.end(), [&](const Opener& opener) {
+                return (!opener.lineStart || index == 0 || text[index - 1] == '\n') && Matches(text, index, opener.literal);
+            });
+
+            if (itrOpener != context.openers.end())
+            {
+                auto length = ByteIndex(itrOpener->literal.size());
+                mark(index, index + length, m_contexts[itrOpener->context].color);
+                index += length;
+                state = (state << 8) | itrOpener->context;
+                continue;
+            }
+        }
+
+        if (!context.tokenize)
+        {
+            mark(index, index + 1, context.color);
+            index++;
+            continue;
+        }
+
+        if (action & CharAction::Word)
+        {
+            auto wordEnd = index + 1;
+            while (wordEnd < size && m_wordChars[text[wordEnd]])
+            {
+                wordEnd++;
+            }
+
+            auto color = context.color;
+            if (std::isdigit(ch))
+            {
+                color = ThemeColor::Number;
+            }
+            else
+            {
+                token.assign(text.begin() + index, text.begin() + wordEnd);
+                if (m_flags & ZepSyntaxFlags::CaseInsensitive)
+                {
+                    std::transform(token.begin(), token.end(), token.begin(), ::tolower);
+                }
+
+                auto itrKeyword = m_keywords.find(token);
+                if (itrKeyword != m_keywords.end())
+                {
+                    color = itrKeyword->second;
+                }
+            }
+
+            mark(index, wordEnd, color);
+            index = wordEnd;
+            continue;
+        }
+
+        if (action & CharAction::Bracket)
+        {
+            mark(index, index + 1, ThemeColor::Parenthesis);
+        }
+        else if (action & CharAction::Space)
+        {
+            mark(index, index + 1, ThemeColor::Whitespace);
+        }
+        else
+        {
+            mark(index, index + 1, context.color);
+        }
+        index++;
+    }
+}
+
+ZepSyntax_Grammar::ZepSyntax_Grammar(ZepBuffer& buffer, std::shared_ptr<const ZepGrammarTable> spGrammar)
+    : ZepSyntax(buffer)
+    , m_spGrammar(spGrammar)
+{
+    m_lineStates.resize(std::max(1l, m_buffer.GetLineCount()), 0);
+}
+
+ZepSyntax_Grammar::~ZepSyntax_Grammar()
+{
+    if (m_cacheWrite.valid())
+    {
+        m_cacheWrite.wait();
+    }
+}
+
+void ZepSyntax_Grammar::UpdateSyntax(SyntaxJob& job)
+{
+    m_spGrammar->Lex(job);
+}
+
+void ZepSyntax_Grammar::Notify(std::shared_ptr<ZepMessage> spMsg)
+{
+    // Keep one state per line in step with the buffer before the base class queues the job.
+    // New lines take the state of the line they were added to, until the job fills them in
+    if (spMsg->messageId == Msg::Buffer)
+    {
+        auto spBufferMsg = std::static_pointer_cast<BufferMessage>(spMsg);
+        if (spBufferMsg->pBuffer == &m_buffer && spBufferMsg->type != BufferMessageType::PreBufferChange)
+        {
+            auto line = std::min(m_buffer.GetBufferLine(spBufferMsg->startLocation) + 1, long(m_lineStates.size()));
+            auto change = m_buffer.GetLineCount() - long(m_lineStates.size());
+            if (change > 0)
+            {
+                m_lineStates.insert(m_lineStates.begin() + line, change, m_lineStates[line - 1]);
+            }
+            else if (change < 0)
+            {
+                line = std::min(line, long(m_lineStates.size()) + change);
+                m_lineStates.erase(m_lineStates.begin() + line, m_lineStates.begin() + line - change);
+            }
+
+            if (spBufferMsg->type == BufferMessageType::Loaded && ReadCache())
+            {
+                return;
+            }
+        }
+    }
+
+    ZepSyntax::Notify(spMsg);
+}
+
+void ZepSyntax_Grammar::BeginSyntaxJob(SyntaxJob& job)
+{
+    job.startLine = m_buffer.GetBufferLine(job.textOffset);
+    job.startState = job.startLine < long(m_lineStates.size()) ? m_lineStates[job.startLine] : 0;
+}
+
+void ZepSyntax_Grammar::EndSyntaxJob(const SyntaxJob& job)
+{
+    auto line = job.startLine + 1;
+    bool changed = false;
+    for (auto state : job.lineStates)
+    {
+        if (line >= long(m_lineStates.size()))
+        {
+            return;
+        }
+        changed = m_lineStates[line] != state;
+        m_lineStates[line++] = state;
+    }
+
+    // The rest of a truncated job carries on from the last line.  Otherwise, if the state flowing into the next line
+    // has changed, the lines after it are lexed again a window at a time, until one ends in the state it had before
+    if (changed || job.truncated)
+    {
+        ByteIndex lineStart, lineEnd;
+        if (m_buffer.GetLineOffsets(line - 1, lineStart, lineEnd))
+        {
+            auto target = job.truncated ? job.targetChar : std::min(m_buffer.EndLocation(), lineStart + SyntaxWindowBytes);
+            QueueUpdateSyntax(lineStart, std::max(target, lineStart));
+            return;
+        }
+    }
+
+    WriteCache();
+}
+
+// Fill in the syntax for a freshly loaded file from the cache; returns true if it did
+bool ZepSyntax_Grammar::ReadCache()
+{
+    if (!GetEditor().GetConfig().syntaxCache || m_buffer.GetFilePath().empty())
+    {
+        return false;
+    }
+
+    // The file may still be being written from the last time; a write of another file carries on
+    if (m_cacheWrite.valid() && m_cacheWritePath == m_buffer.GetFilePath())
+    {
+        m_cacheWrite.wait();
+    }
+
+    SyntaxCacheEntry entry;
+    if (!SyntaxCache_Read(GetEditor(), m_buffer.GetFilePath(), m_spGrammar->GetName(), m_spGrammar->GetVersion(), entry) || entry.lineHashes.empty())
+    {
+        return false;
+    }
+
+    auto& text = m_buffer.GetText();
+    auto lineEnds = m_buffer.GetLineEnds();
+    uint64_t contentHash;
+    std::vector<uint32_t> lineHashes;
+    SyntaxCache_Hash(text.string(), lineEnds, contentHash, lineHashes);
+
+    bool same = contentHash == entry.contentHash && lineHashes.size() == entry.lineHashes.size() && text.size() == entry.syntax.size();
+
+    // Otherwise, everything before the first changed line is still good
+    size_t sameLines = 0;
+    if (!same)
+    {
+        auto maxLines = std::min(lineHashes.size(), entry.lineHashes.size()) - 1;
+        while (sameLines < maxLines && lineHashes[sameLines] == entry.lineHashes[sameLines])
+        {
+            sameLines++;
+        }
+        if (sameLines == 0)
+        {
+            return false;
+        }
+    }
+
+    Interrupt();
+    m_syntax.resize(text.size());
+    m_processedChar = long(m_syntax.size() - 1);
+    m_targetChar = long(0);
+
+    if (same)
+    {
+        m_syntax = entry.syntax;
+        m_lineStates = entry.lineStates;
+        m_cachedVersion = m_buffer.GetUpdateCount();
+        return true;
+    }
+
+    auto reuseEnd = ByteIndex(lineEnds[sameLines - 1]);
+    std::copy(entry.syntax.begin(), entry.syntax.begin() + reuseEnd, m_syntax.begin());
+    std::copy(entry.lineStates.begin(), entry.lineStates.begin() + sameLines + 1, m_lineStates.begin());
+    QueueUpdateSyntax(reuseEnd, ByteIndex(text.size() - 1));
+    return true;
+}
+
+// Store the results for a clean file, once lexing has caught up.  They are copied here, and hashed and written on a
+// worker, one write at a time.  If the last write is still going, this one is made when it is done, from the editor's
+// thread, with whatever is current then
+void ZepSyntax_Grammar::WriteCache()
+{
+    if (!GetEditor().GetConfig().syntaxCache || m_buffer.GetFilePath().empty() || m_buffer.HasFileFlags(FileFlags::Dirty) || m_cachedVersion == m_buffer.GetUpdateCount())
+    {
+        return;
+    }
+
+    if (m_cacheWrite.valid() && !is_future_ready(m_cacheWrite))
+    {
+        m_cacheWritePending = true;
+        return;
+    }
+    m_cacheWritePending = false;
+    m_cachedVersion = m_buffer.GetUpdateCount();
+
+    auto lineEnds = m_buffer.GetLineEnds();
+    if (lineEnds.size() != m_lineStates.size())
+    {
+        return;
+    }
+
+    auto spEntry = std::make_shared<SyntaxCacheEntry>();
+    spEntry->lineStates = m_lineStates;
+    spEntry->syntax = m_syntax;
+
+    auto& editor = GetEditor();
+    auto text = m_buffer.GetText().string();
+    auto filePath = m_buffer.GetFilePath();
+    auto grammarName = m_spGrammar->GetName();
+    auto grammarVersion = m_spGrammar->GetVersion();
+    auto writeId = ++m_cacheWriteId;
+    m_cacheWritePath = filePath;
+    m_cacheWrite = editor.GetThreadPool().enqueue_task(TaskPriority::Background, "WriteSyntaxCache", [this, &editor, spEntry, text, lineEnds, filePath, grammarName, grammarVersion, writeId]() {
+        SyntaxCache_Hash(text, lineEnds, spEntry->contentHash, spEntry->lineHashes);
+        auto written = SyntaxCache_Write(editor, filePath, grammarName, grammarVersion, *spEntry);
+
+        // Make the write that was asked for meanwhile, unless another has started.  The result is set as this returns,
+        // so waiting for it there is brief
+        editor.GetScheduler().Post(this, [this, writeId]() {
+            if (m_cacheWritePending && m_cacheWriteId == writeId)
+            {
+                m_cacheWritePending = false;
+                m_cacheWrite.wait();
+                WriteCache();
+            }
+        });
+        return written;
+    });
+}
+
+} // namespace Zep
@@ -1,6 +1,7 @@
 #include "zep/buffer.h"
 #include "zep/editor.h"
 #include "zep/syntax.h"
+#include "zep/syntax_grammar.h"
 #include "zep/syntax_tree.h"
 
 namespace Zep
@@ -15,6 +16,7 @@ static std::unordered_set<std::string> cpp_keywords = {
     "for", "friend", "goto", "if", "import", "inline", "int", "long", "module", "mutable", "namespace", "new", "noexcept", "not", "not_eq", "nullptr", "operator", "or", "or_eq", "private", "protected", "public",
     "register", "reinterpret_cast", "requires", "return", "short", "signed", "sizeof", "static", "static_assert", "static_cast", "struct", "switch", "synchronized", "template", "this", "thread_local",
     "throw", "true", "try", "typedef", "typeid", "typename", "union", "unsigned", "using", "virtual", "void", "volatile", "wchar_t", "while", "xor", "xor_eq", "#define", "#include",
+    "#if", "#ifdef", "#ifndef", "#else", "#elif", "#endif", "#pragma", "#undef", "#error",
     "uint32_t", "int32_t", "uint64_t", "int64_t", "size_t", "uint8_t", "int8_t", "int16_t", "uint16_t"
 };
 
@@ -24,8 +26,9 @@ static std::unordered_set<std::string> cpp_identifiers = {
     "std", "string", "vector", "map", "unordered_map", "set", "unordered_set", "min", "max"
 };
 
-static std::unordered_set<std::string> toml_keywords = {};
-static std::unordered_set<std::string> toml_identifiers = {};
+static std::unordered_set<std::string> toml_keywords = {
+    "true", "false", "inf", "nan"
+};
 
 static std::unordered_set<std::string> hlsl_keywords = {
     "CompileShader", "const", "continue", "ComputeShader", "ConsumeStructuredBuffer", "default", "DepthStencilState", "DepthStencilView", "discard", "do", "double", "DomainShader", "dword", "else", "export", "extern",
@@ -60,7 +63,9 @@ static std::unordered_set<std::string> glsl_keywords{
     "samplerCube", "sampler1DShadow", "sampler2DShadow", "samplerCubeShadow", "sampler1DArray", "sampler2DArray", "sampler1DArrayShadow", "sampler2DArrayShadow", "isampler1D", "isampler2D",
     "isampler3D", "isamplerCube", "isampler1DArray", "isampler2DArray", "usampler1D", "usampler2D", "usampler3D", "usamplerCube", "usampler1DArray", "usampler2DArray",
     "sampler2DRect", "sampler2DRectShadow", "isampler2DRect", "usampler2DRect", "samplerBuffer", "isamplerBuffer", "usamplerBuffer", "sampler2DMS", "isampler2DMS",
-    "usampler2DMS", "sampler2DMSArray", "isampler2DMSArray", "usampler2DMSArray", "samplerCubeArray", "samplerCubeArrayShadow", "isamplerCubeArray", "usamplerCubeArray"
+    "usampler2DMS", "sampler2DMSArray", "isampler2DMSArray", "usampler2DMSArray", "samplerCubeArray", "samplerCubeArrayShadow", "isamplerCubeArray", "usamplerCubeArray",
+    "float", "double", "int", "uint", "bool", "const", "struct", "if", "else", "for", "while", "do", "switch", "case", "default", "break", "continue", "return", "true", "false",
+    "#define", "#if", "#ifdef", "#ifndef", "#else", "#elif", "#endif", "#extension"
 };
 
 static std::unordered_set<std::string> glsl_identifiers = {
@@ -116,36 +121,113 @@ static std::unordered_set<std::string> lua_identifiers = {
 };
 
 static std::unordered_set<std::string> lisp_keywords = {
-    "+", "-", "eval"
+    "+", "-", "*", "/", "eval", "define", "defun", "defmacro", "lambda", "let", "let*", "letrec", "if", "cond", "else", "when", "unless", "begin", "progn", "quote", "setq", "set!", "and", "or", "not"
 };
 
 static std::unordered_set<std::string> lisp_identifiers = {
-    "cdr", "car"
+    "cdr", "car", "cons", "list", "append", "apply", "map", "null?", "eq?", "equal?"
 };
 
 static std::unordered_set<std::string> tree_keywords = {};
 static std::unordered_set<std::string> tree_identifiers = {};
 
+// C style comments and strings, shared by the C++ and shader grammars
+static void AddCStyleRegions(ZepGrammar& grammar)
+{
+    grammar.regions.push_back(ZepGrammarRegion{ "line_comment", "//", "", ThemeColor::Comment });
+    grammar.regions.push_back(ZepGrammarRegion{ "block_comment", "/*", "*/", ThemeColor::Comment });
+    grammar.regions.push_back(ZepGrammarRegion{ "string", "\"", "\"", ThemeColor::String, '\\', true });
+    grammar.regions.push_back(ZepGrammarRegion{ "char", "'", "'", ThemeColor::String, '\\', true });
+    grammar.contains = { "line_comment", "block_comment", "string", "char" };
+}
+
+static ZepGrammar CppGrammar()
+{
+    ZepGrammar grammar;
+    grammar.name = "cpp";
+    grammar.wordChars = "_#";
+    AddCStyleRegions(grammar);
+    grammar.regions.push_back(ZepGrammarRegion{ "raw_string", "R\"(", ")\"", ThemeColor::String });
+    grammar.contains.push_back("raw_string");
+    grammar.keywordClasses = { { ThemeColor::Keyword, cpp_keywords }, { ThemeColor::Identifier, cpp_identifiers } };
+    return grammar;
+}
+
+static ZepGrammar GlslGrammar()
+{
+    ZepGrammar grammar;
+    grammar.name = "glsl";
+    grammar.wordChars = "_#";
+    AddCStyleRegions(grammar);
+    grammar.keywordClasses = { { ThemeColor::Keyword, glsl_keywords }, { ThemeColor::Identifier, glsl_identifiers } };
+    return grammar;
+}
+
+static ZepGrammar LispGrammar()
+{
+    ZepGrammar grammar;
+    grammar.name = "lisp";
+    grammar.wordChars = "_-+*/<>=!?:&%$";
+    grammar.regions.push_back(ZepGrammarRegion{ "line_comment", ";", "", ThemeColor::Comment });
+
+    // #| ... |# comments nest
+    ZepGrammarRegion blockComment{ "block_comment", "#|", "|#", ThemeColor::Comment };
+    blockComment.contains = { "block_comment" };
+    grammar.regions.push_back(blockComment);
+
+    grammar.regions.push_back(ZepGrammarRegion{ "string", "\"", "\"", ThemeColor::String, '\\' });
+    grammar.contains = { "line_comment", "block_comment", "string" };
+    grammar.keywordClasses = { { ThemeColor::Keyword, lisp_keywords }, { ThemeColor::Identifier, lisp_identifiers } };
+    return grammar;
+}
+
+static ZepGrammar TomlGrammar()
+{
+    ZepGrammar grammar;
+    grammar.name = "toml";
+    grammar.wordChars = "_-";
+    grammar.regions.push_back(ZepGrammarRegion{ "comment", "#", "", ThemeColor::Comment });
+    grammar.regions.push_back(ZepGrammarRegion{ "multiline_string", "\"\"\"", "\"\"\"", ThemeColor::String, '\\' });
+    grammar.regions.push_back(ZepGrammarRegion{ "multiline_literal", "'''", "'''", ThemeColor::String });
+    grammar.regions.push_back(ZepGrammarRegion{ "string", "\"", "\"", ThemeColor::String, '\\', true });
+    grammar.regions.push_back(ZepGrammarRegion{ "literal", "'", "'", ThemeColor::String, 0, true });
+
+    // [table] and [[array]] headers start in the first column; arrays inside values don't
+    ZepGrammarRegion table{ "table", "[", "]", ThemeColor::Keyword, 0, true, true };
+    table.contains = { "string", "literal" };
+    grammar.regions.push_back(table);
+
+    grammar.contains = { "comment", "multiline_string", "multiline_literal", "string", "literal", "table" };
+    grammar.keywordClasses = { { ThemeColor::Keyword, toml_keywords } };
+    return grammar;
+}
+
 void RegisterSyntaxProviders(ZepEditor& editor)
 {
-    editor.RegisterSyntaxFactory({ ".vert", ".frag" }, SyntaxProvider{ "gl_shader", tSyntaxFactory([](ZepBuffer* pBuffer) {
-                                                                          return std::make_shared<ZepSyntax>(*pBuffer, glsl_keywords, glsl_identifiers);
+    // Grammars are compiled once here and shared by every buffer that uses them
+    auto spCpp = std::make_shared<const ZepGrammarTable>(CppGrammar());
+    auto spGlsl = std::make_shared<const ZepGrammarTable>(GlslGrammar());
+    auto spLisp = std::make_shared<const ZepGrammarTable>(LispGrammar());
+    auto spToml = std::make_shared<const ZepGrammarTable>(TomlGrammar());
+
+    editor.RegisterSyntaxFactory({ ".vert", ".frag" }, SyntaxProvider{ "gl_shader", tSyntaxFactory([spGlsl](ZepBuffer* pBuffer) {
+                                                                          return std::make_shared<ZepSyntax_Grammar>(*pBuffer, spGlsl);
                                                                       }) });
 
     editor.RegisterSyntaxFactory({ ".hlsl", ".hlsli", ".vs", ".ps" }, SyntaxProvider{ "hlsl_shader", tSyntaxFactory([](ZepBuffer* pBuffer) {
                                                                                          return std::make_shared<ZepSyntax>(*pBuffer, hlsl_keywords, hlsl_identifiers);
                                                                                      }) });
 
-    editor.RegisterSyntaxFactory({ ".cpp", ".cxx", ".h", ".c" }, SyntaxProvider{ "cpp", tSyntaxFactory([](ZepBuffer* pBuffer) {
-                                                                                    return std::make_shared<ZepSyntax>(*pBuffer, cpp_keywords, cpp_identifiers);
+    editor.RegisterSyntaxFactory({ ".cpp", ".cxx", ".h", ".c" }, SyntaxProvider{ "cpp", tSyntaxFactory([spCpp](ZepBuffer* pBuffer) {
+                                                                                    return std::make_shared<ZepSyntax_Grammar>(*pBuffer, spCpp);
                                                                                 }) });
 
-    editor.RegisterSyntaxFactory({ ".lisp", ".lsp" }, SyntaxProvider{ "lisp", tSyntaxFactory([](ZepBuffer* pBuffer) {
-                                                                         return std::make_shared<ZepSyntax>(*pBuffer, lisp_keywords, lisp_identifiers);
+    editor.RegisterSyntaxFactory({ ".lisp", ".lsp" }, SyntaxProvider{ "lisp", tSyntaxFactory([spLisp](ZepBuffer* pBuffer) {
+                                                                         return std::make_shared<ZepSyntax_Grammar>(*pBuffer, spLisp);
                                                                      }) });
     
-    editor.RegisterSyntaxFactory({ ".scm", ".scheme", ".sps", ".sls", ".sld", ".ss", ".sch" }, SyntaxProvider{ "lisp", tSyntaxFactory([](ZepBuffer* pBuffer) {
-                                                                         return std::make_shared<ZepSyntax>(*pBuffer, lisp_keywords, lisp_identifiers);
+    editor.RegisterSyntaxFactory({ ".scm", ".scheme", ".sps", ".sls", ".sld", ".ss", ".sch" }, SyntaxProvider{ "lisp", tSyntaxFactory([spLisp](ZepBuffer* pBuffer) {
+                                                                         return std::make_shared<ZepSyntax_Grammar>(*pBuffer, spLisp);
                                                                      }) });
 
     editor.RegisterSyntaxFactory({ ".cmake", "CMakeLists.txt" }, SyntaxProvider{ "cmake", tSyntaxFactory([](ZepBuffer* pBuffer) {
@@ -154,8 +236,8 @@ void RegisterSyntaxProviders(ZepEditor& editor)
 
     editor.RegisterSyntaxFactory(
         { ".toml" },
-        SyntaxProvider{ "cpp", tSyntaxFactory([](ZepBuffer* pBuffer) {
-                           return std::make_shared<ZepSyntax>(*pBuffer, toml_keywords, toml_identifiers, ZepSyntaxFlags::CaseInsensitive);
+        SyntaxProvider{ "toml", tSyntaxFactory([spToml](ZepBuffer* pBuffer) {
+                           return std::make_shared<ZepSyntax_Grammar>(*pBuffer, spToml);
                        }) });
 
     editor.RegisterSyntaxFactory(
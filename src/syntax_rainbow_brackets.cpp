@@ -11,7 +11,7 @@ namespace Zep
 ZepSyntaxAdorn_RainbowBrackets::ZepSyntaxAdorn_RainbowBrackets(ZepSyntax& syntax, ZepBuffer& buffer)
     : ZepSyntaxAdorn(syntax, buffer)
 {
-    syntax.GetEditor().RegisterCallback(this);
+    syntax.GetEditor().Subscribe(this, Msg::Buffer, &buffer);
     
     Update(0, buffer.EndLocation());
 }
@@ -30,174 +30,97 @@ void ZepSyntaxAdorn_RainbowBrackets::Notify(std::shared_ptr<ZepMessage> spMsg)
         {
             return;
         }
-        else if (spBufferMsg->type == BufferMessageType::TextDeleted)
+
+        auto leftOpen = m_brackets.LeftOpen();
+        bool nestingChanged = false;
+        if (spBufferMsg->type == BufferMessageType::TextDeleted)
         {
-            Clear(spBufferMsg->startLocation, spBufferMsg->endLocation);
+            nestingChanged = Clear(spBufferMsg->startLocation, spBufferMsg->endLocation);
         }
         else if (spBufferMsg->type == BufferMessageType::TextAdded ||
             spBufferMsg->type == BufferMessageType::Loaded)
         {
             Insert(spBufferMsg->startLocation, spBufferMsg->endLocation);
-            Update(spBufferMsg->startLocation, spBufferMsg->endLocation);
+            nestingChanged = Update(spBufferMsg->startLocation, spBufferMsg->endLocation);
         }
         else if (spBufferMsg->type == BufferMessageType::TextChanged)
         {
-            Update(spBufferMsg->startLocation, spBufferMsg->endLocation);
+            nestingChanged = Update(spBufferMsg->startLocation, spBufferMsg->endLocation);
+        }
+        else
+        {
+            return;
+        }
+
+        // The windows only redraw the edited lines; every bracket after the edit may now be another color,
+        // and the first bracket of a type shows whether the text is left open
+        if (leftOpen != m_brackets.LeftOpen())
+        {
+            m_syntax.GetEditor().Broadcast(MakeMessage<BufferMessage>(&m_buffer, BufferMessageType::SyntaxChanged, 0, m_buffer.EndLocation()));
+        }
+        else if (nestingChanged)
+        {
+            m_syntax.GetEditor().Broadcast(MakeMessage<BufferMessage>(&m_buffer, BufferMessageType::SyntaxChanged, spBufferMsg->startLocation, m_buffer.EndLocation()));
         }
     }
 }
 
-SyntaxResult ZepSyntaxAdorn_RainbowBrackets::GetSyntaxAt(long offset, bool& found) const
+SyntaxResult ZepSyntaxAdorn_RainbowBrackets::ToSyntax(const BracketInfo& bracket)
 {
     SyntaxResult data;
-    auto itr = m_brackets.find(offset);
-    if (itr == m_brackets.end())
-    {
-        found = false;
-        return data;
-    }
-
-    found = true;
-    if (!itr->second.valid)
+    if (!bracket.valid)
     {
         data.foreground = ThemeColor::Text;
         data.background = ThemeColor::Error;
     }
     else
     {
-        data.foreground = (ThemeColor)(((int32_t)ThemeColor::UniqueColor0 + itr->second.indent) % (int32_t)ThemeColor::UniqueColorLast);
+        data.foreground = (ThemeColor)(((int32_t)ThemeColor::UniqueColor0 + bracket.indent) % (int32_t)ThemeColor::UniqueColorLast);
         data.background = ThemeColor::None;
     }
-        
     return data;
 }
 
-void ZepSyntaxAdorn_RainbowBrackets::Insert(long start, long end)
+SyntaxResult ZepSyntaxAdorn_RainbowBrackets::GetSyntaxAt(long offset, bool& found) const
 {
-    // Adjust all the brackets after us by the same distance
-    auto diff = end - start;
-    std::map<ByteIndex, Bracket> replace;
-    for (auto& b : m_brackets)
+    BracketInfo info;
+    found = m_brackets.Find(offset, info);
+    if (!found)
     {
-        if (b.first < start)
-            replace[b.first] = b.second;
-        else
-            replace[b.first + diff] = b.second;
+        return SyntaxResult{};
     }
-    std::swap(m_brackets, replace);
-
-    RefreshBrackets();
+    return ToSyntax(info);
 }
 
-void ZepSyntaxAdorn_RainbowBrackets::Clear(long start, long end)
+// Only visit the brackets inside the range, instead of looking up every location
+void ZepSyntaxAdorn_RainbowBrackets::GetSyntaxRange(ByteIndex start, ByteIndex end, SyntaxResult* pResults) const
 {
-    // Remove brackets in the erased section
-    for (auto current = start; current < end; current++)
-    {
-        m_brackets.erase(ByteIndex(current));
-    }
-
-    // Adjust remaining brackets by the difference
-    auto diff = end - start;
-    std::map<ByteIndex, Bracket> replace;
-    for (auto& b : m_brackets)
-    {
-        if (b.first < start)
-            replace[b.first] = b.second;
-        else
-            replace[b.first - diff] = b.second;
-    }
-    std::swap(m_brackets, replace);
-
-    RefreshBrackets();
+    m_brackets.ForEach(start, end, [&](const BracketInfo& info) {
+        pResults[info.location - start] = ToSyntax(info);
+    });
 }
 
-void ZepSyntaxAdorn_RainbowBrackets::Update(long start, long end)
+ByteIndex ZepSyntaxAdorn_RainbowBrackets::FindMatchingBracket(ByteIndex location, bool& answered) const
 {
-    auto& buffer = m_buffer.GetText();
-    auto itrStart = buffer.begin() + start;
-    auto itrEnd = buffer.begin() + end;
-
-    for (auto itrBracket = itrStart; itrBracket != itrEnd; itrBracket++)
-    {
-        auto offset = itrBracket - buffer.begin();
-        if (*itrBracket == '(')
-        {
-            m_brackets[ByteIndex(offset)] = Bracket{0, BracketType::Bracket, true};
-        }
-        else if (*itrBracket == ')')
-        {
-            m_brackets[ByteIndex(offset)] = Bracket{0, BracketType::Bracket, false};
-        }
-        else if (*itrBracket == '[')
-        {
-            m_brackets[ByteIndex(offset)] = Bracket{0, BracketType::Group, true};
-        }
-        else if (*itrBracket == ']')
-        {
-            m_brackets[ByteIndex(offset)] = Bracket{0, BracketType::Group, false};
-        }
-        else if (*itrBracket == '{')
-        {
-            m_brackets[ByteIndex(offset)] = Bracket{0, BracketType::Brace, true};
-        }
-        else if (*itrBracket == '}')
-        {
-            m_brackets[ByteIndex(offset)] = Bracket{0, BracketType::Brace, false};
-        }
-        else
-        {
-            auto itr = m_brackets.find(ByteIndex(offset));
-            if (itr != std::end(m_brackets))
-            {
-                m_brackets.erase(itr);
-            }
-        }
-    }
-    RefreshBrackets();
+    answered = true;
+    return m_brackets.FindMatch(location);
 }
 
-void ZepSyntaxAdorn_RainbowBrackets::RefreshBrackets()
+void ZepSyntaxAdorn_RainbowBrackets::Insert(long start, long end)
 {
-    std::vector<int32_t> indents((int)BracketType::Max, 0);
-    for (auto& b : m_brackets)
-    {
-        auto& bracket = b.second;
-        if (!bracket.is_open)
-        {
-            indents[int(bracket.type)]--;
-        }
-        bracket.indent = indents[int(bracket.type)];
-        // Allow one bracket error, before going back to normal
-        bracket.valid = (indents[int(bracket.type)] < 0) ? false : true;
-        if (!bracket.valid)
-        {
-            indents[int(bracket.type)] = 0;
-        }
-        if (bracket.is_open)
-        {
-            indents[int(bracket.type)]++;
-        }
-    }
+    // Move the brackets after us along by the same distance
+    m_brackets.InsertText(start, end - start);
+}
 
-    auto MarkTails = [&](auto type)
-    {
-        if (indents[int(type)] > 0)
-        {
-            for (auto& b : m_brackets)
-            {
-                if (b.second.type == type)
-                {
-                    b.second.valid = false;
-                    return;
-                }
-            }
+bool ZepSyntaxAdorn_RainbowBrackets::Clear(long start, long end)
+{
+    // Remove brackets in the erased section, and pull the rest back
+    return m_brackets.EraseText(start, end);
+}
 
-        }
-    };
-    MarkTails(BracketType::Brace);
-    MarkTails(BracketType::Bracket);
-    MarkTails(BracketType::Group);
+bool ZepSyntaxAdorn_RainbowBrackets::Update(long start, long end)
+{
+    return m_brackets.Rescan(m_buffer.GetText(), start, end);
 }
 
 } // namespace Zep
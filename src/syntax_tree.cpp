@@ -21,36 +21,25 @@ ZepSyntax_Tree::ZepSyntax_Tree(ZepBuffer& buffer,
     m_adornments.clear();
 }
 
-void ZepSyntax_Tree::UpdateSyntax()
+void ZepSyntax_Tree::UpdateSyntax(SyntaxJob& job)
 {
-    auto& buffer = m_buffer.GetText();
+    auto& buffer = job.text;
     auto itrCurrent = buffer.begin();
     auto itrEnd = buffer.end();
 
-    assert(std::distance(itrCurrent, itrEnd) <= int(m_syntax.size()));
-    assert(m_syntax.size() == buffer.size());
-
     // Mark a region of the syntax buffer with the correct marker
     auto mark = [&](GapBuffer<uint8_t>::const_iterator itrA, GapBuffer<uint8_t>::const_iterator itrB, ThemeColor type, ThemeColor background) {
-        std::fill(m_syntax.begin() + (itrA - buffer.begin()), m_syntax.begin() + (itrB - buffer.begin()), SyntaxData{ type, background });
-    };
-
-    auto markSingle = [&](GapBuffer<uint8_t>::const_iterator itrA, ThemeColor type, ThemeColor background) {
-        (m_syntax.begin() + (itrA - buffer.begin()))->foreground = type;
-        (m_syntax.begin() + (itrA - buffer.begin()))->background = background;
+        job.Mark(ByteIndex(itrA - buffer.begin()), ByteIndex(itrB - buffer.begin()), SyntaxData{ type, background });
     };
 
     // Walk backwards to previous delimiter
     while (itrCurrent != itrEnd)
     {
-        if (m_stop == true)
+        if (job.cancel)
         {
             return;
         }
 
-        // Update start location
-        m_processedChar = long(itrCurrent - buffer.begin());
-
         if (*itrCurrent == '~' || *itrCurrent == '+')
         {
             mark(itrCurrent, itrCurrent + 1, ThemeColor::CursorNormal, ThemeColor::None);
@@ -65,13 +54,14 @@ void ZepSyntax_Tree::UpdateSyntax()
             itrCurrent = itrNext;
         }
 
+        // Could be at the end after marking a line
+        if (itrCurrent == itrEnd)
+        {
+            break;
+        }
         itrCurrent++;
     }
-
-    // If we got here, we sucessfully completed
-    // Reset the target to the beginning
-    m_targetChar = long(0);
-    m_processedChar = long(buffer.size() - 1);
+    job.syntax.resize(buffer.size());
 }
 
 } // namespace Zep
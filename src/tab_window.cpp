@@ -17,6 +17,8 @@ ZepTabWindow::ZepTabWindow(ZepEditor& editor)
 {
     m_spRootRegion = std::make_shared<Region>();
     m_spRootRegion->flags = RegionFlags::Expanding;
+
+    m_editor.Subscribe(this, Msg::MouseDown);
 }
 
 ZepTabWindow::~ZepTabWindow()
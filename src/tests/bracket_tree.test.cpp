@@ -0,0 +1,233 @@
+#include "config_app.h"
+
+#include "zep/bracket_tree.h"
+#include "zep/buffer.h"
+#include "zep/display.h"
+#include "zep/editor.h"
+#include "zep/syntax.h"
+
+#include <gtest/gtest.h>
+#include <random>
+
+using namespace Zep;
+class BracketTreeTest : public testing::Test
+{
+public:
+    BracketTreeTest()
+    {
+        spEditor = std::make_shared<ZepEditor>(new ZepDisplayNull(), ZEP_ROOT, ZepEditorFlags::DisableThreads);
+    }
+
+public:
+    std::shared_ptr<ZepEditor> spEditor;
+};
+
+namespace
+{
+// The straightforward walk over every bracket, which the tree should agree with
+std::map<ByteIndex, BracketInfo> WalkBrackets(const std::string& text)
+{
+    static const std::string brackets = "()[]{}";
+    static const BracketType types[] = { BracketType::Bracket, BracketType::Group, BracketType::Brace };
+
+    std::map<ByteIndex, BracketInfo> ret;
+    std::vector<int32_t> indents((int)BracketType::Max, 0);
+    for (size_t i = 0; i < text.size(); i++)
+    {
+        auto index = brackets.find(text[i]);
+        if (index == std::string::npos)
+            continue;
+
+        BracketInfo info;
+        info.location = ByteIndex(i);
+        info.type = types[index / 2];
+        info.isOpen = (index & 1) == 0;
+
+        auto& indent = indents[int(info.type)];
+        if (!info.isOpen)
+        {
+            indent--;
+        }
+        info.indent = indent;
+        info.valid = indent >= 0;
+        if (!info.valid)
+        {
+            indent = 0;
+        }
+        if (info.isOpen)
+        {
+            indent++;
+        }
+        ret[info.location] = info;
+    }
+
+    for (auto type : types)
+    {
+        if (indents[int(type)] > 0)
+        {
+            for (auto& b : ret)
+            {
+                if (b.second.type == type)
+                {
+                    b.second.valid = false;
+                    break;
+                }
+            }
+        }
+    }
+    return ret;
+}
+} // namespace
+
+TEST_F(BracketTreeTest, MatchesWalkUnderEdits)
+{
+    ZepBuffer* pBuffer = spEditor->GetEmptyBuffer("test.txt");
+    BracketTree tree;
+
+    std::mt19937 rng(1234);
+    const std::string alphabet = "(){}[]ab \n";
+    auto randomText = [&](int length) {
+        std::string str;
+        for (int i = 0; i < length; i++)
+        {
+            str += alphabet[rng() % alphabet.size()];
+        }
+        return str;
+    };
+
+    for (int step = 0; step < 300; step++)
+    {
+        auto size = ByteIndex(pBuffer->GetText().size() - 1);
+        if (size > 0 && (rng() % 3) == 0)
+        {
+            auto start = ByteIndex(rng() % size);
+            auto end = std::min(size, start + ByteIndex(rng() % 8) + 1);
+            pBuffer->Delete(start, end);
+            tree.EraseText(start, end);
+        }
+        else
+        {
+            auto start = ByteIndex(rng() % (size + 1));
+            auto str = randomText(int(rng() % 8) + 1);
+            pBuffer->Insert(start, str);
+            tree.InsertText(start, ByteIndex(str.size()));
+            tree.Rescan(pBuffer->GetText(), start, start + ByteIndex(str.size()));
+        }
+
+        auto text = pBuffer->GetText().string();
+        auto expected = WalkBrackets(text);
+        ASSERT_EQ(tree.Size(), expected.size());
+
+        std::vector<BracketInfo> visited;
+        tree.ForEach(0, ByteIndex(text.size()), [&](const BracketInfo& info) { visited.push_back(info); });
+        ASSERT_EQ(visited.size(), expected.size());
+
+        auto itrExpected = expected.begin();
+        for (auto& info : visited)
+        {
+            ASSERT_EQ(info.location, itrExpected->first);
+            ASSERT_EQ(info.isOpen, itrExpected->second.isOpen);
+            ASSERT_EQ(info.valid, itrExpected->second.valid);
+            if (info.valid)
+            {
+                ASSERT_EQ(info.indent, itrExpected->second.indent);
+            }
+            itrExpected++;
+        }
+    }
+}
+
+TEST_F(BracketTreeTest, FindMatch)
+{
+    ZepBuffer* pBuffer = spEditor->GetEmptyBuffer("test.txt");
+    pBuffer->SetText("(a [b {c} (d)] e) )");
+
+    BracketTree tree;
+    tree.Rescan(pBuffer->GetText(), 0, ByteIndex(pBuffer->GetText().size()));
+
+    ASSERT_EQ(tree.FindMatch(0), 16);
+    ASSERT_EQ(tree.FindMatch(16), 0);
+    ASSERT_EQ(tree.FindMatch(3), 13);
+    ASSERT_EQ(tree.FindMatch(6), 8);
+    ASSERT_EQ(tree.FindMatch(10), 12);
+    ASSERT_EQ(tree.FindMatch(12), 10);
+    ASSERT_EQ(tree.FindMatch(18), InvalidByteIndex);
+    ASSERT_EQ(tree.FindMatch(1), InvalidByteIndex);
+}
+
+TEST_F(BracketTreeTest, SyntaxFindsMatchAfterEdit)
+{
+    ZepBuffer* pBuffer = spEditor->GetEmptyBuffer("test.cpp");
+    pBuffer->SetText("f(a, b);");
+    pBuffer->Insert(2, "(x)");
+    bool answered = false;
+    ASSERT_EQ(pBuffer->GetSyntax()->FindMatchingBracket(1, answered), 9);
+    ASSERT_TRUE(answered);
+    ASSERT_EQ(pBuffer->FindMatchingBracket(0), 9);
+
+    // The tree knows an unmatched bracket has no partner
+    pBuffer->Insert(0, "{");
+    ASSERT_EQ(pBuffer->GetSyntax()->FindMatchingBracket(0, answered), InvalidByteIndex);
+    ASSERT_TRUE(answered);
+    ASSERT_EQ(pBuffer->FindMatchingBracket(0), InvalidByteIndex);
+}
+
+TEST_F(BracketTreeTest, NestingChange)
+{
+    ZepBuffer* pBuffer = spEditor->GetEmptyBuffer("test.txt");
+    pBuffer->SetText("a(b) c(d) e");
+
+    // Balanced pairs don't move the brackets after them
+    BracketTree tree;
+    ASSERT_FALSE(tree.Rescan(pBuffer->GetText(), 0, ByteIndex(pBuffer->GetText().size())));
+    pBuffer->Insert(1, "[x]");
+    tree.InsertText(1, 3);
+    ASSERT_FALSE(tree.Rescan(pBuffer->GetText(), 1, 4));
+    ASSERT_FALSE(tree.EraseText(1, 4));
+    pBuffer->Delete(1, 4);
+
+    // An open one nests everything after it, and is left open
+    pBuffer->Insert(0, "(");
+    tree.InsertText(0, 1);
+    ASSERT_TRUE(tree.Rescan(pBuffer->GetText(), 0, 1));
+    ASSERT_TRUE(tree.LeftOpen());
+    ASSERT_TRUE(tree.EraseText(0, 1));
+    ASSERT_FALSE(tree.LeftOpen());
+}
+
+// The rainbow colors of later lines change when a bracket is typed, so they must be drawn again
+class BracketSyntaxListener : public ZepComponent
+{
+public:
+    BracketSyntaxListener(ZepEditor& editor, ZepBuffer& buffer)
+        : ZepComponent(editor)
+    {
+        editor.Subscribe(this, Msg::Buffer, &buffer);
+    }
+
+    void Notify(std::shared_ptr<ZepMessage> spMsg) override
+    {
+        auto spBufferMsg = std::static_pointer_cast<BufferMessage>(spMsg);
+        if (spBufferMsg->type == BufferMessageType::SyntaxChanged)
+        {
+            changed.push_back(NVec2<ByteIndex>(spBufferMsg->startLocation, spBufferMsg->endLocation));
+        }
+    }
+
+    std::vector<NVec2<ByteIndex>> changed;
+};
+
+TEST_F(BracketTreeTest, SyntaxChangedAfterBracket)
+{
+    ZepBuffer* pBuffer = spEditor->GetEmptyBuffer("test.cpp");
+    pBuffer->SetText("f(a);\ng(b);\nh(c);\n");
+    BracketSyntaxListener listener(*spEditor, *pBuffer);
+
+    pBuffer->Insert(2, "x");
+    ASSERT_TRUE(listener.changed.empty());
+
+    pBuffer->Insert(8, "{");
+    ASSERT_FALSE(listener.changed.empty());
+    ASSERT_LE(listener.changed.back().x, 8);
+    ASSERT_EQ(listener.changed.back().y, pBuffer->EndLocation());
+}
@@ -0,0 +1,87 @@
+#include "zep/display.h"
+#include "zep/glyph_cache.h"
+
+#include <gtest/gtest.h>
+
+using namespace Zep;
+
+// Every code point has its own width, so measuring the wrong one shows
+class ZepDisplayCodePoints : public ZepDisplayNull
+{
+public:
+    virtual NVec2f GetTextSize(const uint8_t* pBegin, const uint8_t* pEnd = nullptr) const override
+    {
+        measured++;
+        float width = 0.0f;
+        while (pBegin < pEnd)
+        {
+            width += float(utf8::unchecked::next(pBegin) % 7 + 1);
+        }
+        return NVec2f(width, 10.0f);
+    }
+
+    mutable int measured = 0;
+};
+
+TEST(GlyphCache, insert_and_grow)
+{
+    GlyphCache cache;
+    ASSERT_EQ(cache.Find(0x4E00), nullptr);
+
+    for (uint32_t codePoint = 0x4E00; codePoint < 0x4E00 + 5000; codePoint++)
+    {
+        cache.Insert(codePoint, NVec2f(float(codePoint & 0xFF), 1.0f));
+    }
+    cache.Insert(0x4E00, NVec2f(3.0f, 2.0f));
+    ASSERT_EQ(cache.Size(), 5000u);
+
+    ASSERT_EQ(*cache.Find(0x4E00), NVec2f(3.0f, 2.0f));
+    for (uint32_t codePoint = 0x4E01; codePoint < 0x4E00 + 5000; codePoint++)
+    {
+        auto pSize = cache.Find(codePoint);
+        ASSERT_NE(pSize, nullptr);
+        ASSERT_EQ(pSize->x, float(codePoint & 0xFF));
+    }
+    ASSERT_EQ(cache.Find(0x1F600), nullptr);
+}
+
+TEST(Display, char_sizes)
+{
+    ZepDisplayCodePoints display;
+    std::string text = "a\x7F\xC3\xA9\xE2\x82\xAC\xE4\xB8\x80\xF0\x9F\x98\x80";
+    auto pBegin = (const uint8_t*)text.c_str();
+    auto pEnd = pBegin + text.size();
+
+    // The character measured is the one asked for, including the last ASCII one
+    ASSERT_EQ(display.GetCharSize(pBegin + 1).x, float(0x7F % 7 + 1));
+    ASSERT_EQ(display.GetCharSize(pBegin + 2).x, float(0xE9 % 7 + 1));
+    ASSERT_EQ(display.GetCharSize(pBegin + 4).x, float(0x20AC % 7 + 1));
+    ASSERT_EQ(display.GetCharSize(pBegin + 7).x, float(0x4E00 % 7 + 1));
+    ASSERT_EQ(display.GetCharSize(pBegin + 10).x, float(0x1F600 % 7 + 1));
+
+    // A run measures the same, and the common blocks were measured up front
+    std::vector<NVec2f> sizes;
+    auto measured = display.measured;
+    display.GetCharSizes(pBegin, pEnd, sizes);
+    ASSERT_EQ(display.measured, measured);
+    ASSERT_EQ(sizes.size(), 6u);
+    for (size_t index = 0, offset = 0; index < sizes.size(); index++)
+    {
+        ASSERT_EQ(sizes[index], display.GetCharSize(pBegin + offset));
+        offset += utf8_codepoint_length(text[offset]);
+    }
+}
+
+TEST(Display, number_text)
+{
+    ZepDisplayCodePoints display;
+    auto& numberText = display.GetNumberText(1234);
+    ASSERT_EQ(numberText.text, "1234");
+    ASSERT_EQ(numberText.size.x, float(('1' % 7 + 1) + ('2' % 7 + 1) + ('3' % 7 + 1) + ('4' % 7 + 1)));
+
+    // Measured once
+    auto measured = display.measured;
+    display.GetNumberText(1234);
+    ASSERT_EQ(display.measured, measured);
+    ASSERT_EQ(display.GetNumberText(1234 + 512).text, "1746");
+}
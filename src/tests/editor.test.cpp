@@ -0,0 +1,203 @@
+#include "config_app.h"
+
+#include "zep/buffer.h"
+#include "zep/display.h"
+#include "zep/editor.h"
+#include "zep/filesystem.h"
+#include "zep/mode.h"
+#include "zep/syntax.h"
+
+#include <filesystem>
+#include <gtest/gtest.h>
+#include <thread>
+
+using namespace Zep;
+
+// Counts what it hears, and can leave when it hears something
+struct ZepListener : public ZepComponent
+{
+    ZepListener(ZepEditor& editor)
+        : ZepComponent(editor)
+    {
+    }
+
+    virtual void Notify(std::shared_ptr<ZepMessage> message) override
+    {
+        heard.push_back(message->messageId);
+        if (leaveOnNotify)
+        {
+            GetEditor().UnRegisterCallback(leaveOnNotify);
+        }
+    }
+
+    std::vector<Msg> heard;
+    IZepComponent* leaveOnNotify = nullptr;
+};
+
+class EditorMessageTest : public testing::Test
+{
+public:
+    EditorMessageTest()
+    {
+        spEditor = std::make_shared<ZepEditor>(new ZepDisplayNull(), ZEP_ROOT, ZepEditorFlags::DisableThreads);
+        pBuffer1 = spEditor->InitWithText("one.txt", "one\n");
+        pBuffer2 = spEditor->GetEmptyBuffer("two.txt");
+    }
+
+    std::shared_ptr<ZepEditor> spEditor;
+    ZepBuffer* pBuffer1;
+    ZepBuffer* pBuffer2;
+};
+
+TEST_F(EditorMessageTest, subscribe_by_message_and_buffer)
+{
+    ZepListener mouse(*spEditor);
+    ZepListener buffer1(*spEditor);
+    ZepListener anyBuffer(*spEditor);
+    spEditor->Subscribe(&mouse, Msg::MouseUp);
+    spEditor->Subscribe(&buffer1, Msg::Buffer, pBuffer1);
+    spEditor->Subscribe(&anyBuffer, Msg::Buffer);
+
+    spEditor->Broadcast(MakeMessage<ZepMessage>(Msg::MouseUp, NVec2f(0.0f)));
+    spEditor->Broadcast(MakeMessage<BufferMessage>(pBuffer2, BufferMessageType::MarkersChanged, ByteIndex(0), ByteIndex(0)));
+    spEditor->Broadcast(MakeMessage<BufferMessage>(pBuffer1, BufferMessageType::MarkersChanged, ByteIndex(0), ByteIndex(0)));
+    spEditor->Broadcast(MakeMessage<ZepMessage>(Msg::ConfigChanged));
+
+    ASSERT_EQ(mouse.heard, std::vector<Msg>{ Msg::MouseUp });
+    ASSERT_EQ(buffer1.heard, std::vector<Msg>{ Msg::Buffer });
+    ASSERT_EQ(anyBuffer.heard, std::vector<Msg>(2, Msg::Buffer));
+
+    spEditor->Unsubscribe(&buffer1, Msg::Buffer, pBuffer1);
+    spEditor->Broadcast(MakeMessage<BufferMessage>(pBuffer1, BufferMessageType::MarkersChanged, ByteIndex(0), ByteIndex(0)));
+    ASSERT_EQ(buffer1.heard.size(), 1u);
+}
+
+// Leaving while a message is sent doesn't skip the next listener, and the one that left hears nothing
+TEST_F(EditorMessageTest, leave_during_broadcast)
+{
+    ZepListener first(*spEditor);
+    ZepListener second(*spEditor);
+    ZepListener third(*spEditor);
+    spEditor->Subscribe(&first, Msg::ConfigChanged);
+    spEditor->Subscribe(&second, Msg::ConfigChanged);
+    spEditor->Subscribe(&third, Msg::ConfigChanged);
+    first.leaveOnNotify = &second;
+    second.leaveOnNotify = &second;
+
+    spEditor->Broadcast(MakeMessage<ZepMessage>(Msg::ConfigChanged));
+    ASSERT_EQ(first.heard.size(), 1u);
+    ASSERT_TRUE(second.heard.empty());
+    ASSERT_EQ(third.heard.size(), 1u);
+
+    first.leaveOnNotify = nullptr;
+    spEditor->Broadcast(MakeMessage<ZepMessage>(Msg::ConfigChanged));
+    ASSERT_EQ(first.heard.size(), 2u);
+    ASSERT_EQ(third.heard.size(), 2u);
+}
+
+// Freed messages are reused by the next of the same size
+TEST_F(EditorMessageTest, message_memory_is_reused)
+{
+    const void* pFirst;
+    {
+        auto spMessage = MakeMessage<ZepMessage>(Msg::Tick);
+        pFirst = spMessage.get();
+    }
+    auto spMessage = MakeMessage<ZepMessage>(Msg::Tick);
+    ASSERT_EQ(spMessage.get(), pFirst);
+}
+
+// Editors on threads of their own, some sharing a pool; build with ZEP_SANITIZE_THREAD to check them for races
+TEST(EditorThreads, parallel_editors)
+{
+    const int EditorCount = 4;
+    const int LineCount = 25;
+    std::vector<std::string> results(EditorCount);
+    std::vector<std::thread> threads;
+    for (int index = 0; index < EditorCount; index++)
+    {
+        threads.emplace_back([index, &results]() {
+            ZepEditor editor(new ZepDisplayNull(), ZEP_ROOT, (index & 1) ? ZepEditorFlags::SharedThreadPool : ZepEditorFlags::None);
+            editor.SetDisplayRegion(NVec2f(0.0f, 0.0f), NVec2f(1024.0f, 768.0f));
+            auto pBuffer = editor.InitWithText("parallel.cpp", "int main()\n{\n}\n");
+            for (int line = 0; line < LineCount; line++)
+            {
+                for (auto ch : std::string("jOreturn 0;"))
+                {
+                    pBuffer->GetMode()->AddKeyPress(ch);
+                }
+                pBuffer->GetMode()->AddKeyPress(ExtKeys::ESCAPE);
+                editor.RefreshRequired();
+                editor.Display();
+            }
+            pBuffer->GetSyntax()->Wait();
+            results[index] = pBuffer->GetText().string();
+        });
+    }
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    for (auto& result : results)
+    {
+        size_t count = 0;
+        for (auto pos = result.find("return 0;"); pos != std::string::npos; pos = result.find("return 0;", pos + 1))
+        {
+            count++;
+        }
+        ASSERT_EQ(count, size_t(LineCount));
+    }
+}
+
+#ifdef ZEP_FEATURE_CPP_FILE_SYSTEM
+// An atomic write replaces the file whole, and leaves nothing beside it
+TEST(EditorFileSystem, write_replaces_file)
+{
+    ZepFileSystemCPP fileSystem;
+    fileSystem.SetAtomicWrite(true);
+    auto dir = std::filesystem::temp_directory_path() / "zep_write_test";
+    std::filesystem::create_directories(dir);
+    auto path = ZepPath((dir / "file.txt").string());
+
+    ASSERT_TRUE(fileSystem.Write(path, "first version", 13));
+    ASSERT_TRUE(fileSystem.Write(path, "second", 6));
+    ASSERT_EQ(fileSystem.Read(path), "second");
+
+    size_t count = 0;
+    for (auto& entry : std::filesystem::directory_iterator(dir))
+    {
+        (void)entry;
+        count++;
+    }
+    std::filesystem::remove_all(dir);
+    ASSERT_EQ(count, 1u);
+}
+
+// Writes go through a link to the file it points at, in place by default and atomically when asked
+TEST(EditorFileSystem, write_through_link)
+{
+    auto dir = std::filesystem::temp_directory_path() / "zep_link_test";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    auto target = ZepPath((dir / "file.txt").string());
+    auto link = ZepPath((dir / "link.txt").string());
+
+    ZepFileSystemCPP fileSystem;
+    ASSERT_TRUE(fileSystem.Write(target, "first", 5));
+    std::error_code ec;
+    std::filesystem::create_symlink(target.string(), link.string(), ec);
+    if (!ec)
+    {
+        for (auto atomic : { false, true })
+        {
+            fileSystem.SetAtomicWrite(atomic);
+            ASSERT_TRUE(fileSystem.Write(link, atomic ? "atomic" : "in place", atomic ? 6 : 8));
+            ASSERT_TRUE(std::filesystem::is_symlink(link.string()));
+            ASSERT_EQ(fileSystem.Read(target), atomic ? "atomic" : "in place");
+        }
+    }
+    std::filesystem::remove_all(dir);
+}
+#endif
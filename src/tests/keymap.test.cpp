@@ -0,0 +1,113 @@
+#include "zep/keymap.h"
+#include "zep/mode.h"
+
+#include <gtest/gtest.h>
+
+using namespace Zep;
+
+namespace
+{
+const StringId id_TestFind("TestFind");
+const StringId id_TestYank("TestYank");
+const StringId id_TestSelect("TestSelect");
+}
+
+class KeyMapTest : public testing::Test
+{
+public:
+    KeyMapTest()
+    {
+        keymap_add({ &map }, { "<D>f<.>", "f<.>" }, id_TestFind);
+        keymap_add({ &map }, { "<D><R>yy", "<R>yy", "<D>yy", "yy" }, id_TestYank);
+        keymap_add({ &map }, { "<c-s-Left>" }, id_TestSelect);
+        keymap_add({ &map }, { "0" }, id_MotionLineBegin);
+    }
+
+    KeyMap map;
+};
+
+TEST_F(KeyMapTest, captures)
+{
+    KeyMapResult result;
+    keymap_find(map, "12\"ayy", result);
+    ASSERT_EQ(result.foundMapping, id_TestYank);
+    ASSERT_EQ(result.TotalCount(), 12);
+    ASSERT_EQ(result.RegisterName(), 'a');
+    ASSERT_TRUE(result.captureChars.empty());
+
+    result = KeyMapResult();
+    keymap_find(map, "3f<", result);
+    ASSERT_EQ(result.foundMapping, id_TestFind);
+    ASSERT_EQ(result.TotalCount(), 3);
+    ASSERT_EQ(result.captureChars.size(), 1u);
+    ASSERT_EQ(result.captureChars[0], '<');
+}
+
+// A command added after the map has been searched is found by the next search
+TEST_F(KeyMapTest, add_after_find)
+{
+    KeyMapResult result;
+    keymap_find(map, "yy", result);
+    ASSERT_EQ(result.foundMapping, id_TestYank);
+
+    keymap_add({ &map }, { "yw" }, id_TestSelect);
+    result = KeyMapResult();
+    keymap_find(map, "yw", result);
+    ASSERT_EQ(result.foundMapping, id_TestSelect);
+
+    result = KeyMapResult();
+    keymap_find(map, "yy", result);
+    ASSERT_EQ(result.foundMapping, id_TestYank);
+}
+
+// A digit that is a command of its own, rather than the start of a count
+TEST_F(KeyMapTest, key_before_wildcard)
+{
+    KeyMapResult result;
+    keymap_find(map, "0", result);
+    ASSERT_EQ(result.foundMapping, id_MotionLineBegin);
+
+    result = KeyMapResult();
+    keymap_find(map, "10", result);
+    ASSERT_TRUE(result.needMoreChars);
+}
+
+TEST_F(KeyMapTest, need_more_chars)
+{
+    const char* partial[] = { "y", "\"", "\"a", "2\"a", "f", "4" };
+    for (auto& command : partial)
+    {
+        KeyMapResult result;
+        keymap_find(map, command, result);
+        ASSERT_TRUE(result.needMoreChars) << command;
+        ASSERT_EQ(result.foundMapping, StringId()) << command;
+    }
+}
+
+// Groups match however the modifiers are written, and a key that isn't a char doesn't match <.>
+TEST_F(KeyMapTest, groups)
+{
+    KeyMapResult result;
+    keymap_find(map, "<S-C-Left>", result);
+    ASSERT_EQ(result.foundMapping, id_TestSelect);
+
+    result = KeyMapResult();
+    keymap_find(map, "f<Escape>", result);
+    ASSERT_EQ(result.foundMapping, StringId());
+    ASSERT_FALSE(result.needMoreChars);
+}
+
+TEST_F(KeyMapTest, unknown)
+{
+    KeyMapResult result;
+    keymap_find(map, "q", result);
+    ASSERT_EQ(result.foundMapping, StringId());
+    ASSERT_FALSE(result.needMoreChars);
+    ASSERT_EQ(result.commandWithoutGroups, "q");
+    ASSERT_TRUE(result.searchPath.empty());
+
+    result = KeyMapResult();
+    result.recordSearchPath = true;
+    keymap_find(map, "2yy", result);
+    ASSERT_EQ(result.searchPath, "(D:2)(<D>)(y)(y) : TestYank");
+}
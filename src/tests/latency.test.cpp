@@ -0,0 +1,106 @@
+#include "config_app.h"
+
+#include "zep/buffer.h"
+#include "zep/display.h"
+#include "zep/editor.h"
+#include "zep/latency.h"
+#include "zep/mode_vim.h"
+#include "zep/tab_window.h"
+#include "zep/window.h"
+
+#include <gtest/gtest.h>
+
+using namespace Zep;
+
+// Every latency is in the bucket whose top is at or above it, and within a quarter of it
+TEST(Latency, histogram_buckets)
+{
+    for (uint64_t us = 0; us < 5000000; us = us * 9 / 8 + 1)
+    {
+        auto index = LatencyHistogram::BucketIndex(us);
+        ASSERT_GE(LatencyHistogram::BucketTop(index), us);
+        ASSERT_LE(LatencyHistogram::BucketTop(index), us + us / 4);
+        if (index > 0)
+        {
+            ASSERT_LT(LatencyHistogram::BucketTop(index - 1), us);
+        }
+    }
+
+    LatencyHistogram histogram;
+    for (uint64_t us = 1; us <= 100; us++)
+    {
+        histogram.Add(us * 100);
+    }
+    ASSERT_EQ(histogram.count, 100u);
+    ASSERT_EQ(histogram.maxUs, 10000u);
+    ASSERT_DOUBLE_EQ(histogram.Average(), 5050.0);
+    ASSERT_GE(histogram.Percentile(0.5), 5000u);
+    ASSERT_LE(histogram.Percentile(0.5), 6250u);
+    ASSERT_EQ(histogram.Percentile(1.0), 10000u);
+}
+
+// Keys are counted by the mode they were pressed in, and reach the frame when the editor displays
+TEST(Latency, keys_to_frame)
+{
+    auto spEditor = std::make_shared<ZepEditor>(new ZepDisplayNull(), ZEP_ROOT, ZepEditorFlags::DisableThreads);
+    auto spMode = std::make_shared<ZepMode_Vim>(*spEditor);
+    spMode->Init();
+    spEditor->InitWithText("test.txt", "");
+    spMode->Begin(spEditor->GetActiveTabWindow()->GetActiveWindow());
+    spEditor->SetDisplayRegion(NVec2f(0.0f, 0.0f), NVec2f(1024.0f, 1024.0f));
+
+    spMode->AddKeyPress('i');
+    spMode->AddKeyPress('a');
+    spMode->AddKeyPress('b');
+    spMode->AddKeyPress(ExtKeys::ESCAPE);
+
+    auto find = [&](const std::string& mode, const std::string& command) {
+        for (auto& stat : spEditor->GetLatencyStats().GetStats())
+        {
+            if (stat.mode == mode && stat.command == command)
+            {
+                return stat;
+            }
+        }
+        return LatencyStat();
+    };
+    ASSERT_EQ(find("Vim:Normal", "InsertMode").handled.count, 1u);
+    ASSERT_EQ(find("Vim:Insert", "(text)").handled.count, 2u);
+    ASSERT_EQ(find("Vim:Insert", "(text)").frame.count, 0u);
+
+    spEditor->Display();
+    ASSERT_EQ(find("Vim:Insert", "(text)").frame.count, 2u);
+    ASSERT_EQ(find("Vim:Normal", "InsertMode").frame.count, 1u);
+
+    // Shown in a window of its own
+    auto pStats = spEditor->FindExCommand(std::string("ZStats"));
+    ASSERT_NE(pStats, nullptr);
+    auto windowCount = spEditor->GetActiveTabWindow()->GetWindows().size();
+    pStats->Run({ ":ZStats" });
+    ASSERT_EQ(spEditor->GetActiveTabWindow()->GetWindows().size(), windowCount + 1);
+    auto& statsBuffer = spEditor->GetActiveTabWindow()->GetWindows().back()->GetBuffer();
+    ASSERT_NE(statsBuffer.GetText().string().find("Vim:Insert"), std::string::npos);
+
+    pStats->Run({ ":ZStats" });
+    ASSERT_EQ(spEditor->GetActiveTabWindow()->GetWindows().size(), windowCount + 1);
+
+    pStats->Run({ ":ZStats", "reset" });
+    ASSERT_TRUE(spEditor->GetLatencyStats().GetStats().empty());
+}
+
+// With no frames, the keys waiting for one don't pile up
+TEST(Latency, pending_keys_capped)
+{
+    ZepLatencyStats stats;
+    for (uint64_t key = 0; key < 5000; key++)
+    {
+        stats.KeyHandled("Vim:Insert", "(text)", key, key + 1);
+    }
+    stats.FrameDisplayed(6000);
+
+    auto result = stats.GetStats();
+    ASSERT_EQ(result.size(), 1u);
+    ASSERT_EQ(result[0].handled.count, 5000u);
+    ASSERT_GT(result[0].frame.count, 0u);
+    ASSERT_LE(result[0].frame.count, 1024u);
+}
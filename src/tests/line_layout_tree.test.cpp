@@ -0,0 +1,94 @@
+#include "zep/line_layout_tree.h"
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <random>
+
+using namespace Zep;
+
+namespace
+{
+LineLayout MakeLayout(std::mt19937& rng)
+{
+    LineLayout layout;
+    layout.spanCount = 1 + long(rng() % 4);
+    layout.heightPx = 10.0f + 12.0f * (layout.spanCount - 1) + float(rng() % 3);
+    layout.widthPx = float(rng() % 500);
+    return layout;
+}
+
+// The sums and searches against a plain list of the same lines
+void CheckTree(const LineLayoutTree& tree, const std::vector<LineLayout>& lines)
+{
+    ASSERT_EQ(tree.Size(), long(lines.size()));
+    double height = 0.0;
+    long spans = 0;
+    float width = 0.0f;
+    for (long line = 0; line < long(lines.size()); line++)
+    {
+        ASSERT_EQ(tree.HeightPrefix(line), height);
+        ASSERT_EQ(tree.SpanPrefix(line), spans);
+        ASSERT_EQ(tree.Get(line).heightPx, lines[line].heightPx);
+        ASSERT_EQ(tree.FindHeight(height + lines[line].heightPx * 0.5), line);
+        ASSERT_EQ(tree.FindSpan(spans + lines[line].spanCount - 1), line);
+        height += lines[line].heightPx;
+        spans += lines[line].spanCount;
+        width = std::max(width, lines[line].widthPx);
+    }
+    ASSERT_EQ(tree.TotalHeight(), height);
+    ASSERT_EQ(tree.TotalSpans(), spans);
+    ASSERT_EQ(tree.MaxWidth(), width);
+    ASSERT_EQ(tree.FindHeight(height), long(lines.size()));
+    ASSERT_EQ(tree.FindSpan(spans), long(lines.size()));
+}
+} // namespace
+
+// Lines inserted, erased and changed anywhere keep the sums right
+TEST(LineLayoutTree, matches_list)
+{
+    std::mt19937 rng(7);
+    std::vector<LineLayout> lines(100);
+    for (auto& line : lines)
+    {
+        line = MakeLayout(rng);
+    }
+
+    LineLayoutTree tree;
+    tree.Assign(lines);
+    CheckTree(tree, lines);
+
+    for (int step = 0; step < 200; step++)
+    {
+        auto at = long(rng() % (lines.size() + 1));
+        switch (rng() % 3)
+        {
+        case 0:
+        {
+            auto count = 1 + long(rng() % 5);
+            tree.Insert(at, count);
+            lines.insert(lines.begin() + at, count, LineLayout());
+            for (auto line = at; line < at + count; line++)
+            {
+                lines[line] = MakeLayout(rng);
+                tree.Set(line, lines[line]);
+            }
+            break;
+        }
+        case 1:
+        {
+            auto end = std::min(long(lines.size()), at + 1 + long(rng() % 5));
+            tree.Erase(at, end);
+            lines.erase(lines.begin() + at, lines.begin() + end);
+            break;
+        }
+        default:
+            if (at < long(lines.size()))
+            {
+                lines[at] = MakeLayout(rng);
+                tree.Set(at, lines[at]);
+            }
+            break;
+        }
+        CheckTree(tree, lines);
+    }
+}
@@ -93,6 +93,38 @@ TEST_F(VimTest, CheckDisplayWrap)
         ASSERT_STREQ(pBuffer->GetText().string().c_str(), target); \
     };
 
+// Text typed before a frame goes in as one insert, which undoes as the keys would have
+TEST_F(VimTest, CoalescedInsert)
+{
+    spEditor->SetFlags(spEditor->GetFlags() | ZepEditorFlags::CoalesceInput);
+    pBuffer->SetText("one");
+    spMode->AddCommandText("ihello ");
+    ASSERT_STREQ(pBuffer->GetText().string().c_str(), "one");
+    spEditor->Display();
+    ASSERT_STREQ(pBuffer->GetText().string().c_str(), "hello one");
+
+    // The j of jk waits for the k, and the text before it goes in first
+    spMode->AddCommandText("worldjk");
+    ASSERT_STREQ(pBuffer->GetText().string().c_str(), "hello worldone");
+    ASSERT_EQ(spMode->GetEditorMode(), EditorMode::Normal);
+
+    spMode->AddCommandText("u");
+    ASSERT_STREQ(pBuffer->GetText().string().c_str(), "one");
+
+    // j and another char is text, as it was
+    spMode->AddCommandText("ajx");
+    spMode->AddKeyPress(ExtKeys::ESCAPE);
+    ASSERT_STREQ(pBuffer->GetText().string().c_str(), "ojxne");
+
+    // A new line only types, so it waits with the rest
+    spMode->AddCommandText("Ia");
+    spMode->AddKeyPress(ExtKeys::RETURN);
+    spMode->AddCommandText("b");
+    ASSERT_STREQ(pBuffer->GetText().string().c_str(), "ojxne");
+    spEditor->FlushInput();
+    ASSERT_STREQ(pBuffer->GetText().string().c_str(), "a\nbojxne");
+}
+
 TEST_F(VimTest, UndoRedo)
 {
     // The issue here is that setting the text _should_ update the buffer!
@@ -430,6 +462,10 @@ CURSOR_TEST(motion_ge_startspace, "one! two three", "wwjge", 3, 0);
 CURSOR_TEST(motion_0, "one two", "llll0", 0, 0);
 CURSOR_TEST(motion_gg, "one two", "llllgg", 0, 0);
 CURSOR_TEST(motion_dollar, "one two", "ll$", 6, 0);
+CURSOR_TEST(motion_percent, "(a (b) c)", "%", 8, 0);
+CURSOR_TEST(motion_percent_back, "(a (b) c)", "%%", 0, 0);
+CURSOR_TEST(motion_percent_from_text, "a [b]", "%", 4, 0);
+CURSOR_TEST(motion_percent_multiline, "{\na\n}", "%", 0, 2);
 CURSOR_TEST(motion_cr_then_escape, "one", "$a\njk", 0, 1);
 CURSOR_TEST(cursor_copy_yy_paste_line, "one\ntwo", "yyp", 0, 1);
 
@@ -0,0 +1,86 @@
+#include "zep/mcommon/animation/timer.h"
+
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <sstream>
+#include <thread>
+
+using namespace Zep;
+
+namespace
+{
+const profile_zone* FindZone(const std::vector<profile_zone>& zones, const std::string& name)
+{
+    auto itr = std::find_if(zones.begin(), zones.end(), [&](const profile_zone& zone) { return zone.name == name; });
+    return itr == zones.end() ? nullptr : &*itr;
+}
+} // namespace
+
+// Durations of 1..100us give known percentiles, whichever thread they came from
+TEST(Profiler, zone_percentiles)
+{
+    profile_clear();
+    auto record = [](uint64_t first, uint64_t last) {
+        for (auto us = first; us <= last; us++)
+        {
+            profile_add_event("TestZone", 1000000, 1000000 + us * 1000);
+        }
+    };
+    std::thread worker(record, 1, 50);
+    record(51, 100);
+    worker.join();
+
+    auto zones = profile_get_zones();
+    auto pZone = FindZone(zones, "TestZone");
+    ASSERT_NE(pZone, nullptr);
+    ASSERT_EQ(pZone->count, 100u);
+    ASSERT_DOUBLE_EQ(pZone->average, 50.5);
+    ASSERT_DOUBLE_EQ(pZone->p50, 50.0);
+    ASSERT_DOUBLE_EQ(pZone->p95, 95.0);
+    ASSERT_DOUBLE_EQ(pZone->p99, 99.0);
+
+    profile_clear();
+    ASSERT_EQ(FindZone(profile_get_zones(), "TestZone"), nullptr);
+}
+
+// Only the most recent events are kept
+TEST(Profiler, ring_wraps)
+{
+    profile_clear();
+    for (uint64_t index = 0; index < ProfileEventsPerThread + 10; index++)
+    {
+        profile_add_event("Wrapped", 0, index < 10 ? 5000 : 1000);
+    }
+    auto zones = profile_get_zones();
+    auto pZone = FindZone(zones, "Wrapped");
+    ASSERT_NE(pZone, nullptr);
+    ASSERT_LT(pZone->count, ProfileEventsPerThread);
+    ASSERT_DOUBLE_EQ(pZone->p99, 1.0);
+}
+
+TEST(Profiler, chrome_trace)
+{
+    profile_clear();
+    std::thread worker([]() {
+        profile_set_thread_name("Trace \"Worker\"");
+        TIME_SCOPE(TraceZone);
+    });
+    worker.join();
+    {
+        TIME_SCOPE(TraceZone);
+    }
+
+    std::ostringstream str;
+    profile_write_chrome_trace(str);
+    auto trace = str.str();
+    ASSERT_EQ(trace.find("{\"displayTimeUnit\":\"ns\",\"traceEvents\":["), 0u);
+    ASSERT_NE(trace.find("\"name\":\"Trace \\\"Worker\\\"\""), std::string::npos);
+
+    size_t count = 0;
+    for (auto pos = trace.find("\"name\":\"TraceZone\""); pos != std::string::npos; pos = trace.find("\"name\":\"TraceZone\"", pos + 1))
+    {
+        count++;
+    }
+    ASSERT_EQ(count, 2u);
+    ASSERT_EQ(trace.substr(trace.size() - 4), "\n]}\n");
+}
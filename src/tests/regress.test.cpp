@@ -0,0 +1,137 @@
+#include "config_app.h"
+
+#include "zep/buffer.h"
+#include "zep/display.h"
+#include "zep/editor.h"
+#include "zep/mode_vim.h"
+#include "zep/regress.h"
+#include "zep/tab_window.h"
+#include "zep/window.h"
+
+#include <cstdio>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <sstream>
+
+using namespace Zep;
+
+class RegressTest : public testing::Test
+{
+public:
+    std::shared_ptr<ZepEditor> MakeEditor(const std::string& text)
+    {
+        auto spEditor = std::make_shared<ZepEditor>(new ZepDisplayNull(), ZEP_ROOT, ZepEditorFlags::DisableThreads);
+        spEditor->SetDisplayRegion(NVec2f(0.0f, 0.0f), NVec2f(1024.0f, 768.0f));
+        spEditor->InitWithText("test.txt", text);
+        return spEditor;
+    }
+
+    void Type(ZepEditor& editor, const std::string& keys)
+    {
+        for (auto& ch : keys)
+        {
+            auto key = ch == '\n' ? uint32_t(ExtKeys::RETURN) : ch == 27 ? uint32_t(ExtKeys::ESCAPE) : uint32_t(ch);
+            editor.GetActiveTabWindow()->GetActiveWindow()->GetBuffer().GetMode()->AddKeyPress(key);
+        }
+    }
+};
+
+TEST_F(RegressTest, trace_round_trip)
+{
+    WorkloadTrace trace;
+    trace.bufferName = "trace.cpp";
+    trace.text = "int main()\n{\n}\n";
+
+    WorkloadEvent ev;
+    ev.type = WorkloadEventType::Resize;
+    ev.size = NVec2f(800.0f, 600.0f);
+    trace.events.push_back(ev);
+
+    ev = WorkloadEvent();
+    ev.type = WorkloadEventType::Key;
+    ev.timeUs = 1000;
+    ev.key = ExtKeys::RETURN;
+    ev.modifiers = ModifierKey::Shift;
+    trace.events.push_back(ev);
+
+    ev = WorkloadEvent();
+    ev.type = WorkloadEventType::MouseDown;
+    ev.timeUs = 5000000;
+    ev.pos = NVec2f(-3.0f, 250.0f);
+    ev.button = ZepMouseButton::Right;
+    trace.events.push_back(ev);
+
+    std::stringstream str;
+    WriteWorkloadTrace(str, trace);
+
+    WorkloadTrace read;
+    ASSERT_TRUE(ReadWorkloadTrace(str, read));
+    ASSERT_EQ(read.bufferName, trace.bufferName);
+    ASSERT_EQ(read.text, trace.text);
+    ASSERT_EQ(read.events.size(), 3u);
+    ASSERT_EQ(read.events[0].size, NVec2f(800.0f, 600.0f));
+    ASSERT_EQ(read.events[1].timeUs, 1000u);
+    ASSERT_EQ(read.events[1].key, uint32_t(ExtKeys::RETURN));
+    ASSERT_EQ(read.events[1].modifiers, uint32_t(ModifierKey::Shift));
+    ASSERT_EQ(read.events[2].timeUs, 5000000u);
+    ASSERT_EQ(read.events[2].pos, NVec2f(-3.0f, 250.0f));
+    ASSERT_EQ(read.events[2].button, ZepMouseButton::Right);
+
+    // A cut short trace is an error, not a shorter session
+    auto bytes = str.str();
+    std::istringstream truncated(bytes.substr(0, bytes.size() - 1));
+    ASSERT_FALSE(ReadWorkloadTrace(truncated, read));
+
+    // So is a length longer than the file, without trying to make room for it
+    auto nameSize = bytes.find(trace.bufferName) - 1;
+    std::istringstream corrupt(bytes.substr(0, nameSize) + "\xff\xff\xff\xff\xff\xff\xff\x7f" + bytes.substr(nameSize + 1));
+    ASSERT_FALSE(ReadWorkloadTrace(corrupt, read));
+}
+
+// What was typed into one editor, replayed into another, gives the same text
+TEST_F(RegressTest, record_and_replay)
+{
+    auto spEditor = MakeEditor("Hello\nWorld\n");
+    auto& recorder = spEditor->GetWorkloadRecorder();
+    recorder.Start(spEditor->GetActiveTabWindow()->GetActiveWindow()->GetBuffer(), spEditor->GetDisplayRegion());
+    Type(*spEditor, "jAagain\x1b" "kdd");
+    spEditor->OnMouseMove(NVec2f(10.0f, 10.0f));
+    auto trace = recorder.Stop();
+    ASSERT_FALSE(recorder.IsRecording());
+    ASSERT_EQ(trace.events.size(), 13u);
+    ASSERT_EQ(trace.events[0].type, WorkloadEventType::Resize);
+
+    auto expected = spEditor->GetActiveTabWindow()->GetActiveWindow()->GetBuffer().GetText().string();
+    ASSERT_STREQ(expected.c_str(), "Worldagain\n");
+
+    auto spReplay = MakeEditor("");
+    WorkloadReplayResult result;
+    ReplayWorkload(*spReplay, trace, WorkloadReplaySpeed::Fast, result);
+    ASSERT_EQ(spReplay->GetActiveTabWindow()->GetActiveWindow()->GetBuffer().GetText().string(), expected);
+    ASSERT_EQ(result.eventLatencyUs.size(), trace.events.size());
+    ASSERT_EQ(result.latency[size_t(WorkloadEventType::Key)].count, 11u);
+    ASSERT_EQ(result.latency[size_t(WorkloadEventType::MouseMove)].count, 1u);
+}
+
+// The keys that stop the recording aren't in it
+TEST_F(RegressTest, record_ex_command)
+{
+    auto spEditor = MakeEditor("Hello\n");
+    ZepRecordExCommand::Register(*spEditor);
+
+    const std::string path = "zep_record_test.trace";
+    Type(*spEditor, ":ZRecord " + path + "\n");
+    ASSERT_TRUE(spEditor->GetWorkloadRecorder().IsRecording());
+    Type(*spEditor, "x:ZRecord\n");
+    ASSERT_FALSE(spEditor->GetWorkloadRecorder().IsRecording());
+
+    std::ifstream in(path, std::ios::in | std::ios::binary);
+    WorkloadTrace trace;
+    ASSERT_TRUE(ReadWorkloadTrace(in, trace));
+    in.close();
+    std::remove(path.c_str());
+
+    ASSERT_EQ(trace.text, "Hello\n");
+    ASSERT_EQ(trace.events.size(), 2u);
+    ASSERT_EQ(trace.events[1].key, uint32_t('x'));
+}
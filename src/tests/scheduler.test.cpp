@@ -0,0 +1,131 @@
+#include "config_app.h"
+
+#include "zep/buffer.h"
+#include "zep/display.h"
+#include "zep/editor.h"
+#include "zep/scheduler.h"
+#include "zep/syntax.h"
+
+#include <gtest/gtest.h>
+#include <thread>
+
+using namespace Zep;
+
+TEST(Scheduler, deadlines_run_in_order)
+{
+    ZepScheduler scheduler;
+    std::string order;
+    int owner = 0;
+    scheduler.AddDeadline(&owner, 300, [&]() { order += "c"; });
+    scheduler.AddDeadline(&owner, 100, [&]() { order += "a"; });
+    scheduler.AddDeadline(&owner, 200, [&]() { order += "b"; });
+    ASSERT_EQ(scheduler.GetNextDeadline(), 100u);
+
+    ASSERT_FALSE(scheduler.Update(50));
+    ASSERT_TRUE(scheduler.Update(200));
+    ASSERT_EQ(order, "ab");
+    ASSERT_EQ(scheduler.GetNextDeadline(), 300u);
+
+    scheduler.Update(1000);
+    ASSERT_EQ(order, "abc");
+    ASSERT_EQ(scheduler.GetNextDeadline(), NoDeadline);
+}
+
+TEST(Scheduler, cancel_by_id_and_owner)
+{
+    ZepScheduler scheduler;
+    int count = 0;
+    int owner1 = 0;
+    int owner2 = 0;
+    auto id = scheduler.AddDeadline(&owner1, 10, [&]() { count += 1; });
+    scheduler.AddDeadline(&owner1, 10, [&]() { count += 10; });
+    scheduler.AddDeadline(&owner2, 10, [&]() { count += 100; });
+    scheduler.Post(&owner2, [&]() { count += 1000; });
+
+    scheduler.Cancel(id);
+    scheduler.Cancel(&owner2);
+    scheduler.Update(100);
+    ASSERT_EQ(count, 10);
+}
+
+// A repeating timer runs once per update at most, and stops itself
+TEST(Scheduler, repeating_timer)
+{
+    ZepScheduler scheduler;
+    int count = 0;
+    ScheduleId id = InvalidScheduleId;
+    id = scheduler.AddTimer(&scheduler, 0.0, [&]() {
+        if (++count == 3)
+        {
+            scheduler.Cancel(id);
+        }
+    },
+        0.000001);
+
+    for (int update = 0; update < 10; update++)
+    {
+        scheduler.Update(timer_get_time_now() + 1000000);
+        ASSERT_LE(count, std::min(update + 1, 3));
+    }
+    ASSERT_EQ(count, 3);
+    ASSERT_EQ(scheduler.GetNextDeadline(), NoDeadline);
+}
+
+// Work posted from a worker wakes the host, and runs on the next update
+TEST(Scheduler, post_from_thread)
+{
+    ZepScheduler scheduler;
+    std::atomic<int> wakes(0);
+    scheduler.SetWakeCallback([&]() { wakes++; });
+
+    auto mainThread = std::this_thread::get_id();
+    bool ranOnMain = false;
+    std::thread worker([&]() {
+        scheduler.Post(&scheduler, [&]() { ranOnMain = std::this_thread::get_id() == mainThread; });
+    });
+    worker.join();
+
+    ASSERT_EQ(wakes, 1);
+    ASSERT_EQ(scheduler.GetNextDeadline(), 0u);
+    scheduler.Update(timer_get_time_now());
+    ASSERT_TRUE(ranOnMain);
+}
+
+// An idle editor sleeps until the cursor blinks; a flash wakes it each frame, only until it ends
+TEST(Scheduler, editor_wake_time)
+{
+    auto spEditor = std::make_shared<ZepEditor>(new ZepDisplayNull(), ZEP_ROOT, ZepEditorFlags::DisableThreads);
+    auto pBuffer = spEditor->InitWithText("test.cpp", "int main() {}\n");
+    spEditor->RefreshRequired();
+
+    auto now = timer_get_time_now();
+    auto wakeTime = spEditor->GetNextWakeTime();
+    ASSERT_GT(wakeTime, now);
+    ASSERT_LE(wakeTime, now + 600000);
+
+    pBuffer->GetSyntax()->BeginFlash(0.05f);
+    ASSERT_LE(spEditor->GetScheduler().GetNextDeadline(), timer_get_time_now());
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    spEditor->RefreshRequired();
+    spEditor->RefreshRequired();
+    ASSERT_EQ(spEditor->GetScheduler().GetNextDeadline(), NoDeadline);
+}
+
+// Mouse input wakes a host that sleeps until the next deadline
+TEST(Scheduler, mouse_wakes)
+{
+    auto spEditor = std::make_shared<ZepEditor>(new ZepDisplayNull(), ZEP_ROOT, ZepEditorFlags::DisableThreads);
+    spEditor->InitWithText("test.txt", "one\ntwo\n");
+    spEditor->SetDisplayRegion(NVec2f(0.0f, 0.0f), NVec2f(1024.0f, 1024.0f));
+    spEditor->RefreshRequired();
+
+    int wakes = 0;
+    spEditor->GetScheduler().SetWakeCallback([&]() { wakes++; });
+    spEditor->OnMouseMove(NVec2f(10.0f, 10.0f));
+    spEditor->OnMouseDown(NVec2f(10.0f, 10.0f), ZepMouseButton::Left);
+    spEditor->OnMouseUp(NVec2f(10.0f, 10.0f), ZepMouseButton::Left);
+    ASSERT_GE(wakes, 3);
+    ASSERT_TRUE(spEditor->RefreshRequired());
+    spEditor->GetScheduler().SetWakeCallback(nullptr);
+}
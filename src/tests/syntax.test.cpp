@@ -3,9 +3,15 @@
 #include "zep/buffer.h"
 #include "zep/display.h"
 #include "zep/editor.h"
+#include "zep/filesystem.h"
 #include "zep/syntax.h"
+#include "zep/theme.h"
 
+#include <atomic>
+#include <future>
 #include <gtest/gtest.h>
+#include <mutex>
+#include <thread>
 
 using namespace Zep;
 class SyntaxTest : public testing::Test
@@ -39,4 +45,367 @@ CPP_SYNTAX_TEST(cpp_keyword,    "int i;", 0, Keyword);
 CPP_SYNTAX_TEST(cpp_identifier, "a = std::min(a,b);", 4, Identifier);
 CPP_SYNTAX_TEST(cpp_string,     "a = \"hello\";", 4, String);
 CPP_SYNTAX_TEST(cpp_number,     "a = 1234;", 4, Number);
+CPP_SYNTAX_TEST(cpp_block_comment, "/* a\nint */ int", 5, Comment);
+CPP_SYNTAX_TEST(cpp_after_block_comment, "/* a\nint */ int", 13, Keyword);
+CPP_SYNTAX_TEST(cpp_escaped_quote, "a = \"\\\" int\";", 9, String);
+CPP_SYNTAX_TEST(cpp_raw_string, "R\"(a \" int)\" int", 7, String);
+CPP_SYNTAX_TEST(cpp_preprocessor, "#include <a>", 0, Keyword);
+SYNTAX_TEST(lisp_comment, "test.lisp", "(car a) ; car", 10, Comment);
+SYNTAX_TEST(lisp_nested_comment, "test.lisp", "#| a #| b |# car |# car", 13, Comment);
+SYNTAX_TEST(lisp_after_nested_comment, "test.lisp", "#| a #| b |# car |# car", 20, Identifier);
+SYNTAX_TEST(toml_table, "test.toml", "[server]\na = [1]", 1, Keyword);
+SYNTAX_TEST(toml_array, "test.toml", "[server]\na = [1]", 14, Number);
+SYNTAX_TEST(toml_multiline_string, "test.toml", "a = \"\"\"\ntrue\n\"\"\"", 9, String);
+SYNTAX_TEST(glsl_keyword, "test.frag", "vec4 a; // vec4", 0, Keyword);
 
+
+// Edits shift the existing syntax immediately, before the new result arrives
+TEST_F(SyntaxTest, cpp_edit_shifts_syntax)
+{
+    ZepBuffer* pBuffer = spEditor->GetEmptyBuffer("test.cpp");
+    pBuffer->SetText("a = 1;\nint i;");
+    pBuffer->Insert(0, "xx\n");
+    ASSERT_EQ(pBuffer->GetSyntax()->GetSyntaxAt(10).foreground, ThemeColor::Keyword);
+}
+
+// Opening a comment on one line recolors the lines after it, and closing it restores them
+TEST_F(SyntaxTest, cpp_edit_multiline_comment)
+{
+    ZepBuffer* pBuffer = spEditor->GetEmptyBuffer("test.cpp");
+    pBuffer->SetText("a;\nint i;\nint j;");
+    ASSERT_EQ(pBuffer->GetSyntax()->GetSyntaxAt(10).foreground, ThemeColor::Keyword);
+
+    pBuffer->Insert(0, "/*");
+    ASSERT_EQ(pBuffer->GetSyntax()->GetSyntaxAt(12).foreground, ThemeColor::Comment);
+
+    pBuffer->Delete(0, 2);
+    ASSERT_EQ(pBuffer->GetSyntax()->GetSyntaxAt(10).foreground, ThemeColor::Keyword);
+}
+
+// Records how much text each job copies
+class ZepSyntaxMeasured : public ZepSyntax
+{
+public:
+    ZepSyntaxMeasured(ZepBuffer& buffer)
+        : ZepSyntax(buffer, { "int" })
+    {
+    }
+
+    void BeginSyntaxJob(SyntaxJob& job) override
+    {
+        largestSnapshot = std::max(largestSnapshot, ByteIndex(job.text.size()));
+        jobs++;
+    }
+
+    ByteIndex largestSnapshot = 0;
+    long jobs = 0;
+};
+
+// A file of several windows is lexed a window at a time, and an edit only copies the lines it touched
+TEST_F(SyntaxTest, snapshot_windows)
+{
+    std::string text;
+    while (ByteIndex(text.size()) < SyntaxWindowBytes * 3)
+    {
+        text += "int a = 1234;\n";
+    }
+
+    ZepBuffer* pBuffer = spEditor->GetEmptyBuffer("test.txt");
+    pBuffer->SetSyntaxProvider({ "measured", [](ZepBuffer* pBuffer) {
+                                     return std::static_pointer_cast<ZepSyntax>(std::make_shared<ZepSyntaxMeasured>(*pBuffer));
+                                 } });
+    auto pSyntax = static_cast<ZepSyntaxMeasured*>(pBuffer->GetSyntax());
+    pBuffer->SetText(text);
+    pSyntax->Wait();
+    ASSERT_GE(pSyntax->jobs, 3);
+    ASSERT_LE(pSyntax->largestSnapshot, SyntaxWindowBytes);
+    ASSERT_EQ(pSyntax->GetSyntaxAt(long(text.size()) - 14).foreground, ThemeColor::Keyword);
+
+    pSyntax->largestSnapshot = 0;
+    pBuffer->Insert(4, "int ");
+    pSyntax->Wait();
+    ASSERT_LT(pSyntax->largestSnapshot, 100);
+    ASSERT_EQ(pSyntax->GetSyntaxAt(5).foreground, ThemeColor::Keyword);
+}
+
+// A comment opened at the top of a long file reaches the end of it, a window at a time
+TEST_F(SyntaxTest, cpp_comment_over_windows)
+{
+    std::string text;
+    while (ByteIndex(text.size()) < SyntaxWindowBytes * 2)
+    {
+        text += "int a = 1234;\n";
+    }
+
+    ZepBuffer* pBuffer = spEditor->GetEmptyBuffer("test.cpp");
+    pBuffer->SetText(text);
+    pBuffer->GetSyntax()->Wait();
+    auto last = pBuffer->EndLocation() - 5;
+    ASSERT_EQ(pBuffer->GetSyntax()->GetSyntaxAt(last).foreground, ThemeColor::Number);
+
+    pBuffer->Insert(0, "/*");
+    pBuffer->GetSyntax()->Wait();
+    ASSERT_EQ(pBuffer->GetSyntax()->GetSyntaxAt(last + 2).foreground, ThemeColor::Comment);
+
+    pBuffer->Delete(0, 2);
+    pBuffer->GetSyntax()->Wait();
+    ASSERT_EQ(pBuffer->GetSyntax()->GetSyntaxAt(last).foreground, ThemeColor::Number);
+}
+
+// With a real thread pool, edits never wait on the worker, and the final result matches the text
+TEST(SyntaxThreadTest, cpp_threaded_edits)
+{
+    auto spEditor = std::make_shared<ZepEditor>(new ZepDisplayNull(), ZEP_ROOT);
+    ZepBuffer* pBuffer = spEditor->GetEmptyBuffer("test.cpp");
+
+    std::string text;
+    for (int i = 0; i < 1000; i++)
+    {
+        text += "int a = 1234; // comment\n";
+    }
+    pBuffer->SetText(text);
+    for (int i = 0; i < 50; i++)
+    {
+        pBuffer->Insert(0, "int ");
+    }
+    pBuffer->GetSyntax()->Wait();
+
+    ASSERT_EQ(pBuffer->GetSyntax()->GetSyntaxAt(0).foreground, ThemeColor::Keyword);
+    ASSERT_EQ(pBuffer->GetSyntax()->GetSyntaxAt(200 + 8).foreground, ThemeColor::Number);
+}
+
+// Colors come back as runs, resolved through the theme, with brackets merged in
+TEST_F(SyntaxTest, cpp_syntax_spans)
+{
+    ZepBuffer* pBuffer = spEditor->GetEmptyBuffer("test.cpp");
+    pBuffer->SetText("int i = (1);");
+
+    std::vector<SyntaxSpan> spans;
+    pBuffer->GetSyntax()->GetSyntaxSpans(0, 12, spans);
+
+    ASSERT_FALSE(spans.empty());
+    ASSERT_EQ(spans[0].start, 0);
+    ASSERT_EQ(spans[0].end, 3);
+    ASSERT_EQ(spans[0].foreground, pBuffer->GetTheme().GetColor(ThemeColor::Keyword));
+    ASSERT_EQ(spans.back().end, 12);
+
+    // Every location agrees with the single lookup
+    for (auto& span : spans)
+    {
+        for (auto offset = span.start; offset < span.end; offset++)
+        {
+            auto result = pBuffer->GetSyntax()->GetSyntaxAt(offset);
+            ASSERT_EQ(span.hasForeground, result.foreground != ThemeColor::None);
+            if (span.hasForeground)
+            {
+                ASSERT_EQ(span.foreground, pBuffer->GetSyntax()->ToForegroundColor(result));
+            }
+        }
+    }
+}
+
+// Files held in memory, shared between editors, so a second editor can pick up the first one's syntax cache
+class SyntaxCacheFileSystem : public IZepFileSystem
+{
+public:
+    SyntaxCacheFileSystem(std::map<std::string, std::string>& files, int& writes)
+        : m_files(files)
+        , m_writes(writes)
+    {
+    }
+    virtual std::string Read(const ZepPath& filePath) override
+    {
+        return m_files[filePath.string()];
+    }
+    virtual bool Write(const ZepPath& filePath, const void* pData, size_t size) override
+    {
+        // Cache writes wait while they are held, for up to 10 seconds
+        if (filePath.extension() == ".syn")
+        {
+            writeStarted = true;
+            for (int wait = 0; holdWrites && wait < 10000; wait++)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(writeMutex);
+        m_files[filePath.string()] = std::string((const char*)pData, size);
+        if (filePath.extension() == ".syn")
+        {
+            m_writes++;
+            if (pWriteThread)
+            {
+                *pWriteThread = std::this_thread::get_id();
+            }
+        }
+        return true;
+    }
+    virtual ZepPath GetSearchRoot(const ZepPath&, bool& foundGit) const override
+    {
+        foundGit = true;
+        return m_root;
+    }
+    virtual const ZepPath& GetWorkingDirectory() const override
+    {
+        return m_root;
+    }
+    virtual void SetWorkingDirectory(const ZepPath&) override {}
+    virtual bool MakeDirectories(const ZepPath&) override
+    {
+        return true;
+    }
+    virtual bool IsDirectory(const ZepPath& path) const override
+    {
+        return m_files.find(path.string()) == m_files.end();
+    }
+    virtual bool IsReadOnly(const ZepPath&) const override
+    {
+        return false;
+    }
+    virtual bool Exists(const ZepPath& path) const override
+    {
+        return m_files.find(path.string()) != m_files.end();
+    }
+    virtual void ScanDirectory(const ZepPath&, std::function<bool(const ZepPath& path, bool& dont_recurse)>) const override {}
+    virtual bool Equivalent(const ZepPath& path1, const ZepPath& path2) const override
+    {
+        return path1.string() == path2.string();
+    }
+    virtual ZepPath Canonical(const ZepPath& path) const override
+    {
+        return path;
+    }
+
+    std::thread::id* pWriteThread = nullptr;
+    std::atomic<bool> holdWrites{ false };
+    std::atomic<bool> writeStarted{ false };
+    std::mutex writeMutex;
+
+private:
+    ZepPath m_root = ZepPath("/project");
+    std::map<std::string, std::string>& m_files;
+    int& m_writes;
+};
+
+TEST(SyntaxCacheTest, cache_reused_on_reload)
+{
+    std::map<std::string, std::string> files;
+    int writes = 0;
+    files["/project/a.cpp"] = "/* a\nint */\nint i;\n";
+
+    auto loadFile = [&]() {
+        auto spEditor = std::make_shared<ZepEditor>(new ZepDisplayNull(), ZEP_ROOT, ZepEditorFlags::DisableThreads, new SyntaxCacheFileSystem(files, writes));
+        spEditor->GetConfig().syntaxCache = true;
+        auto pBuffer = spEditor->GetFileBuffer(ZepPath("/project/a.cpp"));
+        EXPECT_EQ(pBuffer->GetSyntax()->GetSyntaxAt(5).foreground, ThemeColor::Comment);
+        EXPECT_EQ(pBuffer->GetSyntax()->GetSyntaxAt(13).foreground, ThemeColor::Keyword);
+        return spEditor;
+    };
+
+    // The first load lexes and stores the result
+    loadFile();
+    ASSERT_EQ(writes, 1);
+
+    // The same content comes straight from the cache, so nothing is written
+    loadFile();
+    ASSERT_EQ(writes, 1);
+
+    // A change after the first line relexes from there, and stores the new result
+    files["/project/a.cpp"] = "/* a\nint */\nint j;\n";
+    loadFile();
+    ASSERT_EQ(writes, 2);
+}
+
+// With threads, the stored copy is written by a worker rather than the thread that finished the lex
+TEST(SyntaxCacheTest, cache_written_in_background)
+{
+    std::map<std::string, std::string> files;
+    int writes = 0;
+    files["/project/a.cpp"] = "/* a\nint */\nint i;\n";
+
+    std::thread::id writeThread;
+    auto pFileSystem = new SyntaxCacheFileSystem(files, writes);
+    pFileSystem->pWriteThread = &writeThread;
+    bool workers = false;
+    {
+        ZepEditor editor(new ZepDisplayNull(), ZEP_ROOT, 0, pFileSystem);
+        editor.GetConfig().syntaxCache = true;
+        workers = editor.GetThreadPool().worker_count() > 0;
+        auto pBuffer = editor.GetFileBuffer(ZepPath("/project/a.cpp"));
+        pBuffer->GetSyntax()->Wait();
+        ASSERT_EQ(pBuffer->GetSyntax()->GetSyntaxAt(13).foreground, ThemeColor::Keyword);
+    }
+
+    // The editor waits for the write on the way out
+    ASSERT_EQ(writes, 1);
+    if (workers)
+    {
+        ASSERT_NE(writeThread, std::this_thread::get_id());
+    }
+}
+
+// A file saved while the last cache write is still going is stored after it, without waiting for it
+TEST(SyntaxCacheTest, cache_write_queued_behind_last)
+{
+    std::map<std::string, std::string> files;
+    int writes = 0;
+    std::string text;
+    for (int line = 0; line < 2000; line++)
+    {
+        text += "/* a\nint */\nint i;\n";
+    }
+    files["/project/a.cpp"] = text;
+
+    auto pFileSystem = new SyntaxCacheFileSystem(files, writes);
+    ZepEditor editor(new ZepDisplayNull(), ZEP_ROOT, 0, pFileSystem);
+    editor.GetConfig().syntaxCache = true;
+    if (editor.GetThreadPool().worker_count() == 0)
+    {
+        return;
+    }
+    auto getWrites = [&]() {
+        std::lock_guard<std::mutex> lock(pFileSystem->writeMutex);
+        return writes;
+    };
+
+    // The first write is held on its worker
+    pFileSystem->holdWrites = true;
+    auto pBuffer = editor.GetFileBuffer(ZepPath("/project/a.cpp"));
+    pBuffer->GetSyntax()->Wait();
+    while (!pFileSystem->writeStarted)
+    {
+        std::this_thread::yield();
+    }
+
+    // The other workers are kept busy until the change is saved, so the lex of it catches up with a clean file, and
+    // asks for another write
+    std::promise<void> release;
+    auto released = release.get_future().share();
+    std::atomic<size_t> started(0);
+    std::vector<std::future<void>> blocks;
+    auto busyWorkers = editor.GetThreadPool().worker_count() - 1;
+    for (size_t worker = 0; worker < busyWorkers; worker++)
+    {
+        blocks.push_back(editor.GetThreadPool().enqueue_task(TaskPriority::Interactive, "Block", [&]() { started++; released.wait(); }));
+    }
+    while (started != busyWorkers)
+    {
+        std::this_thread::yield();
+    }
+
+    pBuffer->Insert(0, "int k;\n");
+    int64_t size;
+    pBuffer->Save(size);
+    release.set_value();
+    pBuffer->GetSyntax()->Wait();
+    ASSERT_EQ(getWrites(), 0);
+
+    pFileSystem->holdWrites = false;
+    for (int wait = 0; getWrites() < 2 && wait < 10000; wait++)
+    {
+        editor.GetScheduler().Update(timer_get_time_now());
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    ASSERT_EQ(getWrites(), 2);
+}
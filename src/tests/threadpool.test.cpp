@@ -0,0 +1,136 @@
+#include "zep/mcommon/threadpool.h"
+
+#include <gtest/gtest.h>
+#include <string>
+
+// With no workers, tasks run as they are queued, and are named while they run
+TEST(ThreadPool, single_thread_fallback)
+{
+    ThreadPool pool(1);
+    ASSERT_EQ(pool.worker_count(), 0u);
+
+    std::string name;
+    auto result = pool.enqueue_task(TaskPriority::Background, "Named", [&]() {
+        name = ThreadPool::current_task_name();
+        return 3;
+    });
+    ASSERT_EQ(result.get(), 3);
+    ASSERT_EQ(name, "Named");
+    ASSERT_EQ(ThreadPool::current_task_name(), nullptr);
+    auto doubled = pool.enqueue([](int value) { return value * 2; }, 4);
+    ASSERT_EQ(doubled.get(), 8);
+}
+
+// A worker coming free takes the interactive job before the background work queued ahead of it
+TEST(ThreadPool, priority_order)
+{
+    ThreadPool pool(2);
+    std::promise<void> release1;
+    std::promise<void> release2;
+    auto released1 = release1.get_future().share();
+    auto released2 = release2.get_future().share();
+    std::atomic<int> started(0);
+    auto block1 = pool.enqueue_task(TaskPriority::Normal, "Block", [&]() { started++; released1.wait(); });
+    auto block2 = pool.enqueue_task(TaskPriority::Normal, "Block", [&]() { started++; released2.wait(); });
+    while (started != 2)
+    {
+        std::this_thread::yield();
+    }
+
+    std::mutex orderMutex;
+    std::string order;
+    auto record = [&](char c) {
+        std::lock_guard<std::mutex> lock(orderMutex);
+        order += c;
+    };
+    std::vector<std::future<void>> results;
+    for (int i = 0; i < 3; i++)
+    {
+        results.push_back(pool.enqueue_task(TaskPriority::Background, "Background", [&]() { record('b'); }));
+    }
+    results.push_back(pool.enqueue_task(TaskPriority::Interactive, "Interactive", [&]() { record('i'); }));
+
+    release1.set_value();
+    for (auto& result : results)
+    {
+        result.wait();
+    }
+    ASSERT_EQ(order, "ibbb");
+    release2.set_value();
+    block1.wait();
+    block2.wait();
+}
+
+// Background work leaves a worker free; a cancelled task sees its token
+TEST(ThreadPool, background_limit_and_cancel)
+{
+    ThreadPool pool(2);
+    CancelToken cancel;
+    std::atomic<bool> firstStarted(false);
+    std::atomic<bool> secondStarted(false);
+    auto first = pool.enqueue_task(TaskPriority::Background, "First", cancel, [&](const CancelToken& token) {
+        firstStarted = true;
+        while (!token.is_cancelled())
+        {
+            std::this_thread::yield();
+        }
+        return true;
+    });
+    while (!firstStarted)
+    {
+        std::this_thread::yield();
+    }
+    auto second = pool.enqueue_task(TaskPriority::Background, "Second", [&]() { secondStarted = true; });
+
+    auto normal = pool.enqueue_task(TaskPriority::Normal, "Normal", []() { return 1; });
+    ASSERT_EQ(normal.get(), 1);
+    ASSERT_FALSE(secondStarted);
+
+    cancel.cancel();
+    ASSERT_TRUE(first.get());
+    second.wait();
+    ASSERT_TRUE(secondStarted);
+}
+
+// Workers taking background tasks at once never run more than the limit of them
+TEST(ThreadPool, background_limit_contended)
+{
+    std::atomic<int> running(0);
+    std::atomic<int> most(0);
+    {
+        ThreadPool pool(4);
+        for (int i = 0; i < 256; i++)
+        {
+            pool.enqueue_task(TaskPriority::Background, "Background", [&]() {
+                auto now = ++running;
+                auto seen = most.load();
+                while (now > seen && !most.compare_exchange_weak(seen, now))
+                {
+                }
+                std::this_thread::yield();
+                running--;
+            });
+        }
+    }
+    ASSERT_LE(most, 3);
+    ASSERT_GE(most, 1);
+}
+
+// Tasks queued from a worker, and spread across the others, all run before the pool goes
+TEST(ThreadPool, nested_tasks)
+{
+    std::atomic<int> count(0);
+    {
+        ThreadPool pool(4);
+        for (int i = 0; i < 16; i++)
+        {
+            pool.enqueue([&]() {
+                for (int j = 0; j < 16; j++)
+                {
+                    pool.enqueue([&]() { count++; });
+                }
+            });
+        }
+    }
+    ASSERT_EQ(count, 256);
+}
@@ -0,0 +1,418 @@
+#include "config_app.h"
+
+#include "zep/buffer.h"
+#include "zep/display.h"
+#include "zep/display_recorder.h"
+#include "zep/editor.h"
+#include "zep/tab_window.h"
+#include "zep/window.h"
+
+#include <gtest/gtest.h>
+
+using namespace Zep;
+
+// Measures every character, as it would for a proportional font
+class ZepDisplayMeasured : public ZepDisplayNull
+{
+public:
+    virtual bool HasFixedAdvance() override
+    {
+        return false;
+    }
+};
+
+// Counts the bytes it is asked to measure
+class ZepDisplayCounted : public ZepDisplayMeasured
+{
+public:
+    virtual void GetCharSizes(const uint8_t* pBegin, const uint8_t* pEnd, std::vector<NVec2f>& sizes) override
+    {
+        measuredBytes += long(pEnd - pBegin);
+        ZepDisplayMeasured::GetCharSizes(pBegin, pEnd, sizes);
+    }
+
+    long measuredBytes = 0;
+};
+
+class WindowTest : public testing::Test
+{
+public:
+    WindowTest()
+    {
+        spEditor = std::make_shared<ZepEditor>(new ZepDisplayNull(), ZEP_ROOT, ZepEditorFlags::DisableThreads);
+        spCheckEditor = std::make_shared<ZepEditor>(new ZepDisplayNull(), ZEP_ROOT, ZepEditorFlags::DisableThreads);
+    }
+
+    ~WindowTest()
+    {
+    }
+
+    // Lines of varying length; narrow windows wrap the longer ones
+    std::string MakeText(int lines)
+    {
+        std::string text;
+        for (int line = 0; line < lines; line++)
+        {
+            text += std::string((line * 37) % 150, 'a' + (line % 26)) + "\n";
+        }
+        return text;
+    }
+
+    ZepWindow* InitWindow(ZepEditor& editor, const std::string& text, const NVec2f& size)
+    {
+        editor.InitWithText("Test Buffer", text);
+        editor.SetDisplayRegion(NVec2f(0.0f, 0.0f), size);
+        return editor.GetActiveTabWindow()->GetActiveWindow();
+    }
+
+    // The edited window must show every location where a window laid out from scratch does
+    void CheckLayout(ZepWindow* pWindow, const NVec2f& size)
+    {
+        auto& buffer = pWindow->GetBuffer();
+        auto pCheckWindow = InitWindow(*spCheckEditor, buffer.GetText().string().substr(0, buffer.EndLocation()), size);
+
+        // Both show the scroll bar, so wrap to the same width
+        spEditor->Display();
+        spCheckEditor->Display();
+        for (ByteIndex loc = 0; loc < buffer.EndLocation(); loc++)
+        {
+            pWindow->SetBufferCursor(loc);
+            pCheckWindow->SetBufferCursor(loc);
+            ASSERT_EQ(pWindow->BufferToDisplay(), pCheckWindow->BufferToDisplay()) << "At: " << loc;
+        }
+    }
+
+public:
+    std::shared_ptr<ZepEditor> spEditor;
+    std::shared_ptr<ZepEditor> spCheckEditor;
+};
+
+TEST_F(WindowTest, edits_match_full_layout)
+{
+    for (auto size : { NVec2f(1024.0f, 1024.0f), NVec2f(150.0f, 200.0f) })
+    {
+        auto pWindow = InitWindow(*spEditor, MakeText(60), size);
+        auto& buffer = pWindow->GetBuffer();
+        spEditor->Display();
+
+        // Several edits before the next layout
+        buffer.Insert(10, "new\nlines\n");
+        buffer.Delete(300, 420);
+        buffer.Insert(buffer.EndLocation() - 5, std::string(200, 'x'));
+        CheckLayout(pWindow, size);
+
+        // Edits above and below the last one, laid out each time
+        buffer.Insert(500, "\n\n\n");
+        spEditor->Display();
+        buffer.Delete(20, 21);
+        spEditor->Display();
+        buffer.Insert(buffer.EndLocation(), "end\nof\ntext");
+        CheckLayout(pWindow, size);
+    }
+}
+
+// A config change that moves the text lays the lines out again
+TEST_F(WindowTest, config_change_relayout)
+{
+    auto size = NVec2f(150.0f, 200.0f);
+    auto pWindow = InitWindow(*spEditor, MakeText(60), size);
+    spEditor->Display();
+
+    spEditor->GetConfig().showLineNumbers = false;
+    spCheckEditor->GetConfig().showLineNumbers = false;
+    spEditor->Broadcast(MakeMessage<ZepMessage>(Msg::ConfigChanged));
+    CheckLayout(pWindow, size);
+}
+
+// Lines are only measured near the view, but every line still has its place
+TEST_F(WindowTest, large_buffer_positions)
+{
+    auto pWindow = InitWindow(*spEditor, MakeText(20000), NVec2f(1024.0f, 1024.0f));
+    auto& buffer = pWindow->GetBuffer();
+    spEditor->Display();
+
+    ByteIndex lineStart, lineEnd;
+    buffer.GetLineOffsets(15001, lineStart, lineEnd);
+    pWindow->SetBufferCursor(lineStart + 3);
+    spEditor->Display();
+    ASSERT_EQ(pWindow->BufferToDisplay(), NVec2i(3, 15001));
+
+    // An edit above the view moves the lines below it
+    buffer.Insert(0, "one\ntwo\n");
+    pWindow->SetBufferCursor(lineStart + 11);
+    ASSERT_EQ(pWindow->BufferToDisplay(), NVec2i(3, 15003));
+}
+
+// Laying out a new or joined line costs about the same in a huge buffer as in a small one.
+// The fastest of several edits is compared, and the bound is loose; a relayout of every line is hundreds of times slower
+TEST_F(WindowTest, newline_layout_flat)
+{
+    auto layoutNs = [&](long lines) {
+        std::string text;
+        for (long line = 0; line < lines; line++)
+        {
+            text += "a line of text\n";
+        }
+        auto pWindow = InitWindow(*spEditor, text, NVec2f(1024.0f, 1024.0f));
+        auto& buffer = pWindow->GetBuffer();
+        ByteIndex lineStart, lineEnd;
+        buffer.GetLineOffsets(lines / 2, lineStart, lineEnd);
+        pWindow->SetBufferCursor(lineStart);
+
+        // The first edit after a load lays out every line
+        buffer.Insert(lineStart, "\n");
+        pWindow->GetNumDisplayedLines();
+        buffer.Delete(lineStart, lineStart + 1);
+        pWindow->GetNumDisplayedLines();
+
+        uint64_t fastest = UINT64_MAX;
+        for (int edit = 0; edit < 20; edit++)
+        {
+            buffer.Insert(lineStart, "\n");
+            auto start = profile_get_time_ns();
+            pWindow->GetNumDisplayedLines();
+            auto inserted = profile_get_time_ns() - start;
+            buffer.Delete(lineStart, lineStart + 1);
+            start = profile_get_time_ns();
+            pWindow->GetNumDisplayedLines();
+            fastest = std::min(fastest, inserted + profile_get_time_ns() - start);
+        }
+        return fastest;
+    };
+
+    auto small = layoutNs(100);
+    auto large = layoutNs(200000);
+    ASSERT_LT(large, small * 10 + 1000000) << "100 lines: " << small << "ns, 200000 lines: " << large << "ns";
+}
+
+// Map every character to the display and back, through lines with multi-byte characters
+TEST_F(WindowTest, display_to_buffer_round_trip)
+{
+    auto pWindow = InitWindow(*spEditor, "ascii line\nh\xC3\xA9llo w\xC3\xB6rld\n\xE2\x82\xAC 5\nend", NVec2f(1024.0f, 1024.0f));
+    auto& buffer = pWindow->GetBuffer();
+
+    ByteIndex loc = 0;
+    while (loc < buffer.EndLocation())
+    {
+        pWindow->SetBufferCursor(loc);
+        ASSERT_EQ(pWindow->DisplayToBuffer(pWindow->BufferToDisplay()), loc);
+        loc += utf8_codepoint_length(buffer.GetText()[loc]);
+    }
+
+    // The euro sign is 3 bytes, but one column
+    ByteIndex lineStart, lineEnd;
+    buffer.GetLineOffsets(2, lineStart, lineEnd);
+    pWindow->SetBufferCursor(lineStart + 3);
+    ASSERT_EQ(pWindow->BufferToDisplay(), NVec2i(1, 2));
+}
+
+// Lines counted on a fixed advance display wrap where the measured ones do
+TEST_F(WindowTest, fixed_advance_matches_measured)
+{
+    spCheckEditor = std::make_shared<ZepEditor>(new ZepDisplayMeasured(), ZEP_ROOT, ZepEditorFlags::DisableThreads);
+    for (auto size : { NVec2f(1024.0f, 1024.0f), NVec2f(150.0f, 200.0f), NVec2f(37.0f, 400.0f) })
+    {
+        auto pWindow = InitWindow(*spEditor, MakeText(40) + "tab\tline\n" + std::string(90, 'z') + "\xE2\x82\xAC\n\nend", size);
+        CheckLayout(pWindow, size);
+
+        pWindow->SetBufferCursor(pWindow->GetBuffer().EndLocation() - 1);
+        auto pCheckWindow = spCheckEditor->GetActiveTabWindow()->GetActiveWindow();
+        pCheckWindow->SetBufferCursor(pWindow->GetBuffer().EndLocation() - 1);
+        ASSERT_EQ(pWindow->DisplayToBuffer(NVec2i(2, 5)), pCheckWindow->DisplayToBuffer(NVec2i(2, 5)));
+    }
+}
+
+// Text of one color is drawn a run at a time, not a character at a time
+TEST_F(WindowTest, text_drawn_in_runs)
+{
+    auto pDisplay = new ZepDisplayRecorder();
+    spEditor = std::make_shared<ZepEditor>(pDisplay, ZEP_ROOT, ZepEditorFlags::DisableThreads);
+    auto pWindow = InitWindow(*spEditor, "hello world\nsecond line of text\n\xE2\x82\xAC euro", NVec2f(1024.0f, 1024.0f));
+    pWindow->SetBufferCursor(pWindow->GetBuffer().EndLocation());
+
+    pDisplay->BeginFrame();
+    spEditor->Display();
+
+    auto& frame = pDisplay->GetFrame();
+    ASSERT_NE(frame.text.find("hello world"), std::string::npos);
+    ASSERT_NE(frame.text.find("second line of text"), std::string::npos);
+    ASSERT_NE(frame.text.find("\xE2\x82\xAC euro"), std::string::npos);
+    ASSERT_LT(frame.stats.chars, 20u);
+}
+
+// The same frame twice records the same draw calls; moving the cursor changes a few of them
+TEST_F(WindowTest, recorded_frames_compare)
+{
+    auto pDisplay = new ZepDisplayRecorder();
+    spEditor = std::make_shared<ZepEditor>(pDisplay, ZEP_ROOT, ZepEditorFlags::DisableThreads);
+    auto pWindow = InitWindow(*spEditor, MakeText(100), NVec2f(1024.0f, 1024.0f));
+
+    // Keep the cursor from blinking between frames
+    spEditor->ResetCursorTimer();
+    pDisplay->BeginFrame();
+    spEditor->Display();
+    pDisplay->BeginFrame();
+    spEditor->Display();
+    ASSERT_GT(pDisplay->GetFrame().stats.drawCalls, 0u);
+    ASSERT_TRUE(ZepDisplayRecorder::Compare(pDisplay->GetPreviousFrame(), pDisplay->GetFrame()).Empty());
+
+    pWindow->SetBufferCursor(200);
+    spEditor->ResetCursorTimer();
+    pDisplay->BeginFrame();
+    spEditor->Display();
+    auto diff = ZepDisplayRecorder::Compare(pDisplay->GetPreviousFrame(), pDisplay->GetFrame());
+    ASSERT_FALSE(diff.Empty());
+    ASSERT_GT(diff.unchanged, diff.added);
+}
+
+// A display which keeps the last frame is only drawn over where something changed
+TEST_F(WindowTest, retained_frame_draws_changes)
+{
+    auto pDisplay = new ZepDisplayRecorder(true);
+    spEditor = std::make_shared<ZepEditor>(pDisplay, ZEP_ROOT, ZepEditorFlags::DisableThreads);
+    auto pWindow = InitWindow(*spEditor, MakeText(100), NVec2f(1024.0f, 1024.0f));
+    auto& buffer = pWindow->GetBuffer();
+
+    ByteIndex lineStart, lineEnd;
+    buffer.GetLineOffsets(1, lineStart, lineEnd);
+    pWindow->SetBufferCursor(lineStart);
+
+    spEditor->ResetCursorTimer();
+    pDisplay->BeginFrame();
+    spEditor->Display();
+    auto fullDrawCalls = pDisplay->GetFrame().stats.drawCalls;
+    ASSERT_GT(fullDrawCalls, 0u);
+
+    // Nothing changed
+    spEditor->ResetCursorTimer();
+    pDisplay->BeginFrame();
+    spEditor->Display();
+    ASSERT_EQ(pDisplay->GetFrame().stats.drawCalls, 0u);
+
+    // Along the same line
+    pWindow->SetBufferCursor(lineStart + 5);
+    spEditor->ResetCursorTimer();
+    pDisplay->BeginFrame();
+    spEditor->Display();
+    ASSERT_GT(pDisplay->GetFrame().stats.drawCalls, 0u);
+    ASSERT_LT(pDisplay->GetFrame().stats.drawCalls * 4, fullDrawCalls);
+
+    // An edit draws the new text
+    buffer.Insert(lineStart, "xyz");
+    spEditor->ResetCursorTimer();
+    pDisplay->BeginFrame();
+    spEditor->Display();
+    ASSERT_NE(pDisplay->GetFrame().text.find("xyzbbb"), std::string::npos);
+    ASSERT_LT(pDisplay->GetFrame().stats.drawCalls, fullDrawCalls);
+
+    // Asking for everything draws everything
+    spEditor->InvalidateDisplay();
+    pDisplay->BeginFrame();
+    spEditor->Display();
+    ASSERT_GE(pDisplay->GetFrame().stats.drawCalls, fullDrawCalls);
+}
+
+// A long wrapped line keeps a few blocks of its spans, and builds the others again on the way to them
+TEST_F(WindowTest, long_line_blocks)
+{
+    spCheckEditor = std::make_shared<ZepEditor>(new ZepDisplayMeasured(), ZEP_ROOT, ZepEditorFlags::DisableThreads);
+    std::string text = "first\n";
+    for (long index = 0; index < LongLineBytes * 3; index++)
+    {
+        text += char('a' + index % 26);
+    }
+    text += "\nlast";
+
+    for (auto& editor : { spEditor, spCheckEditor })
+    {
+        auto pWindow = InitWindow(*editor, text, NVec2f(300.0f, 200.0f));
+        editor->Display();
+
+        // The spans after the first hold the same number of characters
+        pWindow->SetBufferCursor(6);
+        auto lineTop = pWindow->BufferToDisplay().y;
+        auto spanLength = [&](long span) {
+            auto start = pWindow->DisplayToBuffer(NVec2i(0, lineTop + span));
+            long length = 1;
+            for (; pWindow->DisplayToBuffer(NVec2i(length, lineTop + span)) == start + length; length++)
+            {
+            }
+            return length;
+        };
+        auto firstLength = spanLength(0);
+        auto splitLength = spanLength(1);
+        auto expected = [&](long loc) {
+            return loc < firstLength ? NVec2i(loc, lineTop) : NVec2i((loc - firstLength) % splitLength, lineTop + 1 + (loc - firstLength) / splitLength);
+        };
+
+        // From the end to the start and back, a block at a time
+        for (auto loc : { 3l * LongLineBytes - 1, 2l * LongLineBytes + 7, 12l, LongLineBytes + 100l, 3l * LongLineBytes })
+        {
+            pWindow->SetBufferCursor(6 + loc);
+            ASSERT_EQ(pWindow->BufferToDisplay(), expected(loc)) << "At: " << loc;
+            ASSERT_EQ(pWindow->DisplayToBuffer(pWindow->BufferToDisplay()), 6 + loc);
+            editor->Display();
+        }
+
+        // The line after it
+        pWindow->SetBufferCursor(long(text.size()) - 1);
+        ASSERT_EQ(pWindow->BufferToDisplay(), NVec2i(3, expected(3 * LongLineBytes).y + 1));
+    }
+}
+
+// The first frame of a huge wrapped line only measures the start of it; the rest is walked when it is needed
+TEST_F(WindowTest, long_line_lazy)
+{
+    auto pDisplay = new ZepDisplayCounted();
+    spEditor = std::make_shared<ZepEditor>(pDisplay, ZEP_ROOT, ZepEditorFlags::DisableThreads);
+    auto lineLength = LongLineBytes * 64;
+    std::string text = std::string(lineLength, 'x') + "\nlast";
+
+    // A block or two of spans
+    auto pWindow = InitWindow(*spEditor, text, NVec2f(300.0f, 200.0f));
+    pDisplay->measuredBytes = 0;
+    spEditor->Display();
+    ASSERT_LT(pDisplay->measuredBytes, lineLength / 16);
+
+    // Each span after the first holds the same number of characters, up to the line after it
+    pWindow->SetBufferCursor(0);
+    auto lineTop = pWindow->BufferToDisplay().y;
+    long spanLength = 1;
+    for (; pWindow->DisplayToBuffer(NVec2i(spanLength, lineTop + 1)) == pWindow->DisplayToBuffer(NVec2i(0, lineTop + 1)) + spanLength; spanLength++)
+    {
+    }
+    auto firstLength = pWindow->DisplayToBuffer(NVec2i(0, lineTop + 1));
+    pWindow->SetBufferCursor(long(text.size()) - 1);
+    spEditor->Display();
+    ASSERT_EQ(pWindow->BufferToDisplay().y, lineTop + 2 + (lineLength - firstLength) / spanLength);
+}
+
+// A long line without wrapping is only measured and drawn as far as the edge of the view
+TEST_F(WindowTest, long_line_without_wrap)
+{
+    auto pDisplay = new ZepDisplayRecorder();
+    spEditor = std::make_shared<ZepEditor>(pDisplay, ZEP_ROOT, ZepEditorFlags::DisableThreads);
+    std::string text;
+    for (long index = 0; index < LongLineBytes * 2; index++)
+    {
+        text += index % 100 == 0 ? "\xE2\x82\xAC" : "x";
+    }
+    text += "\nend";
+
+    auto pWindow = InitWindow(*spEditor, text, NVec2f(200.0f, 200.0f));
+    pWindow->ToggleFlag(WindowFlags::WrapText);
+    pDisplay->BeginFrame();
+    spEditor->Display();
+    ASSERT_LT(pDisplay->GetFrame().stats.glyphs, 1000u);
+
+    // Past the edge, code points are found from the checkpoints
+    auto& buffer = pWindow->GetBuffer();
+    NVec2i column(0, 0);
+    for (ByteIndex loc = 0; loc < buffer.EndLocation(); loc += utf8_codepoint_length(buffer.GetText()[loc]))
+    {
+        pWindow->SetBufferCursor(loc);
+        ASSERT_EQ(pWindow->BufferToDisplay(), column) << "At: " << loc;
+        ASSERT_EQ(pWindow->DisplayToBuffer(column), loc);
+        column = buffer.GetText()[loc] == '\n' ? NVec2i(0, column.y + 1) : NVec2i(column.x + 1, column.y);
+    }
+}
@@ -31,6 +31,24 @@ void ZepTheme::SetThemeType(ThemeType type)
             SetLightTheme();
             break;
     }
+    BuildPalette();
+}
+
+// Resolve the theme into a flat table, so color lookups during drawing are just an index
+void ZepTheme::BuildPalette()
+{
+    static const NVec4f one(1.0f);
+
+    m_palette.assign(size_t(ThemeColor::UniqueColorLast) + 1, one);
+    for (auto& col : m_colors)
+    {
+        m_palette[size_t(col.first)] = col.second;
+    }
+
+    for (auto index = size_t(ThemeColor::UniqueColor0); index < m_palette.size(); index++)
+    {
+        m_palette[index] = m_uniqueColors[(index - size_t(ThemeColor::UniqueColor0)) % (uint32_t)ThemeColor::UniqueColorLast];
+    }
 }
 
 ThemeType ZepTheme::GetThemeType() const
@@ -131,19 +149,13 @@ ThemeColor ZepTheme::GetUniqueColor(uint32_t index) const
 
 const NVec4f& ZepTheme::GetColor(ThemeColor themeColor) const
 {
-    if (themeColor >= ThemeColor::UniqueColor0)
+    if (size_t(themeColor) < m_palette.size())
     {
-        // Return the unique color 
-        return m_uniqueColors[((uint32_t)themeColor - (uint32_t)ThemeColor::UniqueColor0) % (uint32_t)ThemeColor::UniqueColorLast];
+        return m_palette[size_t(themeColor)];
     }
 
-    auto itr = m_colors.find(themeColor);
-    if (itr == m_colors.end())
-    {
-        static const NVec4f one(1.0f);
-        return one;
-    }
-    return itr->second;
+    // Return the unique color 
+    return m_uniqueColors[((uint32_t)themeColor - (uint32_t)ThemeColor::UniqueColor0) % (uint32_t)ThemeColor::UniqueColorLast];
 }
 
 NVec4f ZepTheme::GetComplement(const NVec4f& col, const NVec4f& adjust) const
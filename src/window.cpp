@@ -1,5 +1,6 @@
 #include <cctype>
 #include <cmath>
+#include <limits>
 #include <sstream>
 
 #include "zep/buffer.h"
@@ -78,12 +79,16 @@ ZepWindow::ZepWindow(ZepTabWindow& window, ZepBuffer* buffer)
     m_vScroller = std::make_shared<Scroller>(GetEditor(), *m_vScrollRegion);
     m_vScroller->vertical = false;
 
+    GetEditor().Subscribe(this, Msg::Buffer, m_pBuffer);
+    GetEditor().Subscribe(this, Msg::ComponentChanged);
+    GetEditor().Subscribe(this, Msg::ConfigChanged);
+    GetEditor().Subscribe(this, Msg::MouseMove);
+
     timer_start(m_toolTipTimer);
 }
 
 ZepWindow::~ZepWindow()
 {
-    std::for_each(m_windowLines.begin(), m_windowLines.end(), [](SpanInfo* pInfo) { delete pInfo; });
 }
 
 void ZepWindow::UpdateScrollers()
@@ -100,7 +105,7 @@ void ZepWindow::UpdateScrollers()
     }
     m_vScroller->vScrollVisiblePercent = std::min(m_textRegion->rect.Height() / m_textSizePx.y, 1.0f);
     m_vScroller->vScrollPosition = std::abs(m_textOffsetPx) / m_textSizePx.y;
-    m_vScroller->vScrollLinePercent = 1.0f / m_windowLines.size();
+    m_vScroller->vScrollLinePercent = 1.0f / GetSpanCount();
     m_vScroller->vScrollPagePercent = m_vScroller->vScrollVisiblePercent;
 
     if (GetEditor().GetConfig().showScrollBar == 0 || ZTestFlags(GetWindowFlags(), WindowFlags::HideScrollBar))
@@ -183,7 +188,51 @@ void ZepWindow::Notify(std::shared_ptr<ZepMessage> payload)
             return;
         }
 
-        m_layoutDirty = true;
+        // Only the colors changed, so nothing moves and there is no need to wake the cursor
+        if (pMsg->type == BufferMessageType::SyntaxChanged)
+        {
+            InvalidateLines(m_pBuffer->GetBufferLine(pMsg->startLocation), m_pBuffer->GetBufferLine(pMsg->endLocation));
+            return;
+        }
+
+        switch (pMsg->type)
+        {
+        case BufferMessageType::TextAdded:
+        case BufferMessageType::TextChanged:
+        case BufferMessageType::TextDeleted: {
+            // An empty change is a line widget coming or going, which can be anywhere
+            if (pMsg->type == BufferMessageType::TextChanged && pMsg->startLocation == pMsg->endLocation)
+            {
+                m_layoutDirty = true;
+                break;
+            }
+
+            // Remember the edited lines; the unchanged lines at the end are counted from the end, so that they stay
+            // the same as more edits add and remove lines before the next layout
+            auto firstLine = m_pBuffer->GetBufferLine(pMsg->startLocation);
+            auto lastLine = pMsg->type == BufferMessageType::TextDeleted ? firstLine : m_pBuffer->GetBufferLine(pMsg->endLocation);
+            auto tailLines = std::max(0l, m_pBuffer->GetLineCount() - 1 - lastLine);
+            if (m_dirtyFirstLine == -1)
+            {
+                m_dirtyFirstLine = firstLine;
+                m_dirtyTailLines = tailLines;
+            }
+            else
+            {
+                m_dirtyFirstLine = std::min(m_dirtyFirstLine, firstLine);
+                m_dirtyTailLines = std::min(m_dirtyTailLines, tailLines);
+            }
+        }
+        break;
+        case BufferMessageType::Loaded:
+            m_layoutDirty = true;
+            break;
+        case BufferMessageType::MarkersChanged:
+            m_redrawAll = true;
+            break;
+        default:
+            break;
+        }
 
         if (pMsg->type != BufferMessageType::PreBufferChange)
         {
@@ -227,6 +276,7 @@ void ZepWindow::Notify(std::shared_ptr<ZepMessage> payload)
     else if (payload->messageId == Msg::ConfigChanged)
     {
         m_layoutDirty = true;
+        m_redrawAll = true;
     }
 }
 
@@ -251,22 +301,20 @@ void ZepWindow::EnsureCursorVisible()
 {
     UpdateLayout();
     ByteIndex loc = m_bufferCursor;
-    for (auto& line : m_windowLines)
+    auto& lineSpans = GetLineSpans(m_pBuffer->GetBufferLine(loc));
+    auto spanInLine = FindLineSpan(lineSpans, loc);
+    if (spanInLine != -1)
     {
-        if (line->lineByteRange.first <= loc && line->lineByteRange.second > loc)
+        auto cursorLine = lineSpans.spanLineIndex + spanInLine;
+        if (cursorLine < m_visibleLineIndices.x)
         {
-            auto cursorLine = line->spanLineIndex;
-            if (cursorLine < m_visibleLineIndices.x)
-            {
-                MoveCursorY(std::abs(m_visibleLineIndices.x - cursorLine));
-            }
-            else if (cursorLine >= m_visibleLineIndices.y)
-            {
-                MoveCursorY((long(m_visibleLineIndices.y) - cursorLine) - 1);
-            }
-            m_cursorMoved = false;
-            return;
+            MoveCursorY(std::abs(m_visibleLineIndices.x - cursorLine));
         }
+        else if (cursorLine >= m_visibleLineIndices.y)
+        {
+            MoveCursorY((long(m_visibleLineIndices.y) - cursorLine) - 1);
+        }
+        m_cursorMoved = false;
     }
 }
 
@@ -304,7 +352,9 @@ void ZepWindow::ScrollToCursor()
 
 void ZepWindow::GetCharPointer(ByteIndex loc, const uint8_t*& pBegin, const uint8_t*& pEnd, SpecialChar& special)
 {
-    static char invalidChar;
+    // Shared by every window, so never written
+    static const char invalidReturn = '@' + '\n';
+    static const char invalidNull = '@';
     static const char blankSpace = ' ';
 
     pBegin = &m_pBuffer->GetText()[loc];
@@ -313,10 +363,9 @@ void ZepWindow::GetCharPointer(ByteIndex loc, const uint8_t*& pBegin, const uint
     special = SpecialChar::None;
     if (*pBegin == '\n' || *pBegin == 0)
     {
-        invalidChar = '@' + *pBegin;
         if (GetWindowFlags() & WindowFlags::ShowCR)
         {
-            pBegin = (const uint8_t*)&invalidChar;
+            pBegin = (const uint8_t*)(*pBegin == '\n' ? &invalidReturn : &invalidNull);
         }
         else
         {
@@ -357,108 +406,336 @@ float ZepWindow::GetLineTopPadding(long line)
     return height;
 }
 
-// This is the most expensive part of window update; applying line span generation for wrapped text and unicode
-// character sizes which may vary in byte count and physical pixel width
-// It can take about a millisecond to do during editing on release buildj; but this is fast enough for now.
-// There are several ways in which this function can be optimized:
-// - Only regenerate spans which have changed, since only the edited line range will change.
-// - Generate blocks of text, based on syntax highlighting, instead of single characters.
-// - Have a no-wrap text mode and save a lot of the wrapping work.
-// - Do some threading
-void ZepWindow::UpdateLineSpans()
+// Estimate the size of a line from its length, without measuring the text
+void ZepWindow::EstimateLineLayout(long bufferLine, LineLayout& layout)
 {
-    TIME_SCOPE(UpdateLineSpans);
+    auto& display = GetEditor().GetDisplay();
+    auto lineMargins = GetEditor().GetConfig().lineMargins;
+    float textHeight = display.GetFontHeightPixels();
 
-    //LOG(DEBUG) << "UpdateLineSpans: " << (uint64_t)this << ", " << m_pBuffer->GetName();
-    m_maxDisplayLines = (long)std::max(0.0f, std::floor(m_textRegion->rect.Height() / m_defaultLineSize));
+    ByteIndex lineStart, lineEnd;
+    m_pBuffer->GetLineOffsets(bufferLine, lineStart, lineEnd);
 
-    const auto& textBuffer = m_pBuffer->GetText();
+    // Every character at the default size, not counting the line end
+    auto charWidth = display.GetDefaultCharSize().x + m_xPad;
+    auto textWidth = std::max(0l, lineEnd - lineStart - 1) * charWidth;
 
-    long bufferLine = 0;
-    long spanLine = 0;
-    float bufferPosYPx = 0.0f;
-    float xOffset = m_xPad;
+    layout.spanCount = 1;
+    if (ZTestFlags(GetWindowFlags(), WindowFlags::WrapText) && m_textRegion->rect.Width() > charWidth)
+    {
+        layout.spanCount = std::max(1l, long(std::ceil(textWidth / m_textRegion->rect.Width())));
+    }
+
+    // Split lines don't repeat the widgets above the line
+    auto lineHeight = textHeight + DPI_Y((float)lineMargins.y);
+    layout.heightPx = GetLineTopPadding(bufferLine) + lineHeight + (layout.spanCount - 1) * (lineMargins.x + lineHeight);
+    layout.widthPx = m_xPad + (layout.spanCount == 1 ? textWidth : m_textRegion->rect.Width());
+    layout.measured = false;
+}
 
-    // Nuke the existing spans
-    // In future we can in-place modify for speed
-    std::for_each(m_windowLines.begin(), m_windowLines.end(), [](SpanInfo* pInfo) { delete pInfo; });
-    m_windowLines.clear();
+void ZepWindow::SetLineLayout(long bufferLine, const LineLayout& layout)
+{
+    auto& oldLayout = m_lineLayouts.Get(bufferLine);
+    if (layout.heightPx != oldLayout.heightPx)
+    {
+        InvalidateLines(bufferLine, m_lineLayouts.Size());
+    }
+    if (layout.spanCount != oldLayout.spanCount)
+    {
+        m_layoutVersion++;
+    }
+    m_lineLayouts.Set(bufferLine, layout);
+}
 
+// True if the text is printable ASCII, so every character has the default size on a fixed advance display.  Tabs and
+// other characters with their own size take the measured path
+bool ZepWindow::IsFixedAdvanceText(ByteIndex start, ByteIndex end) const
+{
+    const auto& textBuffer = m_pBuffer->GetText();
+    for (auto ch = start; ch < end; ch++)
+    {
+        auto c = textBuffer[ch];
+        if (c < ' ' || c > '~')
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Layout a buffer line into one or more spans, wrapping it if necessary.
+// This is the most expensive part of window update; applying line span generation for wrapped text and unicode
+// character sizes which may vary in byte count and physical pixel width, so it is only done for lines near the view.
+// The first layout walks the whole line to find its size, and keeps the first block of spans.  A long wrapped line
+// is only walked a block at a time: it remembers where each block it has found starts, so that a block can be built
+// again by walking just that part, and estimates the spans past the last one found until the walk reaches its end
+void ZepWindow::LayoutBufferLine(LineSpans& lineSpans, SpanBlock& block, LineLayout* pLayout)
+{
+    const auto& textBuffer = m_pBuffer->GetText();
     auto& display = GetEditor().GetDisplay();
+    float textHeight = display.GetFontHeightPixels();
+    const auto bufferLine = lineSpans.bufferLine;
+
+    BufferByteRange lineByteRange;
+    m_pBuffer->GetLineOffsets(bufferLine, lineByteRange.first, lineByteRange.second);
+
+    const bool wrap = ZTestFlags(GetWindowFlags(), WindowFlags::WrapText);
+    const float wrapWidth = m_textRegion->rect.Width();
+    const bool longLine = (lineByteRange.second - lineByteRange.first) > LongLineBytes;
+    const auto& fixedCharSize = display.GetDefaultCharSize();
+
+    // Split lines don't repeat the widgets above the line
+    NVec2f padding = NVec2f(GetLineTopPadding(bufferLine), DPI_Y((float)GetEditor().GetConfig().lineMargins.y));
+    const float splitPaddingTop = (float)GetEditor().GetConfig().lineMargins.x;
+    const bool useBlocks = wrap && longLine;
+    if (pLayout)
+    {
+        lineSpans.fixedAdvance = !useBlocks && display.HasFixedAdvance() && IsFixedAdvanceText(lineByteRange.first, lineByteRange.second - 1);
+        lineSpans.blockStarts.clear();
+        lineSpans.complete = !useBlocks;
+        lineSpans.widthPx = 0.0f;
+        lineSpans.firstHeightPx = textHeight + padding.x + padding.y;
+        lineSpans.splitHeightPx = textHeight + splitPaddingTop + padding.y;
+        *pLayout = LineLayout();
+        pLayout->spanCount = 0;
+        pLayout->measured = true;
+        block.first = 0;
+    }
 
-    float textHeight = GetEditor().GetDisplay().GetFontHeightPixels();
+    // The spans kept, and where the walk starts and stops.  A short line is walked to the end to count its spans; a
+    // long wrapped one only as far as the block
+    long spanIndex = block.first;
+    const long keepEnd = useBlocks ? block.first + LongLineSpanStep : std::numeric_limits<long>::max();
+    const auto startCh = lineByteRange.first + (spanIndex == 0 ? 0 : lineSpans.blockStarts[spanIndex / LongLineSpanStep]);
 
-    // Process every buffer line
-    for (;;)
+    // A block of a long line only checks the characters it can reach; a span holds no more than fit in the width
+    bool fixedAdvance = lineSpans.fixedAdvance;
+    if (useBlocks && display.HasFixedAdvance())
     {
-        // We haven't processed this line yet, so we can't display anything
-        // else
-        if (m_pBuffer->GetLineCount() <= bufferLine)
-            break;
+        auto checkEnd = lineByteRange.second - 1;
+        if (fixedCharSize.x >= 1.0f)
+        {
+            auto spanBytes = ByteIndex(wrapWidth / fixedCharSize.x) + 2;
+            checkEnd = std::min(checkEnd, startCh + (LongLineSpanStep + 1) * spanBytes);
+        }
+        fixedAdvance = IsFixedAdvanceText(startCh, checkEnd);
+    }
 
-        BufferByteRange lineByteRange;
-        if (!m_pBuffer->GetLineOffsets(bufferLine, lineByteRange.first, lineByteRange.second))
-            break;
+    float bufferPosYPx = lineSpans.yOffsetPx + (spanIndex == 0 ? 0.0f : lineSpans.firstHeightPx + (spanIndex - 1) * lineSpans.splitHeightPx);
+    if (spanIndex != 0)
+    {
+        padding.x = splitPaddingTop;
+    }
+    float fullLineHeight = textHeight + padding.x + padding.y;
+    float xOffset = m_xPad;
 
-        NVec2f padding = NVec2f(GetLineTopPadding(bufferLine), DPI_Y((float)GetEditor().GetConfig().lineMargins.y));
-        float fullLineHeight = textHeight + padding.x + padding.y;
-
-        // Start a new line
-        SpanInfo* lineInfo = new SpanInfo();
-        lineInfo->bufferLineNumber = bufferLine;
-        lineInfo->spanLineIndex = spanLine;
-        lineInfo->lineByteRange.first = lineByteRange.first;
-        lineInfo->lineByteRange.second = lineByteRange.first;
-        lineInfo->yOffsetPx = bufferPosYPx;
-        lineInfo->padding = padding;
-        lineInfo->textSizePx.x = xOffset;
-        lineInfo->textSizePx.y = textHeight;
-        lineInfo->isSplitContinuation = false;
+    // Reuse the spans, and their code point storage.  Spans past the kept ones are walked through, and measured, in
+    // a scratch span
+    auto& spans = block.spans;
+    size_t spanCount = 0;
+    SpanInfo skippedSpan;
+    auto nextSpan = [&](ByteIndex ch) -> SpanInfo* {
+        if (useBlocks && spanIndex % LongLineSpanStep == 0 && spanIndex / LongLineSpanStep == long(lineSpans.blockStarts.size()))
+        {
+            lineSpans.blockStarts.push_back(ch - lineByteRange.first);
+        }
 
-        // These offsets are 0 -> n + 1, i.e. the last offset the buffer returns is 1 beyond the current
-        // Note: Must not use pointers into the character buffer!
-        for (auto ch = lineByteRange.first; ch < lineByteRange.second; ch += utf8_codepoint_length(textBuffer[ch]))
+        SpanInfo* pSpan = &skippedSpan;
+        if (spanIndex < keepEnd)
         {
-            const uint8_t* pCh = &textBuffer[ch];
-            const auto textSize = display.GetCharSize(pCh);
+            if (spanCount == spans.size())
+            {
+                spans.emplace_back();
+            }
+            pSpan = &spans[spanCount++];
+        }
 
-            // Wrap if we have displayed at least one char, and we have to
-            if (ZTestFlags(GetWindowFlags(), WindowFlags::WrapText) && ch != lineByteRange.first)
+        auto codePoints = std::move(pSpan->lineCodePoints);
+        codePoints.clear();
+        *pSpan = SpanInfo();
+        pSpan->lineCodePoints = std::move(codePoints);
+        pSpan->spanLineIndex = int(lineSpans.spanLineIndex + spanIndex);
+        pSpan->bufferLineNumber = bufferLine;
+        pSpan->lineByteRange = BufferByteRange(ch, ch);
+        pSpan->yOffsetPx = bufferPosYPx;
+        pSpan->padding = padding;
+        pSpan->textSizePx.x = m_xPad;
+        pSpan->textSizePx.y = textHeight;
+        pSpan->isSplitContinuation = spanIndex != 0;
+        pSpan->fixedAdvance = fixedAdvance;
+        pSpan->fixedCharSize = fixedCharSize;
+        pSpan->fixedLastCharSize = fixedCharSize;
+        return pSpan;
+    };
+
+    // Start a new line
+    SpanInfo* lineInfo = nextSpan(startCh);
+
+    auto closeSpan = [&]() {
+        lineSpans.widthPx = std::max(lineSpans.widthPx, lineInfo->textSizePx.x);
+        if (pLayout)
+        {
+            pLayout->heightPx += lineInfo->FullLineHeightPx();
+            pLayout->widthPx = std::max(pLayout->widthPx, lineInfo->textSizePx.x);
+            pLayout->spanCount++;
+        }
+    };
+
+    // Close the current span before 'ch', and continue the buffer line in a new one.  Returns false once the
+    // spans being built are done
+    bool stopped = false;
+    auto splitSpan = [&](ByteIndex ch) {
+        // Remember the offset beyond the end of the line
+        lineInfo->lineByteRange.second = ch;
+        lineInfo->textSizePx.x = xOffset;
+        closeSpan();
+
+        // Next line
+        spanIndex++;
+        bufferPosYPx += fullLineHeight;
+
+        // Reset the line margin and height, because when we split a line we don't include a
+        // custom widget space above it.  That goes just above the first part of the line
+        padding.x = splitPaddingTop;
+        fullLineHeight = textHeight + padding.x + padding.y;
+
+        // Now jump to the next 'screen line' for the rest of this 'buffer line'
+        xOffset = m_xPad;
+        lineInfo = nextSpan(ch);
+        stopped = spanIndex >= keepEnd;
+        return !stopped;
+    };
+
+    // A block built again starts just after a split; its first character wasn't advanced over when it was wrapped
+    bool resumeSplit = spanIndex != 0;
+
+    // Every character but the line end is the same size, so the spans are found by counting instead of
+    // measuring each one.  This follows the same rules as the loop below
+    if (fixedAdvance)
+    {
+        const auto lineEnd = lineByteRange.second - 1;
+        const auto lineEndSize = display.GetCharSize(&textBuffer[lineEnd]);
+        const float advance = fixedCharSize.x + m_xPad;
+
+        auto ch = startCh;
+        while (ch < lineByteRange.second)
+        {
+            if (ch == lineEnd)
             {
-                // At least a single char has wrapped; close the old line, start a new one
-                if (((xOffset + textSize.x) + textSize.x) >= (m_textRegion->rect.Width()))
+                if (resumeSplit || (wrap && ch != lineByteRange.first && ((xOffset + lineEndSize.x) + lineEndSize.x) >= wrapWidth))
                 {
-                    // Remember the offset beyond the end of the line
-                    lineInfo->lineByteRange.second = ch;
-                    lineInfo->textSizePx.x = xOffset;
-                    m_windowLines.push_back(lineInfo);
-
-                    // Next line
-                    lineInfo = new SpanInfo();
-                    spanLine++;
-                    bufferPosYPx += fullLineHeight;
-
-                    // Reset the line margin and height, because when we split a line we don't include a
-                    // custom widget space above it.  That goes just above the first part of the line
-                    padding.x = (float)GetEditor().GetConfig().lineMargins.x;
-                    fullLineHeight = textHeight + padding.x + padding.y;
-
-                    // Now jump to the next 'screen line' for the rest of this 'buffer line'
-                    lineInfo->lineByteRange = BufferByteRange(ch, utf8_codepoint_length(textBuffer[ch]));
-                    lineInfo->spanLineIndex = spanLine;
-                    lineInfo->bufferLineNumber = bufferLine;
-                    lineInfo->yOffsetPx = bufferPosYPx;
-                    lineInfo->padding = padding;
-                    lineInfo->textSizePx.y = textHeight;
-                    lineInfo->textSizePx.x = xOffset;
-                    lineInfo->isSplitContinuation = true;
-
-                    xOffset = m_xPad;
+                    if (!resumeSplit && !splitSpan(ch))
+                    {
+                        break;
+                    }
                 }
                 else
                 {
-                    xOffset += textSize.x + m_xPad;
+                    xOffset += lineEndSize.x + m_xPad;
                 }
+
+                if (textBuffer[ch] == 0 || !ZTestFlags(GetWindowFlags(), WindowFlags::ShowCR))
+                {
+                    xOffset -= (lineEndSize.x + m_xPad);
+                }
+                lineInfo->fixedLastCharSize = lineEndSize;
+                ch++;
+            }
+            else if (resumeSplit || (wrap && ch != lineByteRange.first && ((xOffset + fixedCharSize.x) + fixedCharSize.x) >= wrapWidth))
+            {
+                if (!resumeSplit && !splitSpan(ch))
+                {
+                    break;
+                }
+                ch++;
+            }
+            else
+            {
+                // The run of characters before the next wrap
+                auto count = lineEnd - ch;
+                if (wrap)
+                {
+                    auto fit = ByteIndex(std::ceil((wrapWidth - fixedCharSize.x * 2.0f - xOffset) / advance));
+                    count = std::min(count, std::max(ByteIndex(1), fit));
+                }
+                xOffset += count * advance;
+                ch += count;
+            }
+            resumeSplit = false;
+
+            lineInfo->lineByteRange.second = ch;
+            lineInfo->textSizePx.x = std::max(lineInfo->textSizePx.x, xOffset);
+        }
+    }
+    else
+    {
+        // Measure the line a piece at a time, from a copy; there may be a gap in the buffer
+        const size_t MeasureBytes = 4096;
+        ByteIndex measuredStart = startCh;
+        ByteIndex measuredEnd = startCh;
+        auto measure = [&](ByteIndex ch) {
+            // Whole code points, unless one is cut off by the end of the line
+            auto end = std::min(lineByteRange.second, ch + ByteIndex(MeasureBytes));
+            while (end < lineByteRange.second && (textBuffer[end] & 0xC0) == 0x80)
+            {
+                end++;
+            }
+
+            m_layoutText.clear();
+            for (auto copy = ch; copy < end; copy++)
+            {
+                m_layoutText.push_back(char(textBuffer[copy]));
+            }
+            measuredStart = ch;
+            measuredEnd = end;
+            m_layoutCharSizes.clear();
+            display.GetCharSizes((const uint8_t*)m_layoutText.data(), (const uint8_t*)(m_layoutText.data() + m_layoutText.size()), m_layoutCharSizes);
+        };
+
+        // These offsets are 0 -> n + 1, i.e. the last offset the buffer returns is 1 beyond the current.
+        // The characters are read from the copy that was measured
+        size_t codePoint = 0;
+        for (auto ch = startCh; ch < lineByteRange.second;)
+        {
+            // A long line without wrapping goes past the edge of any view; the rest of it is only counted, with a
+            // checkpoint every so often to find its code points from
+            if (!wrap && longLine && xOffset > m_bufferRegion->rect.Width())
+            {
+                lineInfo->pTailText = &textBuffer;
+                for (auto tail = ch; tail < lineByteRange.second; tail += utf8_codepoint_length(textBuffer[tail]))
+                {
+                    if (lineInfo->tailCodePointCount % LongLineCodePointStep == 0)
+                    {
+                        lineInfo->tailCheckpoints.push_back(tail - lineInfo->lineByteRange.first);
+                    }
+                    lineInfo->tailCodePointCount++;
+                }
+
+                // Not counting the line end
+                xOffset += (lineInfo->tailCodePointCount - 1) * (fixedCharSize.x + m_xPad);
+                lineInfo->lineByteRange.second = lineByteRange.second;
+                lineInfo->textSizePx.x = std::max(lineInfo->textSizePx.x, xOffset);
+                break;
+            }
+
+            if (ch >= measuredEnd)
+            {
+                measure(ch);
+                codePoint = 0;
+            }
+
+            const uint8_t* pCh = (const uint8_t*)m_layoutText.data() + (ch - measuredStart);
+            const auto textSize = m_layoutCharSizes[codePoint++];
+
+            // Wrap if we have displayed at least one char, and we have to
+            if (resumeSplit || (wrap && ch != lineByteRange.first && ((xOffset + textSize.x) + textSize.x) >= wrapWidth))
+            {
+                // At least a single char has wrapped; close the old line, start a new one
+                if (!resumeSplit && !splitSpan(ch))
+                {
+                    break;
+                }
+                resumeSplit = false;
             }
             else
             {
@@ -475,87 +752,398 @@ void ZepWindow::UpdateLineSpans()
                 xOffset -= (textSize.x + m_xPad);
             }
 
-            lineInfo->yOffsetPx = bufferPosYPx;
-            lineInfo->lineByteRange.second = ch + utf8_codepoint_length(textBuffer[ch]);
+            if (lineInfo != &skippedSpan)
+            {
+                LineCharInfo info;
+                info.byteOffset = ch - lineInfo->lineByteRange.first;
+                info.size = textSize;
+                lineInfo->lineCodePoints.push_back(info);
+            }
+
+            ch += utf8_codepoint_length(*pCh);
+            lineInfo->lineByteRange.second = ch;
             lineInfo->textSizePx.x = std::max(lineInfo->textSizePx.x, xOffset);
         }
+    }
 
-        // Complete the line
-        m_windowLines.push_back(lineInfo);
+    if (!stopped)
+    {
+        closeSpan();
+    }
+    spans.resize(spanCount);
 
-        // Next time round - down a buffer line, down a span line
-        bufferLine++;
-        spanLine++;
-        xOffset = m_xPad;
-        bufferPosYPx += fullLineHeight;
+    if (!useBlocks)
+    {
+        if (pLayout)
+        {
+            lineSpans.spanCount = pLayout->spanCount;
+        }
+        return;
     }
 
-    // Sanity
-    if (m_windowLines.empty())
+    // The spans past the last block found take as many bytes each as the ones before them
+    if (!stopped)
     {
-        SpanInfo* lineInfo = new SpanInfo();
-        lineInfo->lineByteRange.first = 0;
-        lineInfo->lineByteRange.second = 0;
-        lineInfo->padding = NVec2f(0.0f);
-        lineInfo->textSizePx = NVec2f(0.0f);
-        lineInfo->bufferLineNumber = 0;
-        m_windowLines.push_back(lineInfo);
+        lineSpans.complete = true;
+        lineSpans.spanCount = spanIndex + 1;
+    }
+    else if (!lineSpans.complete)
+    {
+        auto knownSpans = long(lineSpans.blockStarts.size() - 1) * LongLineSpanStep;
+        auto knownBytes = double(lineSpans.blockStarts.back());
+        auto restBytes = double(lineByteRange.second - lineByteRange.first) - knownBytes;
+        lineSpans.spanCount = knownSpans + std::max(1l, long(std::ceil(restBytes * knownSpans / knownBytes)));
     }
 
-    // Now build the codepoint offsets
-    for (auto& line : m_windowLines)
+    LineLayout layout;
+    layout.heightPx = lineSpans.firstHeightPx + (lineSpans.spanCount - 1) * lineSpans.splitHeightPx;
+    layout.widthPx = lineSpans.widthPx;
+    layout.spanCount = lineSpans.spanCount;
+    layout.measured = true;
+    if (pLayout)
     {
-        auto ch = line->lineByteRange.first;
+        *pLayout = layout;
+    }
+    else
+    {
+        SetLineLayout(bufferLine, layout);
+    }
+}
 
-        // TODO: Optimize
-        line->lineCodePoints.clear();
-        uint32_t points = 0;
-        while (ch < line->lineByteRange.second)
+// Get the spans of a buffer line, building them if the line isn't one of the recently used ones
+LineSpans& ZepWindow::GetLineSpans(long bufferLine)
+{
+    ByteIndex lineStart, lineEnd;
+    m_pBuffer->GetLineOffsets(bufferLine, lineStart, lineEnd);
+    auto yOffsetPx = float(m_lineLayouts.HeightPrefix(bufferLine));
+    auto spanLineIndex = m_lineLayouts.SpanPrefix(bufferLine);
+
+    std::list<LineSpans>::iterator itrEntry;
+    auto itrFound = m_spanCacheLines.find(bufferLine);
+    if (itrFound != m_spanCacheLines.end())
+    {
+        itrEntry = itrFound->second;
+        m_spanCache.splice(m_spanCache.begin(), m_spanCache, itrEntry);
+    }
+    else
+    {
+        // Keep enough lines for a couple of screens
+        auto maxLines = std::max(size_t(256), size_t(m_maxDisplayLines) * 4);
+        if (!m_spanCache.empty() && (m_spanCache.back().bufferLine == -1 || m_spanCache.size() >= maxLines))
         {
-            LineCharInfo info;
+            itrEntry = std::prev(m_spanCache.end());
+            if (itrEntry->bufferLine != -1)
+            {
+                m_spanCacheLines.erase(itrEntry->bufferLine);
+            }
+            m_spanCache.splice(m_spanCache.begin(), m_spanCache, itrEntry);
+        }
+        else
+        {
+            itrEntry = m_spanCache.emplace(m_spanCache.begin());
+        }
 
-            // Important note: We can't navigate the text buffer by pointers!
-            // The gap buffer will get in the way; so need to be careful to use [] or an iterator
-            // GetCharSize is cached for speed on debug builds.
-            info.byteIndex = ByteIndex(ch);
-            info.size = display.GetCharSize(&textBuffer[ch]);
-            line->lineCodePoints.push_back(info);
-            ch += utf8_codepoint_length(textBuffer[ch]);
-            points++;
+        itrEntry->bufferLine = bufferLine;
+        itrEntry->lineStart = lineStart;
+        itrEntry->yOffsetPx = yOffsetPx;
+        itrEntry->spanLineIndex = spanLineIndex;
+        m_spanCacheLines[bufferLine] = itrEntry;
+
+        // Keep the storage of one block
+        if (itrEntry->blocks.empty())
+        {
+            itrEntry->blocks.emplace_back();
         }
+        itrEntry->blocks.resize(1);
+
+        // Now the line is measured, the estimate can be replaced
+        LineLayout layout;
+        LayoutBufferLine(*itrEntry, itrEntry->blocks.front(), &layout);
+        SetLineLayout(bufferLine, layout);
     }
 
-    UpdateVisibleLineRange();
-    m_layoutDirty = true;
+    // Move the spans into place; the lines before may have changed since they were built
+    auto& lineSpans = *itrEntry;
+    if (lineSpans.lineStart != lineStart || lineSpans.yOffsetPx != yOffsetPx || lineSpans.spanLineIndex != spanLineIndex || lineSpans.blocks.front().spans[0].bufferLineNumber != bufferLine)
+    {
+        auto byteShift = lineStart - lineSpans.lineStart;
+        auto yShift = yOffsetPx - lineSpans.yOffsetPx;
+        auto indexShift = spanLineIndex - lineSpans.spanLineIndex;
+        for (auto& block : lineSpans.blocks)
+        {
+            for (auto& span : block.spans)
+            {
+                span.lineByteRange.first += byteShift;
+                span.lineByteRange.second += byteShift;
+                span.yOffsetPx += yShift;
+                span.spanLineIndex += indexShift;
+                span.bufferLineNumber = bufferLine;
+            }
+        }
+        lineSpans.lineStart = lineStart;
+        lineSpans.yOffsetPx = yOffsetPx;
+        lineSpans.spanLineIndex = spanLineIndex;
+    }
+    return lineSpans;
 }
 
-void ZepWindow::UpdateVisibleLineRange()
+// A span of a line, by its index in the line.  The block it is in is built again if it was dropped; spans of the
+// blocks used most recently stay where they are
+SpanInfo& ZepWindow::GetLineSpan(LineSpans& lineSpans, long spanInLine)
 {
-    TIME_SCOPE(UpdateVisibleLineRange);
+    ExtendLineSpans(lineSpans, spanInLine, -1);
+    spanInLine = std::max(0l, std::min(spanInLine, lineSpans.spanCount - 1));
+    for (auto itr = lineSpans.blocks.begin(); itr != lineSpans.blocks.end(); itr++)
+    {
+        if (spanInLine >= itr->first && spanInLine < itr->first + long(itr->spans.size()))
+        {
+            if (itr != lineSpans.blocks.begin())
+            {
+                lineSpans.blocks.splice(lineSpans.blocks.begin(), lineSpans.blocks, itr);
+            }
+            return itr->spans[spanInLine - itr->first];
+        }
+    }
 
-    m_visibleLineIndices.x = (long)m_windowLines.size();
-    m_visibleLineIndices.y = 0;
-    m_textSizePx.x = 0;
-    for (long line = 0; line < long(m_windowLines.size()); line++)
+    // Enough blocks for a few screens
+    auto maxBlocks = std::max(4l, (m_maxDisplayLines * 4) / LongLineSpanStep + 2);
+    if (long(lineSpans.blocks.size()) >= maxBlocks)
     {
-        auto& windowLine = *m_windowLines[line];
-        m_textSizePx.x = std::max(m_textSizePx.x, windowLine.textSizePx.x);
+        lineSpans.blocks.splice(lineSpans.blocks.begin(), lineSpans.blocks, std::prev(lineSpans.blocks.end()));
+    }
+    else
+    {
+        lineSpans.blocks.emplace_front();
+    }
+
+    auto& block = lineSpans.blocks.front();
+    block.first = (spanInLine / LongLineSpanStep) * LongLineSpanStep;
+    LayoutBufferLine(lineSpans, block, nullptr);
 
-        if ((windowLine.yOffsetPx + windowLine.FullLineHeightPx()) <= m_textOffsetPx)
+    // The walk may have found the line ends before its estimate
+    spanInLine = std::min(spanInLine, lineSpans.spanCount - 1);
+    return block.spans[spanInLine - block.first];
+}
+
+// Walk a long wrapped line on, a block at a time, until the block with a span or a location in it has been found,
+// or the line ends.  -1 for either one means it isn't looked for
+void ZepWindow::ExtendLineSpans(LineSpans& lineSpans, long spanInLine, ByteIndex location)
+{
+    auto offset = location - lineSpans.lineStart;
+    while (!lineSpans.complete && (spanInLine / LongLineSpanStep >= long(lineSpans.blockStarts.size()) || (location >= 0 && lineSpans.blockStarts.back() <= offset)))
+    {
+        m_walkBlock.first = long(lineSpans.blockStarts.size() - 1) * LongLineSpanStep;
+        LayoutBufferLine(lineSpans, m_walkBlock, nullptr);
+    }
+}
+
+// The index in the line of the span containing a location, or -1
+long ZepWindow::FindLineSpan(LineSpans& lineSpans, ByteIndex location)
+{
+    if (location < lineSpans.lineStart)
+    {
+        return -1;
+    }
+
+    // The block it is in, then the span
+    ExtendLineSpans(lineSpans, -1, location);
+    long first = 0;
+    if (!lineSpans.blockStarts.empty())
+    {
+        auto itrStart = std::upper_bound(lineSpans.blockStarts.begin(), lineSpans.blockStarts.end(), location - lineSpans.lineStart);
+        first = long(itrStart - lineSpans.blockStarts.begin() - 1) * LongLineSpanStep;
+    }
+
+    GetLineSpan(lineSpans, first);
+    auto& spans = lineSpans.blocks.front().spans;
+    auto itrSpan = std::upper_bound(spans.begin(), spans.end(), location, [](ByteIndex value, const SpanInfo& span) {
+        return value < span.lineByteRange.first;
+    });
+    if (itrSpan == spans.begin() || !(itrSpan - 1)->BufferCursorInside(location))
+    {
+        return -1;
+    }
+    return lineSpans.blocks.front().first + long(itrSpan - spans.begin()) - 1;
+}
+
+// The index in the line of the span at a distance from the top of the text, which might be past the last one.
+// After the first, every span of a line is the same height
+long ZepWindow::FindLineSpanAtY(const LineSpans& lineSpans, float y) const
+{
+    y -= lineSpans.yOffsetPx;
+    if (y < lineSpans.firstHeightPx)
+    {
+        return 0;
+    }
+    return 1 + long((y - lineSpans.firstHeightPx) / lineSpans.splitHeightPx);
+}
+
+long ZepWindow::GetSpanCount() const
+{
+    return m_lineLayouts.TotalSpans();
+}
+
+// Find a span by its index in the window
+SpanInfo& ZepWindow::GetSpan(long index)
+{
+    index = std::max(0l, std::min(index, GetSpanCount() - 1));
+    for (;;)
+    {
+        // Measuring the line can change its span count, and so the line the index falls in
+        auto bufferLine = std::min(m_lineLayouts.FindSpan(index), m_lineLayouts.Size() - 1);
+        auto& lineSpans = GetLineSpans(bufferLine);
+        auto spanInLine = index - lineSpans.spanLineIndex;
+        if (spanInLine < lineSpans.spanCount || bufferLine == m_lineLayouts.Size() - 1)
         {
-            continue;
+            // Walking a long line on can find it ends before its estimate, and the index is in a later line
+            auto& span = GetLineSpan(lineSpans, spanInLine);
+            if (spanInLine < lineSpans.spanCount || bufferLine == m_lineLayouts.Size() - 1)
+            {
+                return span;
+            }
         }
+    }
+}
+
+// Update the layout of the buffer lines edited since the last layout.
+// The lines are only estimated here; they are measured when they come into view
+void ZepWindow::UpdateLineSpans(bool fullLayout)
+{
+    TIME_SCOPE(UpdateLineSpans);
+
+    //LOG(DEBUG) << "UpdateLineSpans: " << (uint64_t)this << ", " << m_pBuffer->GetName();
+    m_maxDisplayLines = (long)std::max(0.0f, std::floor(m_textRegion->rect.Height() / m_defaultLineSize));
+
+    auto lineCount = m_pBuffer->GetLineCount();
 
-        if ((windowLine.yOffsetPx - m_textOffsetPx) >= m_textRegion->rect.Height())
+    // The buffer lines to layout, and the lines they replace
+    long firstLine = 0;
+    long oldEndLine = m_lineLayouts.Size();
+    long newEndLine = lineCount;
+    if (!fullLayout && !m_lineLayouts.Empty())
+    {
+        if (m_dirtyFirstLine == -1)
         {
-            break;
+            return;
+        }
+        oldEndLine = std::max(0l, oldEndLine - m_dirtyTailLines);
+        newEndLine = std::max(0l, lineCount - m_dirtyTailLines);
+        firstLine = std::min(m_dirtyFirstLine, std::min(oldEndLine, newEndLine));
+    }
+    else
+    {
+        fullLayout = true;
+    }
+    m_dirtyFirstLine = -1;
+    m_dirtyTailLines = 0;
+    m_layoutVersion++;
+
+    // Draw the edited lines again, and the ones below them if they moved
+    if (fullLayout)
+    {
+        m_redrawAll = true;
+    }
+    else
+    {
+        InvalidateLines(firstLine, newEndLine - oldEndLine != 0 ? lineCount : std::max(firstLine, newEndLine - 1));
+    }
+
+    // Free the spans of the replaced lines, and renumber the ones after them
+    auto lineShift = newEndLine - oldEndLine;
+    for (auto itr = m_spanCache.begin(); itr != m_spanCache.end();)
+    {
+        auto itrNext = std::next(itr);
+        if (itr->bufferLine >= firstLine && (fullLayout || itr->bufferLine < oldEndLine))
+        {
+            itr->bufferLine = -1;
+            m_spanCache.splice(m_spanCache.end(), m_spanCache, itr);
         }
+        else if (itr->bufferLine >= oldEndLine)
+        {
+            itr->bufferLine += lineShift;
+        }
+        itr = itrNext;
+    }
+    m_spanCacheLines.clear();
+    for (auto itr = m_spanCache.begin(); itr != m_spanCache.end() && itr->bufferLine != -1; itr++)
+    {
+        m_spanCacheLines[itr->bufferLine] = itr;
+    }
+
+    // Estimate the new lines.  Lines added or removed by an edit go in or out of the tree where they were
+    if (fullLayout)
+    {
+        std::vector<LineLayout> layouts(lineCount);
+        for (long line = 0; line < lineCount; line++)
+        {
+            EstimateLineLayout(line, layouts[line]);
+        }
+        m_lineLayouts.Assign(layouts);
+    }
+    else
+    {
+        if (lineShift > 0)
+        {
+            m_lineLayouts.Insert(oldEndLine, lineShift);
+        }
+        else if (lineShift < 0)
+        {
+            m_lineLayouts.Erase(newEndLine, oldEndLine);
+        }
+
+        for (long line = firstLine; line < newEndLine; line++)
+        {
+            LineLayout layout;
+            EstimateLineLayout(line, layout);
+            SetLineLayout(line, layout);
+        }
+    }
+
+    UpdateVisibleLineRange();
+}
+
+void ZepWindow::UpdateVisibleLineRange()
+{
+    TIME_SCOPE(UpdateVisibleLineRange);
+
+    if (m_lineLayouts.Empty())
+    {
+        return;
+    }
+
+    // Start from the line at the top of the view; the lines are measured as they come into view
+    m_visibleLineIndices.x = GetSpanCount();
+    m_visibleLineIndices.y = 0;
+    bool belowView = false;
+    for (long bufferLine = m_lineLayouts.FindHeight(m_textOffsetPx); bufferLine < m_lineLayouts.Size() && !belowView; bufferLine++)
+    {
+        // A long line may start far above the view
+        auto& lineSpans = GetLineSpans(bufferLine);
+        for (long spanInLine = FindLineSpanAtY(lineSpans, m_textOffsetPx); spanInLine < lineSpans.spanCount; spanInLine++)
+        {
+            auto& windowLine = GetLineSpan(lineSpans, spanInLine);
+            if ((windowLine.yOffsetPx + windowLine.FullLineHeightPx()) <= m_textOffsetPx)
+            {
+                continue;
+            }
 
-        m_visibleLineIndices.x = std::min(m_visibleLineIndices.x, long(line));
-        m_visibleLineIndices.y = long(line);
+            if ((windowLine.yOffsetPx - m_textOffsetPx) >= m_textRegion->rect.Height())
+            {
+                belowView = true;
+                break;
+            }
+
+            m_visibleLineIndices.x = std::min(m_visibleLineIndices.x, long(windowLine.spanLineIndex));
+            m_visibleLineIndices.y = long(windowLine.spanLineIndex);
+        }
     }
 
-    m_textSizePx.y = m_windowLines[m_windowLines.size() - 1]->yOffsetPx + GetEditor().GetDisplay().GetFontHeightPixels() + DPI_Y(GetEditor().GetConfig().lineMargins.y) + DPI_Y(GetEditor().GetConfig().lineMargins.x);
+    m_textSizePx.x = m_lineLayouts.MaxWidth();
+
+    // The top of the last span, and a line of text below it
+    auto lastLine = m_lineLayouts.Size() - 1;
+    auto lastTopPx = m_lineLayouts.Get(lastLine).spanCount == 1 ? GetLineTopPadding(lastLine) : (float)GetEditor().GetConfig().lineMargins.x;
+    m_textSizePx.y = float(m_lineLayouts.TotalHeight()) - lastTopPx + DPI_Y(GetEditor().GetConfig().lineMargins.x);
 
     //LOG(DEBUG) << "Text Size: " << m_textSizePx;
 
@@ -567,8 +1155,8 @@ const SpanInfo& ZepWindow::GetCursorLineInfo(long y)
 {
     UpdateLayout();
     y = std::max(0l, y);
-    y = std::min(y, long(m_windowLines.size() - 1));
-    return *m_windowLines[y];
+    y = std::min(y, GetSpanCount() - 1);
+    return GetSpan(y);
 }
 
 // Convert a normalized y coordinate to the window region
@@ -653,17 +1241,14 @@ void ZepWindow::DrawLineWidgets(SpanInfo& lineInfo)
     }
 }
 
-// TODO: This function draws one char at a time.  It could be more optimal at the expense of some
-// complexity.  Basically, I don't like the current implementation, but it works for now.
 // The text is displayed acorrding to the region bounds and the display lineData
-// Additionally (and perhaps that should be a seperate function), this code draws line numbers
+// Additionally (and perhaps that should be a seperate function), this code draws line numbers.
+// Backgrounds are drawn a range at a time, and text a run of one color at a time.  The caller clips to the text
+// region for the whole pass
 bool ZepWindow::DisplayLine(SpanInfo& lineInfo, int displayPass)
 {
-    static const auto blankSpace = ' ';
-
     auto cursorCL = BufferToDisplay();
     auto& display = GetEditor().GetDisplay();
-    display.SetClipRect(m_bufferRegion->rect);
 
     auto& buffer = GetBuffer();
     auto pMode = buffer.GetMode();
@@ -684,19 +1269,17 @@ bool ZepWindow::DisplayLine(SpanInfo& lineInfo, int displayPass)
             return;
 
         auto cursorBufferLine = GetCursorLineInfo(cursorCL.y).bufferLineNumber;
-        std::string strNum;
 
         // In Vim mode show relative lines, unless in Ex mode (with hidden cursor)
+        long number = lineInfo.bufferLineNumber;
         if (m_displayMode == DisplayMode::Vim && pMode->GetCursorType() != CursorType::None)
         {
-            strNum = std::to_string(std::abs(lineInfo.bufferLineNumber - cursorBufferLine));
-        }
-        else
-        {
-            strNum = std::to_string(lineInfo.bufferLineNumber);
+            number = std::abs(lineInfo.bufferLineNumber - cursorBufferLine);
         }
 
-        auto textSize = display.GetTextSize((const uint8_t*)strNum.c_str(), (const uint8_t*)(strNum.c_str() + strNum.size()));
+        auto& numberText = display.GetNumberText(number);
+        auto& strNum = numberText.text;
+        auto textSize = numberText.size;
 
         auto digitCol = m_pBuffer->GetTheme().GetColor(ThemeColor::LineNumber);
         if (lineInfo.BufferCursorInside(m_bufferCursor))
@@ -711,8 +1294,6 @@ bool ZepWindow::DisplayLine(SpanInfo& lineInfo, int displayPass)
     // Drawing commands for the whole line
     if (displayPass == WindowPass::Background)
     {
-        display.SetClipRect(m_textRegion->rect);
-
         NVec2f linePx = GetSpanPixelRange(lineInfo);
 
         // Fill the background of the line
@@ -770,7 +1351,6 @@ bool ZepWindow::DisplayLine(SpanInfo& lineInfo, int displayPass)
                 }
             }
         }
-        display.SetClipRect(m_bufferRegion->rect);
 
         if (m_indicatorRegion->rect.Width() > 0)
         {
@@ -797,242 +1377,324 @@ bool ZepWindow::DisplayLine(SpanInfo& lineInfo, int displayPass)
                 return true;
             });
 
-            display.SetClipRect(m_bufferRegion->rect);
+            display.SetClipRect(m_textRegion->rect);
         }
 
         if (m_numberRegion->rect.Width() > 0)
         {
             display.SetClipRect(m_numberRegion->rect);
             displayLineNumber();
-            display.SetClipRect(m_bufferRegion->rect);
+            display.SetClipRect(m_textRegion->rect);
         }
     }
 
+    // The screen position of each code point, and of the end of them.  Only the code points which start inside the
+    // view are drawn; a long line which isn't wrapped can go a long way past it
+    const auto codePointCount = lineInfo.CodePointCount();
+    m_codePointX.clear();
     auto screenPosX = m_textRegion->rect.Left() + m_xPad;
+    size_t codePointEnd = 0;
+    for (; codePointEnd < codePointCount && screenPosX < m_textRegion->rect.Right(); codePointEnd++)
+    {
+        m_codePointX.push_back(screenPosX);
+        screenPosX += lineInfo.CodePoint(codePointEnd).size.x + m_xPad;
+    }
+    m_codePointX.push_back(screenPosX);
+    const auto visibleEnd = codePointEnd < codePointCount ? lineInfo.CodePointByteIndex(codePointEnd) : lineInfo.lineByteRange.second;
+
     auto pSyntax = m_pBuffer->GetSyntax();
 
+    // Resolve the syntax colors for the visible part of the line once, instead of asking per character
+    m_syntaxSpans.clear();
     if (pSyntax)
     {
         pSyntax->SetCurrentCursor(GetBufferCursor());
+        pSyntax->GetSyntaxSpans(lineInfo.lineByteRange.first, visibleEnd, m_syntaxSpans);
     }
 
+    // The first code point at or after a location
+    auto codePointAt = [&](ByteIndex loc) {
+        size_t low = 0;
+        size_t high = codePointEnd;
+        while (low < high)
+        {
+            auto mid = (low + high) / 2;
+            if (lineInfo.CodePointByteIndex(mid) < loc)
+            {
+                low = mid + 1;
+            }
+            else
+            {
+                high = mid;
+            }
+        }
+        return low;
+    };
+
+    const auto lineTop = ToWindowY(lineInfo.yOffsetPx);
+    const auto lineBottom = ToWindowY(lineInfo.yOffsetPx + lineInfo.FullLineHeightPx());
+
+    // The area covered by the characters of a range which fall on this span
+    auto rangeRect = [&](const BufferByteRange& range, NRectf& rect) {
+        auto first = codePointAt(std::max(range.first, lineInfo.lineByteRange.first));
+        auto last = range.second >= visibleEnd ? codePointEnd : codePointAt(range.second);
+        if (first >= last)
+        {
+            return false;
+        }
+        rect = NRectf(NVec2f(m_codePointX[first], lineTop), NVec2f(m_codePointX[last] - m_xPad, lineBottom));
+        return true;
+    };
+
     auto tipTimeSeconds = timer_get_elapsed_seconds(m_toolTipTimer);
 
-    display.SetClipRect(m_textRegion->rect);
+    if (displayPass == WindowPass::Background)
+    {
+        // If the syntax overrides the background, show it first; one rectangle for each run of the same color
+        NRectf backgroundRect;
+        NVec4f backgroundColor;
+        bool hasBackground = false;
+        for (auto& span : m_syntaxSpans)
+        {
+            NRectf spanRect;
+            if (!span.hasBackground || !rangeRect(BufferByteRange(span.start, span.end), spanRect))
+            {
+                continue;
+            }
+
+            if (hasBackground && backgroundColor == span.background && backgroundRect.Right() + m_xPad >= spanRect.Left())
+            {
+                backgroundRect.bottomRightPx.x = spanRect.Right();
+                continue;
+            }
+
+            if (hasBackground)
+            {
+                display.DrawRectFilled(backgroundRect, backgroundColor);
+            }
+            backgroundRect = spanRect;
+            backgroundColor = span.background;
+            hasBackground = true;
+        }
+
+        if (hasBackground)
+        {
+            display.DrawRectFilled(backgroundRect, backgroundColor);
+        }
+
+        // Show any markers
+        m_pBuffer->ForEachMarker(RangeMarkerType::All, SearchDirection::Forward, lineInfo.lineByteRange.first, visibleEnd, [&](const std::shared_ptr<RangeMarker>& marker) {
+            // Don't show hidden markers
+            NRectf markerRect;
+            if (marker->displayType == RangeMarkerDisplayType::Hidden || !rangeRect(marker->range, markerRect))
+            {
+                return true;
+            }
+
+            if (marker->displayType & RangeMarkerDisplayType::Underline)
+            {
+                display.DrawRectFilled(NRectf(NVec2f(markerRect.Left(), lineBottom - 1), NVec2f(markerRect.Right(), lineBottom)), m_pBuffer->GetTheme().GetColor(marker->highlightColor));
+            }
+
+            if (marker->displayType & RangeMarkerDisplayType::Background)
+            {
+                display.DrawRectFilled(markerRect, m_pBuffer->GetTheme().GetColor(marker->backgroundColor));
+            }
+
+            // If this marker has an associated tooltip, pop it up after a time delay
+            // TODO: Make tooltip generation seperate to this display loop
+            if (m_toolTips.empty() && !m_tipDisabledTillMove && (tipTimeSeconds > 0.5f))
+            {
+                bool showTip = false;
+                if (marker->displayType & RangeMarkerDisplayType::Tooltip)
+                {
+                    if (marker->ContainsLocation(m_mouseBufferLocation) && lineInfo.BufferCursorInside(m_mouseBufferLocation))
+                    {
+                        showTip = true;
+                    }
+                }
+
+                // If we want the tip showing at anywhere on the line, show it
+                if (marker->displayType & RangeMarkerDisplayType::TooltipAtLine)
+                {
+                    // TODO: This should be a helper function
+                    // Checks for mouse pos inside a line string
+                    if (m_mouseHoverPos.y >= lineTop && m_mouseHoverPos.y < (lineTop + defaultCharSize.y) && (m_mouseHoverPos.x < m_textRegion->rect.topLeftPx.x + lineInfo.ByteLength() * defaultCharSize.x))
+                    {
+                        showTip = true;
+                    }
+                }
+
+                if (showTip)
+                {
+                    // Register this tooltip
+                    m_toolTips[NVec2f(m_mouseHoverPos.x, m_mouseHoverPos.y + textBorder)] = marker;
+                }
+            }
+            return true;
+        });
+
+        // Draw the visual selection marker second
+        if (IsActiveWindow() && GetBuffer().HasSelection())
+        {
+            NRectf selectionRect;
+            if (rangeRect(m_pBuffer->GetSelection(), selectionRect))
+            {
+                display.DrawRectFilled(selectionRect, m_pBuffer->GetTheme().GetColor(ThemeColor::VisualSelectBackground));
+            }
+        }
+
+        // If active window and this is the cursor char then display the marker as a priority over what we would have shown
+        auto cursorIndex = codePointAt(m_bufferCursor);
+        if (IsActiveWindow() && cursorIndex < codePointEnd && lineInfo.CodePointByteIndex(cursorIndex) == m_bufferCursor && (!cursorBlink || cursorType == CursorType::LineMarker))
+        {
+            auto cursorX = m_codePointX[cursorIndex];
+            switch (cursorType)
+            {
+            default:
+            case CursorType::None:
+                break;
+
+            case CursorType::LineMarker: {
+                display.SetClipRect(NRectf());
+                auto posX = m_indicatorRegion->rect.Right() - DPI_X(2.0f);
+                display.DrawRectFilled(NRectf(
+                                           NVec2f(posX, lineTop),
+                                           NVec2f(posX + DPI_X(2.0f), lineBottom)),
+                    m_pBuffer->GetTheme().GetColor(ThemeColor::CursorNormal));
+                display.SetClipRect(m_textRegion->rect);
+            }
+            break;
+
+            case CursorType::Insert: {
+                display.DrawRectFilled(NRectf(
+                                           NVec2f(cursorX, lineTop),
+                                           NVec2f(cursorX + DPI_X(1.0f), lineBottom)),
+                    m_pBuffer->GetTheme().GetColor(ThemeColor::CursorInsert));
+            }
+            break;
+
+            case CursorType::Normal:
+            case CursorType::Visual: {
+                display.DrawRectFilled(NRectf(
+                                           NVec2f(cursorX, lineTop),
+                                           NVec2f(cursorX + lineInfo.CodePoint(cursorIndex).size.x, lineBottom)),
+                    m_pBuffer->GetTheme().GetColor(ThemeColor::CursorNormal));
+            }
+            break;
+            }
+        }
+        return true;
+    }
+
+    // Second pass, characters
+    DrawLineWidgets(lineInfo);
+
+    // Characters of the same color are drawn together.  The font places them next to each other, so this only
+    // works when there is no padding between them
+    const auto textY = ToWindowY(lineInfo.yOffsetPx + lineInfo.padding.x);
+    const bool batchRuns = m_xPad == 0.0f;
+    float runX = 0.0f;
+    NVec4f runColor;
+    m_drawRun.clear();
+    auto flushRun = [&]() {
+        if (!m_drawRun.empty())
+        {
+            display.DrawChars(NVec2f(runX, textY), runColor, (const uint8_t*)m_drawRun.data(), (const uint8_t*)m_drawRun.data() + m_drawRun.size());
+            m_drawRun.clear();
+        }
+    };
+
+    auto itrSpan = m_syntaxSpans.cbegin();
 
-    //auto pText = &m_pBuffer->GetText()[0];
-    // Walk from the start of the line to the end of the line (in buffer chars)
-    for (auto cp : lineInfo.lineCodePoints)
+    // Walk from the start of the line to the edge of the view (in buffer chars)
+    for (size_t index = 0; index < codePointEnd; index++)
     {
+        auto cp = lineInfo.CodePoint(index);
+        auto byteIndex = lineInfo.lineByteRange.first + cp.byteOffset;
+        screenPosX = m_codePointX[index];
+
         const uint8_t* pCh;
         const uint8_t* pEnd;
         SpecialChar special;
-        GetCharPointer(cp.byteIndex, pCh, pEnd, special);
+        GetCharPointer(byteIndex, pCh, pEnd, special);
 
-        // TODO : Cache this for speed - a little sluggish on debug builds.
-        if (displayPass == WindowPass::Background)
+        if ((special == SpecialChar::Hidden) && !(GetWindowFlags() & WindowFlags::ShowCR))
         {
-            NRectf charRect(NVec2f(screenPosX, ToWindowY(lineInfo.yOffsetPx)), NVec2f(screenPosX + cp.size.x, ToWindowY(lineInfo.yOffsetPx + lineInfo.FullLineHeightPx())));
-            if (charRect.Contains(m_mouseHoverPos))
-            {
-                // Record the mouse-over buffer location
-                m_mouseBufferLocation = cp.byteIndex;
-            }
-
-            // If the syntax overrides the background, show it first
-            if (pSyntax)
-            {
-                auto syntaxResult = pSyntax->GetSyntaxAt(cp.byteIndex);
-                if (syntaxResult.background != ThemeColor::None)
-                {
-                    auto themeCol = pSyntax->ToBackgroundColor(syntaxResult);
-                    display.DrawRectFilled(charRect, themeCol);
-                }
-            }
-
-            // Show any markers
-            m_pBuffer->ForEachMarker(RangeMarkerType::All, SearchDirection::Forward, lineInfo.lineByteRange.first, lineInfo.lineByteRange.second, [&](const std::shared_ptr<RangeMarker>& marker) {
-                // Don't show hidden markers
-                if (marker->displayType == RangeMarkerDisplayType::Hidden)
-                {
-                    return true;
-                }
-
-                auto sel = marker->range;
-                if (marker->ContainsLocation(cp.byteIndex))
-                {
-                    if (marker->displayType & RangeMarkerDisplayType::Underline)
-                    {
-                        display.DrawRectFilled(NRectf(NVec2f(screenPosX, ToWindowY(lineInfo.yOffsetPx + lineInfo.FullLineHeightPx()) - 1), NVec2f(screenPosX + cp.size.x, ToWindowY(lineInfo.yOffsetPx + lineInfo.FullLineHeightPx()))), m_pBuffer->GetTheme().GetColor(marker->highlightColor));
-                    }
-
-                    if (marker->displayType & RangeMarkerDisplayType::Background)
-                    {
-                        display.DrawRectFilled(charRect, m_pBuffer->GetTheme().GetColor(marker->backgroundColor));
-                    }
+            continue;
+        }
 
-                    // If this marker has an associated tooltip, pop it up after a time delay
-                    // TODO: Make tooltip generation seperate to this display loop
-                    if (m_toolTips.empty() && !m_tipDisabledTillMove && (tipTimeSeconds > 0.5f))
-                    {
-                        bool showTip = false;
-                        if (marker->displayType & RangeMarkerDisplayType::Tooltip)
-                        {
-                            if (m_mouseBufferLocation == cp.byteIndex)
-                            {
-                                showTip = true;
-                            }
-                        }
+        while (itrSpan != m_syntaxSpans.cend() && itrSpan->end <= byteIndex)
+        {
+            itrSpan++;
+        }
+        const SyntaxSpan* pSpan = (itrSpan != m_syntaxSpans.cend() && itrSpan->start <= byteIndex) ? &*itrSpan : nullptr;
 
-                        // If we want the tip showing at anywhere on the line, show it
-                        if (marker->displayType & RangeMarkerDisplayType::TooltipAtLine)
-                        {
-                            // TODO: This should be a helper function
-                            // Checks for mouse pos inside a line string
-                            if (m_mouseHoverPos.y >= ToWindowY(lineInfo.yOffsetPx) && m_mouseHoverPos.y < (ToWindowY(lineInfo.yOffsetPx) + cp.size.y) && (m_mouseHoverPos.x < m_textRegion->rect.topLeftPx.x + lineInfo.ByteLength() * cp.size.x))
-                            {
-                                showTip = true;
-                            }
-                        }
+        auto centerY = lineTop + cp.size.y / 2;
+        auto centerChar = NVec2f(screenPosX + cp.size.x / 2, centerY);
+        NVec4f col;
+        if (special == SpecialChar::Hidden)
+        {
+            col = m_pBuffer->GetTheme().GetColor(ThemeColor::HiddenText);
+        }
+        else if (pSpan && pSpan->hasForeground)
+        {
+            col = pSpan->foreground;
+        }
+        else
+        {
+            col = m_pBuffer->GetTheme().GetColor(ThemeColor::Text);
+        }
 
-                        if (showTip)
-                        {
-                            // Register this tooltip
-                            m_toolTips[NVec2f(m_mouseHoverPos.x, m_mouseHoverPos.y + textBorder)] = marker;
-                        }
-                    }
-                }
-                return true;
-            });
+        // If this is the cursor char we override the colors
+        auto ws = whiteSpaceCol;
+        if (IsActiveWindow() && (byteIndex == m_bufferCursor) && !cursorBlink && cursorType == CursorType::Normal)
+        {
+            col = m_pBuffer->GetTheme().GetComplement(m_pBuffer->GetTheme().GetColor(ThemeColor::CursorNormal));
+            ws = col;
+        }
 
-            // Draw the visual selection marker second
-            if (IsActiveWindow())
+        if (special == SpecialChar::None)
+        {
+            if (m_drawRun.empty() || !(runColor == col))
             {
-                if (GetBuffer().HasSelection())
-                {
-                    auto sel = m_pBuffer->GetSelection();
-                    if (sel.ContainsLocation(cp.byteIndex))
-                    {
-                        display.DrawRectFilled(NRectf(NVec2f(screenPosX, ToWindowY(lineInfo.yOffsetPx)), NVec2f(screenPosX + cp.size.x, ToWindowY(lineInfo.yOffsetPx + lineInfo.FullLineHeightPx()))), m_pBuffer->GetTheme().GetColor(ThemeColor::VisualSelectBackground));
-                    }
-                }
+                flushRun();
+                runX = screenPosX;
+                runColor = col;
             }
-           
-            // If active window and this is the cursor char then display the marker as a priority over what we would have shown
-            if (IsActiveWindow() &&
-                (cp.byteIndex == m_bufferCursor) && (!cursorBlink || cursorType == CursorType::LineMarker))
+            m_drawRun.append((const char*)pCh, (const char*)pEnd);
+            if (!batchRuns)
             {
-                auto height = lineInfo.FullLineHeightPx();
-                switch (cursorType)
-                {
-                default:
-                case CursorType::None:
-                    break;
-
-                case CursorType::LineMarker: {
-                    display.SetClipRect(NRectf());
-                    auto posX = m_indicatorRegion->rect.Right() - DPI_X(2.0f);
-                    GetEditor().GetDisplay().DrawRectFilled(NRectf(
-                        NVec2f(posX, ToWindowY(lineInfo.yOffsetPx)),
-                        NVec2f(posX + DPI_X(2.0f), ToWindowY(lineInfo.yOffsetPx + height))),
-                        m_pBuffer->GetTheme().GetColor(ThemeColor::CursorNormal));
-                    display.SetClipRect(m_textRegion->rect);
-                }
-                break;
-
-                case CursorType::Insert: {
-                    GetEditor().GetDisplay().DrawRectFilled(NRectf(
-                        NVec2f(screenPosX, ToWindowY(lineInfo.yOffsetPx)),
-                        NVec2f(screenPosX + DPI_X(1.0f), ToWindowY(lineInfo.yOffsetPx + height))),
-                        m_pBuffer->GetTheme().GetColor(ThemeColor::CursorInsert));
-                }
-                break;
+                flushRun();
+            }
+        }
+        else if (special == SpecialChar::Space)
+        {
+            // A space shows nothing, so it can carry on a run of any color
+            if (batchRuns && !m_drawRun.empty())
+            {
+                m_drawRun.push_back(' ');
+            }
 
-                case CursorType::Normal:
-                case CursorType::Visual: {
-                    GetEditor().GetDisplay().DrawRectFilled(NRectf(
-                        NVec2f(screenPosX, ToWindowY(lineInfo.yOffsetPx)),
-                        NVec2f(screenPosX + cp.size.x, ToWindowY(lineInfo.yOffsetPx + height))),
-                        m_pBuffer->GetTheme().GetColor(ThemeColor::CursorNormal));
-                }
-                break;
-                }
+            if (GetWindowFlags() & WindowFlags::ShowWhiteSpace)
+            {
+                // A dot
+                display.DrawRectFilled(NRectf(centerChar - DPI_VEC2(NVec2f(1.0f, 1.0f)), centerChar + DPI_VEC2(NVec2f(1.0f, 1.0f))), ws);
             }
         }
-        // Second pass, characters
         else
         {
-            DrawLineWidgets(lineInfo);
-
-            if ((special != SpecialChar::Hidden) || GetWindowFlags() & WindowFlags::ShowCR)
+            flushRun();
+            if (special == SpecialChar::Tab && (GetWindowFlags() & WindowFlags::ShowWhiteSpace))
             {
-                auto centerY = ToWindowY(lineInfo.yOffsetPx) + cp.size.y / 2;
-                auto centerChar = NVec2f(screenPosX + cp.size.x / 2, centerY);
-                NVec4f col;
-                if (special == SpecialChar::Hidden)
-                {
-                    col = m_pBuffer->GetTheme().GetColor(ThemeColor::HiddenText);
-                }
-                else
-                {
-                    if (pSyntax)
-                    {
-                        auto syntaxResult = pSyntax->GetSyntaxAt(cp.byteIndex);
-                        if (syntaxResult.foreground != ThemeColor::None)
-                        {
-                            col = pSyntax->ToForegroundColor(syntaxResult);
-                        }
-                        else
-                        {
-                            col = m_pBuffer->GetTheme().GetColor(ThemeColor::Text);
-                        }
-                    }
-                    else
-                    {
-                        col = m_pBuffer->GetTheme().GetColor(ThemeColor::Text);
-                    }
-                }
-          
-                // If this is the cursor char we override the colors
-                auto ws = whiteSpaceCol;
-                if (IsActiveWindow() && 
-                    (cp.byteIndex == m_bufferCursor) &&
-                    !cursorBlink &&
-                    cursorType == CursorType::Normal)
-                {
-                    col = m_pBuffer->GetTheme().GetComplement(m_pBuffer->GetTheme().GetColor(ThemeColor::CursorNormal));
-                    ws = col;
-                }
-
-                if (special == SpecialChar::None)
-                {
-                    display.DrawChars(NVec2f(screenPosX, ToWindowY(lineInfo.yOffsetPx + lineInfo.padding.x)), col, pCh, pEnd);
-                }
-                else if (special == SpecialChar::Tab)
-                {
-                    if (GetWindowFlags() & WindowFlags::ShowWhiteSpace)
-                    {
-                        // A line and an arrow
-                        display.DrawLine(NVec2f(screenPosX + defaultCharSize.x / 2, centerY), NVec2f(screenPosX + cp.size.x - defaultCharSize.x / 4, centerY), ws, 2);
-                        display.DrawLine(NVec2f(screenPosX, ToWindowY(lineInfo.yOffsetPx)), NVec2f(screenPosX + defaultCharSize.x / 2, centerY), ws, 2);
-                        display.DrawLine(NVec2f(screenPosX, ToWindowY(lineInfo.yOffsetPx + cp.size.y)), NVec2f(screenPosX + defaultCharSize.x / 2, centerY), ws, 2);
-                    }
-                }
-                else if (special == SpecialChar::Space)
-                {
-                    if (GetWindowFlags() & WindowFlags::ShowWhiteSpace)
-                    {
-                        // A dot
-                        display.DrawRectFilled(NRectf(centerChar - DPI_VEC2(NVec2f(1.0f, 1.0f)), centerChar + DPI_VEC2(NVec2f(1.0f, 1.0f))), ws);
-                    }
-                }
+                // A line and an arrow
+                display.DrawLine(NVec2f(screenPosX + defaultCharSize.x / 2, centerY), NVec2f(screenPosX + cp.size.x - defaultCharSize.x / 4, centerY), ws, 2);
+                display.DrawLine(NVec2f(screenPosX, lineTop), NVec2f(screenPosX + defaultCharSize.x / 2, centerY), ws, 2);
+                display.DrawLine(NVec2f(screenPosX, ToWindowY(lineInfo.yOffsetPx + cp.size.y)), NVec2f(screenPosX + defaultCharSize.x / 2, centerY), ws, 2);
             }
         }
-
-        screenPosX += cp.size.x + m_xPad;
     }
-
-    display.SetClipRect(NRectf{});
+    flushRun();
 
     return true;
 }
@@ -1094,7 +1756,7 @@ long ZepWindow::GetMaxDisplayLines()
 long ZepWindow::GetNumDisplayedLines()
 {
     UpdateLayout();
-    return std::min((long)m_windowLines.size(), GetMaxDisplayLines());
+    return std::min(GetSpanCount(), GetMaxDisplayLines());
 }
 
 void ZepWindow::SetBufferCursor(ByteIndex location)
@@ -1121,6 +1783,9 @@ void ZepWindow::SetBuffer(ZepBuffer* pBuffer)
 {
     assert(pBuffer);
 
+    GetEditor().Unsubscribe(this, Msg::Buffer, m_pBuffer);
+    GetEditor().Subscribe(this, Msg::Buffer, pBuffer);
+
     m_pBuffer = pBuffer;
     m_layoutDirty = true;
     m_textOffsetPx = 0;
@@ -1173,8 +1838,11 @@ void ZepWindow::DisplayScrollers()
 
 void ZepWindow::UpdateLayout(bool force)
 {
-    if (m_layoutDirty || force)
+    if (m_layoutDirty || force || m_dirtyFirstLine != -1)
     {
+        // Edits only need the changed lines laid out again
+        bool fullLayout = m_layoutDirty || force;
+
         // Border, and move the text across a bit
         if (ZTestFlags(GetWindowFlags(), WindowFlags::ShowLineNumbers) && GetEditor().GetConfig().showLineNumbers)
         {
@@ -1203,13 +1871,15 @@ void ZepWindow::UpdateLayout(bool force)
             // First layout
             LayoutRegion(*m_bufferRegion);
 
-            // Then update the text alignment
-            UpdateLineSpans();
+            // Then update the text alignment; lines wrapped at another width must all be wrapped again
+            fullLayout |= m_textRegion->rect.Width() != m_layoutWidthPx;
+            m_layoutWidthPx = m_textRegion->rect.Width();
+            UpdateLineSpans(fullLayout);
         }
         else
         {
             // First update the text, since it is always the same size without wrapping
-            UpdateLineSpans();
+            UpdateLineSpans(fullLayout);
 
             // Fix the edit region size at the text size
             m_editRegion->flags = RegionFlags::AlignCenter;
@@ -1249,17 +1919,12 @@ void ZepWindow::GetCursorInfo(NVec2f& pos, NVec2f& size)
     bool found = false;
     float xPos = m_textRegion->rect.topLeftPx.x + m_xPad;
 
-    int count = 0;
-    for (auto ch : cursorBufferLine.lineCodePoints)
+    auto count = std::min(size_t(std::max(0l, cursorCL.x)), cursorBufferLine.CodePointCount());
+    xPos += cursorBufferLine.CodePointX(count, m_xPad);
+    if (count < cursorBufferLine.CodePointCount())
     {
-        if (count == cursorCL.x)
-        {
-            found = true;
-            cursorSize = ch.size;
-            break;
-        }
-        count++;
-        xPos += ch.size.x + m_xPad;
+        found = true;
+        cursorSize = cursorBufferLine.CodePoint(count).size;
     }
 
     // If it's a tab, we show a cursor of standard width at the beginning of it
@@ -1357,11 +2022,11 @@ void ZepWindow::DisplayGridMarkers()
     /*
     for (long windowLine = m_visibleLineIndices.x; windowLine < m_visibleLineIndices.y; windowLine++)
     {
-        auto& lineInfo = *m_windowLines[windowLine];
+        auto& lineInfo = GetSpan(windowLine);
         auto pos = m_textRegion->rect.topLeftPx + NVec2f(m_xPad, 0.0f);
-        for (int i = 0; i < lineInfo.lineCodePoints.size(); i++)
+        for (size_t i = 0; i < lineInfo.CodePointCount(); i++)
         {
-            auto cp = lineInfo.lineCodePoints[i];
+            auto cp = lineInfo.CodePoint(i);
 
             if (i != 0 && i % 8 == 0)
             {
@@ -1373,6 +2038,72 @@ void ZepWindow::DisplayGridMarkers()
     */
 }
 
+void ZepWindow::InvalidateDisplay()
+{
+    m_redrawAll = true;
+}
+
+void ZepWindow::InvalidateLines(long firstLine, long lastLine)
+{
+    if (firstLine > lastLine)
+    {
+        return;
+    }
+
+    // Merge with a range it touches; there are only ever a few
+    for (auto& range : m_redrawLines)
+    {
+        if (firstLine <= range.y + 1 && lastLine >= range.x - 1)
+        {
+            range.x = std::min(range.x, firstLine);
+            range.y = std::max(range.y, lastLine);
+            return;
+        }
+    }
+    m_redrawLines.push_back(NVec2<long>(firstLine, lastLine));
+}
+
+bool ZepWindow::IsLineInvalid(long bufferLine) const
+{
+    for (auto& range : m_redrawLines)
+    {
+        if (bufferLine >= range.x && bufferLine <= range.y)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Fill the backgrounds of the text, line number and indicator regions between two heights
+void ZepWindow::DisplayBackgrounds(float top, float bottom)
+{
+    auto& display = GetEditor().GetDisplay();
+    auto fill = [&](const NRectf& rect, ThemeColor color) {
+        auto area = NRectf(NVec2f(rect.Left(), std::max(top, rect.Top())), NVec2f(rect.Right(), std::min(bottom, rect.Bottom())));
+        if (area.Width() > 0 && area.Height() > 0)
+        {
+            display.DrawRectFilled(area, GetBlendedColor(color));
+        }
+    };
+
+    if (GetEditor().GetConfig().style == EditorStyle::Normal)
+    {
+        // Fill the background color for the whole area, only in normal mode.
+        fill(m_textRegion->rect, ThemeColor::Background);
+    }
+
+    if (m_numberRegion->rect.Width() > 0)
+    {
+        fill(m_numberRegion->rect, ThemeColor::LineNumberBackground);
+    }
+
+    if (m_indicatorRegion->rect.Width() > 0)
+    {
+        fill(m_indicatorRegion->rect, ThemeColor::LineNumberBackground);
+    }
+}
+
 void ZepWindow::Display()
 {
     TIME_SCOPE(Display);
@@ -1399,50 +2130,140 @@ void ZepWindow::Display()
 
     auto& display = GetEditor().GetDisplay();
     auto cursorCL = BufferToDisplay(m_bufferCursor);
-    m_mouseBufferLocation = ByteIndex{ -1 };
+    m_mouseBufferLocation = ScreenToBuffer(m_mouseHoverPos);
 
     // Always update
     UpdateAirline();
 
     UpdateLayout();
 
-    if (GetEditor().GetConfig().style == EditorStyle::Normal)
+    // A display which keeps the last frame only needs the lines which changed, unless the window moved, scrolled or
+    // changed in some way that affects all of it
+    WindowFrameState frameState;
+    frameState.textRect = m_textRegion->rect;
+    frameState.numberRect = m_numberRegion->rect;
+    frameState.indicatorRect = m_indicatorRegion->rect;
+    frameState.textOffsetPx = m_textOffsetPx;
+    frameState.textSizePx = m_textSizePx;
+    frameState.windowFlags = GetWindowFlags();
+    frameState.cursorType = pMode->GetCursorType();
+    frameState.active = IsActiveWindow();
+    frameState.fastUpdate = ZTestFlags(GetEditor().GetFlags(), ZepEditorFlags::FastUpdate);
+    frameState.toolTips = !m_toolTips.empty();
+    frameState.mouseOverScroller = m_vScrollRegion->rect.Contains(GetEditor().GetMousePos());
+    frameState.cursor = m_bufferCursor;
+    frameState.cursorBlink = GetEditor().GetCursorBlinkState();
+    frameState.mouseLocation = m_mouseBufferLocation;
+    frameState.selection = m_pBuffer->HasSelection() ? m_pBuffer->GetSelection() : BufferByteRange(0, 0);
+
+    std::ostringstream airlineText;
+    for (auto& airline : pMode->GetAirlines(*this))
     {
-        // Fill the background color for the whole area, only in normal mode.
-        display.DrawRectFilled(m_textRegion->rect, GetBlendedColor(ThemeColor::Background));
+        for (auto& box : airline.leftBoxes)
+            airlineText << box.text << ToPacked(box.background);
+        for (auto& box : airline.rightBoxes)
+            airlineText << box.text << ToPacked(box.background);
     }
-
-    if (m_numberRegion->rect.Width() > 0)
+    for (auto& box : m_airline.leftBoxes)
+        airlineText << box.text << ToPacked(box.background);
+    for (auto& box : m_airline.rightBoxes)
+        airlineText << box.text << ToPacked(box.background);
+    auto strAirline = airlineText.str();
+    frameState.airlineHash = murmur_hash_64(strAirline.c_str(), uint32_t(strAirline.size()), 0);
+
+    bool redrawAll = m_redrawAll || !display.RetainsFrame() || frameState.fastUpdate || GetEditor().GetConfig().style != EditorStyle::Normal || ZTestFlags(GetWindowFlags(), WindowFlags::GridStyle) || !frameState.SameLayout(m_lastFrameState);
+    if (!redrawAll)
     {
-        display.DrawRectFilled(m_numberRegion->rect, GetBlendedColor(ThemeColor::LineNumberBackground));
+        // The lines the cursor left and arrived on
+        if (frameState.cursor != m_lastFrameState.cursor || frameState.cursorBlink != m_lastFrameState.cursorBlink)
+        {
+            auto lastLine = m_pBuffer->GetBufferLine(m_lastFrameState.cursor);
+            auto line = m_pBuffer->GetBufferLine(frameState.cursor);
+            InvalidateLines(lastLine, lastLine);
+            InvalidateLines(line, line);
+
+            // Relative line numbers all change
+            if (line != lastLine && m_displayMode == DisplayMode::Vim && frameState.cursorType != CursorType::None)
+            {
+                InvalidateLines(0, m_pBuffer->GetLineCount());
+            }
+        }
+
+        if (frameState.mouseLocation != m_lastFrameState.mouseLocation)
+        {
+            for (auto location : { frameState.mouseLocation, m_lastFrameState.mouseLocation })
+            {
+                if (location >= 0)
+                {
+                    auto line = m_pBuffer->GetBufferLine(location);
+                    InvalidateLines(line, line);
+                }
+            }
+        }
+
+        if (frameState.selection != m_lastFrameState.selection)
+        {
+            for (auto& selection : { frameState.selection, m_lastFrameState.selection })
+            {
+                if (selection.first != selection.second)
+                {
+                    InvalidateLines(m_pBuffer->GetBufferLine(selection.first), m_pBuffer->GetBufferLine(selection.second));
+                }
+            }
+        }
     }
 
-    if (m_indicatorRegion->rect.Width() > 0)
+    if (redrawAll)
     {
-        display.DrawRectFilled(m_indicatorRegion->rect, GetBlendedColor(ThemeColor::LineNumberBackground));
-    }
+        DisplayBackgrounds(m_bufferRegion->rect.Top(), m_bufferRegion->rect.Bottom());
 
-    DisplayScrollers();
+        DisplayScrollers();
 
-    // This is a line down the middle of a split
-    if (GetEditor().GetConfig().style == EditorStyle::Normal && !ZTestFlags(GetWindowFlags(), WindowFlags::HideSplitMark))
+        // This is a line down the middle of a split
+        if (GetEditor().GetConfig().style == EditorStyle::Normal && !ZTestFlags(GetWindowFlags(), WindowFlags::HideSplitMark))
+        {
+            display.DrawRectFilled(
+                NRectf(NVec2f(m_expandingEditRegion->rect.topLeftPx.x, m_expandingEditRegion->rect.topLeftPx.y), NVec2f(m_expandingEditRegion->rect.topLeftPx.x + 1, m_expandingEditRegion->rect.bottomRightPx.y)), GetBlendedColor(ThemeColor::TabInactive));
+        }
+    }
+    else if (!m_redrawLines.empty())
     {
-        display.DrawRectFilled(
-            NRectf(NVec2f(m_expandingEditRegion->rect.topLeftPx.x, m_expandingEditRegion->rect.topLeftPx.y), NVec2f(m_expandingEditRegion->rect.topLeftPx.x + 1, m_expandingEditRegion->rect.bottomRightPx.y)), GetBlendedColor(ThemeColor::TabInactive));
+        // Clear the lines being drawn again; when the text after them has moved, clear to the bottom
+        for (long windowLine = m_visibleLineIndices.x; windowLine < m_visibleLineIndices.y; windowLine++)
+        {
+            auto& lineInfo = GetSpan(windowLine);
+            if (IsLineInvalid(lineInfo.bufferLineNumber))
+            {
+                auto bottom = ToWindowY(lineInfo.yOffsetPx + lineInfo.FullLineHeightPx());
+                if (IsLineInvalid(m_pBuffer->GetLineCount() - 1))
+                {
+                    bottom = m_bufferRegion->rect.Bottom();
+                }
+                DisplayBackgrounds(ToWindowY(lineInfo.yOffsetPx), bottom);
+            }
+        }
     }
 
+    if (redrawAll || !m_redrawLines.empty())
     {
         TIME_SCOPE(DrawLine);
         for (int displayPass = 0; displayPass < WindowPass::Max; displayPass++)
         {
+            display.SetClipRect(m_textRegion->rect);
             for (long windowLine = m_visibleLineIndices.x; windowLine < m_visibleLineIndices.y; windowLine++)
             {
-                auto& lineInfo = *m_windowLines[windowLine];
+                auto& lineInfo = GetSpan(windowLine);
+                if (!redrawAll && !IsLineInvalid(lineInfo.bufferLineNumber))
+                {
+                    continue;
+                }
+
                 if (!DisplayLine(lineInfo, displayPass))
                 {
                     break;
                 }
             }
+            display.SetClipRect(NRectf{});
         }
     }
 
@@ -1512,7 +2333,7 @@ void ZepWindow::Display()
     // No tooltip, and we can show one, then ask for tooltips
     if (!m_tipDisabledTillMove && (timer_get_elapsed_seconds(m_toolTipTimer) > 0.5f) && m_toolTips.empty() && m_lastTipQueryPos != m_mouseHoverPos)
     {
-        auto spMsg = std::make_shared<ToolTipMessage>(m_pBuffer, m_mouseHoverPos, m_mouseBufferLocation);
+        auto spMsg = MakeMessage<ToolTipMessage>(m_pBuffer, m_mouseHoverPos, m_mouseBufferLocation);
         GetEditor().Broadcast(spMsg);
         if (spMsg->handled && spMsg->spMarker != nullptr)
         {
@@ -1528,74 +2349,91 @@ void ZepWindow::Display()
 
     display.SetClipRect(NRectf{});
 
-    if (!GetEditor().GetCommandText().empty() || (GetEditor().GetConfig().autoHideCommandRegion == false))
+    if (redrawAll || frameState.airlineHash != m_lastFrameState.airlineHash)
     {
-        auto modeAirlines = GetBuffer().GetMode()->GetAirlines(*this);
+        DisplayAirline();
+    }
 
-        // Airline and underline
-        display.DrawRectFilled(m_airlineRegion->rect, GetBlendedColor(ThemeColor::AirlineBackground));
+    // Tooltips are drawn over the text, so the frame after they go must draw everything again
+    frameState.toolTips = !m_toolTips.empty();
+    m_lastFrameState = frameState;
+    m_redrawAll = false;
+    m_redrawLines.clear();
 
-        auto airHeight = GetEditor().GetDisplay().GetFontHeightPixels();
-        auto border = 12.0f;
+    display.SetClipRect(NRectf{});
+}
 
-        NVec2f screenPosYPx = m_airlineRegion->rect.topLeftPx;
+void ZepWindow::DisplayAirline()
+{
+    if (GetEditor().GetCommandText().empty() && GetEditor().GetConfig().autoHideCommandRegion)
+    {
+        return;
+    }
 
-        auto drawAirline = [&](Airline& airline) {
-            display.SetClipRect(NRectf{});
-            for (int i = 0; i < (int)airline.leftBoxes.size(); i++)
-            {
-                auto pText = (const uint8_t*)airline.leftBoxes[i].text.c_str();
-                auto textSize = display.GetTextSize(pText, pText + airline.leftBoxes[i].text.size());
-                textSize.x += border * 2;
+    auto& display = GetEditor().GetDisplay();
+    auto modeAirlines = GetBuffer().GetMode()->GetAirlines(*this);
 
-                auto col = airline.leftBoxes[i].background;
-                display.DrawRectFilled(NRectf(screenPosYPx, NVec2f(textSize.x + screenPosYPx.x, screenPosYPx.y + airHeight)), col);
+    // Airline and underline
+    display.DrawRectFilled(m_airlineRegion->rect, GetBlendedColor(ThemeColor::AirlineBackground));
 
-                NVec4f textCol = m_pBuffer->GetTheme().GetComplement(airline.leftBoxes[i].background, IsActiveWindow() ? NVec4f(0.0f) : NVec4f(.5f, .5f, .5f, 0.0f));
-                display.DrawChars(screenPosYPx + NVec2f(border, 0.0f), textCol, (const uint8_t*)(airline.leftBoxes[i].text.c_str()));
-                screenPosYPx.x += textSize.x;
-            }
+    auto airHeight = GetEditor().GetDisplay().GetFontHeightPixels();
+    auto border = 12.0f;
 
-            // Clip to the remaining space
-            auto clipRect = NRectf(screenPosYPx.x, screenPosYPx.y, m_airlineRegion->rect.Right() - screenPosYPx.x, airHeight);
-            if (clipRect.Width() > 0 && clipRect.Height() > 0)
-            {
-                display.SetClipRect(clipRect);
+    NVec2f screenPosYPx = m_airlineRegion->rect.topLeftPx;
 
-                float totalRightSize = 0.0f;
-                for (int i = 0; i < (int)airline.rightBoxes.size(); i++)
-                {
-                    auto pText = (const uint8_t*)airline.rightBoxes[i].text.c_str();
-                    totalRightSize += display.GetTextSize(pText, pText + airline.rightBoxes[i].text.size()).x + border * 2;
-                }
+    auto drawAirline = [&](Airline& airline) {
+        display.SetClipRect(NRectf{});
+        for (int i = 0; i < (int)airline.leftBoxes.size(); i++)
+        {
+            auto pText = (const uint8_t*)airline.leftBoxes[i].text.c_str();
+            auto textSize = display.GetTextSize(pText, pText + airline.leftBoxes[i].text.size());
+            textSize.x += border * 2;
 
-                screenPosYPx.x = m_airlineRegion->rect.Right() - totalRightSize;
-                for (int i = 0; i < (int)airline.rightBoxes.size(); i++)
-                {
-                    auto pText = (const uint8_t*)airline.rightBoxes[i].text.c_str();
-                    auto textSize = display.GetTextSize(pText, pText + airline.rightBoxes[i].text.size());
-                    textSize.x += border * 2;
+            auto col = airline.leftBoxes[i].background;
+            display.DrawRectFilled(NRectf(screenPosYPx, NVec2f(textSize.x + screenPosYPx.x, screenPosYPx.y + airHeight)), col);
 
-                    auto col = airline.rightBoxes[i].background;
-                    display.DrawRectFilled(NRectf(screenPosYPx, NVec2f(textSize.x + screenPosYPx.x, screenPosYPx.y + airHeight)), col);
+            NVec4f textCol = m_pBuffer->GetTheme().GetComplement(airline.leftBoxes[i].background, IsActiveWindow() ? NVec4f(0.0f) : NVec4f(.5f, .5f, .5f, 0.0f));
+            display.DrawChars(screenPosYPx + NVec2f(border, 0.0f), textCol, (const uint8_t*)(airline.leftBoxes[i].text.c_str()));
+            screenPosYPx.x += textSize.x;
+        }
 
-                    NVec4f textCol = m_pBuffer->GetTheme().GetComplement(airline.rightBoxes[i].background, IsActiveWindow() ? NVec4f(0.0f) : NVec4f(.5f, .5f, .5f, 0.0f));
-                    display.DrawChars(screenPosYPx + NVec2f(border, 0.0f), textCol, (const uint8_t*)(airline.rightBoxes[i].text.c_str()));
-                    screenPosYPx.x += textSize.x;
-                }
+        // Clip to the remaining space
+        auto clipRect = NRectf(screenPosYPx.x, screenPosYPx.y, m_airlineRegion->rect.Right() - screenPosYPx.x, airHeight);
+        if (clipRect.Width() > 0 && clipRect.Height() > 0)
+        {
+            display.SetClipRect(clipRect);
+
+            float totalRightSize = 0.0f;
+            for (int i = 0; i < (int)airline.rightBoxes.size(); i++)
+            {
+                auto pText = (const uint8_t*)airline.rightBoxes[i].text.c_str();
+                totalRightSize += display.GetTextSize(pText, pText + airline.rightBoxes[i].text.size()).x + border * 2;
             }
-        };
 
-        for (auto& line : modeAirlines)
-        {
-            drawAirline(line);
-            screenPosYPx.y += airHeight;
-            screenPosYPx.x = m_airlineRegion->rect.Left();
+            screenPosYPx.x = m_airlineRegion->rect.Right() - totalRightSize;
+            for (int i = 0; i < (int)airline.rightBoxes.size(); i++)
+            {
+                auto pText = (const uint8_t*)airline.rightBoxes[i].text.c_str();
+                auto textSize = display.GetTextSize(pText, pText + airline.rightBoxes[i].text.size());
+                textSize.x += border * 2;
+
+                auto col = airline.rightBoxes[i].background;
+                display.DrawRectFilled(NRectf(screenPosYPx, NVec2f(textSize.x + screenPosYPx.x, screenPosYPx.y + airHeight)), col);
+
+                NVec4f textCol = m_pBuffer->GetTheme().GetComplement(airline.rightBoxes[i].background, IsActiveWindow() ? NVec4f(0.0f) : NVec4f(.5f, .5f, .5f, 0.0f));
+                display.DrawChars(screenPosYPx + NVec2f(border, 0.0f), textCol, (const uint8_t*)(airline.rightBoxes[i].text.c_str()));
+                screenPosYPx.x += textSize.x;
+            }
         }
-        drawAirline(m_airline);
-    }
+    };
 
-    display.SetClipRect(NRectf{});
+    for (auto& line : modeAirlines)
+    {
+        drawAirline(line);
+        screenPosYPx.y += airHeight;
+        screenPosYPx.x = m_airlineRegion->rect.Left();
+    }
+    drawAirline(m_airline);
 }
 
 void ZepWindow::MoveCursorY(int yDistance, LineLocation clampLocation)
@@ -1613,21 +2451,21 @@ void ZepWindow::MoveCursorY(int yDistance, LineLocation clampLocation)
     // Find the screen line relative target
     auto target = cursorCL + NVec2i(0, yDistance);
     target.y = std::max(0l, target.y);
-    target.y = std::min(target.y, long(m_windowLines.size() - 1));
+    target.y = std::min(target.y, GetSpanCount() - 1);
 
-    auto& line = *m_windowLines[target.y];
+    auto& line = GetSpan(target.y);
 
     // Snap to the new vertical column if necessary (see comment below)
     if (target.x < m_lastCursorColumn)
         target.x = m_lastCursorColumn;
 
-    assert(!line.lineCodePoints.empty());
+    assert(line.CodePointCount() != 0);
 
     // Move to the same codepoint offset on the line below
-    target.x = std::min(target.x, long(line.lineCodePoints.size() - 1));
+    target.x = std::min(target.x, long(line.CodePointCount()) - 1);
     target.x = std::max(target.x, long(0));
 
-    GlyphIterator cursorItr(*m_pBuffer, line.lineCodePoints[target.x].byteIndex);
+    GlyphIterator cursorItr(*m_pBuffer, line.CodePointByteIndex(target.x));
 
     // We can't call the buffer's LineLocation code, because when moving in span lines,
     // we are technically not moving in buffer lines; we are stepping in wrapped buffer lines.
@@ -1671,43 +2509,86 @@ NVec2i ZepWindow::BufferToDisplay(const ByteIndex& loc)
 {
     UpdateLayout();
 
+    // The cursor is asked for many times a frame
+    if (loc == m_displayCacheLocation && m_displayCacheVersion == m_layoutVersion)
+    {
+        return m_displayCachePos;
+    }
+
     NVec2i ret(0, 0);
-    int line_number = 0;
 
-    // TODO: Performance; quick lookup for line
-    for (auto& line : m_windowLines)
-    {
-        // If inside the line...
-        if (line->lineByteRange.first <= loc && line->lineByteRange.second > loc)
-        {
-            ret.y = line_number;
-            ret.x = 0;
+    // Only the spans of the buffer line can contain the location
+    auto& lineSpans = GetLineSpans(m_pBuffer->GetBufferLine(loc));
+    auto spanInLine = FindLineSpan(lineSpans, loc);
 
-            // Scan the code points for where we are
-            for (auto& ch : line->lineCodePoints)
-            {
-                if (ch.byteIndex == loc)
-                {
-                    return ret;
-                }
-                ret.x++;
-            }
-        }
-        line_number++;
+    long codePoint = -1;
+    if (spanInLine != -1)
+    {
+        codePoint = GetLineSpan(lineSpans, spanInLine).CodePointIndex(loc);
     }
 
-    assert(!m_windowLines.empty());
-    if (m_windowLines.empty())
+    if (codePoint != -1)
     {
-        return NVec2i(0, 0);
+        ret = NVec2i(codePoint, lineSpans.spanLineIndex + spanInLine);
+    }
+    else
+    {
+        // Max Last line, last code point offset
+        ret.y = GetSpanCount() - 1;
+        ret.x = long(GetSpan(ret.y).CodePointCount()) - 1;
     }
 
-    // Max Last line, last code point offset
-    ret.y = long(m_windowLines.size() - 1);
-    ret.x = long(m_windowLines[m_windowLines.size() - 1]->lineCodePoints.size() - 1);
+    m_displayCacheLocation = loc;
+    m_displayCacheVersion = m_layoutVersion;
+    m_displayCachePos = ret;
     return ret;
 }
 
+ByteIndex ZepWindow::DisplayToBuffer(const NVec2i& display)
+{
+    UpdateLayout();
+
+    auto& span = GetSpan(display.y);
+    if (span.CodePointCount() == 0)
+    {
+        return span.lineByteRange.first;
+    }
+    return span.CodePointByteIndex(std::max(0l, std::min(display.x, long(span.CodePointCount()) - 1)));
+}
+
+// The buffer location of the character under a point on the screen, or -1
+ByteIndex ZepWindow::ScreenToBuffer(const NVec2f& pos)
+{
+    if (!m_textRegion->rect.Contains(pos) || m_lineLayouts.Empty())
+    {
+        return ByteIndex{ -1 };
+    }
+
+    // Find the line, then the span in it
+    auto textY = pos.y - m_textRegion->rect.Top() + m_textOffsetPx;
+    auto bufferLine = m_lineLayouts.FindHeight(textY);
+    if (bufferLine >= m_lineLayouts.Size())
+    {
+        return ByteIndex{ -1 };
+    }
+
+    auto& lineSpans = GetLineSpans(bufferLine);
+    auto spanInLine = FindLineSpanAtY(lineSpans, textY);
+    if (spanInLine >= lineSpans.spanCount)
+    {
+        return ByteIndex{ -1 };
+    }
+
+    // Characters are drawn with a gap between them, which doesn't count as part of either
+    auto& span = GetLineSpan(lineSpans, spanInLine);
+    auto index = span.CodePointAtX(pos.x - (m_textRegion->rect.Left() + m_xPad), m_xPad);
+    if (index < 0)
+    {
+        return ByteIndex{ -1 };
+    }
+    return span.CodePointByteIndex(size_t(index));
+}
+
 } // namespace Zep
 
 #if 0
@@ -0,0 +1,285 @@
+// Applies a script of vim keys to many files, headless, a file per editor and an editor per core.
+// The script is typed into each file as it would be at the keyboard, in vim's notation for the keys that aren't
+// characters: <Esc>, <CR>, <Tab>, <BS>, <Del>, arrows, <Home>, <End>, <PageUp>, <PageDown>, <F1>..<F12>, <lt> for
+// '<', and C-, S- and A- for modifiers, as in <C-r>.  Line breaks in a script file are ignored, so a long script can
+// be split over lines.  Files the script changes are written back whole, through a temporary file renamed over the
+// old one, so a file is never left half written:
+//   zep_batch (--script <file> | --keys <keys>) [--jobs <count>] [--dry-run] (<file>... | --files <list>)
+#include "config_app.h"
+
+#include "zep/buffer.h"
+#include "zep/display.h"
+#include "zep/editor.h"
+#include "zep/filesystem.h"
+#include "zep/mode_vim.h"
+#include "zep/tab_window.h"
+#include "zep/window.h"
+
+#include "zep/mcommon/animation/timer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+using namespace Zep;
+
+namespace
+{
+
+struct BatchKey
+{
+    uint32_t key;
+    uint32_t modifiers;
+};
+
+struct BatchStats
+{
+    std::atomic<uint64_t> files = { 0 };
+    std::atomic<uint64_t> changed = { 0 };
+    std::atomic<uint64_t> failed = { 0 };
+    std::atomic<uint64_t> bytes = { 0 };
+};
+
+bool ParseKeyName(std::string name, BatchKey& key)
+{
+    key.modifiers = ModifierKey::None;
+    while (name.size() > 2 && name[1] == '-')
+    {
+        switch (toupper(name[0]))
+        {
+        case 'C':
+            key.modifiers |= ModifierKey::Ctrl;
+            break;
+        case 'S':
+            key.modifiers |= ModifierKey::Shift;
+            break;
+        case 'A':
+        case 'M':
+            key.modifiers |= ModifierKey::Alt;
+            break;
+        default:
+            return false;
+        }
+        name = name.substr(2);
+    }
+
+    if (name.size() == 1)
+    {
+        key.key = uint32_t(uint8_t(name[0]));
+        return true;
+    }
+
+    const std::pair<const char*, uint32_t> names[] = {
+        { "cr", ExtKeys::RETURN }, { "return", ExtKeys::RETURN }, { "enter", ExtKeys::RETURN }, { "esc", ExtKeys::ESCAPE },
+        { "escape", ExtKeys::ESCAPE }, { "bs", ExtKeys::BACKSPACE }, { "backspace", ExtKeys::BACKSPACE }, { "left", ExtKeys::LEFT },
+        { "right", ExtKeys::RIGHT }, { "up", ExtKeys::UP }, { "down", ExtKeys::DOWN }, { "tab", ExtKeys::TAB }, { "del", ExtKeys::DEL },
+        { "home", ExtKeys::HOME }, { "end", ExtKeys::END }, { "pagedown", ExtKeys::PAGEDOWN }, { "pageup", ExtKeys::PAGEUP },
+        { "lt", '<' }, { "space", ' ' }
+    };
+    auto lower = string_tolower(name);
+    for (auto& keyName : names)
+    {
+        if (lower == keyName.first)
+        {
+            key.key = keyName.second;
+            return true;
+        }
+    }
+
+    if (lower.size() > 1 && lower[0] == 'f')
+    {
+        auto number = atoi(lower.c_str() + 1);
+        if (number >= 1 && number <= 12)
+        {
+            key.key = ExtKeys::F1 + number - 1;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ParseScript(const std::string& script, std::vector<BatchKey>& keys, std::string& error)
+{
+    for (size_t pos = 0; pos < script.size(); pos++)
+    {
+        auto ch = script[pos];
+        if (ch == '\n' || ch == '\r')
+        {
+            continue;
+        }
+
+        BatchKey key{ uint32_t(uint8_t(ch)), ModifierKey::None };
+        auto close = script.find('>', pos + 1);
+        if (ch == '<' && close != std::string::npos && close > pos + 1)
+        {
+            if (!ParseKeyName(script.substr(pos + 1, close - pos - 1), key))
+            {
+                error = "Unknown key: " + script.substr(pos, close - pos + 1);
+                return false;
+            }
+            pos = close;
+        }
+        keys.push_back(key);
+    }
+    return true;
+}
+
+// One editor for all the files a worker takes; each file is a buffer that goes when it is done
+void RunWorker(const std::vector<std::string>& files, std::atomic<size_t>& nextFile, const std::vector<BatchKey>& keys, bool dryRun, BatchStats& stats, std::mutex& printMutex)
+{
+    auto pFileSystem = new ZepFileSystemCPP();
+    pFileSystem->SetAtomicWrite(true);
+
+    ZepEditor editor(new ZepDisplayNull(), ZEP_ROOT, ZepEditorFlags::DisableThreads | ZepEditorFlags::CoalesceInput, pFileSystem);
+    editor.SetGlobalMode(ZepMode_Vim::StaticName());
+    editor.SetDisplayRegion(NVec2f(0.0f, 0.0f), NVec2f(1920.0f, 1080.0f));
+
+    for (auto index = nextFile++; index < files.size(); index = nextFile++)
+    {
+        auto& path = files[index];
+        if (!editor.GetFileSystem().Exists(path) || editor.GetFileSystem().IsDirectory(path))
+        {
+            std::lock_guard<std::mutex> lock(printMutex);
+            printf("Not a file: %s\n", path.c_str());
+            stats.failed++;
+            continue;
+        }
+
+        auto pBuffer = editor.InitWithFileOrDir(path);
+        auto pWindow = editor.GetActiveTabWindow()->GetActiveWindow();
+        stats.bytes += pBuffer->GetText().size() - 1;
+
+        auto pMode = pWindow->GetBuffer().GetMode();
+        for (auto& key : keys)
+        {
+            pMode->AddKeyPress(key.key, key.modifiers);
+        }
+        editor.FlushInput();
+
+        stats.files++;
+        if (pBuffer->HasFileFlags(FileFlags::Dirty))
+        {
+            int64_t size = 0;
+            if (dryRun || pBuffer->Save(size))
+            {
+                stats.changed++;
+            }
+            else
+            {
+                std::lock_guard<std::mutex> lock(printMutex);
+                printf("Failed to write: %s\n", path.c_str());
+                stats.failed++;
+            }
+        }
+        editor.RemoveBuffer(pBuffer);
+    }
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    std::string script;
+    std::vector<std::string> files;
+    auto jobs = std::max(1u, std::thread::hardware_concurrency());
+    bool dryRun = false;
+    bool haveScript = false;
+    bool usage = false;
+    for (int arg = 1; arg < argc && !usage; arg++)
+    {
+        if (strcmp(argv[arg], "--script") == 0 && arg + 1 < argc)
+        {
+            std::ifstream in(argv[++arg], std::ios::in | std::ios::binary);
+            if (!in)
+            {
+                printf("Can't read script: %s\n", argv[arg]);
+                return 1;
+            }
+            std::ostringstream str;
+            str << in.rdbuf();
+            script = str.str();
+            haveScript = true;
+        }
+        else if (strcmp(argv[arg], "--keys") == 0 && arg + 1 < argc)
+        {
+            script = argv[++arg];
+            haveScript = true;
+        }
+        else if (strcmp(argv[arg], "--jobs") == 0 && arg + 1 < argc)
+        {
+            jobs = std::max(1u, uint32_t(atoi(argv[++arg])));
+        }
+        else if (strcmp(argv[arg], "--dry-run") == 0)
+        {
+            dryRun = true;
+        }
+        else if (strcmp(argv[arg], "--files") == 0 && arg + 1 < argc)
+        {
+            std::ifstream in(argv[++arg]);
+            std::string line;
+            while (std::getline(in, line))
+            {
+                Trim(line);
+                if (!line.empty())
+                {
+                    files.push_back(line);
+                }
+            }
+        }
+        else if (argv[arg][0] != '-')
+        {
+            files.push_back(argv[arg]);
+        }
+        else
+        {
+            usage = true;
+        }
+    }
+
+    if (usage || !haveScript || files.empty())
+    {
+        printf("Usage: zep_batch (--script <file> | --keys <keys>) [--jobs <count>] [--dry-run] (<file>... | --files <list>)\n");
+        return 1;
+    }
+
+    std::vector<BatchKey> keys;
+    std::string error;
+    if (!ParseScript(script, keys, error))
+    {
+        printf("%s\n", error.c_str());
+        return 1;
+    }
+
+    jobs = std::min(jobs, uint32_t(files.size()));
+
+    BatchStats stats;
+    std::atomic<size_t> nextFile(0);
+    std::mutex printMutex;
+
+    timer batchTimer;
+    timer_restart(batchTimer);
+
+    std::vector<std::thread> workers;
+    for (uint32_t job = 0; job < jobs; job++)
+    {
+        workers.emplace_back([&]() {
+            RunWorker(files, nextFile, keys, dryRun, stats, printMutex);
+        });
+    }
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+
+    auto seconds = std::max(timer_get_elapsed_seconds(batchTimer), 1e-6);
+    printf("%llu files, %llu changed%s, %llu failed, %.2f MB in %.3f s with %u jobs: %.1f files/s, %.2f MB/s\n",
+        (unsigned long long)stats.files, (unsigned long long)stats.changed, dryRun ? " (not written)" : "", (unsigned long long)stats.failed,
+        stats.bytes / (1024.0 * 1024.0), seconds, jobs, stats.files / seconds, stats.bytes / (1024.0 * 1024.0) / seconds);
+    return stats.failed == 0 ? 0 : 2;
+}